@@ -13,7 +13,6 @@
 #include "common/configuration.h"
 #include "proto/txn.pb.h"
 
-// #define PREFETCHING
 #define COLD_CUTOFF 990000
 
 // Fills '*keys' with num_keys unique ints k where
@@ -136,7 +135,7 @@ int Microbenchmark::Execute(TxnProto* txn, StorageManager* storage) const {
   // back out.
 
   for (int i = 0; i < kRWSetSize; i++) {
-    Value* val = storage->ReadObject(txn->read_write_set(i));
+    Value* val = storage->ReadAt(txn->read_set_size() + i);
     *val = IntToString(StringToInt(*val) + 1);
     // Not necessary since storage already has a pointer to val.
     //   storage->PutObject(txn->read_write_set(i), val);
@@ -155,9 +154,13 @@ int Microbenchmark::Execute(TxnProto* txn, StorageManager* storage) const {
 
 void Microbenchmark::InitializeStorage(Storage* storage,
                                        Configuration* conf) const {
+  vector<pair<Key, Value*> > objects;
   for (int i = 0; i < nparts*kDBSize; i++) {
-    if (conf->LookupPartition(IntToString(i)) == conf->this_node_id) {
-#ifdef PREFETCHING
+    if (conf->LookupPartition(IntToString(i)) != conf->this_node_id)
+      continue;
+    if (conf->prefetching) {
+      // Objects up to COLD_CUTOFF stay pinned in memory.
+      double wait_time;
       if (i % 10000 == 0)
         std::cout << i << std::endl;
       storage->Prefetch(IntToString(i), &wait_time);
@@ -167,10 +170,15 @@ void Microbenchmark::InitializeStorage(Storage* storage,
         if (i % 10 == 0)
           std::cout << i << std::endl;
       }
-#else
-      storage->PutObject(IntToString(i), new Value(IntToString(i)));
-#endif
+    } else {
+      objects.push_back(pair<Key, Value*>(IntToString(i),
+                                          new Value(IntToString(i))));
+      if (objects.size() == 10000) {
+        storage->PutObjects(objects);
+        objects.clear();
+      }
     }
   }
+  storage->PutObjects(objects);
 }
 
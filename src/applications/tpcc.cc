@@ -6,23 +6,51 @@
 
 #include "applications/tpcc.h"
 
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
 #include <set>
 #include <string>
 
+#include "applications/tpcc_index.h"
+#include "applications/tpcc_records.h"
+#include "backend/read_only_table.h"
 #include "backend/storage.h"
 #include "backend/storage_manager.h"
 #include "common/configuration.h"
 #include "common/utils.h"
-#include "proto/tpcc.pb.h"
 #include "proto/tpcc_args.pb.h"
 #include <iostream>
 
 using std::string;
 
-// ---- THIS IS A HACK TO MAKE ITEMS WORK ON LOCAL MACHINE ---- //
-unordered_map<Key, Value*> ItemList;
-Value* TPCC::GetItem(Key key) const             { return ItemList[key]; }
-void TPCC::SetItem(Key key, Value* value) const { ItemList[key] = value; }
+// Syllables of TPC-C customer last names.
+static const char* kLastNameSyllables[] = {
+  "BAR", "OUGHT", "ABLE", "PRI", "PRES", "ESE", "ANTI", "CALLY", "ATION", "EING"
+};
+
+// Returns the last name TPC-C derives from 'number' (in [0, 999]).
+static string LastName(int number) {
+  return string(kLastNameSyllables[number / 100]) +
+         kLastNameSyllables[(number / 10) % 10] +
+         kLastNameSyllables[number % 10];
+}
+
+// TPC-C's non-uniform random number in [x, y].
+static int NURand(int a, int x, int y) {
+  return (((rand() % (a + 1)) | (rand() % (y - x + 1) + x)) % (y - x + 1)) + x;
+}
+
+ReadOnlyTable<ItemRecord>* TPCC::Items() {
+  // Each process runs one partition, and every partition has every item.
+  static ReadOnlyTable<ItemRecord> items;
+  return &items;
+}
+
+const ItemRecord* TPCC::GetItem(int item_id) const {
+  return Items()->Get(item_id);
+}
 
 // The load generator can be called externally to return a
 // transaction proto containing a new type of transaction.
@@ -61,6 +89,7 @@ TxnProto* TPCC::NewTxn(int64 txn_id, int txn_type, string args,
   bool invalid;
   Value customer_value;
   std::set<int> items_used;
+  TPCCIndex* index = TPCCIndex::Get();
 
   // We set the read and write set based on type
   switch (txn_type) {
@@ -94,13 +123,7 @@ TxnProto* TPCC::NewTxn(int64 txn_id, int txn_type, string args,
       txn->add_read_set(customer_key);
 
       int order_number;
-      if(next_order_id_for_district.count(district_key)>0) {
-        order_number = next_order_id_for_district[district_key];
-        next_order_id_for_district[district_key] ++;
-      } else { 
-        order_number = 0;
-        next_order_id_for_district[district_key] = 1;
-      }
+      order_number = index->NextOrderId(warehouse_id, district_id);
 
       // We set the length of the read and write set uniformly between 5 and 15
       order_line_count = (rand() % 11) + 5;
@@ -210,12 +233,23 @@ TxnProto* TPCC::NewTxn(int64 txn_id, int txn_type, string args,
       // Add history key to write set
       char history_key[128];
       snprintf(history_key, sizeof(history_key), "w%dh%ld",
-               warehouse_id, txn->txn_id());
+               warehouse_id, (long)index->NextHistoryId(warehouse_id));
       txn->add_write_set(history_key);
 
-      // Next, we find the customer as a local one
+      // Next, we find the customer as a local one, 60% of the time by last
+      // name (looked up in the index, so the txn knows its customer upfront)
       if (WAREHOUSES_PER_NODE * config->all_nodes.size() == 1 || !mp) {
         customer_id = rand() % CUSTOMERS_PER_DISTRICT;
+        if (rand() / (static_cast<double>(RAND_MAX + 1.0)) < 0.60) {
+          string last_name = LastName(NURand(255, 0, 999));
+          int by_last_name = index->CustomerByLastName(warehouse_id,
+                                                       district_id,
+                                                       last_name);
+          if (by_last_name >= 0) {
+            customer_id = by_last_name;
+            tpcc_args->set_last_name(last_name);
+          }
+        }
         snprintf(customer_key, sizeof(customer_key),
                  "w%dd%dc%d",
                  warehouse_id, district_id, customer_id);
@@ -241,48 +275,37 @@ TxnProto* TPCC::NewTxn(int64 txn_id, int txn_type, string args,
                  config->LookupPartition(remote_warehouse_key) != remote_node);
       }
 
-      // We only do secondary keying ~60% of the time
-      if (rand() / (static_cast<double>(RAND_MAX + 1.0)) < 0.00) {
-        // Now that we have the object, let's create the txn arg
-        tpcc_args->set_last_name(customer_key);
-        txn->add_read_set(customer_key);
-
-      // Otherwise just give a customer key
-      } else {
-        txn->add_read_write_set(customer_key);
-      }
+      txn->add_read_write_set(customer_key);
 
       break;
 
      case ORDER_STATUS :
      {
-       string customer_string;
-       string customer_latest_order;
-       string warehouse_string;
-       string district_string;
+       int order_number;
        int customer_order_line_number;
-
-       if(latest_order_id_for_customer.size() < 1) {
+       warehouse_id = (rand() % WAREHOUSES_PER_NODE) * config->all_nodes.size() + config->this_node_id;
+       district_id = rand() % DISTRICTS_PER_WAREHOUSE;
+
+       // Pick a customer that has ordered, and its latest order
+       if (!index->RandomOrderingCustomer(warehouse_id, district_id,
+                                          &customer_id, &order_number) ||
+           !index->LookupOrder(warehouse_id, district_id, order_number,
+                               &customer_id, &customer_order_line_number)) {
          txn->set_txn_id(-1);
          break;
        }
 
-       pthread_mutex_lock(&mutex_);
-       customer_string = (*involed_customers)[rand() % involed_customers->size()];
-       pthread_mutex_unlock(&mutex_);
-       customer_latest_order = latest_order_id_for_customer[customer_string];
-       warehouse_string = customer_string.substr(0,customer_string.find("d"));
-       district_string = customer_string.substr(0,customer_string.find("c"));
-       snprintf(customer_key, sizeof(customer_key), "%s", customer_string.c_str());
-       snprintf(warehouse_key, sizeof(warehouse_key), "%s",warehouse_string.c_str());
-       snprintf(district_key, sizeof(district_key), "%s",district_string.c_str());
-
-       customer_order_line_number = order_line_number[customer_latest_order];
+       snprintf(warehouse_key, sizeof(warehouse_key), "w%d", warehouse_id);
+       snprintf(district_key, sizeof(district_key), "w%dd%d",
+                warehouse_id, district_id);
+       snprintf(customer_key, sizeof(customer_key), "w%dd%dc%d",
+                warehouse_id, district_id, customer_id);
        txn->add_read_set(warehouse_key);
        txn->add_read_set(district_key);
        txn->add_read_set(customer_key);
 
-       snprintf(order_key, sizeof(order_key), "%s",customer_latest_order.c_str());
+       snprintf(order_key, sizeof(order_key), "%so%d", district_key,
+                order_number);
        txn->add_read_set(order_key);
        char order_line_key[128];
        for(int i = 0; i < customer_order_line_number; i++) {
@@ -305,33 +328,39 @@ TxnProto* TPCC::NewTxn(int64 txn_id, int txn_type, string args,
         district_id = rand() % DISTRICTS_PER_WAREHOUSE;
         snprintf(district_key, sizeof(district_key), "w%dd%d",warehouse_id, district_id);
 
-       if(latest_order_id_for_district.count(district_key) == 0) {
-              txn->set_txn_id(-1);
+       int latest_order_number;
+       if (!index->LatestOrder(warehouse_id, district_id,
+                               &latest_order_number)) {
+         txn->set_txn_id(-1);
          break;
-       } 
-       
+       }
+
        txn->add_read_set(warehouse_key);
        txn->add_read_set(district_key);
-       int latest_order_number = latest_order_id_for_district[district_key];
        char order_line_key[128];
        char stock_key[128];
 
        tpcc_args->set_lastest_order_number(latest_order_number);
        tpcc_args->set_threshold(rand()%10 + 10);
 
+       // The items of the district's last 20 orders
        for(int i = latest_order_number; (i >= 0) && (i > latest_order_number - 20); i--) {
+         int items[MAX_ORDER_LINES];
+         int ol_number;
+         if (!index->LookupOrderItems(warehouse_id, district_id, i, items,
+                                      &ol_number))
+           continue;
          snprintf(order_key, sizeof(order_key),
                   "%so%d", district_key, i);
-         int ol_number = order_line_number[order_key];
 
          for(int j = 0; j < ol_number;j++) {
-           snprintf(order_line_key, sizeof(order_line_key), "%sol%d",
-                    order_key, j);
-           int item = item_for_order_line[order_line_key];
+           int item = items[j];
            if(items_used.count(item) > 0) {
              continue;
            }
            items_used.insert(item);
+           snprintf(order_line_key, sizeof(order_line_key), "%sol%d",
+                    order_key, j);
            txn->add_read_set(order_line_key);
            snprintf(stock_key, sizeof(stock_key), "%ssi%d",
                     warehouse_key, item);
@@ -351,23 +380,22 @@ TxnProto* TPCC::NewTxn(int64 txn_id, int txn_type, string args,
          
          char order_line_key[128];
          int oldest_order;
+         int ol_number;
        
          for(int i = 0; i < DISTRICTS_PER_WAREHOUSE; i++) {
-           snprintf(district_key, sizeof(district_key), "%sd%d", warehouse_key, i); 
-           if((smallest_order_id_for_district.count(district_key) == 0) || (smallest_order_id_for_district[district_key] > latest_order_id_for_district[district_key])){
+           // Deliver the district's oldest undelivered order, if any
+           if (!index->ClaimUndelivered(warehouse_id, i, &oldest_order) ||
+               !index->LookupOrder(warehouse_id, i, oldest_order,
+                                   &customer_id, &ol_number))
              continue;
-           } else {
-             txn->add_read_set(district_key);
-             oldest_order = smallest_order_id_for_district[district_key];
-             smallest_order_id_for_district[district_key] ++;
 
-             snprintf(new_order_key, sizeof(new_order_key), "%sno%d", district_key, oldest_order);
-             txn->add_read_write_set(new_order_key);
-           }
+           snprintf(district_key, sizeof(district_key), "%sd%d", warehouse_key, i); 
+           txn->add_read_set(district_key);
+           snprintf(new_order_key, sizeof(new_order_key), "%sno%d", district_key, oldest_order);
+           txn->add_read_write_set(new_order_key);
 
            snprintf(order_key, sizeof(order_key), "%so%d", district_key, oldest_order);
            txn->add_read_write_set(order_key);
-           int ol_number = order_line_number[order_key];
            tpcc_args->add_order_line_count(ol_number);
 
            for(int j = 0; j < ol_number; j++) {
@@ -375,7 +403,8 @@ TxnProto* TPCC::NewTxn(int64 txn_id, int txn_type, string args,
              txn->add_read_write_set(order_line_key);
            }
 
-           snprintf(customer_key, sizeof(customer_key), "%s", customer_for_order[order_key].c_str());
+           snprintf(customer_key, sizeof(customer_key), "%sc%d", district_key,
+                    customer_id);
            txn->add_read_write_set(customer_key);
          }
      
@@ -444,51 +473,48 @@ int TPCC::Execute(TxnProto* txn, StorageManager* storage) const {
 // transaction.  This follows the TPC-C standard.
 int TPCC::NewOrderTransaction(TxnProto* txn, StorageManager* storage) const {
   // First, we retrieve the warehouse from storage
-  Value* warehouse_value;
-  Warehouse* warehouse = new Warehouse();
-  warehouse_value = storage->ReadObject(txn->read_set(0));
-  assert(warehouse->ParseFromString(*warehouse_value));
+  WarehouseRecord* warehouse =
+      storage->ReadRecordAt<WarehouseRecord>(0);
+  assert(warehouse != NULL);
 
   // Next, we retrieve the district
-  District* district = new District();
-  Value* district_value = storage->ReadObject(txn->read_write_set(0));
-  assert(district->ParseFromString(*district_value));
-  // Increment the district's next order ID and put to datastore
-  district->set_next_order_id(district->next_order_id() + 1);
-  assert(district->SerializeToString(district_value));
-  // Not necessary since storage already has a pointer to district_value.
-  //   storage->PutObject(district->id(), district_value);
+  DistrictRecord* district =
+      storage->ReadRecordAt<DistrictRecord>(txn->read_set_size());
+  assert(district != NULL);
+  // Increment the district's next order ID in place
+  district->next_order_id++;
 
   // Retrieve the customer we are looking for
-  Value* customer_value;
-  Customer* customer = new Customer();
-  customer_value = storage->ReadObject(txn->read_set(1));
-  assert(customer->ParseFromString(*customer_value));
+  CustomerRecord* customer =
+      storage->ReadRecordAt<CustomerRecord>(1);
+  assert(customer != NULL);
 
   // Next, we get the order line count, system time, and other args from the
   // transaction proto
-  TPCCArgs* tpcc_args = new TPCCArgs();
+  TPCCArgs* tpcc_args = storage->arena()->NewMessage<TPCCArgs>();
   tpcc_args->ParseFromString(txn->arg());
   int order_line_count = tpcc_args->order_line_count(0);
   int order_number =  tpcc_args->order_number();
   double system_time = tpcc_args->system_time();
 
-  // Next we create an Order object
+  // Next we create an Order record
   Key order_key = txn->write_set(order_line_count + 1);
-  Order* order = new Order();
-  order->set_id(order_key);
-  order->set_warehouse_id(warehouse->id());
-  order->set_district_id(district->id());
-  order->set_customer_id(customer->id());
+  OrderRecord order;
+  memset(&order, 0, sizeof(order));
+  SetField(order.id, order_key);
+  memcpy(order.warehouse_id, warehouse->id, sizeof(order.warehouse_id));
+  memcpy(order.district_id, district->id, sizeof(order.district_id));
+  memcpy(order.customer_id, customer->id, sizeof(order.customer_id));
 
   // Set some of the auxiliary data
-  order->set_entry_date(system_time);
-  order->set_carrier_id(-1);
-  order->set_order_line_count(order_line_count);
-  order->set_all_items_local(txn->multipartition());
+  order.entry_date = system_time;
+  order.carrier_id = -1;
+  order.order_line_count = order_line_count;
+  order.all_items_local = txn->multipartition();
 
   // We initialize the order line amount total to 0
   int order_line_amount_total = 0;
+  int items[MAX_ORDER_LINES];
 
   for (int i = 0; i < order_line_count; i++) {
     // For each order line we parse out the three args
@@ -502,108 +528,81 @@ int TPCC::NewOrderTransaction(TxnProto* txn, StorageManager* storage) const {
     string item_key = stock_key.substr(item_idx, string::npos);
 
     // First, we check if the item number is valid
-    Item* item = new Item();
     if (item_key == "i-1")
       return FAILURE;
-    else
-      assert(item->ParseFromString(*GetItem(item_key)));
+    const ItemRecord* item = GetItem(atoi(item_key.c_str() + 1));
+    assert(item != NULL);
 
-    // Next, we create a new order line object with std attributes
-    OrderLine* order_line = new OrderLine();
+    // Next, we create a new order line record with std attributes
+    OrderLineRecord order_line;
+    memset(&order_line, 0, sizeof(order_line));
     Key order_line_key = txn->write_set(i);
-    order_line->set_order_id(order_line_key);
+    SetField(order_line.order_id, order_line_key);
 
     // Set the attributes for this order line
-    order_line->set_district_id(district->id());
-    order_line->set_warehouse_id(warehouse->id());
-    order_line->set_number(i);
-    order_line->set_item_id(item_key);
-    order_line->set_supply_warehouse_id(supply_warehouse_key);
-    order_line->set_quantity(quantity);
-    order_line->set_delivery_date(system_time);
+    memcpy(order_line.district_id, district->id,
+           sizeof(order_line.district_id));
+    memcpy(order_line.warehouse_id, warehouse->id,
+           sizeof(order_line.warehouse_id));
+    order_line.number = i;
+    SetField(order_line.item_id, item_key);
+    SetField(order_line.supply_warehouse_id, supply_warehouse_key);
+    order_line.quantity = quantity;
+    order_line.delivery_date = system_time;
 
     // Next, we get the correct stock from the data store
-    Stock* stock = new Stock();
-    Value* stock_value = storage->ReadObject(stock_key);
-    assert(stock->ParseFromString(*stock_value));
+    StockRecord* stock = storage->ReadRecordAt<StockRecord>(
+        txn->read_set_size() + i + 1);
+    assert(stock != NULL);
 
     // Once we have it we can increase the YTD, order_count, and remote_count
-    stock->set_year_to_date(stock->year_to_date() + quantity);
-    stock->set_order_count(stock->order_count() - 1);
+    stock->year_to_date += quantity;
+    stock->order_count--;
     if (txn->multipartition())
-      stock->set_remote_count(stock->remote_count() + 1);
+      stock->remote_count++;
 
-    // And we decrease the stock's supply appropriately and rewrite to storage
-    if (stock->quantity() >= quantity + 10)
-      stock->set_quantity(stock->quantity() - quantity);
+    // And we decrease the stock's supply appropriately. The record is
+    // updated in place, so nothing needs to be written back.
+    if (stock->quantity >= quantity + 10)
+      stock->quantity -= quantity;
     else
-      stock->set_quantity(stock->quantity() - quantity + 91);
-
-    // Put the stock back into the database
-    assert(stock->SerializeToString(stock_value));
-    // Not necessary since storage already has a ptr to stock_value.
-    //   storage->PutObject(stock_key, stock_value);
-    delete stock;
+      stock->quantity += 91 - quantity;
 
     // Next, we update the order line's amount and add it to the running sum
-    order_line->set_amount(quantity * item->price());
-    order_line_amount_total += (quantity * item->price());
+    order_line.amount = quantity * item->price;
+    order_line_amount_total += (quantity * item->price);
 
     // Finally, we write the order line to storage
-    Value* order_line_value = new Value();
-    assert(order_line->SerializeToString(order_line_value));
-    storage->PutObject(order_line_key, order_line_value);
-    //order->add_order_line_ptr(reinterpret_cast<uint64>(order_line_value));
-
-    pthread_mutex_lock(&mutex_for_item);
-    if (storage->configuration_->this_node_id == storage->configuration_->LookupPartition(txn->read_set(0)))
-      item_for_order_line[order_line_key] = StringToInt(item_key);
-    pthread_mutex_unlock(&mutex_for_item);
-    // Free memory
-    delete order_line;
-    delete item;
+    storage->PutRecord(order_line_key, order_line);
+    if (i < MAX_ORDER_LINES)
+      items[i] = atoi(item_key.c_str() + 1);
   }
 
-  // We create a new NewOrder object
+  // We create a new NewOrder record
   Key new_order_key = txn->write_set(order_line_count);
-  NewOrder* new_order = new NewOrder();
-  new_order->set_id(new_order_key);
-  new_order->set_warehouse_id(warehouse->id());
-  new_order->set_district_id(district->id());
-
-  // Serialize it and put it in the datastore
-  Value* new_order_value = new Value();
-  assert(new_order->SerializeToString(new_order_value));
-  storage->PutObject(new_order_key, new_order_value);
-
-  // Serialize order and put it in the datastore
-  Value* order_value = new Value();
-  assert(order->SerializeToString(order_value));
-  storage->PutObject(order_key, order_value);
-
-  if(storage->configuration_->this_node_id == storage->configuration_->LookupPartition(txn->read_set(0))) {
-    pthread_mutex_lock(&mutex_);
-    if(latest_order_id_for_customer.count(txn->read_set(1)) == 0)
-      involed_customers->push_back(txn->read_set(1));
-    latest_order_id_for_customer[txn->read_set(1)] = order_key;
-
-    if(smallest_order_id_for_district.count(txn->read_write_set(0)) == 0) {
-      smallest_order_id_for_district[txn->read_write_set(0)] = order_number;
+  NewOrderRecord new_order;
+  memset(&new_order, 0, sizeof(new_order));
+  SetField(new_order.id, new_order_key);
+  memcpy(new_order.warehouse_id, warehouse->id,
+         sizeof(new_order.warehouse_id));
+  memcpy(new_order.district_id, district->id, sizeof(new_order.district_id));
+
+  // Put the new order and the order in the datastore
+  storage->PutRecord(new_order_key, new_order);
+  storage->PutRecord(order_key, order);
+
+  // Index the order for the txns that will later read it
+  if (storage->configuration_->this_node_id ==
+      storage->configuration_->LookupPartition(txn->read_set(0))) {
+    int warehouse_id, district_id, customer_id;
+    if (sscanf(txn->read_set(1).c_str(), "w%dd%dc%d", &warehouse_id,
+               &district_id, &customer_id) == 3) {
+      TPCCIndex::Get()->RecordOrder(warehouse_id, district_id, order_number,
+                                    customer_id, order_line_count, items);
     }
-    order_line_number[order_key] =  order_line_count;
-    customer_for_order[order_key] = txn->read_set(1);
-
-    latest_order_id_for_district[txn->read_write_set(0)] = order_number;
-    pthread_mutex_unlock(&mutex_);
   }
 
   // Successfully completed transaction
-  delete warehouse;
-  delete district;
-  delete customer;
-  delete order;
-  delete new_order;
-  delete tpcc_args;
   return SUCCESS;
 }
 
@@ -611,119 +610,67 @@ int TPCC::NewOrderTransaction(TxnProto* txn, StorageManager* storage) const {
 // payment transaction.  This follows the TPC-C standard.
 int TPCC::PaymentTransaction(TxnProto* txn, StorageManager* storage) const {
   // First, we parse out the transaction args from the TPCC proto
-  TPCCArgs* tpcc_args = new TPCCArgs();
+  TPCCArgs* tpcc_args = storage->arena()->NewMessage<TPCCArgs>();
   tpcc_args->ParseFromString(txn->arg());
   int amount = tpcc_args->amount();
 
-  // We create a string to hold up the customer object we look up
-  Value* customer_value;
-  Key customer_key;
-
-  // If there's a last name we do secondary keying
-  if (tpcc_args->has_last_name()) {
-    Key secondary_key = tpcc_args->last_name();
-
-    // If the RW set is not at least of size 3, then no customer key was
-    // given to this transaction.  Otherwise, we perform a check to ensure
-    // the secondary key we just looked up agrees with our previous lookup
-    if (txn->read_write_set_size() < 3 || secondary_key != txn->read_write_set(2)) {
-      // Append the newly read key to write set
-      if (txn->read_write_set_size() < 3)
-        txn->add_read_write_set(secondary_key);
-
-      // Or the old one was incorrect so we overwrite it
-      else
-        txn->set_read_write_set(2, secondary_key);
-
-      return REDO;
-    // Otherwise, we look up the customer's key
-    } else {
-      customer_value = storage->ReadObject(tpcc_args->last_name());
-    }
-
-  // Otherwise we use the final argument
-  } else {
-    customer_key = txn->read_write_set(2);
-    customer_value = storage->ReadObject(customer_key);
-  }
+  // The customer was looked up by the load generator, whether by id or by
+  // last name
+  Key customer_key = txn->read_write_set(2);
+  CustomerRecord* customer =
+      storage->ReadRecordAt<CustomerRecord>(txn->read_set_size() + 2);
+  assert(customer != NULL);
 
-  // Deserialize the warehouse object
+  // Read the warehouse record and update its year to date in place
   Key warehouse_key = txn->read_write_set(0);
-  Value* warehouse_value = storage->ReadObject(warehouse_key);
-  Warehouse* warehouse = new Warehouse();
-  assert(warehouse->ParseFromString(*warehouse_value));
+  WarehouseRecord* warehouse =
+      storage->ReadRecordAt<WarehouseRecord>(txn->read_set_size());
+  assert(warehouse != NULL);
+  warehouse->year_to_date += amount;
 
-  // Next, we update the values of the warehouse and write it out
-  warehouse->set_year_to_date(warehouse->year_to_date() + amount);
-  assert(warehouse->SerializeToString(warehouse_value));
-  // Not necessary since storage already has a pointer to warehouse_value.
-  //   storage->PutObject(warehouse_key, warehouse_value);
-
-  // Deserialize the district object
+  // Read the district record and update its year to date in place
   Key district_key = txn->read_write_set(1);
-  Value* district_value = storage->ReadObject(district_key);
-  District* district = new District();
-  assert(district->ParseFromString(*district_value));
-
-  // Next, we update the values of the district and write it out
-  district->set_year_to_date(district->year_to_date() + amount);
-  assert(district->SerializeToString(district_value));
-  // Not necessary since storage already has a pointer to district_value.
-  //   storage->PutObject(district_key, district_value);
-
-  // We deserialize the customer
-  Customer* customer = new Customer();
-  assert(customer->ParseFromString(*customer_value));
+  DistrictRecord* district =
+      storage->ReadRecordAt<DistrictRecord>(txn->read_set_size() + 1);
+  assert(district != NULL);
+  district->year_to_date += amount;
 
   // Next, we update the customer's balance, payment and payment count
-  customer->set_balance(customer->balance() - amount);
-  customer->set_year_to_date_payment(customer->year_to_date_payment() + amount);
-  customer->set_payment_count(customer->payment_count() + 1);
+  customer->balance -= amount;
+  customer->year_to_date_payment += amount;
+  customer->payment_count++;
 
   // If the customer has bad credit, we update the data information attached
   // to her
-  if (customer->credit() == "BC") {
-    string data = customer->data();
+  if (strcmp(customer->credit, "BC") == 0) {
     char new_information[500];
 
     // Print the new_information into the buffer
     snprintf(new_information, sizeof(new_information), "%s%s%s%s%s%d%s",
-             customer->id().c_str(), customer->warehouse_id().c_str(),
-             customer->district_id().c_str(), district->id().c_str(),
-             warehouse->id().c_str(), amount, customer->data().c_str());
-    customer->set_data(new_information);
+             customer->id, customer->warehouse_id, customer->district_id,
+             district->id, warehouse->id, amount, customer->data);
+    SetField(customer->data, new_information);
   }
 
-  // We write the customer to disk
-  assert(customer->SerializeToString(customer_value));
-  // Not necessary since storage already has a pointer to customer_value.
-  //   storage->PutObject(customer_key, customer_value);
-
-  // Finally, we create a history object and update the data
-  History* history = new History();
-  history->set_customer_id(customer_key);
-  history->set_customer_warehouse_id(customer->warehouse_id());
-  history->set_customer_district_id(customer->district_id());
-  history->set_warehouse_id(warehouse_key);
-  history->set_district_id(district_key);
-
-  // Create the data for the history object
-  char history_data[100];
-  snprintf(history_data, sizeof(history_data), "%s    %s",
-             warehouse->name().c_str(), district->name().c_str());
-  history->set_data(history_data);
-
-  // Write the history object to disk
-  Value* history_value = new Value();
-  assert(history->SerializeToString(history_value));
-  storage->PutObject(txn->write_set(0), history_value);
+  // Finally, we create a history record and update the data
+  HistoryRecord history;
+  memset(&history, 0, sizeof(history));
+  SetField(history.customer_id, customer_key);
+  memcpy(history.customer_warehouse_id, customer->warehouse_id,
+         sizeof(history.customer_warehouse_id));
+  memcpy(history.customer_district_id, customer->district_id,
+         sizeof(history.customer_district_id));
+  SetField(history.warehouse_id, warehouse_key);
+  SetField(history.district_id, district_key);
+
+  // Create the data for the history record
+  snprintf(history.data, sizeof(history.data), "%s    %s",
+           warehouse->name, district->name);
+
+  // Write the history record to disk
+  storage->PutRecord(txn->write_set(0), history);
 
   // Successfully completed transaction
-  delete customer;
-  delete history;
-  delete district;
-  delete warehouse;
-  delete tpcc_args;
   return SUCCESS;
 }
 
@@ -733,117 +680,102 @@ int TPCC::OrderStatusTransaction(TxnProto* txn, StorageManager* storage) const {
 	  //std::cout<<"Actual failed"<<std::endl;
 	  return SUCCESS;
   }
-  TPCCArgs* tpcc_args = new TPCCArgs();
+  TPCCArgs* tpcc_args = storage->arena()->NewMessage<TPCCArgs>();
   tpcc_args->ParseFromString(txn->arg());
 
   int order_line_count = tpcc_args->order_line_count(0);
 
-  Value* warehouse_value;
-  Warehouse* warehouse = new Warehouse();
-  warehouse_value = storage->ReadObject(txn->read_set(0));
-  assert(warehouse->ParseFromString(*warehouse_value));
+  WarehouseRecord* warehouse =
+      storage->ReadRecordAt<WarehouseRecord>(0);
+  assert(warehouse != NULL);
 
-  District* district = new District();
-  Value* district_value = storage->ReadObject(txn->read_set(1));
-  assert(district->ParseFromString(*district_value));
+  DistrictRecord* district =
+      storage->ReadRecordAt<DistrictRecord>(1);
+  assert(district != NULL);
 
-  Value* customer_value;
-  Customer* customer = new Customer();
-  customer_value = storage->ReadObject(txn->read_set(2));
-  assert(customer->ParseFromString(*customer_value));
+  CustomerRecord* customer =
+      storage->ReadRecordAt<CustomerRecord>(2);
+  assert(customer != NULL);
 
-  //  double customer_balance = customer->balance();
-  string customer_first = customer->first();
-  string customer_middle = customer->middle();
-  string customer_last = customer->last();
+  //  double customer_balance = customer->balance;
+  string customer_first = Field(customer->first);
+  string customer_middle = Field(customer->middle);
+  string customer_last = Field(customer->last);
 
-  Order* order = new Order();
-  Value* order_value = storage->ReadObject(txn->read_set(3));
-  assert(order->ParseFromString(*order_value));
-  //  int carrier_id = order->carrier_id();
-  //  double entry_date = order->entry_date();
+  // The customer's latest order may have been delivered long ago and retired
+  // by the storage (see backend/collapsed_versioned_storage.h).
+  OrderRecord* order = storage->ReadRecordAt<OrderRecord>(3);
+  if (order == NULL) {
+    return SUCCESS;
+  }
+  //  int carrier_id = order->carrier_id;
+  //  double entry_date = order->entry_date;
 
 
   for(int i = 0; i < order_line_count; i++) {
-    OrderLine* order_line = new OrderLine();
-    Value* order_line_value = storage->ReadObject(txn->read_set(4+i));
-    assert(order_line->ParseFromString(*order_line_value));
-    string item_key = order_line->item_id();
-    string supply_warehouse_id = order_line->supply_warehouse_id();
-    //    int quantity = order_line->quantity();
-    //    double amount = order_line->amount();
-    //    double delivery_date = order_line->delivery_date();
-    
-    delete order_line;
+    OrderLineRecord* order_line =
+        storage->ReadRecordAt<OrderLineRecord>(4+i);
+    assert(order_line != NULL);
+    string item_key = Field(order_line->item_id);
+    string supply_warehouse_id = Field(order_line->supply_warehouse_id);
+    //    int quantity = order_line->quantity;
+    //    double amount = order_line->amount;
+    //    double delivery_date = order_line->delivery_date;
   }
-   
-  delete warehouse;
-  delete district;
-  delete customer;
-  delete order;
 
   return SUCCESS;
 }
 
-int TPCC::StockLevelTransaction(TxnProto* txn, StorageManager* storage) const { 
+int TPCC::StockLevelTransaction(TxnProto* txn, StorageManager* storage) const {
   int low_stock = 0;
-  TPCCArgs* tpcc_args = new TPCCArgs();
+  TPCCArgs* tpcc_args = storage->arena()->NewMessage<TPCCArgs>();
   tpcc_args->ParseFromString(txn->arg());
   int threshold = tpcc_args->threshold();
 
   if(txn->read_set_size() == 0) {
 	  //std::cout<<"Actual failed"<<std::endl;
-	  delete tpcc_args;
 	  return SUCCESS;
   }
- 
-  Value* warehouse_value;
-  Warehouse* warehouse = new Warehouse();
-  warehouse_value = storage->ReadObject(txn->read_set(0));
-  assert(warehouse->ParseFromString(*warehouse_value));
 
-  District* district = new District();
-  Value* district_value = storage->ReadObject(txn->read_set(1));
-  assert(district->ParseFromString(*district_value));
+  WarehouseRecord* warehouse =
+      storage->ReadRecordAt<WarehouseRecord>(0);
+  assert(warehouse != NULL);
+
+  DistrictRecord* district =
+      storage->ReadRecordAt<DistrictRecord>(1);
+  assert(district != NULL);
 
   int index = 0;
 
   int cycle = (txn->read_set_size() - 2)/2;
   for(int i = 0; i < cycle; i++) {
-    OrderLine* order_line = new OrderLine();
-    Value* order_line_value = storage->ReadObject(txn->read_set(2+index));
+    OrderLineRecord* order_line =
+        storage->ReadRecordAt<OrderLineRecord>(2+index);
     index ++;
-    assert(order_line->ParseFromString(*order_line_value));
-    string item_key = order_line->item_id();
+    assert(order_line != NULL);
+    string item_key = Field(order_line->item_id);
 
-    Stock* stock = new Stock();
-    Value* stock_value = storage->ReadObject(txn->read_set(2+index));
+    StockRecord* stock =
+        storage->ReadRecordAt<StockRecord>(2+index);
     index ++;
-    assert(stock->ParseFromString(*stock_value));
-    if(stock->quantity() < threshold) {
+    assert(stock != NULL);
+    if(stock->quantity < threshold) {
       low_stock ++;
     }
-  
-    delete order_line;
-    delete stock; 
   }
- 
-  delete warehouse;
-  delete district;
+
   return SUCCESS;
 }
 
-int TPCC::DeliveryTransaction(TxnProto* txn, StorageManager* storage) const {      
-  TPCCArgs* tpcc_args = new TPCCArgs();
+int TPCC::DeliveryTransaction(TxnProto* txn, StorageManager* storage) const {
+  TPCCArgs* tpcc_args = storage->arena()->NewMessage<TPCCArgs>();
   tpcc_args->ParseFromString(txn->arg());
 
-  Value* warehouse_value;
-  Warehouse* warehouse = new Warehouse();
-  warehouse_value = storage->ReadObject(txn->read_set(0));
-  assert(warehouse->ParseFromString(*warehouse_value));
+  WarehouseRecord* warehouse =
+      storage->ReadRecordAt<WarehouseRecord>(0);
+  assert(warehouse != NULL);
 
   if(txn->read_set_size() == 1) {
-    delete warehouse; 
     //std::cout<<"Actual failed"<<std::endl;
     return SUCCESS;
   }
@@ -853,54 +785,42 @@ int TPCC::DeliveryTransaction(TxnProto* txn, StorageManager* storage) const {
   int read_write_index = 0;
   int line_count_index = 0;
   for(int i = 1; i <= delivery_district_number; i++) {
-    District* district = new District();
-    Value* district_value = storage->ReadObject(txn->read_set(i));
-    assert(district->ParseFromString(*district_value));
-    
+    DistrictRecord* district =
+        storage->ReadRecordAt<DistrictRecord>(i);
+    assert(district != NULL);
+
     storage->DeleteObject(txn->read_write_set(read_write_index));
     read_write_index ++;
 
-    Order* order = new Order();
-    Value* order_value = storage->ReadObject(txn->read_write_set(read_write_index));
+    OrderRecord* order = storage->ReadRecordAt<OrderRecord>(
+        txn->read_set_size() + read_write_index);
     read_write_index ++;
-    assert(order->ParseFromString(*order_value));
-    char customer_key[128];
-    snprintf(customer_key, sizeof(customer_key),
-             "%s", order->customer_id().c_str());
+    assert(order != NULL);
 
-    order->set_carrier_id(rand()%10);
+    order->carrier_id = rand()%10;
 
     int ol_number = tpcc_args->order_line_count(line_count_index);
     line_count_index ++;
     double total_amount = 0;
 
     for(int j = 0; j < ol_number; j++) {
-      OrderLine* order_line = new OrderLine();
-      Value* order_line_value = storage->ReadObject(txn->read_write_set(read_write_index));
+      OrderLineRecord* order_line = storage->ReadRecordAt<OrderLineRecord>(
+          txn->read_set_size() + read_write_index);
       read_write_index ++;
-      assert(order_line->ParseFromString(*order_line_value));
-      order_line->set_delivery_date(GetTime());
-      total_amount = total_amount + order_line->amount();
-      
-      delete order_line;
+      assert(order_line != NULL);
+      order_line->delivery_date = GetTime();
+      total_amount = total_amount + order_line->amount;
     }
-    
 
-    Customer* customer = new Customer();
-    Value* customer_value = storage->ReadObject(txn->read_write_set(read_write_index));
+
+    CustomerRecord* customer = storage->ReadRecordAt<CustomerRecord>(
+        txn->read_set_size() + read_write_index);
     read_write_index ++;
-    assert(customer->ParseFromString(*customer_value));
-    customer->set_balance(customer->balance() + total_amount);
-    customer->set_delivery_count(customer->delivery_count() + 1);  
-    assert(customer->SerializeToString(customer_value));
-
-    delete district;
-    delete order;
-    delete customer;
-   
+    assert(customer != NULL);
+    customer->balance += total_amount;
+    customer->delivery_count++;
   }
 
-  delete warehouse;   
   return SUCCESS;
 }
 
@@ -912,20 +832,21 @@ void TPCC::InitializeStorage(Storage* storage, Configuration* conf) const {
   for (int i = 0; i < (int)(WAREHOUSES_PER_NODE * conf->all_nodes.size()); i++) {
     // First, we create a key for the warehouse
     char warehouse_key[128], warehouse_key_ytd[128];
-    Value* warehouse_value = new Value();
     snprintf(warehouse_key, sizeof(warehouse_key), "w%d", i);
     snprintf(warehouse_key_ytd, sizeof(warehouse_key_ytd), "w%dy", i);
     if (conf->LookupPartition(warehouse_key) != conf->this_node_id) {
-      continue; 
+      continue;
     }
-    // Next we initialize the object and serialize it
-    Warehouse* warehouse = CreateWarehouse(warehouse_key);
-    assert(warehouse->SerializeToString(warehouse_value));
+    // Next we initialize the record
+    WarehouseRecord* warehouse = CreateWarehouse(warehouse_key);
 
     // Finally, we pass it off to the storage manager to write to disk
     if (conf->LookupPartition(warehouse_key) == conf->this_node_id) {
-      storage->PutObject(warehouse_key, warehouse_value);
-      storage->PutObject(warehouse_key_ytd, new Value(*warehouse_value));
+      storage->PutObject(warehouse_key, NewRecordValue(*warehouse));
+      storage->PutObject(warehouse_key_ytd, NewRecordValue(*warehouse));
+      // Every NewOrder and Payment reads a warehouse and a district.
+      storage->MarkHot(warehouse_key);
+      storage->MarkHot(warehouse_key_ytd);
     }
 
     // Next, we create and write out all of the districts
@@ -937,15 +858,15 @@ void TPCC::InitializeStorage(Storage* storage, Configuration* conf) const {
       snprintf(district_key_ytd, sizeof(district_key_ytd), "w%dd%dy",
                i, j);
 
-      // Next we initialize the object and serialize it
-      Value* district_value = new Value();
-      District* district = CreateDistrict(district_key, warehouse_key);
-      assert(district->SerializeToString(district_value));
+      // Next we initialize the record
+      DistrictRecord* district = CreateDistrict(district_key, warehouse_key);
 
       // Finally, we pass it off to the storage manager to write to disk
       if (conf->LookupPartition(district_key) == conf->this_node_id) {
-        storage->PutObject(district_key, district_value);
-        storage->PutObject(district_key_ytd, new Value(*district_value));
+        storage->PutObject(district_key, NewRecordValue(*district));
+        storage->PutObject(district_key_ytd, NewRecordValue(*district));
+        storage->MarkHot(district_key);
+        storage->MarkHot(district_key_ytd);
       }
 
       // Next, we create and write out all of the customers
@@ -955,15 +876,17 @@ void TPCC::InitializeStorage(Storage* storage, Configuration* conf) const {
         snprintf(customer_key, sizeof(customer_key),
                  "w%dd%dc%d", i, j, k);
 
-        // Next we initialize the object and serialize it
-        Value* customer_value = new Value();
-        Customer* customer = CreateCustomer(customer_key, district_key,
+        // Next we initialize the record
+        CustomerRecord* customer = CreateCustomer(customer_key, district_key,
           warehouse_key);
-        assert(customer->SerializeToString(customer_value));
 
         // Finally, we pass it off to the storage manager to write to disk
-        if (conf->LookupPartition(customer_key) == conf->this_node_id)
-          storage->PutObject(customer_key, customer_value);
+        // and index it by last name
+        if (conf->LookupPartition(customer_key) == conf->this_node_id) {
+          storage->PutObject(customer_key, NewRecordValue(*customer));
+          TPCCIndex::Get()->AddCustomer(i, j, k, Field(customer->last),
+                                        Field(customer->first));
+        }
         delete customer;
       }
 
@@ -975,16 +898,14 @@ void TPCC::InitializeStorage(Storage* storage, Configuration* conf) const {
     for (int j = 0; j < NUMBER_OF_ITEMS; j++) {
       // First, we create a key for the stock
       char item_key[128];
-      Value* stock_value = new Value();
       snprintf(item_key, sizeof(item_key), "i%d", j);
 
-      // Next we initialize the object and serialize it
-      Stock* stock = CreateStock(item_key, warehouse_key);
-      assert(stock->SerializeToString(stock_value));
+      // Next we initialize the record
+      StockRecord* stock = CreateStock(item_key, warehouse_key);
 
       // Finally, we pass it off to the storage manager to write to disk
-      if (conf->LookupPartition(stock->id()) == conf->this_node_id)
-        storage->PutObject(stock->id(), stock_value);
+      if (conf->LookupPartition(stock->id) == conf->this_node_id)
+        storage->PutObject(stock->id, NewRecordValue(*stock));
       delete stock;
     }
 
@@ -997,136 +918,139 @@ void TPCC::InitializeStorage(Storage* storage, Configuration* conf) const {
   for (int i = 0; i < NUMBER_OF_ITEMS; i++) {
     // First, we create a key for the item
     char item_key[128];
-    Value* item_value = new Value();
     snprintf(item_key, sizeof(item_key), "i%d", i);
 
-    // Next we initialize the object and serialize it
-    Item* item = CreateItem(item_key);
-    assert(item->SerializeToString(item_value));
+    // Next we initialize the record
+    ItemRecord* item = CreateItem(item_key);
 
-    // Finally, we pass it off to the local record of items
-    SetItem(string(item_key), item_value);
+    // Finally, we pass it off to the local table of items
+    Items()->Put(i, *item);
     delete item;
   }
+  Items()->Freeze();
 }
 
-// The following method is a dumb constructor for the warehouse protobuffer
-Warehouse* TPCC::CreateWarehouse(Key warehouse_key) const {
-  Warehouse* warehouse = new Warehouse();
+// The following method is a dumb constructor for the warehouse record
+WarehouseRecord* TPCC::CreateWarehouse(Key warehouse_key) const {
+  WarehouseRecord* warehouse = new WarehouseRecord();
 
   // We initialize the id and the name fields
-  warehouse->set_id(warehouse_key);
-  warehouse->set_name(RandomString(10));
+  SetField(warehouse->id, warehouse_key);
+  SetField(warehouse->name, RandomString(10));
 
   // Provide some information to make TPC-C happy
-  warehouse->set_street_1(RandomString(20));
-  warehouse->set_street_2(RandomString(20));
-  warehouse->set_city(RandomString(20));
-  warehouse->set_state(RandomString(2));
-  warehouse->set_zip(RandomString(9));
+  SetField(warehouse->street_1, RandomString(20));
+  SetField(warehouse->street_2, RandomString(20));
+  SetField(warehouse->city, RandomString(20));
+  SetField(warehouse->state, RandomString(2));
+  SetField(warehouse->zip, RandomString(9));
 
   // Set default financial information
-  warehouse->set_tax(0.05);
-  warehouse->set_year_to_date(0.0);
+  warehouse->tax = 0.05;
+  warehouse->year_to_date = 0.0;
 
   return warehouse;
 }
 
-District* TPCC::CreateDistrict(Key district_key, Key warehouse_key) const {
-  District* district = new District();
+DistrictRecord* TPCC::CreateDistrict(Key district_key,
+                                     Key warehouse_key) const {
+  DistrictRecord* district = new DistrictRecord();
 
   // We initialize the id and the name fields
-  district->set_id(district_key);
-  district->set_warehouse_id(warehouse_key);
-  district->set_name(RandomString(10));
+  SetField(district->id, district_key);
+  SetField(district->warehouse_id, warehouse_key);
+  SetField(district->name, RandomString(10));
 
   // Provide some information to make TPC-C happy
-  district->set_street_1(RandomString(20));
-  district->set_street_2(RandomString(20));
-  district->set_city(RandomString(20));
-  district->set_state(RandomString(2));
-  district->set_zip(RandomString(9));
+  SetField(district->street_1, RandomString(20));
+  SetField(district->street_2, RandomString(20));
+  SetField(district->city, RandomString(20));
+  SetField(district->state, RandomString(2));
+  SetField(district->zip, RandomString(9));
 
   // Set default financial information
-  district->set_tax(0.05);
-  district->set_year_to_date(0.0);
-  district->set_next_order_id(1);
+  district->tax = 0.05;
+  district->year_to_date = 0.0;
+  district->next_order_id = 1;
 
   return district;
 }
 
-Customer* TPCC::CreateCustomer(Key customer_key, Key district_key,
-                               Key warehouse_key) const {
-  Customer* customer = new Customer();
+CustomerRecord* TPCC::CreateCustomer(Key customer_key, Key district_key,
+                                     Key warehouse_key) const {
+  CustomerRecord* customer = new CustomerRecord();
 
   // We initialize the various keys
-  customer->set_id(customer_key);
-  customer->set_district_id(district_key);
-  customer->set_warehouse_id(warehouse_key);
-
-  // Next, we create a first and middle name
-  customer->set_first(RandomString(20));
-  customer->set_middle(RandomString(20));
-  customer->set_last(customer_key);
+  SetField(customer->id, customer_key);
+  SetField(customer->district_id, district_key);
+  SetField(customer->warehouse_id, warehouse_key);
+
+  // Next, we create a first and middle name, and a last name as TPC-C
+  // specifies (the first 1000 customers of a district get distinct ones)
+  int number = atoi(strrchr(customer_key.c_str(), 'c') + 1);
+  SetField(customer->first, RandomString(20));
+  SetField(customer->middle, RandomString(20));
+  SetField(customer->last,
+           LastName(number < 1000 ? number : NURand(255, 0, 999)));
 
   // Provide some information to make TPC-C happy
-  customer->set_street_1(RandomString(20));
-  customer->set_street_2(RandomString(20));
-  customer->set_city(RandomString(20));
-  customer->set_state(RandomString(2));
-  customer->set_zip(RandomString(9));
+  SetField(customer->street_1, RandomString(20));
+  SetField(customer->street_2, RandomString(20));
+  SetField(customer->city, RandomString(20));
+  SetField(customer->state, RandomString(2));
+  SetField(customer->zip, RandomString(9));
 
   // Set default financial information
-  customer->set_since(0);
-  customer->set_credit("GC");
-  customer->set_credit_limit(0.01);
-  customer->set_discount(0.5);
-  customer->set_balance(0);
-  customer->set_year_to_date_payment(0);
-  customer->set_payment_count(0);
-  customer->set_delivery_count(0);
+  customer->since = 0;
+  SetField(customer->credit, "GC");
+  customer->credit_limit = 0.01;
+  customer->discount = 0.5;
+  customer->balance = 0;
+  customer->year_to_date_payment = 0;
+  customer->payment_count = 0;
+  customer->delivery_count = 0;
 
   // Set some miscellaneous data
-  customer->set_data(RandomString(50));
+  SetField(customer->data, RandomString(50));
 
   return customer;
 }
 
-Stock* TPCC::CreateStock(Key item_key, Key warehouse_key) const {
-  Stock* stock = new Stock();
+StockRecord* TPCC::CreateStock(Key item_key, Key warehouse_key) const {
+  StockRecord* stock = new StockRecord();
 
   // We initialize the various keys
   char stock_key[128];
   snprintf(stock_key, sizeof(stock_key), "%ss%s",
            warehouse_key.c_str(), item_key.c_str());
-  stock->set_id(stock_key);
-  stock->set_warehouse_id(warehouse_key);
-  stock->set_item_id(item_key);
+  SetField(stock->id, stock_key);
+  SetField(stock->warehouse_id, warehouse_key);
+  SetField(stock->item_id, item_key);
 
   // Next, we create a first and middle name
-  stock->set_quantity(rand() % 100 + 100);
+  stock->quantity = rand() % 100 + 100;
 
   // Set default financial information
-  stock->set_year_to_date(0);
-  stock->set_order_count(0);
-  stock->set_remote_count(0);
+  stock->year_to_date = 0;
+  stock->order_count = 0;
+  stock->remote_count = 0;
 
   // Set some miscellaneous data
-  stock->set_data(RandomString(50));
+  SetField(stock->data, RandomString(50));
 
   return stock;
 }
 
-Item* TPCC::CreateItem(Key item_key) const {
-  Item* item = new Item();
+ItemRecord* TPCC::CreateItem(Key item_key) const {
+  ItemRecord* item = new ItemRecord();
 
   // We initialize the item's key
-  item->set_id(item_key);
+  SetField(item->id, item_key);
 
   // Initialize some fake data for the name, price and data
-  item->set_name(RandomString(24));
-  item->set_price(rand() % 100);
-  item->set_data(RandomString(50));
+  SetField(item->name, RandomString(24));
+  item->price = rand() % 100;
+  SetField(item->data, RandomString(50));
 
   return item;
 }
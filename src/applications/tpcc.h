@@ -21,11 +21,12 @@
 
 using std::string;
 
-class Warehouse;
-class District;
-class Customer;
-class Item;
-class Stock;
+struct WarehouseRecord;
+struct DistrictRecord;
+struct CustomerRecord;
+struct ItemRecord;
+struct StockRecord;
+template<typename T> class ReadOnlyTable;
 
 class TPCC : public Application {
  public:
@@ -90,12 +91,13 @@ class TPCC : public Application {
   virtual void InitializeStorage(Storage* storage, Configuration* conf) const;
 
   // The following methods are simple randomized initializers that provide us
-  // fake data for our TPC-C function
-  Warehouse* CreateWarehouse(Key id) const;
-  District* CreateDistrict(Key id, Key warehouse_id) const;
-  Customer* CreateCustomer(Key id, Key district_id, Key warehouse_id) const;
-  Item* CreateItem(Key id) const;
-  Stock* CreateStock(Key id, Key warehouse_id) const;
+  // fake data for our TPC-C function (see applications/tpcc_records.h)
+  WarehouseRecord* CreateWarehouse(Key id) const;
+  DistrictRecord* CreateDistrict(Key id, Key warehouse_id) const;
+  CustomerRecord* CreateCustomer(Key id, Key district_id,
+                                 Key warehouse_id) const;
+  ItemRecord* CreateItem(Key id) const;
+  StockRecord* CreateStock(Key id, Key warehouse_id) const;
 
   // A NewOrder call takes a set of args and a transaction id and performs
   // the new order transaction as specified by TPC-C.  The return is 1 for
@@ -112,9 +114,11 @@ class TPCC : public Application {
 
   int DeliveryTransaction(TxnProto* txn, StorageManager* storage) const;
 
-  // The following are implementations of retrieval and writing for local items
-  Value* GetItem(Key key) const;
-  void SetItem(Key key, Value* value) const;
+  // The Item table, which every node loads in full and which never changes
+  // once loaded (see backend/read_only_table.h). GetItem returns item
+  // 'item_id', or NULL if there is none.
+  static ReadOnlyTable<ItemRecord>* Items();
+  const ItemRecord* GetItem(int item_id) const;
 };
 
 #endif  // _DB_APPLICATIONS_TPCC_H_
@@ -0,0 +1,182 @@
+// Author: Kun Ren (kun.ren@yale.edu)
+//
+// Secondary indexes over this partition's TPC-C districts (see
+// tpcc_index.h).
+
+#include "applications/tpcc_index.h"
+
+#include <stdlib.h>
+
+#include <algorithm>
+
+#include "applications/tpcc.h"
+
+TPCCIndex::District::District()
+    : next_order(0), oldest_undelivered(0), next_history(0),
+      latest_order(-1),
+      latest_order_for_customer(CUSTOMERS_PER_DISTRICT, -1),
+      ordering_customers(CUSTOMERS_PER_DISTRICT, -1),
+      num_ordering_customers(0) {
+  for (int i = 0; i < ORDER_INDEX_SLOTS; i++)
+    orders[i].order = -1;
+  for (int i = 0; i < RECENT_ORDER_SLOTS; i++)
+    recent_orders[i].order = -1;
+}
+
+TPCCIndex::~TPCCIndex() {
+  unordered_map<int64, District*>::iterator it;
+  for (it = districts_.begin(); it != districts_.end(); ++it)
+    delete it->second;
+}
+
+TPCCIndex* TPCCIndex::Get() {
+  // Each process runs one partition.
+  static TPCCIndex index;
+  return &index;
+}
+
+TPCCIndex::District* TPCCIndex::GetDistrict(int warehouse, int district) {
+  int64 code = static_cast<int64>(warehouse) << 16 | district;
+  {
+    ReadLock l(&mutex_);
+    unordered_map<int64, District*>::iterator it = districts_.find(code);
+    if (it != districts_.end())
+      return it->second;
+  }
+  WriteLock l(&mutex_);
+  District*& slot = districts_[code];
+  if (slot == NULL)
+    slot = new District();
+  return slot;
+}
+
+void TPCCIndex::AddCustomer(int warehouse, int district, int customer,
+                            const string& last, const string& first) {
+  vector<pair<string, int32> >& customers =
+      GetDistrict(warehouse, district)->customers_by_last_name[last];
+  pair<string, int32> entry(first, customer);
+  customers.insert(std::upper_bound(customers.begin(), customers.end(), entry),
+                   entry);
+}
+
+void TPCCIndex::RecordOrder(int warehouse, int district, int order,
+                            int customer, int line_count, const int* items) {
+  District* index = GetDistrict(warehouse, district);
+  if (line_count > MAX_ORDER_LINES)
+    line_count = MAX_ORDER_LINES;
+
+  // Invalidate each slot while it is rewritten.
+  OrderSlot* slot = &index->orders[order & (ORDER_INDEX_SLOTS - 1)];
+  slot->order = -1;
+  __sync_synchronize();
+  slot->customer = customer;
+  slot->line_count = line_count;
+  __sync_synchronize();
+  slot->order = order;
+
+  RecentOrderSlot* recent =
+      &index->recent_orders[order & (RECENT_ORDER_SLOTS - 1)];
+  recent->order = -1;
+  __sync_synchronize();
+  recent->line_count = line_count;
+  for (int i = 0; i < line_count; i++)
+    recent->items[i] = items[i];
+  __sync_synchronize();
+  recent->order = order;
+
+  if (customer >= 0 && customer < CUSTOMERS_PER_DISTRICT) {
+    if (index->latest_order_for_customer[customer] < 0) {
+      index->ordering_customers[index->num_ordering_customers] = customer;
+      __sync_synchronize();
+      index->num_ordering_customers++;
+    }
+    if (index->latest_order_for_customer[customer] < order)
+      index->latest_order_for_customer[customer] = order;
+  }
+
+  __sync_synchronize();
+  if (index->latest_order < order)
+    index->latest_order = order;
+}
+
+int TPCCIndex::NextOrderId(int warehouse, int district) {
+  return __sync_fetch_and_add(&GetDistrict(warehouse, district)->next_order,
+                              1);
+}
+
+int64 TPCCIndex::NextHistoryId(int warehouse) {
+  return __sync_fetch_and_add(&GetDistrict(warehouse, 0)->next_history, 1);
+}
+
+bool TPCCIndex::ClaimUndelivered(int warehouse, int district, int* order) {
+  District* index = GetDistrict(warehouse, district);
+  while (true) {
+    int32 oldest = index->oldest_undelivered;
+    int32 latest = index->latest_order;
+    if (oldest > latest)
+      return false;
+
+    // Orders that left the ring undelivered can no longer be delivered.
+    int32 claimed = std::max(oldest, latest - ORDER_INDEX_SLOTS + 1);
+    if (__sync_bool_compare_and_swap(&index->oldest_undelivered, oldest,
+                                     claimed + 1)) {
+      *order = claimed;
+      return true;
+    }
+  }
+}
+
+bool TPCCIndex::LatestOrder(int warehouse, int district, int* order) {
+  *order = GetDistrict(warehouse, district)->latest_order;
+  return *order >= 0;
+}
+
+bool TPCCIndex::RandomOrderingCustomer(int warehouse, int district,
+                                       int* customer, int* order) {
+  District* index = GetDistrict(warehouse, district);
+  int32 count = index->num_ordering_customers;
+  if (count == 0)
+    return false;
+  __sync_synchronize();
+  *customer = index->ordering_customers[rand() % count];
+  *order = index->latest_order_for_customer[*customer];
+  return *order >= 0;
+}
+
+bool TPCCIndex::LookupOrder(int warehouse, int district, int order,
+                            int* customer, int* line_count) {
+  OrderSlot* slot = &GetDistrict(warehouse, district)->orders[
+      order & (ORDER_INDEX_SLOTS - 1)];
+  if (slot->order != order)
+    return false;
+  __sync_synchronize();
+  *customer = slot->customer;
+  *line_count = slot->line_count;
+  __sync_synchronize();
+  return slot->order == order;
+}
+
+bool TPCCIndex::LookupOrderItems(int warehouse, int district, int order,
+                                 int* items, int* line_count) {
+  RecentOrderSlot* slot = &GetDistrict(warehouse, district)->recent_orders[
+      order & (RECENT_ORDER_SLOTS - 1)];
+  if (slot->order != order)
+    return false;
+  __sync_synchronize();
+  *line_count = slot->line_count;
+  for (int i = 0; i < *line_count; i++)
+    items[i] = slot->items[i];
+  __sync_synchronize();
+  return slot->order == order;
+}
+
+int TPCCIndex::CustomerByLastName(int warehouse, int district,
+                                  const string& last) {
+  // Only modified while loading.
+  District* index = GetDistrict(warehouse, district);
+  map<string, vector<pair<string, int32> > >::const_iterator it =
+      index->customers_by_last_name.find(last);
+  if (it == index->customers_by_last_name.end() || it->second.empty())
+    return -1;
+  return it->second[(it->second.size() - 1) / 2].second;
+}
@@ -0,0 +1,151 @@
+// Author: Kun Ren (kun.ren@yale.edu)
+//
+// Secondary indexes over this partition's TPC-C districts, which the load
+// generator consults to build OrderStatus, Delivery, StockLevel and Payment
+// (by last name) txns and which NewOrder maintains as it commits.
+//
+// Every district has its own index, so districts never contend:
+//  - Orders, ordered by order id, in a ring of the last ORDER_INDEX_SLOTS
+//    orders (customer and number of lines), plus the items of the last
+//    RECENT_ORDER_SLOTS orders (for StockLevel).
+//  - Each customer's latest order, and the customers that have ordered.
+//  - Customers by last name, sorted by first name (built at load time).
+//  - The next order id to hand out and the oldest undelivered order.
+//  - The next History id of the warehouse (in its district 0's index).
+//
+// NewOrder txns of a district are serialized by their write lock on the
+// district, so each district's index has one writer at a time and needs no
+// locks: entries are published with memory barriers, and readers check each
+// ring slot's order id before and after copying it, treating a slot that was
+// overwritten meanwhile as missing. Memory is bounded by the rings.
+
+#ifndef _DB_APPLICATIONS_TPCC_INDEX_H_
+#define _DB_APPLICATIONS_TPCC_INDEX_H_
+
+#include <pthread.h>
+
+#include <map>
+#include <string>
+#include <tr1/unordered_map>
+#include <utility>
+#include <vector>
+
+#include "common/types.h"
+#include "common/utils.h"
+
+using std::map;
+using std::pair;
+using std::string;
+using std::vector;
+using std::tr1::unordered_map;
+
+// Number of orders per district whose customer and line count are indexed
+// (a power of two).
+#define ORDER_INDEX_SLOTS 16384
+
+// Number of orders per district whose items are indexed (a power of two).
+#define RECENT_ORDER_SLOTS 32
+
+// Maximum number of lines of an order.
+#define MAX_ORDER_LINES 15
+
+class TPCCIndex {
+ public:
+  TPCCIndex() {}
+  ~TPCCIndex();
+
+  // Returns the index for this process's partition.
+  static TPCCIndex* Get();
+
+  // Indexes customer 'customer' of a district under 'last' and 'first' name.
+  // Only called while loading, before txns run.
+  void AddCustomer(int warehouse, int district, int customer,
+                   const string& last, const string& first);
+
+  // Records that 'customer' placed order 'order' with 'line_count' lines of
+  // the given 'items'. Called by NewOrder txns as they commit.
+  void RecordOrder(int warehouse, int district, int order, int customer,
+                   int line_count, const int* items);
+
+  // Assigns the next order id of a district.
+  int NextOrderId(int warehouse, int district);
+
+  // Assigns the next History row id of a warehouse. Ids are dense, so that
+  // storages can retire old History rows.
+  int64 NextHistoryId(int warehouse);
+
+  // Claims the district's oldest undelivered recorded order for a Delivery
+  // txn. Returns false if every recorded order has been claimed.
+  bool ClaimUndelivered(int warehouse, int district, int* order);
+
+  // Sets '*order' to the district's latest recorded order. Returns false if
+  // none was recorded yet.
+  bool LatestOrder(int warehouse, int district, int* order);
+
+  // Sets '*customer' to a random customer of the district that has ordered
+  // and '*order' to its latest order. Returns false if none has.
+  bool RandomOrderingCustomer(int warehouse, int district, int* customer,
+                              int* order);
+
+  // Sets '*customer' and '*line_count' to those of 'order'. Returns false if
+  // the order was not recorded or has left the ring.
+  bool LookupOrder(int warehouse, int district, int order, int* customer,
+                   int* line_count);
+
+  // Copies the items of 'order' to 'items' (MAX_ORDER_LINES entries) and
+  // sets '*line_count'. Returns false unless 'order' is a recent one.
+  bool LookupOrderItems(int warehouse, int district, int order, int* items,
+                        int* line_count);
+
+  // Returns the customer with last name 'last' that comes in the middle when
+  // all of them are sorted by first name (as TPC-C's Payment and OrderStatus
+  // specify), or -1 if there is none.
+  int CustomerByLastName(int warehouse, int district, const string& last);
+
+ private:
+  struct OrderSlot {
+    // The order held by the slot; -1 while it is being written.
+    volatile int64 order;
+    int32 customer;
+    int32 line_count;
+  };
+
+  struct RecentOrderSlot {
+    volatile int64 order;
+    int32 line_count;
+    int32 items[MAX_ORDER_LINES];
+  };
+
+  struct District {
+    District();
+
+    // Owned by the load generator.
+    volatile int32 next_order;
+    volatile int32 oldest_undelivered;
+    volatile int64 next_history;
+
+    // Maintained by NewOrder txns.
+    volatile int32 latest_order;
+    OrderSlot orders[ORDER_INDEX_SLOTS];
+    RecentOrderSlot recent_orders[RECENT_ORDER_SLOTS];
+    vector<int32> latest_order_for_customer;
+    vector<int32> ordering_customers;
+    volatile int32 num_ordering_customers;
+
+    // Built at load time: last name -> (first name, customer), sorted.
+    map<string, vector<pair<string, int32> > > customers_by_last_name;
+  };
+
+  // Returns the index of a district, creating it if needed.
+  District* GetDistrict(int warehouse, int district);
+
+  // Districts by warehouse << 16 | district.
+  unordered_map<int64, District*> districts_;
+  MutexRW mutex_;
+
+  // DISALLOW_COPY_AND_ASSIGN
+  TPCCIndex(const TPCCIndex&);
+  TPCCIndex& operator=(const TPCCIndex&);
+};
+
+#endif  // _DB_APPLICATIONS_TPCC_INDEX_H_
@@ -0,0 +1,177 @@
+// Author: Kun Ren (kun.ren@yale.edu)
+//
+// Fixed-layout records for the TPC-C tables. Each record is stored in the
+// database as the raw bytes of its struct, so transactions read and update
+// fields in place (see StorageManager::ReadRecord) instead of parsing and
+// re-serializing a protocol buffer on every access. Records only leave a node
+// as the bytes of a Value inside a MessageProto.
+//
+// Strings are null-terminated in fixed-size fields sized after the TPC-C
+// specification; keys longer than TPCC_KEY_SIZE - 1 are truncated.
+
+#ifndef _DB_APPLICATIONS_TPCC_RECORDS_H_
+#define _DB_APPLICATIONS_TPCC_RECORDS_H_
+
+#include <string.h>
+
+#include <string>
+
+#include "common/types.h"
+
+using std::string;
+
+#define TPCC_KEY_SIZE 24
+
+// Copies 'value' into the fixed-size string field 'field'.
+template<int N>
+static inline void SetField(char (&field)[N], const string& value) {
+  size_t length = value.size() < N - 1 ? value.size() : N - 1;
+  memcpy(field, value.data(), length);
+  field[length] = '\0';
+}
+
+// Returns the contents of the fixed-size string field 'field'.
+template<int N>
+static inline string Field(const char (&field)[N]) {
+  return string(field, strnlen(field, N));
+}
+
+struct WarehouseRecord {
+  char id[TPCC_KEY_SIZE];
+
+  // Informational fields
+  char name[11];
+  char street_1[21];
+  char street_2[21];
+  char city[21];
+  char state[3];
+  char zip[10];
+
+  // Income records
+  double tax;
+  double year_to_date;
+};
+
+struct DistrictRecord {
+  char id[TPCC_KEY_SIZE];
+  char warehouse_id[TPCC_KEY_SIZE];
+
+  // Informational fields
+  char name[11];
+  char street_1[21];
+  char street_2[21];
+  char city[21];
+  char state[3];
+  char zip[10];
+
+  // Income records
+  double tax;
+  double year_to_date;
+  int32 next_order_id;
+};
+
+struct CustomerRecord {
+  char id[TPCC_KEY_SIZE];
+  char district_id[TPCC_KEY_SIZE];
+  char warehouse_id[TPCC_KEY_SIZE];
+
+  // Informational fields
+  char first[21];
+  char middle[21];
+  char last[TPCC_KEY_SIZE];
+  char street_1[21];
+  char street_2[21];
+  char city[21];
+  char state[3];
+  char zip[10];
+
+  // Income records
+  int32 since;
+  char credit[3];
+  double credit_limit;
+  double discount;
+  double balance;
+  double year_to_date_payment;
+  int32 payment_count;
+  int32 delivery_count;
+
+  // Miscellany
+  char data[501];
+};
+
+struct NewOrderRecord {
+  char id[TPCC_KEY_SIZE];
+  char district_id[TPCC_KEY_SIZE];
+  char warehouse_id[TPCC_KEY_SIZE];
+};
+
+struct OrderRecord {
+  char id[TPCC_KEY_SIZE];
+  char district_id[TPCC_KEY_SIZE];
+  char warehouse_id[TPCC_KEY_SIZE];
+  char customer_id[TPCC_KEY_SIZE];
+
+  // Informational fields
+  double entry_date;
+  int32 carrier_id;
+  int32 order_line_count;
+  bool all_items_local;
+};
+
+struct OrderLineRecord {
+  char order_id[TPCC_KEY_SIZE];
+  char district_id[TPCC_KEY_SIZE];
+  char warehouse_id[TPCC_KEY_SIZE];
+  char item_id[TPCC_KEY_SIZE];
+  char supply_warehouse_id[TPCC_KEY_SIZE];
+
+  // Informational fields
+  int32 number;
+  double delivery_date;
+  int32 quantity;
+  double amount;
+  char district_information[25];
+};
+
+struct ItemRecord {
+  char id[TPCC_KEY_SIZE];
+
+  // Informational fields
+  char name[25];
+  double price;
+
+  // Miscellany
+  char data[51];
+};
+
+struct StockRecord {
+  char id[TPCC_KEY_SIZE];
+  char item_id[TPCC_KEY_SIZE];
+  char warehouse_id[TPCC_KEY_SIZE];
+
+  // Informational fields
+  int32 quantity;
+  int32 year_to_date;
+  int32 order_count;
+  int32 remote_count;
+
+  // Miscellany
+  char data[51];
+};
+
+struct HistoryRecord {
+  char customer_id[TPCC_KEY_SIZE];
+  char district_id[TPCC_KEY_SIZE];
+  char warehouse_id[TPCC_KEY_SIZE];
+  char customer_district_id[TPCC_KEY_SIZE];
+  char customer_warehouse_id[TPCC_KEY_SIZE];
+
+  // Informational fields
+  double date;
+  double amount;
+
+  // Miscellany
+  char data[25];
+};
+
+#endif  // _DB_APPLICATIONS_TPCC_RECORDS_H_
@@ -0,0 +1,61 @@
+// Author: Kun Ren (kun.ren@yale.edu)
+//
+// An implementation of the storage interface for tables with dense integer
+// keys (see array_storage.h).
+
+#include "backend/array_storage.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <new>
+
+ArrayStorage::ArrayStorage(int64 num_records, int stride, int offset)
+    : num_records_(num_records), stride_(stride), offset_(offset) {
+  void* records;
+  if (posix_memalign(&records, 64, num_records_ * sizeof(Value)) != 0) {
+    perror("posix_memalign");
+    exit(EXIT_FAILURE);
+  }
+  records_ = reinterpret_cast<Value*>(records);
+  for (int64 i = 0; i < num_records_; i++)
+    new (&records_[i]) Value();
+  present_ = new bool[num_records_];
+  memset(present_, 0, num_records_ * sizeof(bool));
+}
+
+ArrayStorage::~ArrayStorage() {
+  for (int64 i = 0; i < num_records_; i++)
+    records_[i].~Value();
+  free(records_);
+  delete[] present_;
+}
+
+Value* ArrayStorage::ReadObject(const Key& key, int64 txn_id) {
+  int64 slot = Slot(key);
+  if (slot < 0 || !present_[slot])
+    return NULL;
+  return &records_[slot];
+}
+
+bool ArrayStorage::PutObject(const Key& key, Value* value, int64 txn_id) {
+  int64 slot = Slot(key);
+  if (slot < 0)
+    return false;
+  if (value != &records_[slot]) {
+    records_[slot].swap(*value);
+    delete value;
+  }
+  present_[slot] = true;
+  return true;
+}
+
+bool ArrayStorage::DeleteObject(const Key& key, int64 txn_id) {
+  int64 slot = Slot(key);
+  if (slot >= 0) {
+    present_[slot] = false;
+    Value().swap(records_[slot]);
+  }
+  return true;
+}
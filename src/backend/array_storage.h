@@ -0,0 +1,71 @@
+// Author: Kun Ren (kun.ren@yale.edu)
+//
+// An implementation of the storage interface for tables whose keys are dense
+// integers, such as the microbenchmark's. Records live in place in one
+// contiguous, cache-line-aligned array indexed directly by the key, so an
+// access costs a short decimal parse of the key instead of hashing it and
+// probing a map.
+//
+// A node stores every 'stride'th key starting at 'offset' (the keys that
+// Configuration::LookupPartition assigns to it), i.e. key k is kept in slot
+// (k - offset) / 'stride'. Keys that are not decimal integers or fall outside
+// the array are not stored.
+
+#ifndef _DB_BACKEND_ARRAY_STORAGE_H_
+#define _DB_BACKEND_ARRAY_STORAGE_H_
+
+#include "backend/storage.h"
+#include "common/types.h"
+
+class ArrayStorage : public Storage {
+ public:
+  // Creates an array of 'num_records' records, all initially absent.
+  ArrayStorage(int64 num_records, int stride, int offset);
+  virtual ~ArrayStorage();
+
+  virtual bool Prefetch(const Key &key, double* wait_time)  { return false; }
+  virtual bool Unfetch(const Key &key)                      { return false; }
+  virtual Value* ReadObject(const Key& key, int64 txn_id = 0);
+
+  // Takes ownership of 'value': its contents are moved into the array and it
+  // is deleted (unless it is the record ReadObject returned for 'key').
+  // Returns false if 'key' cannot be stored.
+  virtual bool PutObject(const Key& key, Value* value, int64 txn_id = 0);
+  virtual bool DeleteObject(const Key& key, int64 txn_id = 0);
+
+  virtual void PrepareForCheckpoint(int64 stable) {}
+  virtual int Checkpoint() { return 0; }
+
+ private:
+  // Returns the slot of 'key', or -1 if 'key' cannot be stored.
+  int64 Slot(const Key& key) const {
+    const char* p = key.data();
+    const char* end = p + key.size();
+    if (p == end || end - p > 18)
+      return -1;
+    int64 k = 0;
+    for (; p < end; p++) {
+      if (*p < '0' || *p > '9')
+        return -1;
+      k = k * 10 + (*p - '0');
+    }
+    k -= offset_;
+    if (k < 0 || k % stride_ != 0 || k / stride_ >= num_records_)
+      return -1;
+    return k / stride_;
+  }
+
+  int64 num_records_;
+  int stride_;
+  int offset_;
+
+  // The records, and whether each one is present.
+  Value* records_;
+  bool* present_;
+
+  // DISALLOW_COPY_AND_ASSIGN
+  ArrayStorage(const ArrayStorage&);
+  ArrayStorage& operator=(const ArrayStorage&);
+};
+
+#endif  // _DB_BACKEND_ARRAY_STORAGE_H_
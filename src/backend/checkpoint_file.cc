@@ -0,0 +1,267 @@
+// Author: Kun Ren (kun.ren@yale.edu)
+//
+// Binary checkpoint file format (see checkpoint_file.h).
+
+#include "backend/checkpoint_file.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <utility>
+
+#include "backend/epoch_manager.h"
+#include "backend/storage.h"
+
+using std::pair;
+
+#define CHECKPOINT_MAGIC "CALVINCP"
+#define CHECKPOINT_FORMAT_VERSION 1
+
+// Size of a record's <len_key|len_value|version> prefix.
+#define CHECKPOINT_RECORD_HEADER_SIZE 16
+
+struct CheckpointHeader {
+  char magic[8];
+  uint32 format_version;
+  uint32 unused;
+  int64 stable;
+};
+
+struct CheckpointTrailer {
+  uint64 index_offset;
+  uint64 num_segments;
+  uint32 index_crc;
+  uint32 unused;
+  char magic[8];
+};
+
+// Writes 'length' bytes at 'offset' of 'fd'. Returns false on failure.
+static bool WriteFully(int fd, const char* data, uint64 length,
+                       uint64 offset) {
+  while (length > 0) {
+    ssize_t n = pwrite(fd, data, length, offset);
+    if (n < 0)
+      return false;
+    data += n;
+    length -= n;
+    offset += n;
+  }
+  return true;
+}
+
+////////////////////////////////  CheckpointWriter  ////////////////////////////
+
+CheckpointWriter::CheckpointWriter(const string& path, int64 stable,
+                                   int num_threads)
+    : path_(path), buffers_(num_threads), buffered_records_(num_threads, 0),
+      end_(sizeof(CheckpointHeader)), failed_(0), finished_(false) {
+  fd_ = open((path_ + ".tmp").c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd_ < 0) {
+    perror((path_ + ".tmp").c_str());
+    Fail();
+    return;
+  }
+
+  CheckpointHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic));
+  header.format_version = CHECKPOINT_FORMAT_VERSION;
+  header.stable = stable;
+  if (!WriteFully(fd_, reinterpret_cast<char*>(&header), sizeof(header), 0))
+    Fail();
+
+  for (int i = 0; i < num_threads; i++)
+    buffers_[i].reserve(CHECKPOINT_SEGMENT_SIZE + 4096);
+}
+
+CheckpointWriter::~CheckpointWriter() {
+  if (fd_ >= 0)
+    close(fd_);
+  if (!finished_)
+    unlink((path_ + ".tmp").c_str());
+}
+
+void CheckpointWriter::Add(int thread, int64 version, const Key& key,
+                           const Value& value) {
+  string* buffer = &buffers_[thread];
+  uint32 lengths[2] = {static_cast<uint32>(key.size()),
+                       static_cast<uint32>(value.size())};
+  buffer->append(reinterpret_cast<char*>(lengths), sizeof(lengths));
+  buffer->append(reinterpret_cast<char*>(&version), sizeof(version));
+  buffer->append(key);
+  buffer->append(value);
+  buffered_records_[thread]++;
+
+  if (buffer->size() >= CHECKPOINT_SEGMENT_SIZE)
+    WriteSegment(thread);
+}
+
+void CheckpointWriter::WriteSegment(int thread) {
+  string* buffer = &buffers_[thread];
+  if (buffer->empty() || fd_ < 0)
+    return;
+
+  CheckpointSegment segment;
+  segment.length = buffer->size();
+  segment.num_records = buffered_records_[thread];
+  segment.crc = Crc32(buffer->data(), buffer->size());
+  segment.unused = 0;
+  {
+    Lock l(&mutex_);
+    segment.offset = end_;
+    end_ += segment.length;
+    index_.push_back(segment);
+  }
+
+  if (!WriteFully(fd_, buffer->data(), segment.length, segment.offset))
+    Fail();
+  buffer->clear();
+  buffered_records_[thread] = 0;
+}
+
+bool CheckpointWriter::Finish() {
+  for (uint32 i = 0; i < buffers_.size(); i++)
+    WriteSegment(i);
+  if (fd_ < 0)
+    return false;
+
+  CheckpointTrailer trailer;
+  memset(&trailer, 0, sizeof(trailer));
+  trailer.index_offset = end_;
+  trailer.num_segments = index_.size();
+  trailer.index_crc = Crc32(index_.data(),
+                            index_.size() * sizeof(CheckpointSegment));
+  memcpy(trailer.magic, CHECKPOINT_MAGIC, sizeof(trailer.magic));
+
+  uint64 index_length = index_.size() * sizeof(CheckpointSegment);
+  if (!WriteFully(fd_, reinterpret_cast<char*>(index_.data()), index_length,
+                  end_) ||
+      !WriteFully(fd_, reinterpret_cast<char*>(&trailer), sizeof(trailer),
+                  end_ + index_length) ||
+      fdatasync(fd_) != 0) {
+    Fail();
+  }
+  close(fd_);
+  fd_ = -1;
+
+  if (failed_ != 0 || rename((path_ + ".tmp").c_str(), path_.c_str()) != 0)
+    return false;
+  finished_ = true;
+  return true;
+}
+
+////////////////////////////////  CheckpointReader  ////////////////////////////
+
+CheckpointReader::CheckpointReader(const string& path)
+    : data_(NULL), size_(0), stable_(-1), index_(NULL), num_segments_(0),
+      storage_(NULL), num_threads_(0), corrupt_(0) {
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0)
+    return;
+  struct stat st;
+  if (fstat(fd, &st) != 0 ||
+      st.st_size < static_cast<off_t>(sizeof(CheckpointHeader) +
+                                      sizeof(CheckpointTrailer))) {
+    close(fd);
+    return;
+  }
+  size_ = st.st_size;
+  void* data = mmap(NULL, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED)
+    return;
+  madvise(data, size_, MADV_WILLNEED);
+
+  // Validate header, trailer and index before exposing the mapping.
+  const char* bytes = reinterpret_cast<const char*>(data);
+  CheckpointHeader header;
+  CheckpointTrailer trailer;
+  memcpy(&header, bytes, sizeof(header));
+  memcpy(&trailer, bytes + size_ - sizeof(trailer), sizeof(trailer));
+  uint64 index_length = trailer.num_segments * sizeof(CheckpointSegment);
+  if (memcmp(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic)) != 0 ||
+      memcmp(trailer.magic, CHECKPOINT_MAGIC, sizeof(trailer.magic)) != 0 ||
+      header.format_version != CHECKPOINT_FORMAT_VERSION ||
+      trailer.num_segments > size_ / sizeof(CheckpointSegment) ||
+      trailer.index_offset + index_length + sizeof(trailer) != size_ ||
+      Crc32(bytes + trailer.index_offset, index_length) != trailer.index_crc) {
+    printf("CheckpointReader: %s is not a valid checkpoint\n", path.c_str());
+    munmap(data, size_);
+    return;
+  }
+
+  data_ = bytes;
+  stable_ = header.stable;
+  index_ = reinterpret_cast<const CheckpointSegment*>(bytes +
+                                                      trailer.index_offset);
+  num_segments_ = trailer.num_segments;
+}
+
+CheckpointReader::~CheckpointReader() {
+  if (data_ != NULL)
+    munmap(const_cast<char*>(data_), size_);
+}
+
+uint64 CheckpointReader::num_records() const {
+  uint64 records = 0;
+  for (uint64 i = 0; i < num_segments_; i++)
+    records += index_[i].num_records;
+  return records;
+}
+
+void* CheckpointReader::RunLoader(void* arg) {
+  pair<int, CheckpointReader*>* thread =
+      reinterpret_cast<pair<int, CheckpointReader*>*>(arg);
+  thread->second->LoadSegments(thread->first);
+  delete thread;
+  return NULL;
+}
+
+bool CheckpointReader::Load(Storage* storage, int num_threads) {
+  if (data_ == NULL)
+    return false;
+  storage_ = storage;
+  num_threads_ = num_threads;
+  corrupt_ = 0;
+
+  vector<pthread_t> threads(num_threads);
+  for (int i = 0; i < num_threads; i++) {
+    pthread_create(&threads[i], NULL, RunLoader,
+                   new pair<int, CheckpointReader*>(i, this));
+  }
+  for (int i = 0; i < num_threads; i++)
+    pthread_join(threads[i], NULL);
+  return corrupt_ == 0;
+}
+
+void CheckpointReader::LoadSegments(int thread) {
+  // Loader threads write to the storage concurrently, like workers.
+  EpochPin pin(storage_->epochs());
+  for (uint64 i = thread; i < num_segments_; i += num_threads_) {
+    const CheckpointSegment& segment = index_[i];
+    const char* p = data_ + segment.offset;
+    const char* end = p + segment.length;
+    if (segment.offset + segment.length > size_ ||
+        Crc32(p, segment.length) != segment.crc) {
+      printf("CheckpointReader: segment %lu is corrupt\n",
+             static_cast<unsigned long>(i));
+      __sync_fetch_and_add(&corrupt_, 1);
+      continue;
+    }
+
+    while (p < end) {
+      uint32 lengths[2];
+      int64 version;
+      memcpy(lengths, p, sizeof(lengths));
+      memcpy(&version, p + sizeof(lengths), sizeof(version));
+      p += CHECKPOINT_RECORD_HEADER_SIZE;
+      storage_->PutObject(Key(p, lengths[0]),
+                          new Value(p + lengths[0], lengths[1]), version);
+      p += lengths[0] + lengths[1];
+    }
+  }
+}
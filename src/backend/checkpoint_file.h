@@ -0,0 +1,139 @@
+// Author: Kun Ren (kun.ren@yale.edu)
+//
+// Binary checkpoint file format, written by several threads at once and
+// loaded back through mmap by several threads at once.
+//
+// File layout:
+//
+//   header:   magic "CALVINCP", format version, stable txn id
+//   segments: runs of records, each written in one piece by one thread
+//   index:    one entry per segment (offset, length, record count, CRC-32)
+//   trailer:  offset and size of the index, CRC-32 of the index, magic
+//
+// A record is <len_key|len_value|version|key|value>, where 'version' is the
+// txn id passed to Storage::PutObject when the record is loaded. Every writer
+// thread fills its own buffer and, whenever it holds a full segment, reserves
+// the next range of the file and writes the segment there, so threads never
+// wait on each other's I/O. The loader maps the file, validates the trailer
+// and index, and splits the segments among its threads, each of which checks
+// its segments' checksums before decoding them.
+//
+// A checkpoint is written as '<path>.tmp' and renamed to '<path>' once its
+// index is on disk, so a file under the final name is always complete.
+
+#ifndef _DB_BACKEND_CHECKPOINT_FILE_H_
+#define _DB_BACKEND_CHECKPOINT_FILE_H_
+
+#include <pthread.h>
+
+#include <string>
+#include <vector>
+
+#include "common/types.h"
+#include "common/utils.h"
+
+using std::string;
+using std::vector;
+
+class Storage;
+
+// Size at which a writer thread's buffered records are written out as a
+// segment.
+#define CHECKPOINT_SEGMENT_SIZE (1 << 20)
+
+// Number of threads used to write and load checkpoints.
+#define CHECKPOINT_THREADS 4
+
+// Index entry describing one segment.
+struct CheckpointSegment {
+  uint64 offset;
+  uint64 length;
+  uint64 num_records;
+  uint32 crc;
+  uint32 unused;
+};
+
+class CheckpointWriter {
+ public:
+  // Creates '<path>.tmp' for a checkpoint stable as of txn 'stable', to be
+  // written by threads 0 .. 'num_threads' - 1.
+  CheckpointWriter(const string& path, int64 stable, int num_threads);
+
+  // Discards the temporary file unless Finish succeeded.
+  ~CheckpointWriter();
+
+  // Adds a record from writer thread 'thread'. Each thread id must be used
+  // by only one thread at a time.
+  void Add(int thread, int64 version, const Key& key, const Value& value);
+
+  // Writes out all buffered records and the index, syncs the file and gives
+  // it its final name. Must be called after all writer threads are done.
+  // Returns false if any write failed.
+  bool Finish();
+
+ private:
+  // Writes thread 'thread's buffer out as a segment.
+  void WriteSegment(int thread);
+
+  // Records that a write failed. May be called by any writer thread.
+  void Fail() { __sync_fetch_and_add(&failed_, 1); }
+
+  string path_;
+  int fd_;
+
+  // Per-thread record buffers and the number of records in each.
+  vector<string> buffers_;
+  vector<uint64> buffered_records_;
+
+  // Segments written so far and the end of the file, protected by 'mutex_'.
+  vector<CheckpointSegment> index_;
+  uint64 end_;
+  Mutex mutex_;
+
+  // Number of failed writes, updated atomically.
+  volatile int failed_;
+  bool finished_;
+};
+
+class CheckpointReader {
+ public:
+  // Maps the checkpoint at 'path' and validates its header, index and
+  // trailer. Check valid() before using the reader.
+  explicit CheckpointReader(const string& path);
+  ~CheckpointReader();
+
+  // Returns true if the file could be mapped and its index is intact.
+  bool valid() const { return data_ != NULL; }
+
+  // Txn id up to which the checkpoint is stable.
+  int64 stable() const { return stable_; }
+
+  // Number of records in the checkpoint.
+  uint64 num_records() const;
+
+  // Loads every record into 'storage', decoding segments on 'num_threads'
+  // threads that put their records into 'storage' concurrently, as workers
+  // do (each key appears once in a checkpoint). Returns false (after loading
+  // all intact segments) if any segment's checksum does not match.
+  bool Load(Storage* storage, int num_threads);
+
+ private:
+  // Loads the segments assigned to 'thread'.
+  void LoadSegments(int thread);
+  static void* RunLoader(void* arg);
+
+  const char* data_;
+  uint64 size_;
+  int64 stable_;
+  const CheckpointSegment* index_;
+  uint64 num_segments_;
+
+  // State of the current Load call.
+  Storage* storage_;
+  int num_threads_;
+
+  // Number of corrupt segments found, updated atomically.
+  volatile int corrupt_;
+};
+
+#endif  // _DB_BACKEND_CHECKPOINT_FILE_H_
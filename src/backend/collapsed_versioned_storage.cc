@@ -4,131 +4,375 @@
 
 #include "backend/collapsed_versioned_storage.h"
 
+#include <dirent.h>
 #include <pthread.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
 #include <cstdio>
 #include <cstdlib>
 #include <string>
 
+#include "backend/checkpoint_file.h"
+#include "common/utils.h"
+
 using std::string;
 
-#define TPCCHACK
+// Parses the decimal number at 'p' into '*n'. Returns the end of the number,
+// or NULL if there is none before 'end'.
+static const char* ParseNumber(const char* p, const char* end, int64* n) {
+  const char* start = p;
+  *n = 0;
+  for (; p < end && *p >= '0' && *p <= '9' && p - start < 18; p++)
+    *n = *n * 10 + (*p - '0');
+  return p == start ? NULL : p;
+}
 
-#ifdef TPCCHACK
-#define MAXARRAYSIZE 1000000
-  // For inserted objects we need to make a representation that is thread-safe
-  // (i.e. an array).  This is kind of hacky, but since this only corresponds
-  // to TPCC, we'll be okay
-  Value* NewOrderStore[MAXARRAYSIZE];
-  Value* OrderStore[MAXARRAYSIZE];
-  Value* OrderLineStore[MAXARRAYSIZE * 15];
-  Value* HistoryStore[MAXARRAYSIZE];
-#endif
+CollapsedVersionedStorage::~CollapsedVersionedStorage() {
+  unordered_map<int64, DistrictInserts*>::iterator it;
+  for (it = districts_.begin(); it != districts_.end(); ++it)
+    delete it->second;
+  unordered_map<int64, InsertTable*>::iterator history;
+  for (history = histories_.begin(); history != histories_.end(); ++history)
+    delete history->second;
+}
 
-Value* CollapsedVersionedStorage::ReadObject(const Key& key, int64 txn_id) {
-#ifdef TPCCHACK
-  if (key.find("ol") != string::npos) {
-    return OrderLineStore[txn_id * 15 + atoi(&key[key.find("line(") + 5])];
-  } else if (key.find("no") != string::npos) {
-    return NewOrderStore[txn_id];
-  } else if (key.find("o") != string::npos) {
-    return OrderStore[txn_id];
-  } else if (key.find("h") != string::npos) {
-    return HistoryStore[txn_id];
-  } else {
-#endif
+bool CollapsedVersionedStorage::FindInsertTable(const Key& key, bool insert,
+                                                InsertTable** table,
+                                                int64* id, int32* owner,
+                                                DistrictInserts** district) {
+  const char* p = key.data();
+  const char* end = p + key.size();
+  int64 warehouse, district_id, order, line;
+  if (p == end || *p++ != 'w' || (p = ParseNumber(p, end, &warehouse)) == NULL
+      || p == end)
+    return false;
 
-  // Check to see if a match even exists
-  if (objects_.count(key) != 0) {
-    for (DataNode* list = objects_[key]; list; list = list->next) {
-      if (list->txn_id <= txn_id) {
-        return list->value;
-      }
+  if (*p == 'h') {
+    if ((p = ParseNumber(p + 1, end, id)) != end)
+      return false;
+    *table = NULL;
+    {
+      ReadLock l(&mutex_);
+      unordered_map<int64, InsertTable*>::iterator it =
+          histories_.find(warehouse);
+      if (it != histories_.end())
+        *table = it->second;
+    }
+    if (*table == NULL && insert) {
+      WriteLock l(&mutex_);
+      InsertTable*& slot = histories_[warehouse];
+      if (slot == NULL)
+        slot = new InsertTable(&epochs_);
+      *table = slot;
     }
+    *owner = warehouse;
+    if (district != NULL)
+      *district = NULL;
+    return true;
+  }
+
+  // Otherwise the key must be "w<W>d<D>no<O>", "w<W>d<D>o<O>" or
+  // "w<W>d<D>o<O>ol<L>".
+  if (*p++ != 'd' || (p = ParseNumber(p, end, &district_id)) == NULL ||
+      p == end)
+    return false;
+  bool new_order = (*p == 'n');
+  if (new_order && (++p == end || *p != 'o'))
+    return false;
+  if (*p != 'o' || (p = ParseNumber(p + 1, end, &order)) == NULL)
+    return false;
+  line = -1;
+  if (!new_order && p != end) {
+    if (end - p < 3 || p[0] != 'o' || p[1] != 'l' ||
+        ParseNumber(p + 2, end, &line) != end || line >= ORDER_LINE_SLOTS)
+      return false;
+  } else if (p != end) {
+    return false;
   }
 
-#ifdef TPCCHACK
+  int64 code = warehouse << 16 | district_id;
+  DistrictInserts* inserts = NULL;
+  {
+    ReadLock l(&mutex_);
+    unordered_map<int64, DistrictInserts*>::iterator it =
+        districts_.find(code);
+    if (it != districts_.end())
+      inserts = it->second;
+  }
+  if (inserts == NULL && insert) {
+    WriteLock l(&mutex_);
+    DistrictInserts*& slot = districts_[code];
+    if (slot == NULL)
+      slot = new DistrictInserts(&epochs_);
+    inserts = slot;
   }
-#endif
 
-  // No match found
-  return NULL;
+  *owner = 0;
+  if (district != NULL)
+    *district = inserts;
+  if (new_order) {
+    *id = order;
+    *table = inserts ? &inserts->new_orders : NULL;
+  } else if (line < 0) {
+    *id = order;
+    *table = inserts ? &inserts->orders : NULL;
+  } else {
+    *id = order * ORDER_LINE_SLOTS + line;
+    *table = inserts ? &inserts->order_lines : NULL;
+  }
+  return true;
 }
 
-bool CollapsedVersionedStorage::PutObject(const Key& key, Value* value,
-                                          int64 txn_id) {
-#ifdef TPCCHACK
-  if (key.find("ol") != string::npos) {
-    OrderLineStore[txn_id * 15 + atoi(&key[key.find("line(") + 5])] =
-      value;
-  } else if (key.find("no") != string::npos) {
-    NewOrderStore[txn_id] = value;
-  } else if (key.find("o") != string::npos) {
-    OrderStore[txn_id] = value;
-  } else if (key.find("h") != string::npos) {
-    HistoryStore[txn_id] = value;
-  } else {
-#endif
+DataNode** CollapsedVersionedStorage::Lookup(const Key& key, bool insert) {
+  {
+    ReadLock l(&mutex_);
+    unordered_map<Key, DataNode*>::iterator it = objects_.find(key);
+    if (it != objects_.end())
+      return &it->second;
+  }
+  if (!insert)
+    return NULL;
+
+  // Elements never move in an unordered_map, so the slot stays valid.
+  WriteLock l(&mutex_);
+  return &objects_[key];
+}
+
+DataNode* CollapsedVersionedStorage::WritableVersion(DataNode** slot,
+                                                     int64 txn_id,
+                                                     bool copy_value) {
+  if (snapshots_)
+    return SnapshotVersion(slot, txn_id, copy_value);
+
+  DataNode* head = *slot;
+  if (head != NULL && !checkpointing_) {
+    // No checkpoint needs the older versions any more.
+    DataNode* old = head->next;
+    if (old != NULL) {
+      head->next = NULL;
+      RetireVersions(head, old);
+    }
+    return head;
+  }
 
-  // Create the new version to insert into the list
+  if (head != NULL && (head->txn_id > stable_) == (txn_id > stable_))
+    return head;
+
+  if (head != NULL && txn_id <= stable_) {
+    // A write from before the checkpoint's boundary after a later one (only
+    // possible when txns are not executed in order): it belongs to the stable
+    // version.
+    DataNode* list = head;
+    while (list->next != NULL && list->txn_id > stable_)
+      list = list->next;
+    if (list->txn_id <= stable_)
+      return list;
+    DataNode* item = new DataNode();
+    item->txn_id = txn_id;
+    item->value = NULL;
+    item->next = NULL;
+    list->next = item;
+    return item;
+  }
+
+  // The newest version is stable (or there is none yet): add a live version
+  // in front of it, leaving it untouched for the capture.
   DataNode* item = new DataNode();
   item->txn_id = txn_id;
-  item->value = value;
-  item->next = NULL;
-
-  // Is the most recent value a candidate for pruning?
-  DataNode* current;
-  if (objects_.count(key) != 0 && (current = objects_[key]) != NULL) {
-    int64 most_recent = current->txn_id;
-
-    if ((most_recent > stable_ && txn_id > stable_) ||
-        (most_recent <= stable_ && txn_id <= stable_)) {
-      item->next = current->next;
-      delete current;
-    } else {
-      item->next = current;
-    }
+  item->value = (copy_value && head != NULL && head->value != NULL) ?
+                new Value(*head->value) : NULL;
+  item->next = head;
+  __sync_synchronize();
+  *slot = item;
+  return item;
+}
+
+DataNode* CollapsedVersionedStorage::SnapshotVersion(DataNode** slot,
+                                                     int64 txn_id,
+                                                     bool copy_value) {
+  DataNode* head = *slot;
+  DataNode* item = head;
+  if (head == NULL || head->txn_id < txn_id) {
+    item = new DataNode();
+    item->txn_id = txn_id;
+    item->value = (copy_value && head != NULL && head->value != NULL) ?
+                  new Value(*head->value) : NULL;
+    item->next = head;
+    __sync_synchronize();
+    *slot = item;
+  }
+
+  // Readers stop at the first version at or below their snapshot, which is
+  // never older than the horizon: they do not get past 'keep'. A stale
+  // horizon only keeps more versions.
+  int64 horizon = snapshot_horizon_;
+  if (checkpointing_ && stable_ < horizon)
+    horizon = stable_;
+  DataNode* keep = item;
+  while (keep != NULL && keep->txn_id > horizon)
+    keep = keep->next;
+  if (keep != NULL && keep->next != NULL) {
+    DataNode* old = keep->next;
+    keep->next = NULL;
+    RetireVersions(item, old);
   }
-  objects_[key] = item;
+  return item;
+}
 
-#ifdef TPCCHACK
+void CollapsedVersionedStorage::RetireVersions(DataNode* head,
+                                               DataNode* old) {
+  while (old != NULL) {
+    DataNode* next = old->next;
+    RetireValue(head, old, old->value);
+    epochs_.Retire(old);
+    old = next;
   }
-#endif
+}
 
-  return true;
+void CollapsedVersionedStorage::RetireValue(DataNode* head, DataNode* version,
+                                            Value* value) {
+  // Versions share a value when a txn writes back an object it read without
+  // ReadObjectForUpdate. Unlinked versions still point to the rest of theirs.
+  if (value == NULL)
+    return;
+  for (DataNode* list = head; list != NULL; list = list->next) {
+    if (list != version && list->value == value)
+      return;
+  }
+  for (DataNode* list = version->next; list != NULL; list = list->next) {
+    if (list->value == value)
+      return;
+  }
+  epochs_.Retire(value);
 }
 
-bool CollapsedVersionedStorage::DeleteObject(const Key& key, int64 txn_id) {
-#ifdef TPCCHACK
-  if (key.find("o") != string::npos || key.find("h") != string::npos)
-    return false;
-#endif
+Value* CollapsedVersionedStorage::ReadObject(const Key& key, int64 txn_id) {
+  InsertTable* table;
+  int64 id;
+  int32 owner;
+  if (FindInsertTable(key, false, &table, &id, &owner)) {
+    if (table == NULL)
+      return NULL;
+    InsertedRecord* row = table->Find(id);
+    if (row == NULL || row->owner != owner)
+      return NULL;
+    return table->Read(id, txn_id);
+  }
 
-  DataNode* list = (objects_.count(key) == 0 ? NULL : objects_[key]);
+  // Check to see if a match even exists. Outside of checkpoints and
+  // snapshot reads only the newest version is visible; older ones are about
+  // to be dropped.
+  DataNode** slot = Lookup(key, false);
+  if (slot != NULL) {
+    for (DataNode* list = *slot; list; list = list->next) {
+      if (list->txn_id <= txn_id)
+        return list->value;
+      if (!checkpointing_ && !snapshots_)
+        break;
+    }
+  }
 
-  while (list != NULL) {
-    if ((list->txn_id > stable_ && txn_id > stable_) ||
-        (list->txn_id <= stable_ && txn_id <= stable_))
-      break;
+  // No match found
+  return NULL;
+}
 
-    list = list->next;
+Value* CollapsedVersionedStorage::ReadObjectForUpdate(const Key& key,
+                                                      int64 txn_id) {
+  // Like records, inserted rows keep the contents that snapshot readers and
+  // the checkpoint in progress may still read.
+  InsertTable* table;
+  int64 id;
+  int32 owner;
+  if (FindInsertTable(key, false, &table, &id, &owner)) {
+    if (table == NULL)
+      return NULL;
+    InsertedRecord* row = table->Find(id);
+    if (row == NULL || row->owner != owner)
+      return NULL;
+    int64 first_snapshot = LLONG_MAX;
+    int64 last_snapshot = LLONG_MIN;
+    if (snapshots_) {
+      first_snapshot = snapshot_horizon_;
+      last_snapshot = LLONG_MAX;
+    }
+    if (checkpointing_) {
+      if (stable_ < first_snapshot)
+        first_snapshot = stable_;
+      if (stable_ > last_snapshot)
+        last_snapshot = stable_;
+    }
+    return table->Update(id, txn_id, first_snapshot, last_snapshot);
   }
 
-  // First we need to insert an empty string when there is >1 item
-  if (list != NULL && objects_[key] == list && list->next != NULL) {
-    objects_[key]->txn_id = txn_id;
-    objects_[key]->value = NULL;
+  DataNode** slot = Lookup(key, false);
+  if (slot == NULL || *slot == NULL)
+    return NULL;
+  DataNode* version = WritableVersion(slot, txn_id, true);
+  version->txn_id = txn_id;
+  return version->value;
+}
+
+bool CollapsedVersionedStorage::PutObject(const Key& key, Value* value,
+                                          int64 txn_id) {
+  InsertTable* table;
+  int64 id;
+  int32 owner;
+  DistrictInserts* inserts;
+  if (FindInsertTable(key, true, &table, &id, &owner, &inserts)) {
+    if (!table->Put(id, value, txn_id, owner))
+      return false;
+
+    // History rows are retired as new ones are inserted, one segment at a
+    // time. Like orders, they are kept while a checkpoint is in progress.
+    if (inserts == NULL && !checkpointing_ && id > RETAINED_HISTORY &&
+        (id & (INSERT_SEGMENT_SIZE - 1)) == 0)
+      table->Retire(id - RETAINED_HISTORY);
+    return true;
+  }
 
-  // Otherwise we need to free the head
-  } else if (list != NULL && objects_[key] == list) {
-    delete objects_[key];
-    objects_[key] = NULL;
+  DataNode** slot = Lookup(key, true);
+  DataNode* version = WritableVersion(slot, txn_id, false);
+  Value* old = version->value;
+  version->txn_id = txn_id;
+  version->value = value;
+  if (old != value)
+    RetireValue(*slot, version, old);
+  return true;
+}
 
-  // Lastly, we may only want to free the tail
-  } else if (list != NULL) {
-    delete list;
-    objects_[key]->next = NULL;
+bool CollapsedVersionedStorage::DeleteObject(const Key& key, int64 txn_id) {
+  InsertTable* table;
+  int64 id;
+  int32 owner;
+  DistrictInserts* inserts;
+  if (FindInsertTable(key, false, &table, &id, &owner, &inserts)) {
+    if (table == NULL || !table->Delete(id, txn_id))
+      return false;
+
+    // Deleting a NewOrder row delivers its order: older orders are no longer
+    // needed beyond the retained ones. Retirement waits for checkpoints, which
+    // read the tables without locks.
+    if (table == &inserts->new_orders && !checkpointing_ &&
+        id > RETAINED_ORDERS) {
+      int64 retired = id - RETAINED_ORDERS;
+      inserts->new_orders.Retire(retired);
+      inserts->orders.Retire(retired);
+      inserts->order_lines.Retire(retired * ORDER_LINE_SLOTS);
+    }
+    return true;
   }
 
+  // Deletion leaves an empty version, so that a checkpoint in progress still
+  // sees the stable one.
+  DataNode** slot = Lookup(key, false);
+  if (slot == NULL || *slot == NULL)
+    return true;
+  DataNode* version = WritableVersion(slot, txn_id, false);
+  Value* old = version->value;
+  version->txn_id = txn_id;
+  version->value = NULL;
+  RetireValue(*slot, version, old);
   return true;
 }
 
@@ -136,88 +380,195 @@ int CollapsedVersionedStorage::Checkpoint() {
   pthread_t checkpointing_daemon;
   int thread_status = pthread_create(&checkpointing_daemon, NULL,
                                      &RunCheckpointer, this);
+  if (thread_status == 0)
+    pthread_detach(checkpointing_daemon);
 
   return thread_status;
 }
 
+// Arguments of a checkpoint writer thread.
+struct CheckpointSlice {
+  CollapsedVersionedStorage* storage;
+  CheckpointWriter* writer;
+  int thread;
+};
+
+void* CollapsedVersionedStorage::RunCheckpointWriter(void* arg) {
+  // Workers take precedence over the capture when they compete for cores.
+  setpriority(PRIO_PROCESS, syscall(SYS_gettid), CHECKPOINT_NICENESS);
+
+  CheckpointSlice* slice = reinterpret_cast<CheckpointSlice*>(arg);
+  slice->storage->WriteCheckpointSlice(slice->writer, slice->thread);
+  return NULL;
+}
+
+void CollapsedVersionedStorage::WriteCheckpointSlice(CheckpointWriter* writer,
+                                                     int thread) {
+  // Each thread writes every CHECKPOINT_THREADS'th collected record. Stable
+  // versions are never modified while the checkpoint is in progress, and
+  // later versions are only ever added in front of them.
+  for (size_t i = thread; i < capture_.size(); i += CHECKPOINT_THREADS) {
+    for (DataNode* list = capture_[i].second; list; list = list->next) {
+      if (list->txn_id <= stable_) {
+        if (list->value != NULL)
+          writer->Add(thread, 0, *capture_[i].first, *list->value);
+        break;
+      }
+    }
+  }
+
+  WriteInsertedSlice(writer, thread);
+}
+
+// Returns true if 'row' was inserted and not deleted as of txn 'stable'.
+static inline bool StableRow(const InsertedRecord& row, int64 stable) {
+  return row.value != NULL && row.txn_id <= stable &&
+         (row.deleted < 0 || row.deleted > stable);
+}
+
+void CollapsedVersionedStorage::WriteInsertedSlice(CheckpointWriter* writer,
+                                                   int thread) {
+  // Inserted rows are restored with the inserting txn's id as their version,
+  // and their contents as of the boundary: later updates go to copies.
+  // Retirement is suspended during the capture, so no segment goes away
+  // while it is read.
+  char key[64];
+  for (size_t i = thread; i < capture_districts_.size();
+       i += CHECKPOINT_THREADS) {
+    int warehouse = static_cast<int>(capture_districts_[i].first >> 16);
+    int district = static_cast<int>(capture_districts_[i].first & 0xFFFF);
+    DistrictInserts* inserts = capture_districts_[i].second;
+    InsertTable* tables[] = {&inserts->new_orders, &inserts->orders,
+                             &inserts->order_lines};
+    for (int t = 0; t < 3; t++) {
+      for (int64 s = 0; s < tables[t]->NumSegments(); s++) {
+        InsertedRecord* rows = tables[t]->Segment(s);
+        for (int j = 0; rows != NULL && j < INSERT_SEGMENT_SIZE; j++) {
+          if (!StableRow(rows[j], stable_))
+            continue;
+          int64 id = (s << INSERT_SEGMENT_BITS) + j;
+          if (t == 0) {
+            snprintf(key, sizeof(key), "w%dd%dno%ld", warehouse, district,
+                     (long)id);
+          } else if (t == 1) {
+            snprintf(key, sizeof(key), "w%dd%do%ld", warehouse, district,
+                     (long)id);
+          } else {
+            snprintf(key, sizeof(key), "w%dd%do%ldol%ld", warehouse, district,
+                     (long)(id / ORDER_LINE_SLOTS),
+                     (long)(id % ORDER_LINE_SLOTS));
+          }
+          writer->Add(thread, rows[j].txn_id, key,
+                      *InsertTable::VersionAt(rows[j], stable_));
+        }
+      }
+    }
+  }
+
+  for (size_t i = thread; i < capture_histories_.size();
+       i += CHECKPOINT_THREADS) {
+    int warehouse = static_cast<int>(capture_histories_[i].first);
+    InsertTable* history = capture_histories_[i].second;
+    for (int64 s = 0; s < history->NumSegments(); s++) {
+      InsertedRecord* rows = history->Segment(s);
+      for (int j = 0; rows != NULL && j < INSERT_SEGMENT_SIZE; j++) {
+        if (!StableRow(rows[j], stable_))
+          continue;
+        snprintf(key, sizeof(key), "w%dh%ld", warehouse,
+                 (long)((s << INSERT_SEGMENT_BITS) + j));
+        writer->Add(thread, rows[j].txn_id, key,
+                    *InsertTable::VersionAt(rows[j], stable_));
+      }
+    }
+  }
+}
+
 void CollapsedVersionedStorage::CaptureCheckpoint() {
   // Give the user output
   fprintf(stdout, "Beginning checkpoint capture...\n");
+  double start = GetTime();
 
-  // First, we open the file for writing
+  // The checkpoint only gets its final name once it is complete, so recovery
+  // never loads a partial one.
   char log_name[200];
   snprintf(log_name, sizeof(log_name), "%s/%ld.checkpoint", CHKPNTDIR, (long)stable_);
-  FILE* checkpoint = fopen(log_name, "w");
-
-  // Next we iterate through all of the objects and write the stable version
-  // to disk
-  unordered_map<Key, DataNode*>::iterator it;
-  for (it = objects_.begin(); it != objects_.end(); it++) {
-    // Read in the stable value
-    Key key = it->first;
-    Value* result = ReadObject(key, stable_);
-
-    // Write <len_key_bytes|key|len_value_bytes|value> to disk
-    int key_length = key.length();
-    int val_length = result->length();
-    fprintf(checkpoint, "%c%c%c%c%s%c%c%c%c%s",
-            static_cast<char>(key_length >> 24),
-            static_cast<char>(key_length >> 16),
-            static_cast<char>(key_length >> 8),
-            static_cast<char>(key_length),
-            key.c_str(),
-            static_cast<char>(val_length >> 24),
-            static_cast<char>(val_length >> 16),
-            static_cast<char>(val_length >> 8),
-            static_cast<char>(val_length),
-            result->c_str());
-
-    // Remove object from tree if there's an old version
-    if (it->second->next != NULL)
-      DeleteObject(key, stable_);
-  }
-
-#ifdef TPCCHACK
-  fprintf(checkpoint, "\nNewOrder\n");
-  for (int64 i = 0; i < MAXARRAYSIZE; i++) {
-    if (NewOrderStore[i] != NULL) {
-      fprintf(checkpoint, "%ld%s",
-              static_cast<long>((*NewOrderStore[i]).length()),
-              (*NewOrderStore[i]).c_str());
-    }
+  CheckpointWriter writer(log_name, stable_, CHECKPOINT_THREADS);
+
+  // Collect every record's version list. Keys inserted later were inserted
+  // by txns after the boundary and are not part of the checkpoint. The pin
+  // keeps what the capture collects from being freed until it is written.
+  int64 epoch = epochs_.Pin();
+  {
+    ReadLock l(&mutex_);
+    capture_.clear();
+    capture_.reserve(objects_.size());
+    unordered_map<Key, DataNode*>::iterator it;
+    for (it = objects_.begin(); it != objects_.end(); ++it)
+      capture_.push_back(pair<const Key*, DataNode*>(&it->first, it->second));
+    capture_districts_.assign(districts_.begin(), districts_.end());
+    capture_histories_.assign(histories_.begin(), histories_.end());
   }
 
-  fprintf(checkpoint, "\nOrder\n");
-  for (int64 i = 0; i < MAXARRAYSIZE; i++) {
-    if (OrderStore[i] != NULL) {
-      fprintf(checkpoint, "%ld%s",
-              static_cast<long>((*OrderStore[i]).length()),
-              (*OrderStore[i]).c_str());
-    }
+  pthread_t threads[CHECKPOINT_THREADS];
+  CheckpointSlice slices[CHECKPOINT_THREADS];
+  for (int i = 0; i < CHECKPOINT_THREADS; i++) {
+    slices[i].storage = this;
+    slices[i].writer = &writer;
+    slices[i].thread = i;
+    pthread_create(&threads[i], NULL, &RunCheckpointWriter, &slices[i]);
   }
+  for (int i = 0; i < CHECKPOINT_THREADS; i++)
+    pthread_join(threads[i], NULL);
+  epochs_.Unpin(epoch);
 
-  fprintf(checkpoint, "\nOrderLine\n");
-  for (int64 i = 0; i < MAXARRAYSIZE * 15; i++) {
-    if (OrderLineStore[i] != NULL) {
-      fprintf(checkpoint, "%ld%s",
-              static_cast<long>((*OrderLineStore[i]).length()),
-              (*OrderLineStore[i]).c_str());
-    }
+  // Stable versions may be dropped again from now on.
+  bool finished = writer.Finish();
+  capture_.clear();
+  capture_districts_.clear();
+  capture_histories_.clear();
+  checkpointing_ = false;
+
+  // Give the user output
+  if (finished) {
+    fprintf(stdout, "Finished checkpointing in %f seconds\n",
+            GetTime() - start);
+  } else {
+    fprintf(stdout, "Checkpointing failed\n");
   }
+}
 
-  fprintf(checkpoint, "\nHistory\n");
-  for (int64 i = 0; i < MAXARRAYSIZE; i++) {
-    if (HistoryStore[i] != NULL) {
-      fprintf(checkpoint, "%ld%s",
-              static_cast<long>((*HistoryStore[i]).length()),
-              (*HistoryStore[i]).c_str());
-    }
+int64 CollapsedVersionedStorage::LoadLatestCheckpoint(Storage* storage) {
+  // Find the checkpoint with the highest stable txn id.
+  DIR* dir = opendir(CHKPNTDIR);
+  if (dir == NULL)
+    return -1;
+  int64 stable = -1;
+  struct dirent* entry;
+  while ((entry = readdir(dir)) != NULL) {
+    string name(entry->d_name);
+    size_t suffix = name.find(".checkpoint");
+    if (suffix == string::npos || suffix + 11 != name.length())
+      continue;
+    int64 id = atoll(name.c_str());
+    if (id > stable)
+      stable = id;
   }
-#endif
+  closedir(dir);
+  if (stable < 0)
+    return -1;
 
-  // Close the file
-  fclose(checkpoint);
+  char log_name[200];
+  snprintf(log_name, sizeof(log_name), "%s/%ld.checkpoint", CHKPNTDIR, (long)stable);
+  fprintf(stdout, "Loading checkpoint %s...\n", log_name);
+  double start = GetTime();
+  CheckpointReader reader(log_name);
+  if (!reader.valid() || !reader.Load(storage, CHECKPOINT_THREADS)) {
+    fprintf(stdout, "Could not load checkpoint %s\n", log_name);
+    return -1;
+  }
 
-  // Give the user output
-  fprintf(stdout, "Finished checkpointing\n");
+  fprintf(stdout, "Loaded %lu objects stable as of txn %ld in %f seconds\n",
+          static_cast<unsigned long>(reader.num_records()),
+          (long)reader.stable(), GetTime() - start);
+  return reader.stable();
 }
@@ -2,20 +2,88 @@
 //
 // This implements a simple collapsed storage that can be used in a versioned
 // deterministic database system.
+//
+// Checkpoints are consistent and asynchronous. At a batch boundary the
+// scheduler calls PrepareForCheckpoint with the id of the batch's last txn,
+// and from then on every record keeps up to two versions (Ping-Pong style):
+// the stable one, as of that txn, and the live one. The first later txn to
+// modify a record (PutObject, DeleteObject or ReadObjectForUpdate) copies it
+// into a new live version instead of overwriting the stable one. Once all
+// txns up to the boundary have completed, Checkpoint starts a background
+// capture that writes the stable versions while execution continues. The
+// capture never takes locks held by workers: it only follows version lists,
+// whose stable nodes are never modified or freed while a checkpoint is in
+// progress. Superseded stable versions are dropped by the next write to the
+// record after the capture has finished.
+//
+// Overhead is bounded by one copy per record modified during a capture and
+// by the capture threads, which run at a low priority (CHECKPOINT_NICENESS)
+// so that workers take precedence over them; at most one checkpoint is in
+// progress at a time.
+//
+// Rows that TPC-C only ever inserts (NewOrder, Order, OrderLine and History)
+// are not kept in 'objects_' but in append-only tables (see
+// backend/insert_table.h): one of each kind per district, indexed by order
+// id, and one History table per warehouse, indexed by the warehouse's dense
+// History id. Such rows are recognized by their keys ("w1d2no3", "w1d2o3",
+// "w1d2o3ol4" and "w1h5"). The tables keep the id of the txn that inserted or
+// deleted each row, so checkpoints include exactly the rows inserted and not
+// deleted as of their boundary. Updates to inserted rows (ReadObjectForUpdate)
+// keep the contents as of the boundary like updates to records do.
+// Once an order has been delivered, orders more than RETAINED_ORDERS older
+// than it are retired, and History rows more than RETAINED_HISTORY older than
+// the latest one (no txn reads them) are retired as new ones are inserted
+// (while no checkpoint is in progress).
+//
+// With snapshot reads enabled (see Storage::EnableSnapshotReads), every
+// write by a txn other than the newest version's adds a new version in front
+// of it, so read-only txns can read any snapshot from the horizon on without
+// locks. Writes drop the versions older than the newest one at or below the
+// horizon (and the checkpoint's boundary, during a capture): no reader can
+// reach past that one. Inserted rows are hidden from snapshots before their
+// insertion, and their updates keep the contents older snapshots read the
+// same way (see InsertTable::Update).
+//
+// Dropped versions, replaced values and retired rows are not freed right
+// away but retired to 'epochs_' (see backend/epoch_manager.h), since workers
+// and the capture may still be using them.
 
 #ifndef _DB_BACKEND_COLLAPSED_VERSIONED_STORAGE_H_
 #define _DB_BACKEND_COLLAPSED_VERSIONED_STORAGE_H_
 
+#include <pthread.h>
+
 #include <climits>
 #include <cstring>
 #include <tr1/unordered_map>
 //#include <unordered_map>
+#include <utility>
 
+#include "backend/epoch_manager.h"
+#include "backend/insert_table.h"
 #include "backend/versioned_storage.h"
+#include "common/utils.h"
 
 #define CHKPNTDIR "../db/checkpoints"
 
+// Nice value of the capture's writer threads, so that they mostly run on
+// cores the workers leave idle.
+#define CHECKPOINT_NICENESS 19
+
+// Order lines are stored under id order_id * ORDER_LINE_SLOTS + number.
+#define ORDER_LINE_SLOTS 16
+
+// Number of orders before the latest delivered one that each district keeps.
+#define RETAINED_ORDERS 8192
+
+// Number of History rows before the latest inserted one that each warehouse
+// keeps.
+#define RETAINED_HISTORY 8192
+
+class CheckpointWriter;
+
 //using std::unordered_map;
+using std::pair;
 using std::tr1::unordered_map;
 
 struct DataNode {
@@ -24,19 +92,25 @@ struct DataNode {
   DataNode* next;
 };
 
+// The inserted rows of one TPC-C district.
+struct DistrictInserts {
+  explicit DistrictInserts(EpochManager* epochs)
+      : new_orders(epochs), orders(epochs), order_lines(epochs) {}
+
+  InsertTable new_orders;
+  InsertTable orders;
+  InsertTable order_lines;
+};
+
 class CollapsedVersionedStorage : public VersionedStorage {
  public:
   CollapsedVersionedStorage() {
     stable_ = 0;
-
-#ifdef TPCCHACK
-    memset(&NewOrderStore, 0, sizeof(NewOrderStore));
-    memset(&OrderStore, 0, sizeof(OrderStore));
-    memset(&OrderLineStore, 0, sizeof(OrderLineStore));
-    memset(&HistoryStore, 0, sizeof(HistoryStore));
-#endif
+    checkpointing_ = false;
+    snapshots_ = false;
+    snapshot_horizon_ = 0;
   }
-  virtual ~CollapsedVersionedStorage() {}
+  virtual ~CollapsedVersionedStorage();
 
   // TODO(Thad and Philip): How can we incorporate this type of versioned
   // storage into the work that you've been doing with prefetching?  It seems
@@ -45,6 +119,7 @@ class CollapsedVersionedStorage : public VersionedStorage {
 
   // Standard operators in the DB
   virtual Value* ReadObject(const Key& key, int64 txn_id = LLONG_MAX);
+  virtual Value* ReadObjectForUpdate(const Key& key, int64 txn_id);
   virtual bool PutObject(const Key& key, Value* value, int64 txn_id);
   virtual bool DeleteObject(const Key& key, int64 txn_id);
 
@@ -56,14 +131,79 @@ class CollapsedVersionedStorage : public VersionedStorage {
   // previously stable values are no longer necessary.  At this point in time,
   // the database can switch the labels as to what is stable (the previously
   // frozen values) to a new txn_id occurring in the future.
-  virtual void PrepareForCheckpoint(int64 stable) { stable_ = stable; }
+  virtual void PrepareForCheckpoint(int64 stable) {
+    stable_ = stable;
+    checkpointing_ = true;
+  }
   virtual int Checkpoint();
+  virtual bool CheckpointInProgress() { return checkpointing_; }
+
+  virtual bool EnableSnapshotReads() {
+    snapshots_ = true;
+    return true;
+  }
+  virtual void SetSnapshotHorizon(int64 horizon) {
+    snapshot_horizon_ = horizon;
+  }
+
+  virtual EpochManager* epochs() { return &epochs_; }
 
   // The capture checkpoint method is an internal method that allows us to
   // write out the stable checkpoint to disk.
   virtual void CaptureCheckpoint();
 
+  // Loads the most recent complete checkpoint in CHKPNTDIR into 'storage'
+  // (see backend/checkpoint_file.h).
+  // Returns the txn id up to which the checkpoint is stable (every later txn
+  // must be replayed), or -1 if no checkpoint was found.
+  static int64 LoadLatestCheckpoint(Storage* storage);
+
  private:
+  // Writes this thread's share of the stable state to 'writer'.
+  void WriteCheckpointSlice(CheckpointWriter* writer, int thread);
+  static void* RunCheckpointWriter(void* arg);
+
+  // Returns the slot in 'objects_' holding 'key's version list, inserting
+  // an empty one if 'insert' is true (otherwise returns NULL if 'key' does
+  // not exist).
+  DataNode** Lookup(const Key& key, bool insert);
+
+  // Returns the version in 'slot' that a write by 'txn_id' may modify in
+  // place. If the newest version is stable and must be preserved for the
+  // checkpoint in progress, first adds a new live version in front of it,
+  // copying its value if 'copy_value' is true. Outside of checkpoints, drops
+  // the older versions instead.
+  DataNode* WritableVersion(DataNode** slot, int64 txn_id, bool copy_value);
+
+  // WritableVersion with snapshot reads enabled: adds a new version unless
+  // the newest one is 'txn_id's own, and drops the versions no reader can see.
+  DataNode* SnapshotVersion(DataNode** slot, int64 txn_id, bool copy_value);
+
+  // Retires the versions from 'old' on, which were just unlinked from the
+  // list starting at 'head', and their values.
+  void RetireVersions(DataNode* head, DataNode* old);
+
+  // Retires 'value', which 'version' of the list starting at 'head' no
+  // longer holds, unless another version of the list still does.
+  void RetireValue(DataNode* head, DataNode* version, Value* value);
+
+  // Returns true if 'key' names an inserted row (see above), in which case
+  // '*table' is set to the row's table (or NULL if it does not exist and
+  // 'insert' is false), '*id' to its id and '*owner' to its owner, and
+  // '*district' (if given) to the row's district tables (NULL for History).
+  bool FindInsertTable(const Key& key, bool insert, InsertTable** table,
+                       int64* id, int32* owner,
+                       DistrictInserts** district = NULL);
+
+  // Writes this thread's share of the inserted rows that are stable to
+  // 'writer'.
+  void WriteInsertedSlice(CheckpointWriter* writer, int thread);
+
+  // Replaced versions and values, and retired rows of the inserted tables,
+  // are freed once no txn or capture that may hold them is still running.
+  // Declared first, so that it outlives everything retiring into it.
+  EpochManager epochs_;
+
   // We make a simple mapping of keys to a map of "versions" of our value.
   // The int64 represents a simple transaction id and the Value associated with
   // it is whatever value was written out at that time.
@@ -73,6 +213,35 @@ class CollapsedVersionedStorage : public VersionedStorage {
   // to write out to storage, and which should be the latest to be overwritten
   // in the current database execution cycle, respectively.
   int64 stable_;
+
+  // True from PrepareForCheckpoint until the capture is on disk.
+  volatile bool checkpointing_;
+
+  // True once snapshot reads are enabled, and the oldest snapshot any reader
+  // may still read.
+  bool snapshots_;
+  volatile int64 snapshot_horizon_;
+
+  // Protects the structure of 'objects_': inserts of new keys (by txns and
+  // by concurrent checkpoint loaders) hold it exclusively, and lookups and the
+  // capture's collection of the version lists hold it shared. Version lists
+  // themselves are protected by the txns' locks.
+  MutexRW mutex_;
+
+  // Version lists collected by the current capture, and their keys.
+  vector<pair<const Key*, DataNode*> > capture_;
+
+  // Inserted rows of each district, by warehouse id << 16 | district id.
+  // Protected by 'mutex_' like 'objects_'.
+  unordered_map<int64, DistrictInserts*> districts_;
+
+  // History rows of each warehouse, by warehouse id. Protected by 'mutex_'
+  // like 'objects_'.
+  unordered_map<int64, InsertTable*> histories_;
+
+  // District and History tables collected by the current capture.
+  vector<pair<int64, DistrictInserts*> > capture_districts_;
+  vector<pair<int64, InsertTable*> > capture_histories_;
 };
 
 static inline void* RunCheckpointer(void* storage) {
@@ -0,0 +1,238 @@
+// Author: Kun Ren (kun.ren@yale.edu)
+//
+// A concurrent hash index mapping Keys to Value pointers (see
+// concurrent_index.h).
+
+#include "backend/concurrent_index.h"
+
+#include <string.h>
+
+#include <tr1/functional>
+
+// Shards grow once more than 3/4 of their slots are used.
+#define INDEX_MAX_LOAD(slots) ((slots) / 4 * 3)
+
+ConcurrentIndex::ConcurrentIndex(EpochManager* epochs) : epochs_(epochs) {
+  shards_ = new Shard[INDEX_SHARDS];
+  for (int i = 0; i < INDEX_SHARDS; i++) {
+    shards_[i].table = NewTable(INDEX_INITIAL_SLOTS);
+    shards_[i].used = 0;
+    shards_[i].size = 0;
+  }
+}
+
+ConcurrentIndex::~ConcurrentIndex() {
+  for (int i = 0; i < INDEX_SHARDS; i++) {
+    Shard* shard = &shards_[i];
+    Table* table = shard->table;
+    for (uint64 j = 0; j <= table->mask; j++) {
+      if (table->slots[j].state == FULL)
+        delete table->slots[j].key;
+    }
+    DeleteTable(table);
+    for (uint32 j = 0; j < shard->retired_tables.size(); j++)
+      DeleteTable(shard->retired_tables[j]);
+    for (uint32 j = 0; j < shard->retired_keys.size(); j++)
+      delete shard->retired_keys[j];
+  }
+  delete[] shards_;
+}
+
+uint64 ConcurrentIndex::Hash(const Key& key) {
+  // Spread the string hash over all 64 bits, since the top bits select the
+  // shard and the bottom bits the slot.
+  uint64 h = std::tr1::hash<Key>()(key);
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  return h;
+}
+
+ConcurrentIndex::Table* ConcurrentIndex::NewTable(uint64 slots) {
+  Table* table = new Table();
+  table->mask = slots - 1;
+  table->slots = new Slot[slots];
+  memset(table->slots, 0, slots * sizeof(Slot));
+  return table;
+}
+
+void ConcurrentIndex::DeleteTable(Table* table) {
+  delete[] table->slots;
+  delete table;
+}
+
+Value* ConcurrentIndex::Lookup(const Key& key) const {
+  uint64 hash = Hash(key);
+  const Table* table = ShardFor(hash)->table;
+  __sync_synchronize();
+  for (uint64 i = hash & table->mask; ; i = (i + 1) & table->mask) {
+    const Slot* slot = &table->slots[i];
+    uint32 seq, state;
+    uint64 slot_hash;
+    const Key* slot_key;
+    Value* value;
+    do {
+      while ((seq = slot->seq) & 1) {}
+      __sync_synchronize();
+      state = slot->state;
+      slot_hash = slot->hash;
+      slot_key = slot->key;
+      value = slot->value;
+      __sync_synchronize();
+    } while (slot->seq != seq);
+
+    if (state == EMPTY)
+      return NULL;
+    // Keys are immutable, and not freed while the reader may use them.
+    if (state == FULL && slot_hash == hash && *slot_key == key)
+      return value;
+  }
+}
+
+void ConcurrentIndex::Prefetch(const Key& key) const {
+  uint64 hash = Hash(key);
+  const Table* table = ShardFor(hash)->table;
+  __builtin_prefetch(&table->slots[hash & table->mask]);
+}
+
+Value* ConcurrentIndex::Insert(const Key& key, Value* value) {
+  uint64 hash = Hash(key);
+  Shard* shard = ShardFor(hash);
+  Lock l(&shard->mutex);
+  if (shard->used + 1 > INDEX_MAX_LOAD(shard->table->mask + 1))
+    Grow(shard, (shard->table->mask + 1) * 2);
+  return InsertLocked(shard, hash, key, value);
+}
+
+void ConcurrentIndex::InsertBatch(const vector<pair<Key, Value*> >& objects) {
+  vector<vector<pair<uint64, uint32> > > by_shard(INDEX_SHARDS);
+  for (uint32 i = 0; i < objects.size(); i++) {
+    uint64 hash = Hash(objects[i].first);
+    by_shard[hash >> (64 - INDEX_SHARD_BITS)].push_back(
+        pair<uint64, uint32>(hash, i));
+  }
+
+  for (int i = 0; i < INDEX_SHARDS; i++) {
+    if (by_shard[i].empty())
+      continue;
+    Shard* shard = &shards_[i];
+    Lock l(&shard->mutex);
+    uint64 slots = shard->table->mask + 1;
+    while (shard->used + by_shard[i].size() > INDEX_MAX_LOAD(slots))
+      slots *= 2;
+    if (slots != shard->table->mask + 1)
+      Grow(shard, slots);
+    for (uint32 j = 0; j < by_shard[i].size(); j++) {
+      const pair<Key, Value*>& object = objects[by_shard[i][j].second];
+      InsertLocked(shard, by_shard[i][j].first, object.first, object.second);
+    }
+  }
+}
+
+Value* ConcurrentIndex::InsertLocked(Shard* shard, uint64 hash,
+                                     const Key& key, Value* value) {
+  Table* table = shard->table;
+  Slot* free_slot = NULL;
+  for (uint64 i = hash & table->mask; ; i = (i + 1) & table->mask) {
+    Slot* slot = &table->slots[i];
+    if (slot->state == FULL && slot->hash == hash && *slot->key == key) {
+      // Existing key: only the value changes.
+      Value* old = slot->value;
+      slot->seq++;
+      __sync_synchronize();
+      slot->value = value;
+      __sync_synchronize();
+      slot->seq++;
+      return old;
+    }
+    if (slot->state == ERASED && free_slot == NULL)
+      free_slot = slot;
+    if (slot->state == EMPTY) {
+      if (free_slot == NULL) {
+        free_slot = slot;
+        shard->used++;
+      }
+      break;
+    }
+  }
+
+  free_slot->seq++;
+  __sync_synchronize();
+  free_slot->hash = hash;
+  free_slot->key = new Key(key);
+  free_slot->value = value;
+  free_slot->state = FULL;
+  __sync_synchronize();
+  free_slot->seq++;
+  shard->size++;
+  return NULL;
+}
+
+bool ConcurrentIndex::Erase(const Key& key, Value** value) {
+  uint64 hash = Hash(key);
+  Shard* shard = ShardFor(hash);
+  Lock l(&shard->mutex);
+  Table* table = shard->table;
+  for (uint64 i = hash & table->mask; ; i = (i + 1) & table->mask) {
+    Slot* slot = &table->slots[i];
+    if (slot->state == EMPTY)
+      return false;
+    if (slot->state == FULL && slot->hash == hash && *slot->key == key) {
+      // The slot stays ERASED rather than EMPTY so that probes for keys
+      // placed after it keep going.
+      if (value != NULL)
+        *value = slot->value;
+      slot->seq++;
+      __sync_synchronize();
+      slot->state = ERASED;
+      slot->value = NULL;
+      __sync_synchronize();
+      slot->seq++;
+      const Key* erased_key = slot->key;
+      if (epochs_ != NULL)
+        epochs_->Retire(const_cast<Key*>(erased_key));
+      else
+        shard->retired_keys.push_back(erased_key);
+      shard->size--;
+      return true;
+    }
+  }
+}
+
+void ConcurrentIndex::Grow(Shard* shard, uint64 slots) {
+  Table* old_table = shard->table;
+  Table* table = NewTable(slots);
+  uint64 used = 0;
+  for (uint64 i = 0; i <= old_table->mask; i++) {
+    const Slot& old_slot = old_table->slots[i];
+    if (old_slot.state != FULL)
+      continue;
+    uint64 j = old_slot.hash & table->mask;
+    while (table->slots[j].state != EMPTY)
+      j = (j + 1) & table->mask;
+    table->slots[j].hash = old_slot.hash;
+    table->slots[j].key = old_slot.key;
+    table->slots[j].value = old_slot.value;
+    table->slots[j].state = FULL;
+    used++;
+  }
+
+  // Readers still probing the old table see its (unchanged) entries until
+  // they finish.
+  __sync_synchronize();
+  shard->table = table;
+  if (epochs_ != NULL)
+    epochs_->Retire(old_table, FreeTable);
+  else
+    shard->retired_tables.push_back(old_table);
+  shard->used = used;
+}
+
+uint64 ConcurrentIndex::size() const {
+  uint64 size = 0;
+  for (int i = 0; i < INDEX_SHARDS; i++) {
+    Lock l(&shards_[i].mutex);
+    size += shards_[i].size;
+  }
+  return size;
+}
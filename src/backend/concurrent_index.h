@@ -0,0 +1,134 @@
+// Author: Kun Ren (kun.ren@yale.edu)
+//
+// A concurrent hash index mapping Keys to Value pointers.
+//
+// The index is split into INDEX_SHARDS shards by the top bits of each key's
+// hash, and every shard is an open-addressing (linear probing) table. Writers
+// serialize on their shard's mutex, so inserts into different shards never
+// contend. Readers take no locks at all: every slot carries a sequence number
+// that writers make odd while they modify the slot, and a reader retries a
+// slot whose sequence number was odd or changed while it read it. A lookup
+// therefore probes the table once and never blocks behind a writer.
+//
+// Memory read by lock-free readers stays valid while they may use it: tables
+// outgrown by a shard and keys of erased entries are retired to the index's
+// EpochManager (see backend/epoch_manager.h), whose readers pin it, or
+// deleted with the index if it has none. Values are the caller's.
+
+#ifndef _DB_BACKEND_CONCURRENT_INDEX_H_
+#define _DB_BACKEND_CONCURRENT_INDEX_H_
+
+#include <pthread.h>
+
+#include <utility>
+#include <vector>
+
+#include "backend/epoch_manager.h"
+#include "common/types.h"
+#include "common/utils.h"
+
+using std::pair;
+using std::vector;
+
+// Number of independently locked shards is 2^INDEX_SHARD_BITS.
+#define INDEX_SHARD_BITS 6
+#define INDEX_SHARDS (1 << INDEX_SHARD_BITS)
+
+// Initial number of slots of each shard's table (a power of two).
+#define INDEX_INITIAL_SLOTS 1024
+
+class ConcurrentIndex {
+ public:
+  explicit ConcurrentIndex(EpochManager* epochs = NULL);
+  ~ConcurrentIndex();
+
+  // Returns the value stored under 'key', or NULL if there is none. Never
+  // blocks; safe to call concurrently with any other method.
+  Value* Lookup(const Key& key) const;
+
+  // Issues a software prefetch of the slot a lookup of 'key' probes first,
+  // without waiting for it, so that lookups of several keys overlap their
+  // cache misses. Callers keep the tables valid the same way as for Lookup.
+  void Prefetch(const Key& key) const;
+
+  // Stores 'value' under 'key', replacing any previous value. Returns the
+  // value replaced, or NULL if there was none.
+  Value* Insert(const Key& key, Value* value);
+
+  // Stores every (key, value) pair of 'objects', locking each shard once and
+  // growing it at most once.
+  void InsertBatch(const vector<pair<Key, Value*> >& objects);
+
+  // Removes 'key', storing its value in '*value' (if not NULL). Returns false
+  // if it was not present.
+  bool Erase(const Key& key, Value** value = NULL);
+
+  // Number of keys stored.
+  uint64 size() const;
+
+ private:
+  enum SlotState {
+    EMPTY = 0,
+    FULL = 1,
+    ERASED = 2,
+  };
+
+  struct Slot {
+    // Odd while a writer modifies the slot.
+    volatile uint32 seq;
+    volatile uint32 state;
+    volatile uint64 hash;
+    const Key* volatile key;
+    Value* volatile value;
+  };
+
+  struct Table {
+    uint64 mask;
+    Slot* slots;
+  };
+
+  struct Shard {
+    Mutex mutex;
+    Table* volatile table;
+
+    // Slots that are FULL or ERASED (the latter still lengthen probes).
+    uint64 used;
+    uint64 size;
+
+    // Outgrown tables and erased keys, deleted with the index if it has no
+    // EpochManager.
+    vector<Table*> retired_tables;
+    vector<const Key*> retired_keys;
+
+    // Pads shards to separate cache lines.
+    char padding[64];
+  };
+
+  static uint64 Hash(const Key& key);
+  Shard* ShardFor(uint64 hash) const {
+    return &shards_[hash >> (64 - INDEX_SHARD_BITS)];
+  }
+
+  // Inserts into 'shard', whose mutex the caller holds. Returns the value
+  // replaced, if any.
+  Value* InsertLocked(Shard* shard, uint64 hash, const Key& key,
+                      Value* value);
+
+  // Replaces 'shard's table with one of at least 'slots' slots.
+  void Grow(Shard* shard, uint64 slots);
+
+  static Table* NewTable(uint64 slots);
+  static void DeleteTable(Table* table);
+  static void FreeTable(void* table) {
+    DeleteTable(reinterpret_cast<Table*>(table));
+  }
+
+  Shard* shards_;
+  EpochManager* epochs_;
+
+  // DISALLOW_COPY_AND_ASSIGN
+  ConcurrentIndex(const ConcurrentIndex&);
+  ConcurrentIndex& operator=(const ConcurrentIndex&);
+};
+
+#endif  // _DB_BACKEND_CONCURRENT_INDEX_H_
@@ -0,0 +1,160 @@
+// Author: Kun Ren (kun.ren@yale.edu)
+//
+// Epoch-based memory reclamation (see epoch_manager.h).
+
+#include "backend/epoch_manager.h"
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <vector>
+
+#include "common/utils.h"
+
+using std::vector;
+
+// Every thread that uses an epoch manager gets an index, the same in all of
+// them, which it gives back when it exits.
+static Mutex thread_index_mutex;
+static vector<int> free_thread_indexes;
+static volatile int thread_indexes = 0;
+static pthread_key_t thread_index_key;
+static pthread_once_t thread_index_once = PTHREAD_ONCE_INIT;
+static __thread int thread_index = -1;
+
+static void ReleaseThreadIndex(void* index) {
+  Lock l(&thread_index_mutex);
+  free_thread_indexes.push_back(reinterpret_cast<intptr_t>(index) - 1);
+}
+
+static void CreateThreadIndexKey() {
+  pthread_key_create(&thread_index_key, ReleaseThreadIndex);
+}
+
+static int ThreadIndex() {
+  if (thread_index >= 0)
+    return thread_index;
+  pthread_once(&thread_index_once, CreateThreadIndexKey);
+  {
+    Lock l(&thread_index_mutex);
+    if (!free_thread_indexes.empty()) {
+      thread_index = free_thread_indexes.back();
+      free_thread_indexes.pop_back();
+    } else if (thread_indexes < EPOCH_MAX_THREADS) {
+      thread_index = thread_indexes;
+      thread_indexes = thread_indexes + 1;
+    } else {
+      printf("EpochManager: more than %d threads\n", EPOCH_MAX_THREADS);
+      exit(EXIT_FAILURE);
+    }
+  }
+  // Stored off by one, since NULL values are not passed to the destructor.
+  pthread_setspecific(thread_index_key,
+                      reinterpret_cast<void*>(thread_index + 1));
+  return thread_index;
+}
+
+EpochManager::EpochManager() : epoch_(0) {
+  slots_ = new Slot[EPOCH_MAX_THREADS];
+}
+
+EpochManager::~EpochManager() {
+  for (int i = 0; i < EPOCH_MAX_THREADS; i++) {
+    deque<RetiredObject>* retired = &slots_[i].retired;
+    for (uint32 j = 0; j < retired->size(); j++)
+      (*retired)[j].free((*retired)[j].object);
+  }
+  delete[] slots_;
+}
+
+EpochManager::Slot* EpochManager::ThisSlot() {
+  return &slots_[ThreadIndex()];
+}
+
+int64 EpochManager::Pin() {
+  Slot* slot = ThisSlot();
+  int64 epoch;
+  if (slot->pins.empty()) {
+    // Announce the epoch before reading anything, and make sure the epoch
+    // did not advance past it in between.
+    do {
+      epoch = epoch_;
+      slot->active = epoch;
+      __sync_synchronize();
+    } while (epoch != epoch_);
+  } else {
+    // Older pins keep the announced epoch in place.
+    epoch = epoch_;
+  }
+
+  if (!slot->pins.empty() && slot->pins.back().first == epoch)
+    slot->pins.back().second++;
+  else
+    slot->pins.push_back(pair<int64, int>(epoch, 1));
+  return epoch;
+}
+
+void EpochManager::Unpin(int64 epoch) {
+  Slot* slot = ThisSlot();
+  deque<pair<int64, int> >::iterator it = slot->pins.begin();
+  while (it->first != epoch)
+    ++it;
+  it->second--;
+  while (!slot->pins.empty() && slot->pins.front().second == 0)
+    slot->pins.pop_front();
+
+  // Everything read under the pin is read before it is released.
+  __sync_synchronize();
+  slot->active = slot->pins.empty() ? -1 : slot->pins.front().first;
+  if (slot->pins.empty() && !slot->retired.empty())
+    Reclaim(slot);
+}
+
+void EpochManager::Retire(void* object, void (*free)(void*)) {
+  Slot* slot = ThisSlot();
+  // The object was unlinked before the epoch is read.
+  __sync_synchronize();
+  RetiredObject retired;
+  retired.epoch = epoch_;
+  retired.object = object;
+  retired.free = free;
+  slot->retired.push_back(retired);
+  slot->retired_count = slot->retired_count + 1;
+  if (slot->retired.size() % EPOCH_RECLAIM_BATCH == 0)
+    Reclaim(slot);
+}
+
+void EpochManager::Reclaim() {
+  Reclaim(ThisSlot());
+}
+
+void EpochManager::TryAdvance() {
+  int64 epoch = epoch_;
+  __sync_synchronize();
+  int threads = thread_indexes;
+  for (int i = 0; i < threads; i++) {
+    int64 active = slots_[i].active;
+    if (active >= 0 && active != epoch)
+      return;
+  }
+  __sync_bool_compare_and_swap(&epoch_, epoch, epoch + 1);
+}
+
+void EpochManager::Reclaim(Slot* slot) {
+  TryAdvance();
+  int64 epoch = epoch_;
+  while (!slot->retired.empty() && slot->retired.front().epoch + 2 <= epoch) {
+    slot->retired.front().free(slot->retired.front().object);
+    slot->retired.pop_front();
+    slot->retired_count = slot->retired_count - 1;
+  }
+}
+
+int64 EpochManager::retired() const {
+  int64 retired = 0;
+  for (int i = 0; i < EPOCH_MAX_THREADS; i++)
+    retired += slots_[i].retired_count;
+  return retired;
+}
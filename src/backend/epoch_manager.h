@@ -0,0 +1,134 @@
+// Author: Kun Ren (kun.ren@yale.edu)
+//
+// Epoch-based reclamation of memory that lock-free readers may still hold,
+// shared by the storage backends.
+//
+// Threads pin the current epoch while they use objects found without locks
+// (a worker pins it for each txn it executes, from its reads until it is
+// done), and retire the objects they unlink instead of deleting them. A
+// retired object is tagged with the epoch in which it was retired. The
+// global epoch only advances once every thread that holds a pin has pinned
+// the current epoch, so once the global epoch is two past an object's tag,
+// every pin that could have reached the object has been released and the
+// object is freed. Memory thus stays bounded by what is retired during the
+// longest pin.
+//
+// Each thread has a slot (up to EPOCH_MAX_THREADS threads at a time) holding
+// its oldest pin and the objects it retired, so pinning and retiring take no
+// locks and write only to the thread's own slot; advancing the epoch reads
+// every slot. A thread may hold several pins at once (e.g. for txns waiting
+// for remote reads) and release them in any order, but must release each pin
+// itself.
+
+#ifndef _DB_BACKEND_EPOCH_MANAGER_H_
+#define _DB_BACKEND_EPOCH_MANAGER_H_
+
+#include <deque>
+#include <utility>
+
+#include "common/types.h"
+
+using std::deque;
+using std::pair;
+
+// Maximum number of threads using epoch managers at a time.
+#define EPOCH_MAX_THREADS 256
+
+// A thread tries to free its retired objects after every this many retires
+// (as well as whenever it releases its last pin).
+#define EPOCH_RECLAIM_BATCH 64
+
+class EpochManager {
+ public:
+  EpochManager();
+
+  // Frees every retired object. No thread may use the manager any more.
+  ~EpochManager();
+
+  // Pins the current epoch for the calling thread and returns it. Objects
+  // retired from now on stay valid until the pin is released.
+  int64 Pin();
+
+  // Releases a pin of the calling thread returned by Pin.
+  void Unpin(int64 epoch);
+
+  // Retires 'object', which no reader that pins the epoch from now on can
+  // find any more: 'free(object)' is called once the pins that might hold it
+  // have all been released.
+  void Retire(void* object, void (*free)(void*));
+  template<typename T> void Retire(T* object) { Retire(object, &Delete<T>); }
+
+  // Advances the epoch if possible and frees the objects retired by the
+  // calling thread that no pin can hold any more.
+  void Reclaim();
+
+  // The current epoch, and the number of retired objects not freed yet.
+  int64 epoch() const { return epoch_; }
+  int64 retired() const;
+
+ private:
+  struct RetiredObject {
+    int64 epoch;
+    void* object;
+    void (*free)(void*);
+  };
+
+  struct Slot {
+    // The oldest epoch pinned by the slot's thread, or -1 if it holds none.
+    volatile int64 active;
+
+    // The thread's pins (epochs and their counts) and retired objects, both
+    // oldest first. Only touched by the thread.
+    deque<pair<int64, int> > pins;
+    deque<RetiredObject> retired;
+    volatile int64 retired_count;
+
+    // Pads slots to separate cache lines.
+    char padding[64];
+
+    Slot() : active(-1), retired_count(0) {}
+  };
+
+  template<typename T> static void Delete(void* object) {
+    delete static_cast<T*>(object);
+  }
+
+  // Returns the calling thread's slot, assigning it one on first use.
+  Slot* ThisSlot();
+
+  // Advances the epoch if every pinning thread has pinned the current one.
+  void TryAdvance();
+
+  // Frees the objects retired into 'slot' that no pin can hold any more.
+  void Reclaim(Slot* slot);
+
+  volatile int64 epoch_;
+  Slot* slots_;
+
+  // DISALLOW_COPY_AND_ASSIGN
+  EpochManager(const EpochManager&);
+  EpochManager& operator=(const EpochManager&);
+};
+
+// Holds a pin of 'epochs' (if not NULL) for the current scope.
+class EpochPin {
+ public:
+  explicit EpochPin(EpochManager* epochs) : epochs_(epochs), epoch_(0) {
+    if (epochs_ != NULL)
+      epoch_ = epochs_->Pin();
+  }
+  ~EpochPin() {
+    if (epochs_ != NULL)
+      epochs_->Unpin(epoch_);
+  }
+
+ private:
+  EpochManager* epochs_;
+  int64 epoch_;
+
+  // DISALLOW_COPY_AND_ASSIGN
+  EpochPin(const EpochPin&);
+  EpochPin& operator=(const EpochPin&);
+};
+
+#endif  // _DB_BACKEND_EPOCH_MANAGER_H_
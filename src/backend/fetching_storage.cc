@@ -5,7 +5,10 @@
 
 #include "backend/fetching_storage.h"
 
+#include <stdio.h>
+
 typedef FetchingStorage::Latch Latch;
+typedef FetchingStorage::TxnFetch TxnFetch;
 
 ////////////////// Constructors/Destructors  //////////////////////
 
@@ -21,12 +24,25 @@ FetchingStorage* FetchingStorage::BuildStorage() {
 
 // Private constructor
 
-FetchingStorage::FetchingStorage() {
+FetchingStorage::FetchingStorage()
+    : memory_budget_(FETCH_MEMORY_BUDGET), resident_bytes_(0),
+      eviction_requested_(false), retry_requested_(false), clock_hand_(0) {
   main_memory_ = new SimpleStorage();
   // 1 MILLION LATCHES!
-  latches_ = new Latch[1000000];
+  latches_ = new Latch[FETCH_OBJECTS];
+  for (int i = 0; i < FETCH_WAIT_STRIPES; i++) {
+    pthread_mutex_init(&wait_mutexes_[i], NULL);
+    pthread_cond_init(&wait_conds_[i], NULL);
+  }
+  pthread_mutex_init(&evict_mutex_, NULL);
+  pthread_cond_init(&evict_cond_, NULL);
+
+  if (!log_.Open(STORAGE_FILE, FETCH_QUEUE_DEPTH, FETCH_BUFFERS)) {
+    printf("FetchingStorage: cannot set up the log at %s\n", STORAGE_FILE);
+    exit(EXIT_FAILURE);
+  }
 
-  pthread_create(&gc_thread_, NULL, RunGCThread,
+  pthread_create(&evictor_thread_, NULL, RunEvictorThread,
     reinterpret_cast<void*>(this));
 }
 
@@ -44,27 +60,61 @@ Latch* FetchingStorage::LatchFor(const Key& key) {
   return latches_ + atoi(key.c_str());
 }
 
-void FetchingStorage::GetKey(int fd, Key* key) {
-    char path[255];
-    snprintf(path, sizeof(path), "/proc/self/fd/%d", fd);
-    char key_c_str[255];
-    memset(&key_c_str, 0, 255);
-    readlink(path, key_c_str, 255);
-    *key = string((strrchr(key_c_str, '/') + 1));
-}
-
-void* FetchingStorage::RunGCThread(void *arg) {
+void* FetchingStorage::RunEvictorThread(void *arg) {
   FetchingStorage* storage = reinterpret_cast<FetchingStorage*>(arg);
   while (true) {
-    double start_time = GetTime();
-    for (int i = COLD_CUTOFF; i < 1000000; i++) {
-      storage->HardUnfetch(IntToString(i));
-    }
-    usleep(static_cast<int>(1000000*(GetTime()-start_time)));
+    pthread_mutex_lock(&storage->evict_mutex_);
+    while (!storage->eviction_requested_ && !storage->retry_requested_)
+      pthread_cond_wait(&storage->evict_cond_, &storage->evict_mutex_);
+    bool retry = storage->retry_requested_;
+    storage->eviction_requested_ = false;
+    storage->retry_requested_ = false;
+    pthread_mutex_unlock(&storage->evict_mutex_);
+
+    if (retry)
+      storage->RetryFetches();
+
+    // If every object in memory is pinned or referenced, the sweep stops
+    // short, and the next unfetch or new object wakes the evictor again.
+    storage->Sweep();
   }
   return NULL;
 }
 
+void FetchingStorage::SetMemoryBudget(int64 bytes) {
+  memory_budget_ = bytes;
+  RequestEviction();
+}
+
+void FetchingStorage::SetResident(Latch* latch, int64 bytes) {
+  __sync_fetch_and_add(&resident_bytes_, bytes - latch->bytes);
+  latch->bytes = bytes;
+  RequestEviction();
+}
+
+void FetchingStorage::RequestEviction() {
+  if (resident_bytes_ <= memory_budget_)
+    return;
+  pthread_mutex_lock(&evict_mutex_);
+  eviction_requested_ = true;
+  pthread_cond_signal(&evict_cond_);
+  pthread_mutex_unlock(&evict_mutex_);
+}
+
+void FetchingStorage::Sweep() {
+  int64 target = memory_budget_ / 100 * FETCH_LOW_WATERMARK;
+  for (int passed = 0;
+       passed < 2 * FETCH_OBJECTS &&
+       resident_bytes_ > target;
+       passed++) {
+    int id = clock_hand_;
+    clock_hand_ = (clock_hand_ + 1) % FETCH_OBJECTS;
+    if (latches_[id].state == IN_MEMORY)
+      StartEvict(id, false);
+  }
+  log_.Submit();
+}
+
 ///////////// The meat and potato public interface methods.  ///////////
 
 Value* FetchingStorage::ReadObject(const Key& key, int64 txn_id) {
@@ -76,20 +126,38 @@ Value* FetchingStorage::ReadObject(const Key& key, int64 txn_id) {
   assert(latch->state == FETCHING || latch->state == IN_MEMORY);
   assert(latch->active_requests > 0);
   pthread_mutex_unlock(&latch->lock_);
-  // Block thread until pre-fetch on this key is done.
-  while (latch->state == FETCHING) {}
+  // Sleep until pre-fetch on this key is done.
+  if (latch->state == FETCHING) {
+    pthread_mutex_t* mutex = WaitMutexFor(latch);
+    pthread_mutex_lock(mutex);
+    while (latch->state == FETCHING)
+      pthread_cond_wait(WaitCondFor(latch), mutex);
+    pthread_mutex_unlock(mutex);
+  }
   return main_memory_->ReadObject(key);
 }
 
+Value* FetchingStorage::ReadObjectForUpdate(const Key& key, int64 txn_id) {
+  Value* value = ReadObject(key, txn_id);
+  // The txn is pinning the object, so it cannot be evicted meanwhile.
+  Latch* latch = LatchFor(key);
+  pthread_mutex_lock(&latch->lock_);
+  latch->dirty = true;
+  pthread_mutex_unlock(&latch->lock_);
+  return value;
+}
+
 // Write data to memory.
 bool FetchingStorage::PutObject(const Key& key, Value* value, int64 txn_id) {
   Latch* latch = LatchFor(key);
   pthread_mutex_lock(&latch->lock_);
   // Must call a prefetch before transaction
   assert(latch->active_requests > 0);
+  main_memory_->PutObject(key, value);
   latch->state = IN_MEMORY;
+  latch->dirty = true;
+  SetResident(latch, value == NULL ? 0 : value->size());
   pthread_mutex_unlock(&latch->lock_);
-  main_memory_->PutObject(key, value);
   return true;
 }
 
@@ -98,71 +166,41 @@ bool FetchingStorage::DeleteObject(const Key& key, int64 txn_id) {
   return PutObject(key, NULL, txn_id);
 }
 
-// Return false if file does not exist.
 bool FetchingStorage::Prefetch(const Key& key, double* wait_time) {
-  Latch* latch = LatchFor(key);
-
-  pthread_mutex_lock(&latch->lock_);
+  State previous_state = StartFetch(key, NULL);
+  log_.Submit();
 
-  int active_requests = latch->active_requests;
-  latch->active_requests++;
-
-  State previous_state = latch->state;
-  if (previous_state == ON_DISK)
-    latch->state = FETCHING;
-  if (previous_state == UNINITIALIZED) {
-    main_memory_->PutObject(key, new Value());
-    latch->state = IN_MEMORY;
-  }
-  if (previous_state == RELEASING)
-    latch->state = IN_MEMORY;
-  State current_state = latch->state;
-
-  pthread_mutex_unlock(&latch->lock_);
-
-  // Pre-fetch and in memory pre-states are no-ops.
-  if (current_state == IN_MEMORY) {
-    *wait_time = 0;  // You're good to go.
-    return true;
-  } else if (previous_state == FETCHING) {
-    // We already have another prefetching attempt.
+  if (previous_state == ON_DISK || previous_state == FETCHING)
     *wait_time = 0.100;  // arbitrary nonzero result.
+  else
+    *wait_time = 0;  // You're good to go.
+  return true;
+}
+
+bool FetchingStorage::PrefetchTxn(TxnProto* txn, const vector<Key>& keys,
+                                  AtomicQueue<TxnProto*>* resident) {
+  // The txn's own reference keeps it from being handed over before all of
+  // its fetches have started.
+  TxnFetch* fetch = new TxnFetch();
+  fetch->txn = txn;
+  fetch->resident = resident;
+  fetch->pending = 1;
+
+  for (uint32 i = 0; i < keys.size(); i++)
+    StartFetch(keys[i], fetch);
+  log_.Submit();
+
+  if (__sync_sub_and_fetch(&fetch->pending, 1) == 0) {
+    delete fetch;
     return true;
-  } else {
-    // Not in memory: cold call to prefetch.
-    assert(active_requests == 0);
-    *wait_time = 0.100;  // somewhat larger arbitrary nonzero result.
-    char* buf = new char[PAGE_SIZE];
-    return FileRead(key, buf, PAGE_SIZE);
   }
+  return false;
 }
 
 bool FetchingStorage::HardUnfetch(const Key& key) {
-  // Since we have a write lock, we know there are no concurrent
-  // reads to this key, so we can freely read as well.
-  Latch* latch = LatchFor(key);
-  pthread_mutex_lock(&latch->lock_);
-
-  State previous_state = latch->state;
-  int active_requests = latch->active_requests;
-
-  // Only one of the following two conditions can be true.
-  if (active_requests == 0)
-    latch->state = RELEASING;
-  if (active_requests == 0 && latch->state == FETCHING)
-    latch->state = ON_DISK;
-
-  pthread_mutex_unlock(&latch->lock_);
-
-  if (active_requests == 0 && previous_state == IN_MEMORY) {
-    Value* result = main_memory_->ReadObject(key);
-    int len = strlen(result->c_str());
-    char* c_result = new char[len+1];
-    strcpy(c_result, result->c_str());
-    return FilePut(key, c_result, len);
-  } else {
-    return true;
-  }
+  StartEvict(atoi(key.c_str()), true);
+  log_.Submit();
+  return true;
 }
 
 bool FetchingStorage::Unfetch(const Key& key) {
@@ -173,108 +211,175 @@ bool FetchingStorage::Unfetch(const Key& key) {
   assert(latch->active_requests >= 0);
   assert(latch->state == FETCHING || latch->state == RELEASING ||
          latch->state == IN_MEMORY);
+  bool unpinned = latch->active_requests == 0;
   pthread_mutex_unlock(&latch->lock_);
   if (state == UNINITIALIZED)
     HardUnfetch(key);
+  // The object may be what the evictor was missing.
+  if (unpinned)
+    RequestEviction();
   return true;
 }
 
-///////////////// Asynchronous Callbacks ////////////////////////
+///////////////// Fetches and evictions ////////////////////////
+
+FetchingStorage::State FetchingStorage::StartFetch(const Key& key,
+                                                   TxnFetch* fetch) {
+  Latch* latch = LatchFor(key);
+
+  pthread_mutex_lock(&latch->lock_);
+
+  latch->active_requests++;
 
-void FetchingStorage::PrefetchCompletionHandler(sigval_t sigval) {
-  struct aiocb *req;
-  req = (struct aiocb *)sigval.sival_ptr;
-  /* Did the request complete? */
-  if (aio_error(req) == 0) {
-    /* Request completed successfully, get the return status */
-    string key;
-    char* buf =
-        const_cast<char*>(reinterpret_cast<volatile char*>(req->aio_buf));
-    GetKey(req->aio_fildes, &key);
-    FetchingStorage* store = FetchingStorage::BuildStorage();
-    Latch* latch = store->LatchFor(key);
-    pthread_mutex_lock(&latch->lock_);
-    State prev_state = latch->state;
+  State previous_state = latch->state;
+  // Objects count as referenced when txns access them again while they are
+  // in memory, so that one pass over many objects does not push out those
+  // accessed repeatedly.
+  if (previous_state == IN_MEMORY)
+    latch->referenced = true;
+  if (previous_state == ON_DISK)
+    latch->state = FETCHING;
+  if (previous_state == UNINITIALIZED) {
+    main_memory_->PutObject(key, new Value());
     latch->state = IN_MEMORY;
-    pthread_mutex_unlock(&latch->lock_);
-    /* Nothing interfered with our fetch */
-    if (prev_state == FETCHING) {
-      string* value = new string(buf, PAGE_SIZE);
-      store->main_memory_->PutObject(key, value);
+    latch->dirty = true;
+  }
+
+  if (latch->state == FETCHING && fetch != NULL) {
+    if (latch->waiters == NULL)
+      latch->waiters = new vector<TxnFetch*>();
+    latch->waiters->push_back(fetch);
+    __sync_fetch_and_add(&fetch->pending, 1);
+  }
+
+  pthread_mutex_unlock(&latch->lock_);
+
+  // Not in memory: cold call to prefetch.
+  if (previous_state == ON_DISK) {
+    Request* request = new Request(this, key);
+    if (!log_.Read(atoi(key.c_str()), request)) {
+      // Never written, so empty.
+      request->Complete(NULL, 0);
     }
-    delete[] buf;
-    close(req->aio_fildes);
-    delete req;
   }
+  return previous_state;
 }
 
-void FetchingStorage::UnfetchCompletionHandler(sigval_t sigval) {
-  struct aiocb *req;
-  req = (struct aiocb *)sigval.sival_ptr;
-  /* Did the request complete? */
-  if (aio_error(req) == 0) {
-    /* Request completed successfully, get the return status */
-    string key;
-    GetKey(req->aio_fildes, &key);
-    FetchingStorage* store = FetchingStorage::BuildStorage();
-    Latch* latch = store->LatchFor(key);
-    pthread_mutex_lock(&latch->lock_);
-    // Hasn't been fetched.
-    assert(latch->active_requests >= 0);
-    int active_requests = latch->active_requests;
-    State state = latch->state;
+void FetchingStorage::RetryFetches() {
+  // Give whatever made the reads fail a moment to pass.
+  Spin(FETCH_RETRY_DELAY);
+  pair<Key, int> failed;
+  while (failed_fetches_.Pop(&failed)) {
+    Request* request = new Request(this, failed.first, failed.second + 1);
+    if (!log_.Read(atoi(failed.first.c_str()), request))
+      request->Complete(NULL, 0);
+  }
+  log_.Submit();
+}
+
+void FetchingStorage::StartEvict(int id, bool force) {
+  // Objects prefetched by a txn are pinned, so nothing reads the object
+  // while it is copied out.
+  Latch* latch = &latches_[id];
+  Key key = IntToString(id);
+  pthread_mutex_lock(&latch->lock_);
+  if (latch->active_requests > 0 || latch->state != IN_MEMORY) {
     pthread_mutex_unlock(&latch->lock_);
-    if (state == RELEASING && active_requests <= 0) {
-       store->main_memory_->DeleteObject(key);
-       latch->state = ON_DISK;
+    return;
+  }
+  if (latch->referenced && !force) {
+    // Second chance.
+    latch->referenced = false;
+    pthread_mutex_unlock(&latch->lock_);
+    return;
+  }
+  if (latch->dirty) {
+    // Otherwise the copy in the log is current.
+    Value* value = main_memory_->ReadObject(key);
+    bool appended = (value != NULL) ?
+                    log_.Append(id, value->data(), value->size()) :
+                    log_.Append(id, NULL, 0);
+    if (!appended) {
+      // Too long for the log: the object stays in memory, spared until the
+      // hand comes around again.
+      latch->referenced = true;
+      pthread_mutex_unlock(&latch->lock_);
+      return;
     }
-    close(req->aio_fildes);
-    delete[] reinterpret_cast<volatile char*>(req->aio_buf);
-    delete req;
+    latch->dirty = false;
   }
-  return;
+  DropObject(key, latch);
+  pthread_mutex_unlock(&latch->lock_);
 }
 
-/*
- * Here live the bogus hacks.
- */
-
-bool FetchingStorage::FileRead(const Key& key, char* result, int size) {
-  string fileName(STORAGE_PATH);
-  fileName.append(key);
-  int fd = open(fileName.c_str(), O_RDONLY|O_NONBLOCK);
-  if (fd == -1)
-    return false;
-  return aio_read(generateControlBlock(fd, result, size, FETCH)) >= 0;
+void FetchingStorage::DropObject(const Key& key, Latch* latch) {
+  // The object is freed once no txn that read it is still executing.
+  main_memory_->DeleteObject(key);
+  latch->state = ON_DISK;
+  __sync_fetch_and_sub(&resident_bytes_, latch->bytes);
+  latch->bytes = 0;
 }
 
-bool FetchingStorage::FilePut(const Key& key, char* value, int size) {
-  string fileName(STORAGE_PATH);
-  fileName.append(key);
-  mode_t mode = S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH;
-  int fd = open(fileName.c_str(), O_RDWR|O_CREAT|O_TRUNC|O_NONBLOCK, mode);
-  if (fd == -1)
-    return false;
-  return aio_write(generateControlBlock(fd, value, size, RELEASE)) >= 0;
+///////////////// Asynchronous Callbacks ////////////////////////
+
+void FetchingStorage::Request::Complete(const char* data, int length) {
+  storage_->FetchDone(key_, data, length, attempts_);
+  delete this;
 }
 
-aiocb* FetchingStorage::generateControlBlock(
-    int fd, char* buf, const int size, Operation op) {
-  aiocb* aiocbp = new aiocb();
-  aiocbp->aio_fildes = fd;
-  aiocbp->aio_offset = 0;
-  aiocbp->aio_buf = buf;
-  aiocbp->aio_nbytes = size;
-  aiocbp->aio_reqprio = 0;
-  /* Link the AIO request with a thread callback */
-  aiocbp->aio_sigevent.sigev_notify = SIGEV_THREAD;
-  if (op == FETCH)
-    aiocbp->aio_sigevent.sigev_notify_function =
-        &PrefetchCompletionHandler;
-  else
-    aiocbp->aio_sigevent.sigev_notify_function =
-        &UnfetchCompletionHandler;
-  aiocbp->aio_sigevent.sigev_notify_attributes = NULL;
-  aiocbp->aio_sigevent.sigev_value.sival_ptr = aiocbp;
-  return aiocbp;
+void FetchingStorage::FetchDone(const Key& key, const char* data,
+                                int length, int attempts) {
+  if (data == NULL && length < 0) {
+    // The object stays on disk, and its fetch (with the txns and readers
+    // waiting for it) in progress until the evictor thread reads it again.
+    printf("FetchingStorage: reading %s failed (attempt %d of %d)\n",
+           key.c_str(), attempts, FETCH_READ_ATTEMPTS);
+    if (attempts >= FETCH_READ_ATTEMPTS) {
+      printf("FetchingStorage: cannot read %s, giving up\n", key.c_str());
+      exit(EXIT_FAILURE);
+    }
+    failed_fetches_.Push(pair<Key, int>(key, attempts));
+    pthread_mutex_lock(&evict_mutex_);
+    retry_requested_ = true;
+    pthread_cond_signal(&evict_cond_);
+    pthread_mutex_unlock(&evict_mutex_);
+    return;
+  }
+
+  Value* value = new Value();
+  if (data != NULL)
+    value->assign(data, length);
+
+  Latch* latch = LatchFor(key);
+  pthread_mutex_lock(&latch->lock_);
+  // Nothing interfered with our fetch.
+  if (latch->state == FETCHING) {
+    main_memory_->PutObject(key, value);
+    latch->state = IN_MEMORY;
+    latch->dirty = false;
+    SetResident(latch, value->size());
+  } else {
+    delete value;
+  }
+  vector<TxnFetch*>* waiters = latch->waiters;
+  latch->waiters = NULL;
+  pthread_mutex_unlock(&latch->lock_);
+
+  // Wake the readers sleeping on the object, and count the fetch off for
+  // the txns waiting for it.
+  pthread_mutex_lock(WaitMutexFor(latch));
+  pthread_cond_broadcast(WaitCondFor(latch));
+  pthread_mutex_unlock(WaitMutexFor(latch));
+  if (waiters != NULL) {
+    for (uint32 i = 0; i < waiters->size(); i++)
+      FetchArrived((*waiters)[i]);
+    delete waiters;
+  }
+}
+
+void FetchingStorage::FetchArrived(TxnFetch* fetch) {
+  if (__sync_sub_and_fetch(&fetch->pending, 1) == 0) {
+    fetch->resident->Push(fetch->txn);
+    delete fetch;
+  }
 }
@@ -2,83 +2,195 @@
 //
 // An implementation of the storage interface taking into account
 // main memory, disk, and swapping algorithms.
+//
+// Objects on disk live in a LogStore under their ids. A txn's cold objects
+// are fetched with one batch of reads (see PrefetchTxn); ReadObject sleeps
+// until a fetch in progress completes.
+//
+// Memory is managed as a buffer pool with a budget of bytes. Objects
+// prefetched by txns that have not yet unfetched them are pinned (their
+// latch counts them in 'active_requests'); every other object in memory may
+// be evicted. When the objects in memory exceed the budget, an evictor
+// thread runs CLOCK over the latches: an object prefetched again while in
+// memory since the hand last passed it has its reference bit cleared and is
+// spared, others are evicted until memory is back below FETCH_LOW_WATERMARK
+// percent of the budget. Clean objects are dropped at once; dirty ones are
+// appended to the log first, which copies them into its tail block, so an
+// eviction never waits for the disk. Objects too long for the log stay in
+// memory.
+//
+// A fetch whose read fails stays in progress, and the evictor thread reads
+// the object again, up to FETCH_READ_ATTEMPTS times in all; txns never see
+// an object that could not be read.
 
 #ifndef _DB_BACKEND_FETCHING_STORAGE_H_
 #define _DB_BACKEND_FETCHING_STORAGE_H_
 
-#include <aio.h>
 #include <pthread.h>
-#include <sys/stat.h>
-#include <fcntl.h>
 #include <cassert>
 #include <cstdlib>
 #include <cstring>
 #include <string>
-#include <csignal>
+#include <utility>
+#include <vector>
 
 #include "common/utils.h"
 #include "backend/storage.h"
 #include "backend/simple_storage.h"
+#include "backend/log_store.h"
 
-#define PAGE_SIZE 1000
+// Objects on disk are at most LOG_MAX_RECORD_SIZE bytes long; longer ones
+// are never evicted.
 #define STORAGE_PATH "../db/storage/"
+#define STORAGE_FILE STORAGE_PATH "log"
+
+// Number of objects (keys "0" to "999999").
+#define FETCH_OBJECTS 1000000
+
+// Default memory budget, and the share of it (in percent) an eviction sweep
+// brings memory down to.
+#define FETCH_MEMORY_BUDGET (1024LL * 1024 * 1024)
+#define FETCH_LOW_WATERMARK 90
+
+// Depth of the log's ring and number of its block buffers, which bounds the
+// fetches and block writes in flight.
+#define FETCH_QUEUE_DEPTH 256
+#define FETCH_BUFFERS 256
+
+// Number of condition variables readers waiting for fetches sleep on.
+#define FETCH_WAIT_STRIPES 1024
 
-#define COLD_CUTOFF 990000
+// Number of times an object's read is attempted before the process gives up,
+// and the seconds between attempts.
+#define FETCH_READ_ATTEMPTS 5
+#define FETCH_RETRY_DELAY 0.01
 
 class FetchingStorage : public Storage {
  public:
   static FetchingStorage* BuildStorage();
   ~FetchingStorage();
   virtual Value* ReadObject(const Key& key, int64 txn_id = 0);
+  virtual Value* ReadObjectForUpdate(const Key& key, int64 txn_id = 0);
   virtual bool PutObject(const Key& key, Value* value, int64 txn_id = 0);
   virtual bool DeleteObject(const Key& key, int64 txn_id = 0);
   virtual bool Prefetch(const Key &key, double* wait_time);
+  virtual bool PrefetchTxn(TxnProto* txn, const vector<Key>& keys,
+                           AtomicQueue<TxnProto*>* resident);
   virtual bool Unfetch(const Key &key);
   bool HardUnfetch(const Key& key);
 
+  // Sets the bytes of objects kept in memory.
+  void SetMemoryBudget(int64 bytes);
+
+  // Bytes of objects in memory.
+  int64 resident_bytes() const { return resident_bytes_; }
+
+  // Objects in memory are owned by 'main_memory_', which also frees those
+  // evicted.
+  virtual EpochManager* epochs() { return main_memory_->epochs(); }
+
   // Latch object that stores a counter for readlocks and a boolean for write
   // locks.
   enum State {
     UNINITIALIZED, IN_MEMORY, ON_DISK, FETCHING, RELEASING
   };
+
+  // A txn waiting for its cold objects, with the number of fetches it waits
+  // for.
+  struct TxnFetch {
+    TxnProto* txn;
+    AtomicQueue<TxnProto*>* resident;
+    volatile int pending;
+  };
+
   class Latch {
    public:
     int active_requests;  // Can be as many as you want.
-    State state;
+    volatile State state;
     pthread_mutex_t lock_;
 
+    // Buffer pool state of an object in memory: its size as accounted in
+    // 'resident_bytes_', whether it was accessed again since the CLOCK hand
+    // last passed it, and whether it changed since it was last on disk.
+    int64 bytes;
+    volatile bool referenced;
+    bool dirty;
+
+    // Txns waiting for the fetch in progress, or NULL if there are none.
+    vector<TxnFetch*>* waiters;
+
     Latch() {
       active_requests = 0;
       state = UNINITIALIZED;
       pthread_mutex_init(&lock_, NULL);
+      waiters = NULL;
+      bytes = 0;
+      referenced = false;
+      dirty = false;
     }
   };
   Latch* LatchFor(const Key &key);
-  static void PrefetchCompletionHandler(sigval_t sigval);
-  static void UnfetchCompletionHandler(sigval_t sigval);
-  static void GetKey(int fd, Key* key);
 
  private:
   FetchingStorage();
-  /*
-   * The following functions are bogus hacks that should be factored out into
-   * a separate disk layer. To make the callbacks play nice for now, everything
-   * is being placed here. After November 1, we can swap out backends.
-   */
-
-  enum Operation {
-    FETCH, RELEASE
+
+  // A fetch of one object in flight.
+  class Request : public LogStore::ReadCompletion {
+   public:
+    Request(FetchingStorage* storage, const Key& key, int attempts = 1)
+        : storage_(storage), key_(key), attempts_(attempts) {}
+    virtual void Complete(const char* data, int length);
+
+   private:
+    FetchingStorage* storage_;
+    Key key_;
+
+    // Number of this attempt to read the object.
+    int attempts_;
   };
 
-  // Registers an asynchronous read.
-  bool FileRead(const Key& key, char* result, int size);
+  // Starts fetching 'key' if it is on disk, queueing the read without
+  // submitting it. If the key is (or already was) being fetched and 'fetch'
+  // is not NULL, 'fetch' waits for it. Returns the key's state before.
+  State StartFetch(const Key& key, TxnFetch* fetch);
+
+  // Evicts object 'id' unless it is pinned or not in memory, or (unless
+  // 'force' is set) was referenced since the last call, which clears its
+  // reference bit. A dirty object is appended to the log first.
+  void StartEvict(int id, bool force);
+
+  // Drops the object of 'latch' from memory. Requires the latch's lock.
+  void DropObject(const Key& key, Latch* latch);
 
-  // Registers an asynchronous write.
-  bool FilePut(const Key& key, char* value, int size);
+  // Accounts for object 'latch' taking 'bytes' bytes of memory now, and
+  // wakes the evictor if that exceeds the budget. Requires the latch's lock.
+  void SetResident(Latch* latch, int64 bytes);
 
-  // XXX(scw): Document? `int fd' used to be `int& fd'. Move it to the last
-  //           argument and retype `int* fd' if used as an output argument.
-  aiocb* generateControlBlock(int fd, char* buf, const int size, Operation op);
+  // Wakes the evictor if memory exceeds the budget.
+  void RequestEviction();
+
+  // Runs the CLOCK hand until memory is below the low watermark or every
+  // object was passed twice, and submits the log's writes.
+  void Sweep();
+
+  // Completion of attempt 'attempts' to fetch 'key', with the object's record
+  // (NULL if it has none, or with a negative 'length' if reading it failed,
+  // in which case the read is retried).
+  void FetchDone(const Key& key, const char* data, int length, int attempts);
+
+  // Reads the objects whose reads failed again. Run by the evictor thread.
+  void RetryFetches();
+
+  // Counts off a fetch 'fetch' waited for, handing its txn to the scheduler
+  // once it waits for none.
+  static void FetchArrived(TxnFetch* fetch);
+
+  pthread_mutex_t* WaitMutexFor(Latch* latch) {
+    return &wait_mutexes_[(latch - latches_) % FETCH_WAIT_STRIPES];
+  }
+  pthread_cond_t* WaitCondFor(Latch* latch) {
+    return &wait_conds_[(latch - latches_) % FETCH_WAIT_STRIPES];
+  }
 
   static FetchingStorage* self;
 
@@ -86,9 +198,27 @@ class FetchingStorage : public Storage {
 
   Storage* main_memory_;
   Latch* latches_;
-
-  // GC thread stuff.
-  static void* RunGCThread(void *arg);
-  pthread_t gc_thread_;
+  LogStore log_;
+
+  // Readers of objects being fetched sleep on these, by latch.
+  pthread_mutex_t wait_mutexes_[FETCH_WAIT_STRIPES];
+  pthread_cond_t wait_conds_[FETCH_WAIT_STRIPES];
+
+  // Buffer pool accounting: bytes of objects in memory.
+  volatile int64 memory_budget_;
+  volatile int64 resident_bytes_;
+
+  // Evictor thread stuff. The evictor sleeps until 'eviction_requested_' or
+  // 'retry_requested_'.
+  static void* RunEvictorThread(void *arg);
+  pthread_t evictor_thread_;
+  pthread_mutex_t evict_mutex_;
+  pthread_cond_t evict_cond_;
+  bool eviction_requested_;
+  bool retry_requested_;
+
+  // Keys whose reads failed, with the number of attempts made so far.
+  AtomicQueue<pair<Key, int> > failed_fetches_;
+  int clock_hand_;
 };
 #endif  // _DB_BACKEND_FETCHING_STORAGE_H_
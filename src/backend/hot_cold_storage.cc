@@ -0,0 +1,100 @@
+// Author: Kun Ren (kun.ren@yale.edu)
+//
+// A SimpleStorage that keeps hot records apart from cold ones (see
+// hot_cold_storage.h).
+
+#include "backend/hot_cold_storage.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+HotColdStorage::HotColdStorage(int capacity)
+    : capacity_(capacity), size_(0) {
+  void* records;
+  if (posix_memalign(&records, 64, capacity_ * sizeof(HotRecord)) != 0) {
+    perror("posix_memalign");
+    exit(EXIT_FAILURE);
+  }
+  records_ = reinterpret_cast<HotRecord*>(records);
+  memset(records_, 0, capacity_ * sizeof(HotRecord));
+}
+
+HotColdStorage::~HotColdStorage() {
+  free(records_);
+}
+
+bool HotColdStorage::MarkHot(const Key& key) {
+  Value* value = objects_.Lookup(key);
+  if (value == NULL)
+    return false;
+  if (HotRecordOf(value) != NULL)
+    return true;
+  if (value->size() > HOT_RECORD_SIZE || size_ == capacity_)
+    return false;
+
+  HotRecord* record = &records_[size_++];
+  memcpy(record->data, value->data(), value->size());
+  record->size = value->size();
+  objects_.Insert(key, AsValue(record));
+  epochs_.Retire(value);
+  return true;
+}
+
+Value* HotColdStorage::ReadObject(const Key& key, int64 txn_id) {
+  Value* value = objects_.Lookup(key);
+  HotRecord* record = HotRecordOf(value);
+  if (record == NULL)
+    return value;
+  Value* copy = new Value(record->data, record->size);
+  epochs_.Retire(copy);
+  return copy;
+}
+
+Value* HotColdStorage::ReadObjectOrRecord(const Key& key, int64 txn_id,
+                                          bool for_update, char** record,
+                                          int* size) {
+  Value* value = objects_.Lookup(key);
+  HotRecord* hot = HotRecordOf(value);
+  if (hot == NULL) {
+    *record = NULL;
+    return value;
+  }
+  *record = hot->data;
+  *size = hot->size;
+  return NULL;
+}
+
+bool HotColdStorage::PutObject(const Key& key, Value* value, int64 txn_id) {
+  HotRecord* record = HotRecordOf(objects_.Lookup(key));
+  if (record != NULL && value->size() <= HOT_RECORD_SIZE) {
+    // Written in place. The txn holds the key's lock, and 'value' was never
+    // in the index.
+    memcpy(record->data, value->data(), value->size());
+    record->size = value->size();
+    delete value;
+    return true;
+  }
+
+  Value* old = objects_.Insert(key, value);
+  if (old != NULL && old != value && HotRecordOf(old) == NULL)
+    epochs_.Retire(old);
+  return true;
+}
+
+bool HotColdStorage::PutObjects(const vector<pair<Key, Value*> >& objects,
+                                int64 txn_id) {
+  if (size_ == 0)
+    return SimpleStorage::PutObjects(objects, txn_id);
+  // Batches could replace hot records unnoticed.
+  for (uint32 i = 0; i < objects.size(); i++)
+    PutObject(objects[i].first, objects[i].second, txn_id);
+  return true;
+}
+
+bool HotColdStorage::DeleteObject(const Key& key, int64 txn_id) {
+  Value* old = NULL;
+  if (objects_.Erase(key, &old) && old != NULL && HotRecordOf(old) == NULL)
+    epochs_.Retire(old);
+  return true;
+}
@@ -0,0 +1,88 @@
+// Author: Kun Ren (kun.ren@yale.edu)
+//
+// A SimpleStorage that keeps the few records most txns access (TPC-C's
+// warehouses and districts) apart from the bulk of the database, so that they
+// stay in the cache instead of being scattered among millions of cold
+// records.
+//
+// Applications mark hot keys with MarkHot while loading the database. Hot
+// records must be fixed-layout records (see RecordOf in common/types.h) of at
+// most HOT_RECORD_SIZE bytes. Their bytes live in place in one compact,
+// cache-line-aligned array, each in a slot of whole cache lines, so that no
+// heap buffer lies behind them and workers updating different hot records
+// never contend for a line. Txns read and update them in place through
+// ReadObjectOrRecord (StorageManager::ReadRecordAt), and writes of new values
+// copy the new contents into the slot. The index maps hot keys to their slots
+// like it maps cold keys to their values, so lookups cost the same for both
+// and cold keys pay nothing for the hot array.
+
+#ifndef _DB_BACKEND_HOT_COLD_STORAGE_H_
+#define _DB_BACKEND_HOT_COLD_STORAGE_H_
+
+#include "backend/simple_storage.h"
+#include "common/types.h"
+
+// Default maximum number of hot records. Keys marked hot beyond it stay cold.
+#define HOT_RECORDS_CAPACITY 1024
+
+// Maximum size of a hot record. A slot holds the record followed by its size,
+// in three cache lines.
+#define HOT_RECORD_SIZE 184
+
+class HotColdStorage : public SimpleStorage {
+ public:
+  explicit HotColdStorage(int capacity = HOT_RECORDS_CAPACITY);
+  virtual ~HotColdStorage();
+
+  // Moves the object stored under 'key' into the hot array. Must be called
+  // after the object is put, and not concurrently with any other method.
+  // Returns false if there is no such object, it is larger than
+  // HOT_RECORD_SIZE or the array is full.
+  virtual bool MarkHot(const Key& key);
+
+  // Returns a copy of a hot record, valid while the caller pins the epoch.
+  virtual Value* ReadObject(const Key& key, int64 txn_id = 0);
+  virtual Value* ReadObjectOrRecord(const Key& key, int64 txn_id,
+                                    bool for_update, char** record,
+                                    int* size);
+
+  // Writing a value larger than HOT_RECORD_SIZE to a hot key makes it cold.
+  // The value written may not be a copy returned by ReadObject.
+  virtual bool PutObject(const Key& key, Value* value, int64 txn_id = 0);
+  virtual bool PutObjects(const vector<pair<Key, Value*> >& objects,
+                          int64 txn_id = 0);
+
+  // Deleting a hot object makes its key cold; its slot is not reused.
+  virtual bool DeleteObject(const Key& key, int64 txn_id = 0);
+
+ private:
+  // A hot record's slot, aligned to a cache line.
+  struct HotRecord {
+    char data[HOT_RECORD_SIZE];
+    int64 size;
+  };
+
+  // The index stores hot keys' slots in place of values.
+  static Value* AsValue(HotRecord* record) {
+    return reinterpret_cast<Value*>(record);
+  }
+
+  // Returns the slot 'value' stands for, or NULL if it is a cold value.
+  HotRecord* HotRecordOf(Value* value) const {
+    HotRecord* record = reinterpret_cast<HotRecord*>(value);
+    if (record < records_ || record >= records_ + capacity_)
+      return NULL;
+    return record;
+  }
+
+  // The hot records, of which the first 'size_' are in use.
+  HotRecord* records_;
+  int capacity_;
+  int size_;
+
+  // DISALLOW_COPY_AND_ASSIGN
+  HotColdStorage(const HotColdStorage&);
+  HotColdStorage& operator=(const HotColdStorage&);
+};
+
+#endif  // _DB_BACKEND_HOT_COLD_STORAGE_H_
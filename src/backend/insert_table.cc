@@ -0,0 +1,186 @@
+// Author: Kun Ren (kun.ren@yale.edu)
+//
+// An append-only table for records inserted under dense ids (see
+// insert_table.h).
+
+#include "backend/insert_table.h"
+
+#include <string.h>
+
+// Initial number of segments the directory can hold.
+#define INSERT_INITIAL_SEGMENTS 64
+
+InsertTable::InsertTable(EpochManager* epochs)
+    : epochs_(epochs), retired_(0) {
+  directory_ = new Directory();
+  directory_->size = INSERT_INITIAL_SEGMENTS;
+  directory_->segments = new InsertedRecord*[INSERT_INITIAL_SEGMENTS];
+  memset(directory_->segments, 0,
+         INSERT_INITIAL_SEGMENTS * sizeof(InsertedRecord*));
+}
+
+InsertTable::~InsertTable() {
+  for (int64 i = 0; i < directory_->size; i++) {
+    if (directory_->segments[i] != NULL)
+      FreeSegment(directory_->segments[i]);
+  }
+  FreeDirectory(directory_);
+}
+
+void InsertTable::FreeSegment(void* segment) {
+  InsertedRecord* rows = reinterpret_cast<InsertedRecord*>(segment);
+  for (int i = 0; i < INSERT_SEGMENT_SIZE; i++) {
+    delete rows[i].value;
+    RowVersion* version = rows[i].updates;
+    while (version != NULL) {
+      RowVersion* next = version->next;
+      delete version->value;
+      delete version;
+      version = next;
+    }
+  }
+  delete[] rows;
+}
+
+void InsertTable::FreeDirectory(void* directory) {
+  Directory* d = reinterpret_cast<Directory*>(directory);
+  delete[] d->segments;
+  delete d;
+}
+
+InsertedRecord* InsertTable::AllocateSegment(int64 segment) {
+  if (segment < retired_)
+    return NULL;
+
+  Directory* directory = directory_;
+  if (segment >= directory->size) {
+    // Double the directory until it covers 'segment'. Readers may still be
+    // using the old one, so it is retired.
+    int64 size = directory->size;
+    while (size <= segment)
+      size *= 2;
+    Directory* grown = new Directory();
+    grown->size = size;
+    grown->segments = new InsertedRecord*[size];
+    memset(grown->segments, 0, size * sizeof(InsertedRecord*));
+    memcpy(grown->segments, directory->segments,
+           directory->size * sizeof(InsertedRecord*));
+    __sync_synchronize();
+    directory_ = grown;
+    epochs_->Retire(directory, FreeDirectory);
+    directory = grown;
+  }
+
+  if (directory->segments[segment] == NULL) {
+    InsertedRecord* rows = new InsertedRecord[INSERT_SEGMENT_SIZE];
+    for (int i = 0; i < INSERT_SEGMENT_SIZE; i++) {
+      rows[i].txn_id = -1;
+      rows[i].deleted = -1;
+      rows[i].value = NULL;
+      rows[i].updates = NULL;
+      rows[i].owner = 0;
+    }
+    __sync_synchronize();
+    directory->segments[segment] = rows;
+  }
+  return directory->segments[segment];
+}
+
+bool InsertTable::Put(int64 id, Value* value, int64 txn_id, int32 owner) {
+  if (id < 0)
+    return false;
+  InsertedRecord* row = Find(id);
+  if (row == NULL) {
+    Lock l(&mutex_);
+    InsertedRecord* segment = AllocateSegment(id >> INSERT_SEGMENT_BITS);
+    if (segment == NULL)
+      return false;
+    row = &segment[id & (INSERT_SEGMENT_SIZE - 1)];
+  }
+
+  Value* old = row->value;
+  RowVersion* updates = row->updates;
+  row->txn_id = txn_id;
+  row->deleted = -1;
+  row->owner = owner;
+  row->updates = NULL;
+  __sync_synchronize();
+  row->value = value;
+  if (old != NULL && old != value)
+    epochs_->Retire(old);
+  if (updates != NULL)
+    RetireVersions(updates, false);
+  return true;
+}
+
+Value* InsertTable::Update(int64 id, int64 txn_id, int64 first_snapshot,
+                           int64 last_snapshot) {
+  if (Read(id, txn_id) == NULL)
+    return NULL;
+  InsertedRecord* row = Find(id);
+
+  // Readers of the snapshots from the current contents' txn up to 'txn_id'
+  // would see the update: keep the current contents for them.
+  RowVersion* newest = row->updates;
+  int64 newest_id = (newest != NULL) ? newest->txn_id : row->txn_id;
+  int64 from = (newest_id > first_snapshot) ? newest_id : first_snapshot;
+  int64 to = (last_snapshot < txn_id - 1) ? last_snapshot : txn_id - 1;
+  if (from <= to) {
+    RowVersion* version = new RowVersion();
+    version->txn_id = txn_id;
+    version->value = new Value(*(newest != NULL ? newest->value : row->value));
+    version->next = newest;
+    __sync_synchronize();
+    row->updates = version;
+  }
+
+  // No reader gets past the newest contents at or below 'first_snapshot',
+  // which become the row's oldest.
+  RowVersion** link = &row->updates;
+  while (*link != NULL && (*link)->txn_id > first_snapshot)
+    link = &(*link)->next;
+  RowVersion* oldest = *link;
+  if (oldest != NULL) {
+    Value* old = row->value;
+    row->value = oldest->value;
+    __sync_synchronize();
+    *link = NULL;
+    epochs_->Retire(old);
+    RetireVersions(oldest, true);
+  }
+  return (row->updates != NULL) ? row->updates->value : row->value;
+}
+
+void InsertTable::RetireVersions(RowVersion* version, bool keep_value) {
+  while (version != NULL) {
+    RowVersion* next = version->next;
+    if (!keep_value)
+      epochs_->Retire(version->value);
+    keep_value = false;
+    epochs_->Retire(version);
+    version = next;
+  }
+}
+
+bool InsertTable::Delete(int64 id, int64 txn_id) {
+  InsertedRecord* row = Find(id);
+  if (row == NULL || row->value == NULL)
+    return false;
+  row->deleted = txn_id;
+  return true;
+}
+
+void InsertTable::Retire(int64 id) {
+  Lock l(&mutex_);
+  Directory* directory = directory_;
+  int64 end = id >> INSERT_SEGMENT_BITS;
+  if (end > directory->size)
+    end = directory->size;
+  for (; retired_ < end; retired_++) {
+    InsertedRecord* segment = directory->segments[retired_];
+    if (segment != NULL) {
+      directory->segments[retired_] = NULL;
+      epochs_->Retire(segment, FreeSegment);
+    }
+  }
+}
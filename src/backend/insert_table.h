@@ -0,0 +1,173 @@
+// Author: Kun Ren (kun.ren@yale.edu)
+//
+// An append-only table for records that are only ever inserted under dense,
+// increasing ids, such as TPC-C's orders (ids handed out per district by
+// D_NEXT_O_ID) or history rows (keyed by the inserting txn's id).
+//
+// Rows live in fixed-size segments of INSERT_SEGMENT_SIZE rows that are
+// allocated on first use, and a directory maps an id's segment number to its
+// segment, so finding a row costs a shift and two loads. Readers take no
+// locks; allocating a segment, growing the directory and retiring segments
+// serialize on the table's mutex, which is taken once per segment rather than
+// once per row. Concurrent writers must write different rows.
+//
+// Memory stays bounded over long runs by retiring whole segments of rows that
+// will no longer be read (e.g. delivered orders). A retired segment is
+// unlinked from the directory at once, but only freed through the table's
+// EpochManager (see backend/epoch_manager.h), once the readers that may have
+// found it just before it was unlinked have released their pins. Outgrown
+// directories and replaced values are retired the same way, so readers must
+// pin the epoch while they use what they read.
+//
+// Rows may be updated after they are inserted (e.g. TPC-C's Delivery sets an
+// order's carrier). Update modifies a row in place unless readers may still
+// read it as of an earlier txn (a snapshot or a checkpoint's boundary), in
+// which case it adds a copy in front of the earlier contents, so that such
+// readers never see later updates or half-written rows.
+
+#ifndef _DB_BACKEND_INSERT_TABLE_H_
+#define _DB_BACKEND_INSERT_TABLE_H_
+
+#include <pthread.h>
+
+#include <utility>
+#include <vector>
+
+#include "backend/epoch_manager.h"
+#include "common/types.h"
+#include "common/utils.h"
+
+using std::pair;
+using std::vector;
+
+// Number of rows per segment is 2^INSERT_SEGMENT_BITS.
+#define INSERT_SEGMENT_BITS 10
+#define INSERT_SEGMENT_SIZE (1 << INSERT_SEGMENT_BITS)
+
+// Contents of an inserted row written by an update (see InsertTable::Update).
+struct RowVersion {
+  int64 txn_id;
+  Value* value;
+  RowVersion* next;
+};
+
+struct InsertedRecord {
+  // The txn that inserted the row, and the one that deleted it (or -1).
+  int64 txn_id;
+  int64 deleted;
+
+  // The row's oldest contents still readable, owned by the table; NULL if the
+  // row was never inserted.
+  Value* value;
+
+  // Contents written since by updates that kept the earlier ones, newest
+  // first, also owned by the table.
+  RowVersion* updates;
+
+  // For tables shared by several owners (e.g. the warehouses of a partition),
+  // the row's owner.
+  int32 owner;
+};
+
+class InsertTable {
+ public:
+  explicit InsertTable(EpochManager* epochs);
+  ~InsertTable();
+
+  // Returns the row with id 'id', or NULL if its segment was never allocated
+  // or has been retired. The row's value is NULL if it was never inserted.
+  // Never blocks.
+  InsertedRecord* Find(int64 id) const {
+    Directory* directory = directory_;
+    int64 segment = id >> INSERT_SEGMENT_BITS;
+    if (id < 0 || segment >= directory->size ||
+        directory->segments[segment] == NULL)
+      return NULL;
+    return &directory->segments[segment][id & (INSERT_SEGMENT_SIZE - 1)];
+  }
+
+  // Returns the value of row 'id' as seen by 'txn_id', i.e. NULL if it was
+  // never inserted, was retired, was inserted by a later txn (as snapshot
+  // reads may find), or was deleted by 'txn_id' or an earlier txn.
+  Value* Read(int64 id, int64 txn_id) const {
+    InsertedRecord* row = Find(id);
+    if (row == NULL || row->value == NULL || row->txn_id > txn_id ||
+        (row->deleted >= 0 && row->deleted <= txn_id))
+      return NULL;
+    return VersionAt(*row, txn_id);
+  }
+
+  // Returns the contents of inserted row 'row' as of 'txn_id', which must not
+  // precede its insertion.
+  static Value* VersionAt(const InsertedRecord& row, int64 txn_id) {
+    for (RowVersion* version = row.updates; version != NULL;
+         version = version->next) {
+      if (version->txn_id <= txn_id)
+        return version->value;
+    }
+    return row.value;
+  }
+
+  // Returns the contents of row 'id' for 'txn_id' to modify in place, or NULL
+  // if 'txn_id' cannot see the row. Readers may read the row as of any txn
+  // from 'first_snapshot' through 'last_snapshot': if one of them could see
+  // the current contents, 'txn_id' gets a copy of them instead. Contents no
+  // reader can see any more are retired.
+  Value* Update(int64 id, int64 txn_id, int64 first_snapshot,
+                int64 last_snapshot);
+
+  // Stores 'value' as row 'id', inserted by 'txn_id', and takes ownership of
+  // it (retiring the row's previous contents). Returns false (leaving 'value'
+  // to the caller) if 'id' is negative or lies in a retired segment.
+  bool Put(int64 id, Value* value, int64 txn_id, int32 owner = 0);
+
+  // Marks row 'id' as deleted by 'txn_id'. Its value is kept until its
+  // segment is retired, since an earlier txn or a checkpoint may still read
+  // it. Returns false if the row does not exist.
+  bool Delete(int64 id, int64 txn_id);
+
+  // Retires every segment all of whose ids are below 'id'. Rows below the
+  // first retired id can never be stored again.
+  void Retire(int64 id);
+
+  // The number of segments the directory can hold (every id is below
+  // NumSegments() * INSERT_SEGMENT_SIZE), and segment 'segment' (NULL if it
+  // was never allocated or has been retired). Used to scan the table.
+  int64 NumSegments() const { return directory_->size; }
+  InsertedRecord* Segment(int64 segment) const {
+    return directory_->segments[segment];
+  }
+
+ private:
+  struct Directory {
+    int64 size;
+    InsertedRecord** segments;
+  };
+
+  // Returns segment 'segment', allocating it (and growing the directory) if
+  // needed. Returns NULL if it was retired. Requires 'mutex_'.
+  InsertedRecord* AllocateSegment(int64 segment);
+
+  // Retires 'version' and the older ones after it, and their values (except
+  // 'version's own if 'keep_value' is true).
+  void RetireVersions(RowVersion* version, bool keep_value);
+
+  // Free a segment (an InsertedRecord array) and the contents of its rows,
+  // and a directory.
+  static void FreeSegment(void* segment);
+  static void FreeDirectory(void* directory);
+
+  EpochManager* epochs_;
+  Directory* volatile directory_;
+
+  // Segments below 'retired_' have been retired.
+  int64 retired_;
+
+  Mutex mutex_;
+
+  // DISALLOW_COPY_AND_ASSIGN
+  InsertTable(const InsertTable&);
+  InsertTable& operator=(const InsertTable&);
+};
+
+#endif  // _DB_BACKEND_INSERT_TABLE_H_
@@ -0,0 +1,353 @@
+// Author: Kun Ren (kun.ren@yale.edu)
+//
+// A log-structured store of records by id (see log_store.h).
+
+#include "backend/log_store.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// Header preceding each record in its block.
+struct RecordHeader {
+  int64 id;
+  uint32 length;
+  uint32 magic;
+};
+
+LogStore::LogStore()
+    : tail_block_(-1), tail_buffer_(-1), tail_used_(0), fd_(-1),
+      segment_buffer_(NULL), stopped_(true) {
+}
+
+LogStore::~LogStore() {
+  if (!stopped_) {
+    stopped_ = true;
+    pthread_join(compaction_thread_, NULL);
+  }
+  if (fd_ >= 0)
+    close(fd_);
+  free(segment_buffer_);
+}
+
+bool LogStore::Open(const string& path, int depth, int buffers) {
+  // The index does not survive, so neither does the log.
+  fd_ = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_DIRECT, 0644);
+  if (fd_ < 0)
+    fd_ = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd_ < 0) {
+    perror(path.c_str());
+    return false;
+  }
+  if (posix_memalign(reinterpret_cast<void**>(&segment_buffer_), 4096,
+                     LOG_SEGMENT_BLOCKS * LOG_BLOCK_SIZE) != 0) {
+    perror("posix_memalign");
+    exit(EXIT_FAILURE);
+  }
+  if (!engine_.Open(path, depth, buffers, LOG_BLOCK_SIZE, true))
+    return false;
+
+  stopped_ = false;
+  pthread_create(&compaction_thread_, NULL, RunCompactionThread, this);
+  return true;
+}
+
+bool LogStore::Append(int64 id, const char* data, int length) {
+  return AppendIf(id, data, length, NULL);
+}
+
+bool LogStore::AppendIf(int64 id, const char* data, int length,
+                        const Location* expected) {
+  if (length > LOG_MAX_RECORD_SIZE) {
+    printf("LogStore: record %lld of %d bytes exceeds the maximum of %d\n",
+           static_cast<long long>(id), length, LOG_MAX_RECORD_SIZE);
+    return false;
+  }
+  int size = LOG_RECORD_HEADER_SIZE + length;
+
+  // A buffer for the next tail block is acquired without holding 'mutex_',
+  // as completions that free buffers take it.
+  int spare = -1;
+  bool appended = false;
+  while (true) {
+    {
+      Lock l(&mutex_);
+      if (expected != NULL) {
+        unordered_map<int64, Location>::iterator it = index_.find(id);
+        if (it == index_.end() || it->second.block != expected->block ||
+            it->second.offset != expected->offset)
+          break;
+      }
+      if (tail_buffer_ < 0 || tail_used_ + size > LOG_BLOCK_SIZE) {
+        if (spare >= 0) {
+          AdvanceTail(spare);
+          spare = -1;
+        }
+      }
+      if (tail_buffer_ >= 0 && tail_used_ + size <= LOG_BLOCK_SIZE) {
+        char* record = engine_.Buffer(tail_buffer_) + tail_used_;
+        RecordHeader header;
+        header.id = id;
+        header.length = length;
+        header.magic = LOG_RECORD_MAGIC;
+        memcpy(record, &header, sizeof(header));
+        memcpy(record + LOG_RECORD_HEADER_SIZE, data, length);
+
+        Forget(id);
+        Location location;
+        location.block = tail_block_;
+        location.offset = tail_used_;
+        location.length = length;
+        index_[id] = location;
+        segments_[SegmentOf(tail_block_)].live += size;
+        tail_used_ += size;
+        appended = true;
+        break;
+      }
+    }
+    spare = engine_.AcquireBuffer();
+  }
+
+  // Another append may have started a new tail meanwhile.
+  if (spare >= 0)
+    engine_.ReleaseBuffer(spare);
+  return appended;
+}
+
+void LogStore::AdvanceTail(int buffer) {
+  if (tail_buffer_ >= 0)
+    engine_.QueueWrite(tail_block_, tail_buffer_,
+                       new BlockWrite(this, tail_block_, tail_buffer_));
+
+  if (tail_block_ >= 0 && (tail_block_ + 1) % LOG_SEGMENT_BLOCKS != 0) {
+    tail_block_++;
+  } else {
+    if (tail_block_ >= 0)
+      segments_[SegmentOf(tail_block_)].sealed = true;
+    int segment;
+    if (!free_segments_.empty()) {
+      segment = free_segments_.back();
+      free_segments_.pop_back();
+    } else {
+      segment = segments_.size();
+      segments_.push_back(Segment());
+    }
+    tail_block_ = static_cast<int64>(segment) * LOG_SEGMENT_BLOCKS;
+  }
+
+  // Zeroes end the block's records.
+  memset(engine_.Buffer(buffer), 0, LOG_BLOCK_SIZE);
+  tail_buffer_ = buffer;
+  tail_used_ = 0;
+  unwritten_blocks_[tail_block_] = buffer;
+  segments_[SegmentOf(tail_block_)].unwritten++;
+}
+
+void LogStore::Forget(int64 id) {
+  unordered_map<int64, Location>::iterator it = index_.find(id);
+  if (it == index_.end())
+    return;
+  int s = SegmentOf(it->second.block);
+  Segment* segment = &segments_[s];
+  segment->live -= LOG_RECORD_HEADER_SIZE + it->second.length;
+  index_.erase(it);
+  // Segments whose records all died need no compaction.
+  if (segment->live == 0 && segment->sealed && !segment->compacting &&
+      !segment->freeing) {
+    segment->freeing = true;
+    MaybeFreeSegment(s);
+  }
+}
+
+void LogStore::MaybeFreeSegment(int s) {
+  Segment* segment = &segments_[s];
+  if (!segment->freeing || segment->reads > 0 || segment->unwritten > 0)
+    return;
+  *segment = Segment();
+  free_segments_.push_back(s);
+  // Give the space back to the file system until the segment is reused.
+  off_t size = static_cast<off_t>(LOG_SEGMENT_BLOCKS) * LOG_BLOCK_SIZE;
+  fallocate(fd_, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, s * size, size);
+}
+
+bool LogStore::Read(int64 id, ReadCompletion* completion) {
+  Location location;
+  string data;
+  bool in_memory = false;
+  {
+    Lock l(&mutex_);
+    unordered_map<int64, Location>::iterator it = index_.find(id);
+    if (it == index_.end())
+      return false;
+    location = it->second;
+    unordered_map<int64, int>::iterator block =
+        unwritten_blocks_.find(location.block);
+    if (block != unwritten_blocks_.end()) {
+      data.assign(engine_.Buffer(block->second) + location.offset +
+                  LOG_RECORD_HEADER_SIZE, location.length);
+      in_memory = true;
+    } else {
+      // Keeps the segment from being recycled under the read.
+      segments_[SegmentOf(location.block)].reads++;
+    }
+  }
+
+  if (in_memory) {
+    completion->Complete(data.data(), data.size());
+  } else {
+    int buffer = engine_.AcquireBuffer();
+    engine_.QueueRead(location.block, buffer,
+                      new BlockRead(this, id, location, buffer, completion));
+  }
+  return true;
+}
+
+void LogStore::Submit() {
+  engine_.Submit();
+}
+
+int64 LogStore::live_bytes() {
+  Lock l(&mutex_);
+  int64 live = 0;
+  for (uint32 i = 0; i < segments_.size(); i++)
+    live += segments_[i].live;
+  return live;
+}
+
+int LogStore::segments_in_use() {
+  Lock l(&mutex_);
+  return segments_.size() - free_segments_.size();
+}
+
+///////////////// Compaction ////////////////////////
+
+void* LogStore::RunCompactionThread(void* arg) {
+  LogStore* store = reinterpret_cast<LogStore*>(arg);
+  while (!store->stopped_) {
+    if (!store->Compact())
+      usleep(LOG_COMPACTION_INTERVAL);
+  }
+  return NULL;
+}
+
+bool LogStore::Compact() {
+  const int64 segment_size =
+      static_cast<int64>(LOG_SEGMENT_BLOCKS) * LOG_BLOCK_SIZE;
+  int victim = -1;
+  int64 live;
+  {
+    Lock l(&mutex_);
+    for (uint32 i = 0; i < segments_.size(); i++) {
+      Segment* segment = &segments_[i];
+      if (!segment->sealed || segment->compacting || segment->freeing ||
+          segment->unwritten > 0 ||
+          segment->live * 100 >= segment_size * LOG_COMPACTION_THRESHOLD)
+        continue;
+      if (victim < 0 || segment->live < segments_[victim].live)
+        victim = i;
+    }
+    if (victim < 0)
+      return false;
+    segments_[victim].compacting = true;
+    live = segments_[victim].live;
+  }
+
+  // Read the whole segment at once; every block of it is on disk.
+  int64 read = live > 0 ? 0 : segment_size;
+  while (read < segment_size) {
+    ssize_t result = pread(fd_, segment_buffer_ + read, segment_size - read,
+                           victim * segment_size + read);
+    if (result < 0 && errno == EINTR)
+      continue;
+    if (result <= 0) {
+      perror("LogStore: reading segment for compaction");
+      return false;
+    }
+    read += result;
+  }
+
+  // Copy out the records the index still points to.
+  for (int b = 0; b < LOG_SEGMENT_BLOCKS; b++) {
+    char* block = segment_buffer_ + b * LOG_BLOCK_SIZE;
+    int offset = 0;
+    while (offset + LOG_RECORD_HEADER_SIZE <= LOG_BLOCK_SIZE) {
+      RecordHeader header;
+      memcpy(&header, block + offset, sizeof(header));
+      if (header.magic != LOG_RECORD_MAGIC ||
+          offset + LOG_RECORD_HEADER_SIZE + header.length > LOG_BLOCK_SIZE)
+        break;
+      Location location;
+      location.block = static_cast<int64>(victim) * LOG_SEGMENT_BLOCKS + b;
+      location.offset = offset;
+      location.length = header.length;
+      AppendIf(header.id, block + offset + LOG_RECORD_HEADER_SIZE,
+               header.length, &location);
+      offset += LOG_RECORD_HEADER_SIZE + header.length;
+    }
+  }
+
+  Lock l(&mutex_);
+  Segment* segment = &segments_[victim];
+  segment->compacting = false;
+  if (segment->live == 0) {
+    segment->freeing = true;
+    MaybeFreeSegment(victim);
+  }
+  return true;
+}
+
+///////////////// Asynchronous Callbacks ////////////////////////
+
+void LogStore::BlockRead::Complete(int result) {
+  char* block = store_->engine_.Buffer(buffer_);
+  RecordHeader header;
+  memcpy(&header, block + location_.offset, sizeof(header));
+  if (result < 0) {
+    printf("LogStore: reading block %lld failed: %s\n",
+           static_cast<long long>(location_.block), strerror(-result));
+    completion_->Complete(NULL, -1);
+  } else if (result < location_.offset + LOG_RECORD_HEADER_SIZE +
+                      location_.length ||
+             header.magic != LOG_RECORD_MAGIC || header.id != id_ ||
+             static_cast<int>(header.length) != location_.length) {
+    printf("LogStore: record %lld in block %lld is corrupt\n",
+           static_cast<long long>(id_),
+           static_cast<long long>(location_.block));
+    completion_->Complete(NULL, -1);
+  } else {
+    completion_->Complete(block + location_.offset + LOG_RECORD_HEADER_SIZE,
+                          location_.length);
+  }
+  store_->engine_.ReleaseBuffer(buffer_);
+
+  {
+    Lock l(&store_->mutex_);
+    int s = SegmentOf(location_.block);
+    store_->segments_[s].reads--;
+    store_->MaybeFreeSegment(s);
+  }
+  delete this;
+}
+
+void LogStore::BlockWrite::Complete(int result) {
+  if (result != LOG_BLOCK_SIZE) {
+    // The block stays in memory, and its records readable from there.
+    printf("LogStore: writing block %lld failed: %s\n",
+           static_cast<long long>(block_),
+           result < 0 ? strerror(-result) : "short write");
+    delete this;
+    return;
+  }
+  {
+    Lock l(&store_->mutex_);
+    store_->unwritten_blocks_.erase(block_);
+    int s = SegmentOf(block_);
+    store_->segments_[s].unwritten--;
+    store_->MaybeFreeSegment(s);
+  }
+  store_->engine_.ReleaseBuffer(buffer_);
+  delete this;
+}
@@ -0,0 +1,207 @@
+// Author: Kun Ren (kun.ren@yale.edu)
+//
+// A log-structured store of records by id, the on-disk half of
+// FetchingStorage.
+//
+// Records are appended to the tail of a single log file, packed into blocks
+// of LOG_BLOCK_SIZE bytes, and an in-memory index maps each id to the block
+// and offset of its latest record. Writes are therefore sequential whole
+// blocks, issued once a block fills up, however scattered the ids written
+// are; a record in a block not yet on disk is read from memory. Reads fetch
+// the one block holding the record through a UringEngine, with O_DIRECT
+// where the file system supports it, so cold records do not also take up the
+// page cache.
+//
+// The log is divided into segments of LOG_SEGMENT_BLOCKS blocks. Rewriting
+// a record leaves its old copy dead; a compaction thread copies the live
+// records of segments mostly dead (below LOG_COMPACTION_THRESHOLD percent
+// live) to the tail and then recycles the segment, so the log stays within a
+// small factor of the live data.
+//
+// The index is not persisted: the store is a backing store for objects that
+// do not fit in memory, and a new store starts out empty.
+
+#ifndef _DB_BACKEND_LOG_STORE_H_
+#define _DB_BACKEND_LOG_STORE_H_
+
+#include <pthread.h>
+
+#include <string>
+#include <vector>
+
+#include "common/types.h"
+#include "common/utils.h"
+#include "backend/uring_engine.h"
+
+using std::string;
+using std::vector;
+
+#define LOG_BLOCK_SIZE 4096
+#define LOG_SEGMENT_BLOCKS 1024
+
+// Each record is preceded by its id, its length and LOG_RECORD_MAGIC, and
+// fits in one block.
+#define LOG_RECORD_HEADER_SIZE 16
+#define LOG_MAX_RECORD_SIZE (LOG_BLOCK_SIZE - LOG_RECORD_HEADER_SIZE)
+#define LOG_RECORD_MAGIC 0x4c4f4752
+
+// Segments with fewer live bytes than this percentage of their size are
+// compacted.
+#define LOG_COMPACTION_THRESHOLD 50
+
+// How long the compaction thread sleeps when there is nothing to compact
+// (in microseconds).
+#define LOG_COMPACTION_INTERVAL 10000
+
+class LogStore {
+ public:
+  // Completion of a read, run with the record (valid only during the call)
+  // and its length, or with NULL and -1 if reading it failed.
+  class ReadCompletion {
+   public:
+    virtual ~ReadCompletion() {}
+    virtual void Complete(const char* data, int length) = 0;
+  };
+
+  LogStore();
+  ~LogStore();
+
+  // Creates (or empties) the log at 'path', sets up its engine with a ring of
+  // 'depth' entries and 'buffers' block buffers, and starts the compaction
+  // thread. Returns false if the log cannot be set up.
+  bool Open(const string& path, int depth, int buffers);
+
+  // Appends a record of 'length' bytes at 'data' for 'id', replacing any
+  // earlier one. The record is copied; the write of its block is queued once
+  // the block is full and started by the next Submit. Returns false, leaving
+  // any earlier record in place, if the record is longer than
+  // LOG_MAX_RECORD_SIZE.
+  bool Append(int64 id, const char* data, int length);
+
+  // Reads the record of 'id' and runs 'completion' with it, at once if the
+  // record is still in memory and otherwise once a queued read (started by
+  // the next Submit) completes. Returns false, without running 'completion',
+  // if 'id' has no record.
+  bool Read(int64 id, ReadCompletion* completion);
+
+  // Starts every queued read and write.
+  void Submit();
+
+  // Bytes of live records (including their headers), and the segments in
+  // use.
+  int64 live_bytes();
+  int segments_in_use();
+
+ private:
+  // Where a record is in the log.
+  struct Location {
+    int64 block;
+    int offset;
+    int length;
+  };
+
+  struct Segment {
+    // Bytes of records in the segment still in the index.
+    int64 live;
+    // Blocks of the segment not yet on disk, and reads in flight.
+    int unwritten;
+    int reads;
+    // Whether the tail has moved past the segment, whether its live records
+    // are being copied out, and whether it is waiting for reads to drain
+    // before being recycled.
+    bool sealed;
+    bool compacting;
+    bool freeing;
+
+    Segment()
+        : live(0), unwritten(0), reads(0), sealed(false), compacting(false),
+          freeing(false) {}
+  };
+
+  // A block read or write in flight.
+  class BlockRead : public UringEngine::Completion {
+   public:
+    BlockRead(LogStore* store, int64 id, const Location& location, int buffer,
+              ReadCompletion* completion)
+        : store_(store), id_(id), location_(location), buffer_(buffer),
+          completion_(completion) {}
+    virtual void Complete(int result);
+
+   private:
+    LogStore* store_;
+    int64 id_;
+    Location location_;
+    int buffer_;
+    ReadCompletion* completion_;
+  };
+
+  class BlockWrite : public UringEngine::Completion {
+   public:
+    BlockWrite(LogStore* store, int64 block, int buffer)
+        : store_(store), block_(block), buffer_(buffer) {}
+    virtual void Complete(int result);
+
+   private:
+    LogStore* store_;
+    int64 block_;
+    int buffer_;
+  };
+
+  // Appends the record unless it is too long, or 'expected' is not NULL and
+  // the index no longer points there. Returns whether it was appended.
+  bool AppendIf(int64 id, const char* data, int length,
+                const Location* expected);
+
+  // Queues the write of the tail block and starts the next one in 'buffer',
+  // in a new segment if the tail's is full. Requires 'mutex_'.
+  void AdvanceTail(int buffer);
+
+  // Drops the index's reference to the record of 'id', if any. Requires
+  // 'mutex_'.
+  void Forget(int64 id);
+
+  // Recycles 'segment' if it is being freed and no reads of it are in
+  // flight. Requires 'mutex_'.
+  void MaybeFreeSegment(int segment);
+
+  // Copies the live records of the emptiest compactable segment to the tail.
+  // Returns false if no segment needed compaction.
+  bool Compact();
+
+  static void* RunCompactionThread(void* arg);
+
+  static int SegmentOf(int64 block) { return block / LOG_SEGMENT_BLOCKS; }
+
+  // Protects everything below.
+  Mutex mutex_;
+
+  unordered_map<int64, Location> index_;
+  vector<Segment> segments_;
+  vector<int> free_segments_;
+
+  // Block being filled, its buffer and the bytes used in it.
+  int64 tail_block_;
+  int tail_buffer_;
+  int tail_used_;
+
+  // Buffers of the blocks not yet on disk, by block.
+  unordered_map<int64, int> unwritten_blocks_;
+
+  // Descriptor of the log used by the compaction thread to read whole
+  // segments, and the aligned buffer it reads them into.
+  int fd_;
+  char* segment_buffer_;
+
+  pthread_t compaction_thread_;
+  volatile bool stopped_;
+
+  // Declared last so that it is destroyed (running every completion still
+  // in flight) first.
+  UringEngine engine_;
+
+  // DISALLOW_COPY_AND_ASSIGN
+  LogStore(const LogStore&);
+  LogStore& operator=(const LogStore&);
+};
+
+#endif  // _DB_BACKEND_LOG_STORE_H_
@@ -0,0 +1,405 @@
+// Author: Kun Ren (kun.ren@yale.edu)
+//
+// A concurrent ordered index mapping Keys to Value pointers (see
+// ordered_index.h).
+
+#include "backend/ordered_index.h"
+
+OrderedIndex::OrderedIndex() : size_(0) {
+  LeafNode* root = NewLeaf();
+  nodes_.push_back(root);
+  root_ = root;
+}
+
+OrderedIndex::~OrderedIndex() {
+  // Separators in inner nodes point to keys of leaves or to retired keys, so
+  // only those are deleted.
+  for (uint32 i = 0; i < nodes_.size(); i++) {
+    Node* node = nodes_[i];
+    if (node->leaf) {
+      for (int j = 0; j < node->count; j++)
+        delete node->keys[j];
+      delete static_cast<LeafNode*>(node);
+    } else {
+      delete static_cast<InnerNode*>(node);
+    }
+  }
+  for (uint32 i = 0; i < retired_keys_.size(); i++)
+    delete retired_keys_[i];
+}
+
+OrderedIndex::LeafNode* OrderedIndex::NewLeaf() {
+  LeafNode* leaf = new LeafNode();
+  leaf->version = 0;
+  leaf->leaf = true;
+  leaf->count = 0;
+  for (int i = 0; i < ORDERED_NODE_KEYS; i++) {
+    leaf->prefixes[i] = 0;
+    leaf->keys[i] = NULL;
+    leaf->values[i] = NULL;
+  }
+  leaf->next = NULL;
+  return leaf;
+}
+
+OrderedIndex::InnerNode* OrderedIndex::NewInner() {
+  InnerNode* inner = new InnerNode();
+  inner->version = 0;
+  inner->leaf = false;
+  inner->count = 0;
+  for (int i = 0; i < ORDERED_NODE_KEYS; i++) {
+    inner->prefixes[i] = 0;
+    inner->keys[i] = NULL;
+  }
+  for (int i = 0; i <= ORDERED_NODE_KEYS; i++)
+    inner->children[i] = NULL;
+  return inner;
+}
+
+uint64 OrderedIndex::Prefix(const Key& key) {
+  uint64 prefix = 0;
+  for (uint32 i = 0; i < 8; i++) {
+    prefix <<= 8;
+    if (i < key.size())
+      prefix |= static_cast<unsigned char>(key[i]);
+  }
+  return prefix;
+}
+
+int OrderedIndex::LowerBound(const Node* node, const Key& key,
+                             uint64 prefix) {
+  int count = node->count;
+  if (count < 0 || count > ORDERED_NODE_KEYS)
+    return -1;
+  int low = 0;
+  int high = count;
+  while (low < high) {
+    int middle = (low + high) / 2;
+    uint64 middle_prefix = node->prefixes[middle];
+    bool less;
+    if (middle_prefix != prefix) {
+      less = middle_prefix < prefix;
+    } else {
+      const Key* middle_key = node->keys[middle];
+      if (middle_key == NULL)
+        return -1;
+      less = *middle_key < key;
+    }
+    if (less)
+      low = middle + 1;
+    else
+      high = middle;
+  }
+  return low;
+}
+
+bool OrderedIndex::ReadLock(const Node* node, uint64* version) {
+  *version = node->version;
+  __sync_synchronize();
+  return (*version & 2) == 0;
+}
+
+bool OrderedIndex::Validate(const Node* node, uint64 version) {
+  __sync_synchronize();
+  return node->version == version;
+}
+
+bool OrderedIndex::UpgradeLock(Node* node, uint64 version) {
+  return __sync_bool_compare_and_swap(&node->version, version, version + 2);
+}
+
+void OrderedIndex::Unlock(Node* node) {
+  __sync_fetch_and_add(&node->version, 2);
+}
+
+bool OrderedIndex::FindLeaf(const Key& key, uint64 prefix, LeafNode** leaf,
+                            uint64* version) const {
+  Node* node = root_;
+  uint64 node_version;
+  if (!ReadLock(node, &node_version) || node != root_)
+    return false;
+  while (!node->leaf) {
+    InnerNode* inner = static_cast<InnerNode*>(node);
+    int position = LowerBound(inner, key, prefix);
+    if (position < 0)
+      return false;
+    Node* child = inner->children[position];
+    uint64 child_version;
+    if (child == NULL || !ReadLock(child, &child_version) ||
+        !Validate(inner, node_version))
+      return false;
+    node = child;
+    node_version = child_version;
+  }
+  *leaf = static_cast<LeafNode*>(node);
+  *version = node_version;
+  return true;
+}
+
+Value* OrderedIndex::Lookup(const Key& key) const {
+  uint64 prefix = Prefix(key);
+  while (true) {
+    LeafNode* leaf;
+    uint64 version;
+    if (!FindLeaf(key, prefix, &leaf, &version))
+      continue;
+    int position = LowerBound(leaf, key, prefix);
+    if (position < 0)
+      continue;
+    Value* value = NULL;
+    if (position < leaf->count && leaf->prefixes[position] == prefix) {
+      const Key* found = leaf->keys[position];
+      if (found != NULL && *found == key)
+        value = leaf->values[position];
+    }
+    if (Validate(leaf, version))
+      return value;
+  }
+}
+
+void OrderedIndex::Insert(const Key& key, Value* value) {
+  uint64 prefix = Prefix(key);
+  while (!TryInsert(key, prefix, value)) {}
+}
+
+bool OrderedIndex::TryInsert(const Key& key, uint64 prefix, Value* value) {
+  Node* node = root_;
+  uint64 version;
+  if (!ReadLock(node, &version) || node != root_)
+    return false;
+
+  InnerNode* parent = NULL;
+  uint64 parent_version = 0;
+  while (true) {
+    if (node->count == ORDERED_NODE_KEYS) {
+      // Split full nodes on the way down, so that the parent always has room
+      // for the new separator, then start over.
+      if (parent != NULL && !UpgradeLock(parent, parent_version))
+        return false;
+      if (!UpgradeLock(node, version)) {
+        if (parent != NULL)
+          Unlock(parent);
+        return false;
+      }
+      if (parent == NULL && node != root_) {
+        Unlock(node);
+        return false;
+      }
+      Split(parent, node);
+      Unlock(node);
+      if (parent != NULL)
+        Unlock(parent);
+      return false;
+    }
+    if (node->leaf)
+      break;
+
+    InnerNode* inner = static_cast<InnerNode*>(node);
+    int position = LowerBound(inner, key, prefix);
+    if (position < 0)
+      return false;
+    Node* child = inner->children[position];
+    uint64 child_version;
+    if (child == NULL || !ReadLock(child, &child_version) ||
+        !Validate(inner, version))
+      return false;
+    parent = inner;
+    parent_version = version;
+    node = child;
+    version = child_version;
+  }
+
+  // A leaf only loses keys to a split, which changes its version, so it is
+  // still the right leaf if it can be locked at the version seen.
+  LeafNode* leaf = static_cast<LeafNode*>(node);
+  if (!UpgradeLock(leaf, version))
+    return false;
+  int position = LowerBound(leaf, key, prefix);
+  int count = leaf->count;
+  if (position < count && *leaf->keys[position] == key) {
+    leaf->values[position] = value;
+  } else {
+    for (int i = count; i > position; i--) {
+      leaf->prefixes[i] = leaf->prefixes[i - 1];
+      leaf->keys[i] = leaf->keys[i - 1];
+      leaf->values[i] = leaf->values[i - 1];
+    }
+    leaf->prefixes[position] = prefix;
+    leaf->keys[position] = new Key(key);
+    leaf->values[position] = value;
+    leaf->count = count + 1;
+    __sync_fetch_and_add(&size_, 1);
+  }
+  Unlock(leaf);
+  return true;
+}
+
+void OrderedIndex::Split(InnerNode* parent, Node* node) {
+  int count = node->count;
+  int middle = count / 2;
+  Node* right;
+  const Key* separator;
+  uint64 separator_prefix;
+
+  if (node->leaf) {
+    // The left half keeps keys [0, middle); its last key separates the two.
+    LeafNode* leaf = static_cast<LeafNode*>(node);
+    LeafNode* right_leaf = NewLeaf();
+    for (int i = middle; i < count; i++) {
+      right_leaf->prefixes[i - middle] = leaf->prefixes[i];
+      right_leaf->keys[i - middle] = leaf->keys[i];
+      right_leaf->values[i - middle] = leaf->values[i];
+    }
+    right_leaf->count = count - middle;
+    right_leaf->next = leaf->next;
+    separator = leaf->keys[middle - 1];
+    separator_prefix = leaf->prefixes[middle - 1];
+    __sync_synchronize();
+    leaf->next = right_leaf;
+    leaf->count = middle;
+    right = right_leaf;
+  } else {
+    // Key 'middle' moves up; the left half keeps the keys before it and the
+    // right half the keys after it.
+    InnerNode* inner = static_cast<InnerNode*>(node);
+    InnerNode* right_inner = NewInner();
+    for (int i = middle + 1; i < count; i++) {
+      right_inner->prefixes[i - middle - 1] = inner->prefixes[i];
+      right_inner->keys[i - middle - 1] = inner->keys[i];
+    }
+    for (int i = middle + 1; i <= count; i++)
+      right_inner->children[i - middle - 1] = inner->children[i];
+    right_inner->count = count - middle - 1;
+    separator = inner->keys[middle];
+    separator_prefix = inner->prefixes[middle];
+    __sync_synchronize();
+    inner->count = middle;
+    right = right_inner;
+  }
+
+  {
+    Lock l(&mutex_);
+    nodes_.push_back(right);
+  }
+
+  if (parent == NULL) {
+    InnerNode* root = NewInner();
+    root->prefixes[0] = separator_prefix;
+    root->keys[0] = separator;
+    root->children[0] = node;
+    root->children[1] = right;
+    root->count = 1;
+    {
+      Lock l(&mutex_);
+      nodes_.push_back(root);
+    }
+    __sync_synchronize();
+    root_ = root;
+    return;
+  }
+
+  int position = LowerBound(parent, *separator, separator_prefix);
+  int parent_count = parent->count;
+  for (int i = parent_count; i > position; i--) {
+    parent->prefixes[i] = parent->prefixes[i - 1];
+    parent->keys[i] = parent->keys[i - 1];
+    parent->children[i + 1] = parent->children[i];
+  }
+  parent->prefixes[position] = separator_prefix;
+  parent->keys[position] = separator;
+  parent->children[position + 1] = right;
+  parent->count = parent_count + 1;
+}
+
+bool OrderedIndex::Erase(const Key& key) {
+  uint64 prefix = Prefix(key);
+  while (true) {
+    LeafNode* leaf;
+    uint64 version;
+    if (!FindLeaf(key, prefix, &leaf, &version) ||
+        !UpgradeLock(leaf, version))
+      continue;
+    int position = LowerBound(leaf, key, prefix);
+    int count = leaf->count;
+    if (position == count || *leaf->keys[position] != key) {
+      Unlock(leaf);
+      return false;
+    }
+
+    const Key* erased = leaf->keys[position];
+    for (int i = position; i < count - 1; i++) {
+      leaf->prefixes[i] = leaf->prefixes[i + 1];
+      leaf->keys[i] = leaf->keys[i + 1];
+      leaf->values[i] = leaf->values[i + 1];
+    }
+    leaf->count = count - 1;
+    Unlock(leaf);
+
+    __sync_fetch_and_sub(&size_, 1);
+    Lock l(&mutex_);
+    retired_keys_.push_back(erased);
+    return true;
+  }
+}
+
+int OrderedIndex::Scan(const Key& start, const Key& end, int limit,
+                       vector<pair<Key, Value*> >* results) const {
+  // Where the scan stands: keys from 'from' on (or after it, once it is the
+  // last key returned) remain to be scanned.
+  Key from = start;
+  bool inclusive = true;
+  int found = 0;
+  vector<pair<Key, Value*> > batch;
+
+  while (limit < 0 || found < limit) {
+    LeafNode* leaf;
+    uint64 version;
+    uint64 prefix = Prefix(from);
+    if (!FindLeaf(from, prefix, &leaf, &version))
+      continue;
+
+    // Walk the leaf chain, copying each leaf's keys in range and only
+    // keeping them once the leaf is known not to have changed meanwhile.
+    while (true) {
+      int position = LowerBound(leaf, from, prefix);
+      if (position < 0)
+        break;
+      int count = leaf->count;
+      bool done = false;
+      batch.clear();
+      for (int i = position; i < count; i++) {
+        const Key* key = leaf->keys[i];
+        if (key == NULL)
+          break;
+        if (!inclusive && *key == from)
+          continue;
+        if ((!end.empty() && *key >= end) ||
+            (limit >= 0 && found + static_cast<int>(batch.size()) >= limit)) {
+          done = true;
+          break;
+        }
+        batch.push_back(pair<Key, Value*>(*key, leaf->values[i]));
+      }
+      LeafNode* next = leaf->next;
+      uint64 next_version = 0;
+      bool next_locked = next != NULL && ReadLock(next, &next_version);
+      if (!Validate(leaf, version))
+        break;
+
+      results->insert(results->end(), batch.begin(), batch.end());
+      found += batch.size();
+      if (!batch.empty()) {
+        from = batch.back().first;
+        prefix = Prefix(from);
+        inclusive = false;
+      }
+      if (done || next == NULL)
+        return found;
+      if (!next_locked)
+        break;
+      leaf = next;
+      version = next_version;
+    }
+  }
+  return found;
+}
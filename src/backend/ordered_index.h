@@ -0,0 +1,135 @@
+// Author: Kun Ren (kun.ren@yale.edu)
+//
+// A concurrent ordered index mapping Keys to Value pointers, supporting range
+// scans in key order.
+//
+// The index is a B+-tree whose nodes hold up to ORDERED_NODE_KEYS keys.
+// Besides a pointer to each key, a node stores the key's first eight bytes as
+// a big-endian integer, so a binary search over a node mostly compares
+// integers in one array and only dereferences keys whose prefixes tie. Leaves
+// are linked left to right, so a scan descends the tree once and then walks
+// the leaf chain.
+//
+// Concurrency uses optimistic lock coupling: every node carries a version
+// word whose low bits mark a writer holding the node, and that every unlock
+// advances. Readers take no locks; they note a node's version, read the node,
+// and check that the version is unchanged before trusting what they read
+// (including the child pointer that takes them one level down), retrying from
+// the root otherwise. Writers lock only the nodes they modify. Full nodes are
+// split on the way down, so a split never has to propagate upwards.
+//
+// Nodes are never merged or freed while the index exists, and erased keys are
+// retired and deleted with the index, so memory read by lock-free readers
+// stays valid. Erasing keys may leave leaves sparse or empty.
+
+#ifndef _DB_BACKEND_ORDERED_INDEX_H_
+#define _DB_BACKEND_ORDERED_INDEX_H_
+
+#include <pthread.h>
+
+#include <utility>
+#include <vector>
+
+#include "common/types.h"
+#include "common/utils.h"
+
+using std::pair;
+using std::vector;
+
+// Maximum number of keys of a node.
+#define ORDERED_NODE_KEYS 32
+
+class OrderedIndex {
+ public:
+  OrderedIndex();
+  ~OrderedIndex();
+
+  // Returns the value stored under 'key', or NULL if there is none. Never
+  // blocks; safe to call concurrently with any other method.
+  Value* Lookup(const Key& key) const;
+
+  // Stores 'value' under 'key', replacing any previous value.
+  void Insert(const Key& key, Value* value);
+
+  // Removes 'key'. Returns false if it was not present.
+  bool Erase(const Key& key);
+
+  // Appends the (key, value) pairs whose keys lie in ['start', 'end') to
+  // '*results' in key order, at most 'limit' of them unless 'limit' is
+  // negative, and returns how many were appended. An empty 'end' means no
+  // upper bound. Never blocks. Each leaf is read consistently, but keys
+  // inserted or erased during the scan may or may not be seen.
+  int Scan(const Key& start, const Key& end, int limit,
+           vector<pair<Key, Value*> >* results) const;
+
+  // Number of keys stored.
+  uint64 size() const { return size_; }
+
+ private:
+  struct Node {
+    // Bit 1 is set while a writer holds the node; the version advances with
+    // every unlock.
+    volatile uint64 version;
+    bool leaf;
+    volatile int32 count;
+    volatile uint64 prefixes[ORDERED_NODE_KEYS];
+    const Key* volatile keys[ORDERED_NODE_KEYS];
+  };
+
+  // Child 'i' holds the keys greater than key 'i - 1' and at most key 'i'.
+  struct InnerNode : public Node {
+    Node* volatile children[ORDERED_NODE_KEYS + 1];
+  };
+
+  struct LeafNode : public Node {
+    Value* volatile values[ORDERED_NODE_KEYS];
+    LeafNode* volatile next;
+  };
+
+  // Returns the first eight bytes of 'key' as a big-endian integer, padded
+  // with zeros, so that prefixes order like the keys they come from.
+  static uint64 Prefix(const Key& key);
+
+  // Returns the position of the first key of 'node' that is not less than
+  // 'key', or -1 if 'node' was seen in an inconsistent state.
+  static int LowerBound(const Node* node, const Key& key, uint64 prefix);
+
+  // Optimistic lock primitives. ReadLock notes the version of a node that no
+  // writer holds (returning false otherwise); Validate checks that it has not
+  // changed since; UpgradeLock turns a noted version into a write lock unless
+  // the node changed; Unlock releases a write lock.
+  static bool ReadLock(const Node* node, uint64* version);
+  static bool Validate(const Node* node, uint64 version);
+  static bool UpgradeLock(Node* node, uint64 version);
+  static void Unlock(Node* node);
+
+  // Descends to the leaf that would hold 'key' and notes its version. Returns
+  // false if the descent must be retried.
+  bool FindLeaf(const Key& key, uint64 prefix, LeafNode** leaf,
+                uint64* version) const;
+
+  // One attempt of Insert. Returns false if it must be retried.
+  bool TryInsert(const Key& key, uint64 prefix, Value* value);
+
+  // Splits the full 'node' and adds the new right half to 'parent' (or to a
+  // new root if 'node' is the root). Requires write locks on both.
+  void Split(InnerNode* parent, Node* node);
+
+  static LeafNode* NewLeaf();
+  static InnerNode* NewInner();
+
+  Node* volatile root_;
+  volatile uint64 size_;
+
+  // Every node ever allocated and the keys that were erased, deleted with
+  // the index.
+  vector<Node*> nodes_;
+  vector<const Key*> retired_keys_;
+  Mutex mutex_;
+
+  // DISALLOW_COPY_AND_ASSIGN
+  OrderedIndex(const OrderedIndex&);
+  OrderedIndex& operator=(const OrderedIndex&);
+};
+
+#endif  // _DB_BACKEND_ORDERED_INDEX_H_
@@ -0,0 +1,25 @@
+// Author: Kun Ren (kun.ren@yale.edu)
+//
+// An implementation of the storage interface using a concurrent ordered index.
+
+#include "backend/ordered_storage.h"
+
+Value* OrderedStorage::ReadObject(const Key& key, int64 txn_id) {
+  return objects_.Lookup(key);
+}
+
+bool OrderedStorage::PutObject(const Key& key, Value* value, int64 txn_id) {
+  objects_.Insert(key, value);
+  return true;
+}
+
+bool OrderedStorage::DeleteObject(const Key& key, int64 txn_id) {
+  objects_.Erase(key);
+  return true;
+}
+
+bool OrderedStorage::Scan(const Key& start, const Key& end, int limit,
+                          vector<pair<Key, Value*> >* results, int64 txn_id) {
+  objects_.Scan(start, end, limit, results);
+  return true;
+}
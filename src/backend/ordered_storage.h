@@ -0,0 +1,33 @@
+// Author: Kun Ren (kun.ren@yale.edu)
+//
+// An implementation of the storage interface that keeps objects ordered by
+// key in a concurrent B+-tree (see backend/ordered_index.h), so that besides
+// point reads and writes it supports range scans. Reads and scans never block.
+//
+// Selected with deployment/main.cc's 'o' flag. The bundled applications only
+// read and write point keys (TPC-C's keys are not zero-padded, so they do not
+// sort in numeric order); scans are for applications that declare ranges.
+
+#ifndef _DB_BACKEND_ORDERED_STORAGE_H_
+#define _DB_BACKEND_ORDERED_STORAGE_H_
+
+#include "backend/ordered_index.h"
+#include "backend/storage.h"
+#include "common/types.h"
+
+class OrderedStorage : public Storage {
+ public:
+  virtual ~OrderedStorage() {}
+
+  virtual bool Prefetch(const Key &key, double* wait_time)  { return false; }
+  virtual bool Unfetch(const Key &key)                      { return false; }
+  virtual Value* ReadObject(const Key& key, int64 txn_id = 0);
+  virtual bool PutObject(const Key& key, Value* value, int64 txn_id = 0);
+  virtual bool DeleteObject(const Key& key, int64 txn_id = 0);
+  virtual bool Scan(const Key& start, const Key& end, int limit,
+                    vector<pair<Key, Value*> >* results, int64 txn_id = 0);
+
+ private:
+  OrderedIndex objects_;
+};
+#endif  // _DB_BACKEND_ORDERED_STORAGE_H_
@@ -0,0 +1,73 @@
+// Author: Kun Ren (kun.ren@yale.edu)
+//
+// A read-only table of fixed-layout records of type T (see RecordOf in
+// common/types.h) under dense integer ids, for static reference data that
+// every node keeps a full copy of, such as TPC-C's Item table.
+//
+// A table is filled once while the database is loaded, then frozen. From then
+// on it never changes, so reads take no locks, and since the rows are stored
+// as T in one dense array indexed by id, reading one costs a bounds check and
+// an array access: no key hashing and no parsing.
+//
+// To add another reference table, declare a ReadOnlyTable of its record type,
+// Put its rows from the application's InitializeStorage, and Freeze it.
+
+#ifndef _DB_BACKEND_READ_ONLY_TABLE_H_
+#define _DB_BACKEND_READ_ONLY_TABLE_H_
+
+#include <vector>
+
+#include "common/types.h"
+
+using std::vector;
+
+template<typename T>
+class ReadOnlyTable {
+ public:
+  ReadOnlyTable() : frozen_(false) {}
+
+  // Stores 'row' as row 'id', replacing any previous row. Returns false (and
+  // stores nothing) if 'id' is negative or the table is frozen.
+  bool Put(int64 id, const T& row) {
+    if (id < 0 || frozen_)
+      return false;
+    if (id >= static_cast<int64>(rows_.size())) {
+      rows_.resize(id + 1);
+      present_.resize(id + 1, false);
+    }
+    rows_[id] = row;
+    present_[id] = true;
+    return true;
+  }
+
+  // Ends loading. Must be called before any Get, and before the txns that
+  // read the table start.
+  void Freeze() {
+    vector<T>(rows_).swap(rows_);
+    vector<char>(present_).swap(present_);
+    frozen_ = true;
+  }
+
+  // Returns row 'id', or NULL if there is none.
+  const T* Get(int64 id) const {
+    if (id < 0 || id >= static_cast<int64>(rows_.size()) || !present_[id])
+      return NULL;
+    return &rows_[id];
+  }
+
+  bool frozen() const { return frozen_; }
+
+  // One more than the largest id stored.
+  int64 size() const { return rows_.size(); }
+
+ private:
+  vector<T> rows_;
+  vector<char> present_;
+  bool frozen_;
+
+  // DISALLOW_COPY_AND_ASSIGN
+  ReadOnlyTable(const ReadOnlyTable&);
+  ReadOnlyTable& operator=(const ReadOnlyTable&);
+};
+
+#endif  // _DB_BACKEND_READ_ONLY_TABLE_H_
@@ -1,30 +1,31 @@
 // Author: Alexander Thomson (thomson@cs.yale.edu)
 // Author: Kun Ren (kun.ren@yale.edu)
 //
-// A simple implementation of the storage interface using an stl map.
+// A simple implementation of the storage interface using a concurrent hash
+// index.
 
 #include "backend/simple_storage.h"
 
 Value* SimpleStorage::ReadObject(const Key& key, int64 txn_id) {
-  if (objects_.count(key) != 0) {
-    return objects_[key];
-  } else {
-    return NULL;
-  }
+  return objects_.Lookup(key);
 }
 
 bool SimpleStorage::PutObject(const Key& key, Value* value, int64 txn_id) {
-pthread_mutex_lock(&mutex_);
-  objects_[key] = value;
-pthread_mutex_unlock(&mutex_);
+  Value* old = objects_.Insert(key, value);
+  if (old != NULL && old != value)
+    epochs_.Retire(old);
   return true;
 }
 
-bool SimpleStorage::DeleteObject(const Key& key, int64 txn_id) {
-  objects_.erase(key);
+bool SimpleStorage::PutObjects(const vector<pair<Key, Value*> >& objects,
+                               int64 txn_id) {
+  objects_.InsertBatch(objects);
   return true;
 }
 
-void SimpleStorage::Initmutex() {
-  pthread_mutex_init(&mutex_, NULL);
+bool SimpleStorage::DeleteObject(const Key& key, int64 txn_id) {
+  Value* old = NULL;
+  if (objects_.Erase(key, &old) && old != NULL)
+    epochs_.Retire(old);
+  return true;
 }
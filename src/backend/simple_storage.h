@@ -1,40 +1,45 @@
 // Author: Alexander Thomson (thomson@cs.yale.edu)
 // Author: Kun Ren (kun.ren@yale.edu)
 //
-// A simple implementation of the storage interface using an stl map.
+// A simple implementation of the storage interface using a concurrent hash
+// index (see backend/concurrent_index.h), so that reads never block and
+// inserts by different workers rarely contend.
+//
+// The storage owns the values it is given. Replaced and deleted values are
+// retired to its EpochManager and freed once no txn that may have read them
+// is still executing.
 
 #ifndef _DB_BACKEND_SIMPLE_STORAGE_H_
 #define _DB_BACKEND_SIMPLE_STORAGE_H_
 
-#include <tr1/unordered_map>
-//#include <unordered_map>
-
+#include "backend/concurrent_index.h"
+#include "backend/epoch_manager.h"
 #include "backend/storage.h"
 #include "common/types.h"
-#include <pthread.h>
-
-using std::tr1::unordered_map;
-//using std::unordered_map;
 
 class SimpleStorage : public Storage {
  public:
+  SimpleStorage() : objects_(&epochs_) {}
   virtual ~SimpleStorage() {}
 
   // TODO(Thad): Implement something real here
   virtual bool Prefetch(const Key &key, double* wait_time)  { return false; }
   virtual bool Unfetch(const Key &key)                      { return false; }
+  virtual void PrefetchLookup(const Key& key) { objects_.Prefetch(key); }
   virtual Value* ReadObject(const Key& key, int64 txn_id = 0);
   virtual bool PutObject(const Key& key, Value* value, int64 txn_id = 0);
   virtual bool DeleteObject(const Key& key, int64 txn_id = 0);
+  virtual bool PutObjects(const vector<pair<Key, Value*> >& objects,
+                          int64 txn_id = 0);
 
   virtual void PrepareForCheckpoint(int64 stable) {}
   virtual int Checkpoint() { return 0; }
-  virtual void Initmutex();
 
- private:
-  unordered_map<Key, Value*> objects_;
-  pthread_mutex_t mutex_;
+  virtual EpochManager* epochs() { return &epochs_; }
 
+ protected:
+  EpochManager epochs_;
+  ConcurrentIndex objects_;
 };
 #endif  // _DB_BACKEND_SIMPLE_STORAGE_H_
 
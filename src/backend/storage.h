@@ -6,12 +6,18 @@
 #ifndef _DB_BACKEND_STORAGE_H_
 #define _DB_BACKEND_STORAGE_H_
 
+#include <utility>
 #include <vector>
 
 #include "common/types.h"
 
+using std::pair;
 using std::vector;
 
+template<typename T> class AtomicQueue;
+class EpochManager;
+class TxnProto;
+
 class Storage {
  public:
   virtual ~Storage() {}
@@ -20,6 +26,31 @@ class Storage {
   // on disk, asynchronously or otherwise.
   virtual bool Prefetch(const Key &key, double* wait_time) = 0;
 
+  // Prefetches the objects 'keys' accessed by 'txn' (those stored here),
+  // starting the loads of those on disk together. Returns true if all of them
+  // are already in memory; otherwise 'txn' is pushed onto '*resident' once
+  // they are. Storages that keep every object in memory need not override
+  // this.
+  virtual bool PrefetchTxn(TxnProto* txn, const vector<Key>& keys,
+                           AtomicQueue<TxnProto*>* resident) {
+    return true;
+  }
+
+  // Issues software prefetches for the memory a ReadObject of 'key' will
+  // touch, without waiting for them, so that reads of a group of objects
+  // (e.g. those of several ready txns) overlap their cache misses. Callers
+  // pin the storage's epochs meanwhile. Storages need not override this.
+  virtual void PrefetchLookup(const Key& key) {}
+
+  // Hints that 'key' is accessed by far more txns than most keys (e.g.
+  // TPC-C's warehouses and districts), so that the storage may keep it apart
+  // from the rest as a hot record (see ReadObjectOrRecord). Applications hint
+  // while loading the database, once the object is put, and only for objects
+  // holding fixed-layout records (see RecordOf in common/types.h). Returns
+  // true if the storage takes the hint; storages that keep every key alike
+  // ignore it.
+  virtual bool MarkHot(const Key& key) { return false; }
+
   // Unfetch object on memory, writing it off to disk, asynchronously or
   // otherwise.
   virtual bool Unfetch(const Key &key) = 0;
@@ -28,20 +59,80 @@ class Storage {
   // and returns true. If the object does not exist, false is returned.
   virtual Value* ReadObject(const Key& key, int64 txn_id = 0) = 0;
 
+  // Like ReadObject, but for a txn that is about to modify the returned
+  // object in place. Storages that keep older versions (e.g. for a checkpoint
+  // in progress) preserve them before handing out the object.
+  virtual Value* ReadObjectForUpdate(const Key& key, int64 txn_id = 0) {
+    return ReadObject(key, txn_id);
+  }
+
+  // Like ReadObject, or ReadObjectForUpdate if 'for_update' is true, except
+  // for hot records (see MarkHot) that the storage keeps as bytes in place
+  // rather than as Values: for those it returns NULL, sets '*record' to the
+  // record's bytes, which txns read and modify in place, and '*size' to
+  // their number. Otherwise '*record' is set to NULL. Storages without hot
+  // records need not override this.
+  virtual Value* ReadObjectOrRecord(const Key& key, int64 txn_id,
+                                    bool for_update, char** record,
+                                    int* size) {
+    *record = NULL;
+    return for_update ? ReadObjectForUpdate(key, txn_id) :
+                        ReadObject(key, txn_id);
+  }
+
   // Sets the object specified by 'key' equal to 'value'. Any previous version
   // of the object is replaced. Returns true if the write succeeds, or false if
   // it fails for any reason.
   virtual bool PutObject(const Key& key, Value* value, int64 txn_id = 0) = 0;
 
+  // Sets every (key, value) pair of 'objects', e.g. when loading the initial
+  // database. Storages with a cheaper bulk-insert path override this.
+  virtual bool PutObjects(const vector<pair<Key, Value*> >& objects,
+                          int64 txn_id = 0) {
+    bool success = true;
+    for (uint32 i = 0; i < objects.size(); i++)
+      success = PutObject(objects[i].first, objects[i].second, txn_id) &&
+                success;
+    return success;
+  }
+
   // Removes the object specified by 'key' if there is one. Returns true if the
   // deletion succeeds (or if no object is found with the specified key), or
   // false if it fails for any reason.
   virtual bool DeleteObject(const Key& key, int64 txn_id = 0) = 0;
 
-  // TODO(Thad): Something here
+  // Appends the objects whose keys lie in ['start', 'end') to '*results' in
+  // key order, at most 'limit' of them unless 'limit' is negative, and
+  // returns true. An empty 'end' means no upper bound. Storages that do not
+  // keep objects ordered by key return false.
+  virtual bool Scan(const Key& start, const Key& end, int limit,
+                    vector<pair<Key, Value*> >* results, int64 txn_id = 0) {
+    return false;
+  }
+
+  // Checkpointing: PrepareForCheckpoint marks txn 'stable' as the point the
+  // next checkpoint captures; it must be called before any later txn
+  // executes. Checkpoint starts capturing in the background once every txn
+  // up to 'stable' has completed. CheckpointInProgress returns true from
+  // PrepareForCheckpoint until the capture is on disk. Storages that do not
+  // support checkpoints ignore all of this.
   virtual void PrepareForCheckpoint(int64 stable) {}
   virtual int Checkpoint() { return 0; }
+  virtual bool CheckpointInProgress() { return false; }
   virtual void Initmutex() {}
+
+  // Snapshot reads: once EnableSnapshotReads returns true, every later write
+  // keeps the version it supersedes, so that txns can read the state as of
+  // any txn id no older than the last horizon passed to SetSnapshotHorizon
+  // (by passing that id as 'txn_id') without taking locks. Versions no such
+  // read can see may be dropped. Storages that keep no versions return false.
+  virtual bool EnableSnapshotReads() { return false; }
+  virtual void SetSnapshotHorizon(int64 horizon) {}
+
+  // Threads that use objects read from the storage pin its EpochManager (see
+  // backend/epoch_manager.h) for as long as they do, if it has one: replaced
+  // objects and versions are freed only once no pin may hold them.
+  virtual EpochManager* epochs() { return NULL; }
 };
 
 #endif  // _DB_BACKEND_STORAGE_H_
@@ -5,6 +5,7 @@
 
 #include <ucontext.h>
 
+#include "backend/epoch_manager.h"
 #include "backend/storage.h"
 #include "common/configuration.h"
 #include "common/connection.h"
@@ -13,10 +14,25 @@
 #include "proto/message.pb.h"
 
 StorageManager::StorageManager(Configuration* config, Connection* connection,
-                               Storage* actual_storage, TxnProto* txn)
+                               Storage* actual_storage, TxnProto* txn,
+                               Arena* arena)
     : configuration_(config), connection_(connection),
-      actual_storage_(actual_storage), txn_(txn) {
-  MessageProto message;
+      actual_storage_(actual_storage), txn_(txn),
+      arena_(arena != NULL ? arena : &own_arena_),
+      reads_(txn->read_set_size() + txn->read_write_set_size()),
+      received_(0), epochs_(actual_storage->epochs()), epoch_(0) {
+  if (epochs_ != NULL)
+    epoch_ = epochs_->Pin();
+  values_ = reinterpret_cast<Value**>(
+      arena_->Allocate(reads_ * sizeof(values_[0])));
+  records_ = reinterpret_cast<char**>(
+      arena_->Allocate(reads_ * sizeof(records_[0])));
+  record_sizes_ = reinterpret_cast<int*>(
+      arena_->Allocate(reads_ * sizeof(record_sizes_[0])));
+  for (int i = 0; i < reads_; i++) {
+    values_[i] = NULL;
+    records_[i] = NULL;
+  }
 
   // If reads are performed at this node, execute local reads and broadcast
   // results to all (other) writers.
@@ -27,33 +43,68 @@ StorageManager::StorageManager(Configuration* config, Connection* connection,
   }
 
   if (reader) {
+    // The local reads are only copied into a message if other writers need
+    // them, so that single-partition txns do not touch the objects' contents
+    // before executing.
+    bool remote_writers = false;
+    for (int i = 0; i < txn->writers_size(); i++) {
+      if (txn->writers(i) != configuration_->this_node_id)
+        remote_writers = true;
+    }
+    MessageProto& message = *arena_->NewMessage<MessageProto>();
     message.set_destination_channel(IntToString(txn->txn_id()));
     message.set_type(MessageProto::READ_RESULT);
 
-    // Execute local reads.
+    // Execute local reads (as of the snapshot for txns at SNAPSHOT
+    // isolation, which hold no locks).
+    int64 version = txn->isolation_level() == TxnProto::SNAPSHOT ?
+                    txn->snapshot() : txn->txn_id();
     for (int i = 0; i < txn->read_set_size(); i++) {
       const Key& key = txn->read_set(i);
       if (configuration_->LookupPartition(key) ==
           configuration_->this_node_id) {
-        Value* val = actual_storage_->ReadObject(key);
-        objects_[key] = val;
-        message.add_keys(key);
-        message.add_values(val == NULL ? "" : *val);
+        Value* val = actual_storage_->ReadObjectOrRecord(
+            key, version, false, &records_[i], &record_sizes_[i]);
+        if (val != NULL)
+          __builtin_prefetch(val);
+        values_[i] = val;
+        received_++;
+        if (remote_writers) {
+          message.add_positions(i);
+          if (records_[i] != NULL)
+            message.add_values(records_[i], record_sizes_[i]);
+          else
+            message.add_values(val == NULL ? "" : *val);
+        }
       }
     }
     for (int i = 0; i < txn->read_write_set_size(); i++) {
       const Key& key = txn->read_write_set(i);
       if (configuration_->LookupPartition(key) ==
           configuration_->this_node_id) {
-        Value* val = actual_storage_->ReadObject(key);
-        objects_[key] = val;
-        message.add_keys(key);
-        message.add_values(val == NULL ? "" : *val);
+        // The txn may modify this value in place.
+        int position = txn->read_set_size() + i;
+        Value* val = actual_storage_->ReadObjectOrRecord(
+            key, txn->txn_id(), true, &records_[position],
+            &record_sizes_[position]);
+        if (val != NULL)
+          __builtin_prefetch(val);
+        values_[position] = val;
+        received_++;
+        if (remote_writers) {
+          message.add_positions(position);
+          if (records_[position] != NULL)
+            message.add_values(records_[position], record_sizes_[position]);
+          else
+            message.add_values(val == NULL ? "" : *val);
+        }
       }
     }
 
-    // Broadcast local reads to (other) writers.
-    for (int i = 0; i < txn->writers_size(); i++) {
+    // Broadcast local reads to (other) writers. Nodes that only hold part of
+    // a scanned range have none to send.
+    for (int i = 0; i < txn->writers_size() && message.positions_size() > 0;
+         i++) {
       if (txn->writers(i) != configuration_->this_node_id) {
         message.set_destination_node(txn->writers(i));
         connection_->Send1(message);
@@ -73,28 +124,46 @@ StorageManager::StorageManager(Configuration* config, Connection* connection,
 
 void StorageManager::HandleReadResult(const MessageProto& message) {
   assert(message.type() == MessageProto::READ_RESULT);
-  for (int i = 0; i < message.keys_size(); i++) {
-    Value* val = new Value(message.values(i));
-    objects_[message.keys(i)] = val;
-    remote_reads_.push_back(val);
+  for (int i = 0; i < message.positions_size(); i++) {
+    values_[message.positions(i)] = arena_->New<Value>(message.values(i));
+    received_++;
   }
 }
 
 bool StorageManager::ReadyToExecute() {
-  return static_cast<int>(objects_.size()) ==
-         txn_->read_set_size() + txn_->read_write_set_size();
+  return received_ == reads_;
+}
+
+void StorageManager::PrefetchReads() {
+  for (int i = 0; i < reads_; i++) {
+    if (records_[i] != NULL)
+      __builtin_prefetch(records_[i]);
+    else if (values_[i] != NULL)
+      __builtin_prefetch(values_[i]->data());
+  }
 }
 
 StorageManager::~StorageManager() {
   //delete txn_;
-  for (vector<Value*>::iterator it = remote_reads_.begin();
-       it != remote_reads_.end(); ++it) {
-    delete *it;
+  if (epochs_ != NULL)
+    epochs_->Unpin(epoch_);
+}
+
+int StorageManager::Position(const Key& key) {
+  for (int i = 0; i < txn_->read_set_size(); i++) {
+    if (txn_->read_set(i) == key)
+      return i;
   }
+  for (int i = 0; i < txn_->read_write_set_size(); i++) {
+    if (txn_->read_write_set(i) == key)
+      return txn_->read_set_size() + i;
+  }
+  return -1;
 }
 
 Value* StorageManager::ReadObject(const Key& key) {
-  return objects_[key];
+  int i = Position(key);
+  return (i < 0) ? NULL : ReadAt(i);
 }
 
 bool StorageManager::PutObject(const Key& key, Value* value) {
@@ -113,3 +182,11 @@ bool StorageManager::DeleteObject(const Key& key) {
     return true;  // Not this node's problem.
 }
 
+bool StorageManager::Scan(const Key& start, const Key& end, int limit,
+                          vector<pair<Key, Value*> >* results) {
+  set<int> nodes;
+  configuration_->LookupRangePartitions(start, end, &nodes);
+  if (nodes.count(configuration_->this_node_id) == 0)
+    return false;
+  return actual_storage_->Scan(start, end, limit, results, txn_->txn_id());
+}
@@ -24,16 +24,20 @@
 
 #include <tr1/unordered_map>
 //#include <unordered_map>
+#include <utility>
 #include <vector>
 
+#include "common/arena.h"
 #include "common/types.h"
 
+using std::pair;
 using std::vector;
 using std::tr1::unordered_map;
 //using std::unordered_map;
 
 class Configuration;
 class Connection;
+class EpochManager;
 class MessageProto;
 class Scheduler;
 class Storage;
@@ -42,20 +46,79 @@ class TxnProto;
 class StorageManager {
  public:
   // TODO(alex): Document this class correctly.
+  //
+  // The txn's transient objects, including the manager's own bookkeeping,
+  // are allocated from 'arena' (see common/arena.h), which must outlive the
+  // manager. Without one, the manager uses an arena of its own.
   StorageManager(Configuration* config, Connection* connection,
-                 Storage* actual_storage, TxnProto* txn);
+                 Storage* actual_storage, TxnProto* txn, Arena* arena = NULL);
 
   ~StorageManager();
 
+  // Returns the object read at position 'i' of the txn's reads: its read
+  // set followed by its read-write set, i.e. key 'read_set(i)' for 'i' less
+  // than 'read_set_size()' and 'read_write_set(i - read_set_size())' after.
+  // For a hot record (see Storage::ReadObjectOrRecord) this is a copy in the
+  // arena: updates go through ReadRecordAt or PutObject.
+  Value* ReadAt(int i) {
+    if (values_[i] == NULL && records_[i] != NULL)
+      values_[i] = arena_->New<Value>(records_[i], record_sizes_[i]);
+    return values_[i];
+  }
+
+  // Returns the object read under 'key', searching the txn's reads for it.
+  // Applications that know where 'key' appears in them use ReadAt instead.
   Value* ReadObject(const Key& key);
   bool PutObject(const Key& key, Value* value);
   bool DeleteObject(const Key& key);
 
+  // Appends the objects of this node whose keys lie in ['start', 'end') to
+  // '*results' in key order, at most 'limit' of them unless 'limit' is
+  // negative. The txn must have declared the range in its 'range_start' and
+  // 'range_end' so that it is locked. Returns false if no key in the range is
+  // stored at this partition or the storage cannot scan.
+  bool Scan(const Key& start, const Key& end, int limit,
+            vector<pair<Key, Value*> >* results);
+
+  // Typed access to objects stored as fixed-layout records (see RecordOf in
+  // common/types.h). ReadRecord returns the record in place (including hot
+  // records), so updates to its fields need no PutRecord; it returns NULL if
+  // 'key' holds no record of type T.
+  template<typename T>
+  T* ReadRecord(const Key& key) {
+    int i = Position(key);
+    return (i < 0) ? NULL : ReadRecordAt<T>(i);
+  }
+  template<typename T>
+  T* ReadRecordAt(int i) {
+    if (records_[i] != NULL) {
+      return (record_sizes_[i] == sizeof(T)) ?
+             reinterpret_cast<T*>(records_[i]) : NULL;
+    }
+    return RecordOf<T>(values_[i]);
+  }
+  template<typename T>
+  bool PutRecord(const Key& key, const T& record) {
+    return PutObject(key, NewRecordValue(record));
+  }
+
   void HandleReadResult(const MessageProto& message);
   bool ReadyToExecute();
 
+  // Issues software prefetches for the contents of the objects read at this
+  // node. The constructor already prefetches the objects themselves, so
+  // workers that start several txns together call this once all their
+  // managers are constructed, before executing the first.
+  void PrefetchReads();
+
   Storage* GetStorage() { return actual_storage_; }
 
+  // The arena of the txn's transient objects, freed in bulk when the txn
+  // completes. Applications allocate the objects they only need while
+  // executing the txn here (e.g. with New or NewMessage) instead of on the
+  // heap.
+  Arena* arena() { return arena_; }
+
   // Set by the constructor, indicating whether 'txn' involves any writes at
   // this node.
   bool writer;
@@ -75,14 +138,31 @@ class StorageManager {
   // Transaction that corresponds to this instance of a StorageManager.
   TxnProto* txn_;
 
-  // Local copy of all data objects read/written by 'txn_', populated at
-  // StorageManager construction time.
-  //
-  // TODO(alex): Should these be pointers to reduce object copying overhead?
-  unordered_map<Key, Value*> objects_;
-
-  vector<Value*> remote_reads_;
-
+  // Arena of the txn's transient objects: 'own_arena_' unless the
+  // constructor was given one.
+  Arena own_arena_;
+  Arena* arena_;
+
+  // The objects read by 'txn_', by position (see ReadAt), and how many of
+  // the positions have been filled. Local reads are filled at construction
+  // time and remote ones by HandleReadResult, copied into the arena.
+  Value** values_;
+  int reads_;
+  int received_;
+
+  // The bytes and sizes of the local reads the storage keeps as hot records
+  // in place (see Storage::ReadObjectOrRecord), by position; NULL elsewhere.
+  char** records_;
+  int* record_sizes_;
+
+  // Returns the position of 'key' among the txn's reads, or -1.
+  int Position(const Key& key);
+
+  // The storage's epochs (if it has any), pinned from before the local
+  // reads until the manager is deleted, so that the objects read stay valid.
+  // The manager must be deleted by the thread that created it.
+  EpochManager* epochs_;
+  int64 epoch_;
 };
 
 #endif  // _DB_BACKEND_STORAGE_MANAGER_H_
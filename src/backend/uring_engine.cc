@@ -0,0 +1,278 @@
+// Author: Kun Ren (kun.ren@yale.edu)
+//
+// An asynchronous block I/O engine over Linux io_uring (see uring_engine.h).
+
+#include "backend/uring_engine.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+static int SetupRing(uint32 entries, io_uring_params* params) {
+  return syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int EnterRing(int ring_fd, uint32 to_submit, uint32 min_complete,
+                     uint32 flags) {
+  return syscall(__NR_io_uring_enter, ring_fd, to_submit, min_complete, flags,
+                 NULL, 0);
+}
+
+static int RegisterWithRing(int ring_fd, uint32 opcode, void* arg,
+                            uint32 count) {
+  return syscall(__NR_io_uring_register, ring_fd, opcode, arg, count);
+}
+
+UringEngine::UringEngine()
+    : ring_fd_(-1), file_fd_(-1), block_size_(0), sq_ring_(NULL),
+      sq_ring_size_(0), sqes_(NULL), sqes_size_(0), cq_ring_(NULL),
+      cq_ring_size_(0), queued_(0), buffer_memory_(NULL) {
+  pthread_mutex_init(&buffer_mutex_, NULL);
+  pthread_cond_init(&buffer_freed_, NULL);
+}
+
+UringEngine::~UringEngine() {
+  if (ring_fd_ >= 0) {
+    // A request without a completion stops the completion thread once
+    // everything submitted before it has completed.
+    {
+      Lock l(&submit_mutex_);
+      Queue(IORING_OP_NOP, 0, -1, NULL);
+      SubmitLocked();
+    }
+    pthread_join(completion_thread_, NULL);
+
+    munmap(sqes_, sqes_size_);
+    if (cq_ring_ != sq_ring_)
+      munmap(cq_ring_, cq_ring_size_);
+    munmap(sq_ring_, sq_ring_size_);
+    close(ring_fd_);
+  }
+  if (file_fd_ >= 0)
+    close(file_fd_);
+  free(buffer_memory_);
+  pthread_mutex_destroy(&buffer_mutex_);
+  pthread_cond_destroy(&buffer_freed_);
+}
+
+bool UringEngine::Open(const string& path, int depth, int buffers,
+                       int block_size, bool direct_io) {
+  if (direct_io) {
+    file_fd_ = open(path.c_str(), O_RDWR | O_CREAT | O_DIRECT, 0644);
+    if (file_fd_ < 0) {
+      // Not every file system supports O_DIRECT (e.g. tmpfs).
+      printf("UringEngine: O_DIRECT unavailable for %s, using buffered I/O\n",
+             path.c_str());
+    }
+  }
+  if (file_fd_ < 0)
+    file_fd_ = open(path.c_str(), O_RDWR | O_CREAT, 0644);
+  if (file_fd_ < 0) {
+    perror(path.c_str());
+    return false;
+  }
+
+  io_uring_params params;
+  memset(&params, 0, sizeof(params));
+  ring_fd_ = SetupRing(depth, &params);
+  if (ring_fd_ < 0) {
+    perror("io_uring_setup");
+    return false;
+  }
+
+  // Map the rings and the submission queue entries.
+  sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(uint32);
+  cq_ring_size_ = params.cq_off.cqes +
+                  params.cq_entries * sizeof(io_uring_cqe);
+  bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+  if (single_mmap && cq_ring_size_ > sq_ring_size_)
+    sq_ring_size_ = cq_ring_size_;
+  sq_ring_ = mmap(NULL, sq_ring_size_, PROT_READ | PROT_WRITE,
+                  MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQ_RING);
+  if (sq_ring_ == MAP_FAILED) {
+    perror("mmap");
+    close(ring_fd_);
+    ring_fd_ = -1;
+    return false;
+  }
+  if (single_mmap) {
+    cq_ring_ = sq_ring_;
+    cq_ring_size_ = sq_ring_size_;
+  } else {
+    cq_ring_ = mmap(NULL, cq_ring_size_, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_CQ_RING);
+  }
+  sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+  void* sqes = mmap(NULL, sqes_size_, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQES);
+  if (cq_ring_ == MAP_FAILED || sqes == MAP_FAILED) {
+    perror("mmap");
+    if (cq_ring_ != MAP_FAILED && cq_ring_ != sq_ring_)
+      munmap(cq_ring_, cq_ring_size_);
+    munmap(sq_ring_, sq_ring_size_);
+    close(ring_fd_);
+    ring_fd_ = -1;
+    return false;
+  }
+
+  char* sq = reinterpret_cast<char*>(sq_ring_);
+  sq_head_ = reinterpret_cast<volatile uint32*>(sq + params.sq_off.head);
+  sq_tail_ = reinterpret_cast<volatile uint32*>(sq + params.sq_off.tail);
+  sq_mask_ = *reinterpret_cast<uint32*>(sq + params.sq_off.ring_mask);
+  sq_entries_ = *reinterpret_cast<uint32*>(sq + params.sq_off.ring_entries);
+  sq_array_ = reinterpret_cast<uint32*>(sq + params.sq_off.array);
+  sqes_ = reinterpret_cast<io_uring_sqe*>(sqes);
+
+  char* cq = reinterpret_cast<char*>(cq_ring_);
+  cq_head_ = reinterpret_cast<volatile uint32*>(cq + params.cq_off.head);
+  cq_tail_ = reinterpret_cast<volatile uint32*>(cq + params.cq_off.tail);
+  cq_mask_ = *reinterpret_cast<uint32*>(cq + params.cq_off.ring_mask);
+  cqes_ = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+
+  // Register the file and the buffers.
+  block_size_ = block_size;
+  if (posix_memalign(reinterpret_cast<void**>(&buffer_memory_), 4096,
+                     static_cast<size_t>(buffers) * block_size) != 0) {
+    perror("posix_memalign");
+    exit(EXIT_FAILURE);
+  }
+  vector<iovec> iovecs(buffers);
+  for (int i = 0; i < buffers; i++) {
+    iovecs[i].iov_base = Buffer(i);
+    iovecs[i].iov_len = block_size;
+    free_buffers_.push_back(buffers - 1 - i);
+  }
+  if (RegisterWithRing(ring_fd_, IORING_REGISTER_FILES, &file_fd_, 1) < 0 ||
+      RegisterWithRing(ring_fd_, IORING_REGISTER_BUFFERS, &iovecs[0],
+                       buffers) < 0) {
+    perror("io_uring_register");
+    munmap(sqes_, sqes_size_);
+    if (cq_ring_ != sq_ring_)
+      munmap(cq_ring_, cq_ring_size_);
+    munmap(sq_ring_, sq_ring_size_);
+    close(ring_fd_);
+    ring_fd_ = -1;
+    return false;
+  }
+
+  pthread_create(&completion_thread_, NULL, RunCompletionThread, this);
+  return true;
+}
+
+int UringEngine::AcquireBuffer() {
+  pthread_mutex_lock(&buffer_mutex_);
+  if (free_buffers_.empty()) {
+    // The buffers may be held by requests that are only queued.
+    pthread_mutex_unlock(&buffer_mutex_);
+    Submit();
+    pthread_mutex_lock(&buffer_mutex_);
+  }
+  while (free_buffers_.empty())
+    pthread_cond_wait(&buffer_freed_, &buffer_mutex_);
+  int buffer = free_buffers_.back();
+  free_buffers_.pop_back();
+  pthread_mutex_unlock(&buffer_mutex_);
+  return buffer;
+}
+
+void UringEngine::ReleaseBuffer(int buffer) {
+  pthread_mutex_lock(&buffer_mutex_);
+  free_buffers_.push_back(buffer);
+  pthread_cond_signal(&buffer_freed_);
+  pthread_mutex_unlock(&buffer_mutex_);
+}
+
+void UringEngine::QueueRead(int64 block, int buffer, Completion* completion) {
+  Lock l(&submit_mutex_);
+  Queue(IORING_OP_READ_FIXED, block, buffer, completion);
+}
+
+void UringEngine::QueueWrite(int64 block, int buffer, Completion* completion) {
+  Lock l(&submit_mutex_);
+  Queue(IORING_OP_WRITE_FIXED, block, buffer, completion);
+}
+
+void UringEngine::Submit() {
+  Lock l(&submit_mutex_);
+  SubmitLocked();
+}
+
+void UringEngine::Queue(int op, int64 block, int buffer,
+                        Completion* completion) {
+  uint32 tail = *sq_tail_;
+  if (tail - *sq_head_ == sq_entries_) {
+    SubmitLocked();
+    tail = *sq_tail_;
+  }
+
+  uint32 index = tail & sq_mask_;
+  io_uring_sqe* sqe = &sqes_[index];
+  memset(sqe, 0, sizeof(*sqe));
+  sqe->opcode = op;
+  sqe->user_data = reinterpret_cast<uint64>(completion);
+  if (op == IORING_OP_NOP) {
+    // Completes after every request submitted before it.
+    sqe->flags = IOSQE_IO_DRAIN;
+  } else {
+    // File 0 of the registered files.
+    sqe->flags = IOSQE_FIXED_FILE;
+    sqe->fd = 0;
+    sqe->off = block * block_size_;
+    sqe->addr = reinterpret_cast<uint64>(Buffer(buffer));
+    sqe->len = block_size_;
+    sqe->buf_index = buffer;
+  }
+  sq_array_[index] = index;
+
+  // The kernel must see the entry before the new tail.
+  __sync_synchronize();
+  *sq_tail_ = tail + 1;
+  queued_++;
+}
+
+void UringEngine::SubmitLocked() {
+  while (queued_ > 0) {
+    int submitted = EnterRing(ring_fd_, queued_, 0, 0);
+    if (submitted < 0) {
+      if (errno == EINTR || errno == EAGAIN || errno == EBUSY)
+        continue;
+      perror("io_uring_enter");
+      exit(EXIT_FAILURE);
+    }
+    queued_ -= submitted;
+  }
+}
+
+void* UringEngine::RunCompletionThread(void* arg) {
+  UringEngine* engine = reinterpret_cast<UringEngine*>(arg);
+  while (true) {
+    uint32 head = *engine->cq_head_;
+    uint32 tail = *engine->cq_tail_;
+    if (head == tail) {
+      // Sleep in the kernel until a request completes.
+      EnterRing(engine->ring_fd_, 0, 1, IORING_ENTER_GETEVENTS);
+      continue;
+    }
+    __sync_synchronize();
+
+    for (; head != tail; head++) {
+      io_uring_cqe* cqe = &engine->cqes_[head & engine->cq_mask_];
+      Completion* completion = reinterpret_cast<Completion*>(cqe->user_data);
+      int result = cqe->res;
+      // Hand the entry back to the kernel before running the completion.
+      __sync_synchronize();
+      *engine->cq_head_ = head + 1;
+      if (completion == NULL)
+        return NULL;
+      completion->Complete(result);
+    }
+  }
+  return NULL;
+}
@@ -0,0 +1,127 @@
+// Author: Kun Ren (kun.ren@yale.edu)
+//
+// An asynchronous block I/O engine over Linux io_uring, used by LogStore to
+// move cold records between memory and disk.
+//
+// The engine reads and writes fixed-size blocks of a single file. The file
+// and a pool of page-aligned block buffers are registered with the kernel
+// once, so requests carry neither a file descriptor lookup nor a buffer
+// mapping. Requests are queued without a system call and submitted together
+// by Submit, so a txn's cold records cost one io_uring_enter however many of
+// them there are. A dedicated thread sleeps in the kernel until requests
+// complete and runs their completions; nothing polls.
+//
+// The kernel interface is used directly through its system calls, so no
+// library beyond the kernel headers is needed.
+
+#ifndef _DB_BACKEND_URING_ENGINE_H_
+#define _DB_BACKEND_URING_ENGINE_H_
+
+#include <pthread.h>
+
+#include <string>
+#include <vector>
+
+#include "common/types.h"
+#include "common/utils.h"
+
+using std::string;
+using std::vector;
+
+struct io_uring_cqe;
+struct io_uring_sqe;
+
+class UringEngine {
+ public:
+  // Completion of a request, run on the engine's completion thread with the
+  // number of bytes transferred or a negative errno.
+  class Completion {
+   public:
+    virtual ~Completion() {}
+    virtual void Complete(int result) = 0;
+  };
+
+  UringEngine();
+  ~UringEngine();
+
+  // Opens (creating it if needed) the file at 'path', sets up a ring of
+  // 'depth' entries and 'buffers' registered buffers of 'block_size' bytes
+  // each, and starts the completion thread. With 'direct_io' the file is
+  // opened with O_DIRECT where the file system supports it, so blocks bypass
+  // the page cache ('block_size' must then be a multiple of the device's
+  // sector size). Returns false if the file cannot be opened or the kernel
+  // does not support io_uring.
+  bool Open(const string& path, int depth, int buffers, int block_size,
+            bool direct_io);
+
+  // Takes a registered buffer from the pool, waiting (after submitting any
+  // queued requests) while every buffer is in use.
+  int AcquireBuffer();
+
+  // Returns a buffer to the pool.
+  void ReleaseBuffer(int buffer);
+
+  char* Buffer(int buffer) { return buffer_memory_ + buffer * block_size_; }
+  int block_size() const { return block_size_; }
+
+  // Queue a read of block 'block' of the file into 'buffer', or a write of
+  // 'buffer' to it. 'completion' runs once the request completes. Requests
+  // are not started before the next Submit.
+  void QueueRead(int64 block, int buffer, Completion* completion);
+  void QueueWrite(int64 block, int buffer, Completion* completion);
+
+  // Starts every queued request with one system call.
+  void Submit();
+
+ private:
+  // Queues a request with opcode 'op', submitting the queue first if it is
+  // full. Requires 'submit_mutex_'.
+  void Queue(int op, int64 block, int buffer, Completion* completion);
+
+  // Submits the queued requests. Requires 'submit_mutex_'.
+  void SubmitLocked();
+
+  static void* RunCompletionThread(void* arg);
+
+  int ring_fd_;
+  int file_fd_;
+  int block_size_;
+
+  // Submission queue ring, shared with the kernel.
+  void* sq_ring_;
+  size_t sq_ring_size_;
+  volatile uint32* sq_head_;
+  volatile uint32* sq_tail_;
+  uint32 sq_mask_;
+  uint32 sq_entries_;
+  uint32* sq_array_;
+  io_uring_sqe* sqes_;
+  size_t sqes_size_;
+
+  // Completion queue ring, shared with the kernel (and mapped together with
+  // the submission ring if the kernel supports it).
+  void* cq_ring_;
+  size_t cq_ring_size_;
+  volatile uint32* cq_head_;
+  volatile uint32* cq_tail_;
+  uint32 cq_mask_;
+  io_uring_cqe* cqes_;
+
+  // Requests queued since the last submission.
+  uint32 queued_;
+  Mutex submit_mutex_;
+
+  // Registered buffers and the ones not in use.
+  char* buffer_memory_;
+  vector<int> free_buffers_;
+  pthread_mutex_t buffer_mutex_;
+  pthread_cond_t buffer_freed_;
+
+  pthread_t completion_thread_;
+
+  // DISALLOW_COPY_AND_ASSIGN
+  UringEngine(const UringEngine&);
+  UringEngine& operator=(const UringEngine&);
+};
+
+#endif  // _DB_BACKEND_URING_ENGINE_H_
@@ -0,0 +1,70 @@
+// Author: Kun Ren (kun.ren@yale.edu)
+//
+// A region allocator for objects that all die at the same time (see
+// arena.h).
+
+#include "common/arena.h"
+
+#include <stdlib.h>
+
+Arena::Arena()
+    : block_(-1), block_start_(NULL), next_(NULL), end_(NULL), allocated_(0),
+      messages_(NULL) {
+}
+
+Arena::~Arena() {
+  Reset();
+  for (uint32 i = 0; i < blocks_.size(); i++)
+    free(blocks_[i]);
+}
+
+void* Arena::AllocateSlow(size_t size) {
+  if (size > ARENA_BLOCK_SIZE / 4) {
+    char* block = reinterpret_cast<char*>(malloc(size));
+    large_blocks_.push_back(block);
+    allocated_ += size;
+    return block;
+  }
+
+  // Move on to the next block, allocating it the first time round.
+  allocated_ += next_ - block_start_;
+  block_++;
+  if (block_ == static_cast<int>(blocks_.size()))
+    blocks_.push_back(reinterpret_cast<char*>(malloc(ARENA_BLOCK_SIZE)));
+  block_start_ = blocks_[block_];
+  next_ = block_start_ + size;
+  end_ = block_start_ + ARENA_BLOCK_SIZE;
+  return block_start_;
+}
+
+google::protobuf::Arena* Arena::Messages() {
+  if (messages_ == NULL) {
+    google::protobuf::ArenaOptions options;
+    options.initial_block =
+        reinterpret_cast<char*>(Allocate(ARENA_MESSAGE_BLOCK_SIZE));
+    options.initial_block_size = ARENA_MESSAGE_BLOCK_SIZE;
+    messages_ = New<google::protobuf::Arena>(options);
+  }
+  return messages_;
+}
+
+void Arena::Reset() {
+  for (int i = destructors_.size() - 1; i >= 0; i--)
+    destructors_[i].destroy(destructors_[i].object);
+  destructors_.clear();
+  messages_ = NULL;
+
+  for (uint32 i = 0; i < large_blocks_.size(); i++)
+    free(large_blocks_[i]);
+  large_blocks_.clear();
+
+  allocated_ = 0;
+  if (blocks_.empty()) {
+    block_ = -1;
+    block_start_ = next_ = end_ = NULL;
+  } else {
+    block_ = 0;
+    block_start_ = next_ = blocks_[0];
+    end_ = blocks_[0] + ARENA_BLOCK_SIZE;
+  }
+}
@@ -0,0 +1,172 @@
+// Author: Kun Ren (kun.ren@yale.edu)
+//
+// A region allocator for objects that all die at the same time, such as the
+// transient objects of one txn's execution (its StorageManager, remote read
+// results and argument messages).
+//
+// Allocation bumps a pointer through blocks of ARENA_BLOCK_SIZE bytes. Reset
+// frees everything at once: it runs the destructors of the objects created
+// with New, in reverse order of creation, and rewinds to the first block.
+// Blocks are kept for reuse, so an arena that is reset after every txn stops
+// calling malloc once it has grown to fit the txn. Allocations larger than a
+// quarter block get blocks of their own, which Reset frees.
+//
+// Protocol buffer messages created with NewMessage live on a protobuf arena
+// whose first block is carved out of this one, so that their fields (repeated
+// fields, strings) come from the region as well.
+//
+// Arenas are not thread-safe: each worker thread uses its own.
+
+#ifndef _DB_COMMON_ARENA_H_
+#define _DB_COMMON_ARENA_H_
+
+#include <google/protobuf/arena.h>
+#include <stddef.h>
+
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "common/types.h"
+
+using std::vector;
+
+// Size of an arena's blocks.
+#define ARENA_BLOCK_SIZE 16384
+
+// Size of the first block of the protobuf arena of an arena's messages.
+#define ARENA_MESSAGE_BLOCK_SIZE 2048
+
+class Arena {
+ public:
+  Arena();
+  ~Arena();
+
+  // Returns 'size' bytes aligned for any type.
+  void* Allocate(size_t size) {
+    size = (size + kAlignment - 1) & ~(kAlignment - 1);
+    if (size > static_cast<size_t>(end_ - next_))
+      return AllocateSlow(size);
+    void* memory = next_;
+    next_ += size;
+    return memory;
+  }
+
+  // Constructs a T in the arena, to be destroyed by Reset.
+  template<typename T, typename... Args>
+  T* New(Args&&... args) {
+    T* object = new (Allocate(sizeof(T))) T(std::forward<Args>(args)...);
+    if (!std::is_trivially_destructible<T>::value)
+      destructors_.push_back(Destructor(&Destroy<T>, object));
+    return object;
+  }
+
+  // Creates a protocol buffer message of type T in the arena.
+  template<typename T>
+  T* NewMessage() {
+    return google::protobuf::Arena::CreateMessage<T>(Messages());
+  }
+
+  // Destroys every object created in the arena and frees its memory for
+  // reuse.
+  void Reset();
+
+  // Number of bytes handed out since the last Reset.
+  size_t allocated() const { return allocated_ + (next_ - block_start_); }
+
+ private:
+  static const size_t kAlignment = 16;
+
+  struct Destructor {
+    Destructor(void (*d)(void*), void* o) : destroy(d), object(o) {}
+    void (*destroy)(void*);
+    void* object;
+  };
+
+  template<typename T>
+  static void Destroy(void* object) { static_cast<T*>(object)->~T(); }
+
+  // Allocates from the next block, or from a block of its own if 'size' is
+  // large.
+  void* AllocateSlow(size_t size);
+
+  // Returns the protobuf arena of this arena's messages, creating it if
+  // needed.
+  google::protobuf::Arena* Messages();
+
+  // Blocks of ARENA_BLOCK_SIZE bytes; 'block_' is the one being allocated
+  // from, between 'next_' and 'end_'.
+  vector<char*> blocks_;
+  int block_;
+  char* block_start_;
+  char* next_;
+  char* end_;
+
+  // Blocks of large allocations.
+  vector<char*> large_blocks_;
+
+  // Bytes handed out from blocks before 'block_'.
+  size_t allocated_;
+
+  vector<Destructor> destructors_;
+  google::protobuf::Arena* messages_;
+
+  // DISALLOW_COPY_AND_ASSIGN
+  Arena(const Arena&);
+  Arena& operator=(const Arena&);
+};
+
+// An STL allocator handing out memory from an Arena, for containers that die
+// with it. Deallocation is a no-op; the memory is reclaimed by Reset.
+template<typename T>
+class ArenaAllocator {
+ public:
+  typedef T value_type;
+  typedef T* pointer;
+  typedef const T* const_pointer;
+  typedef T& reference;
+  typedef const T& const_reference;
+  typedef size_t size_type;
+  typedef ptrdiff_t difference_type;
+
+  template<typename U>
+  struct rebind { typedef ArenaAllocator<U> other; };
+
+  explicit ArenaAllocator(Arena* arena) : arena_(arena) {}
+  template<typename U>
+  ArenaAllocator(const ArenaAllocator<U>& other) : arena_(other.arena()) {}
+
+  pointer allocate(size_type n, const void* hint = 0) {
+    return static_cast<pointer>(arena_->Allocate(n * sizeof(T)));
+  }
+  void deallocate(pointer p, size_type n) {}
+
+  pointer address(reference x) const { return &x; }
+  const_pointer address(const_reference x) const { return &x; }
+  size_type max_size() const { return size_t(-1) / sizeof(T); }
+  void construct(pointer p, const T& value) { new (p) T(value); }
+  template<typename U, typename... Args>
+  void construct(U* p, Args&&... args) {
+    new (p) U(std::forward<Args>(args)...);
+  }
+  void destroy(pointer p) { p->~T(); }
+  template<typename U>
+  void destroy(U* p) { p->~U(); }
+
+  Arena* arena() const { return arena_; }
+
+ private:
+  Arena* arena_;
+};
+
+template<typename T, typename U>
+bool operator==(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) {
+  return a.arena() == b.arena();
+}
+template<typename T, typename U>
+bool operator!=(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) {
+  return a.arena() != b.arena();
+}
+
+#endif  // _DB_COMMON_ARENA_H_
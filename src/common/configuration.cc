@@ -17,7 +17,11 @@
 using std::string;
 
 Configuration::Configuration(int node_id, const string& filename)
-    : this_node_id(node_id) {
+    : this_node_id(node_id), sequencer_mode(EPOCH_SEQUENCING),
+      dissemination_fanout(0), input_log(-1), input_log_dir("../db/log"),
+      input_log_replica(-1), input_log_direct_io(false),
+      checkpoint_interval(0), prefetching(false), prefetch_percentile(99),
+      snapshot_reads(false), first_epoch(0) {
   if (ReadFromFile(filename))  // Reading from file failed.
     exit(0);
 }
@@ -30,6 +34,27 @@ int Configuration::LookupPartition(const Key& key) const {
     return StringToInt(key) % static_cast<int>(all_nodes.size());
 }
 
+void Configuration::LookupRangePartitions(const Key& start, const Key& end,
+                                          set<int>* nodes) const {
+  // A range within one TPC-C warehouse ('start' and 'end' share "w<W>", and
+  // 'start' goes on with a non-digit, so no key in the range has a longer
+  // warehouse number) is stored at that warehouse's partition. Other keys are
+  // partitioned by hash, so other ranges may have keys at every partition.
+  size_t warehouse_end = 1;
+  while (warehouse_end < start.size() && isdigit(start[warehouse_end]))
+    warehouse_end++;
+  if (!start.empty() && start[0] == 'w' && warehouse_end > 1 &&
+      warehouse_end < start.size() && start[warehouse_end] > '9' &&
+      end.size() > warehouse_end &&
+      end.compare(0, warehouse_end, start, 0, warehouse_end) == 0) {
+    nodes->insert(LookupPartition(start));
+    return;
+  }
+  for (map<int, Node*>::const_iterator it = all_nodes.begin();
+       it != all_nodes.end(); ++it)
+    nodes->insert(it->first);
+}
+
 bool Configuration::WriteToFile(const string& filename) const {
   FILE* fp = fopen(filename.c_str(), "w");
   if (fp == NULL)
@@ -45,6 +70,27 @@ bool Configuration::WriteToFile(const string& filename) const {
             node->host.c_str(),
             node->port);
   }
+  if (sequencer_mode == STREAM_SEQUENCING)
+    fprintf(fp, "sequencer_mode=stream\n");
+  if (dissemination_fanout > 0)
+    fprintf(fp, "dissemination_fanout=%d\n", dissemination_fanout);
+  if (input_log >= 0) {
+    const char* durability[] = {"none", "local", "replica"};
+    fprintf(fp, "input_log=%s\n", durability[input_log]);
+    fprintf(fp, "input_log_dir=%s\n", input_log_dir.c_str());
+    if (input_log_replica >= 0)
+      fprintf(fp, "input_log_replica=%d\n", input_log_replica);
+    if (input_log_direct_io)
+      fprintf(fp, "input_log_direct_io=1\n");
+  }
+  if (checkpoint_interval > 0)
+    fprintf(fp, "checkpoint_interval=%d\n", checkpoint_interval);
+  if (prefetching) {
+    fprintf(fp, "prefetching=1\n");
+    fprintf(fp, "prefetch_percentile=%d\n", prefetch_percentile);
+  }
+  if (snapshot_reads)
+    fprintf(fp, "snapshot_reads=1\n");
   fclose(fp);
   return true;
 }
@@ -76,7 +122,39 @@ int Configuration::ReadFromFile(const string& filename) {
 }
 
 void Configuration::ProcessConfigLine(char key[], char value[]) {
-  if (strncmp(key, "node", 4) != 0) {
+  if (strcmp(key, "sequencer_mode") == 0) {
+    if (strcmp(value, "stream") == 0)
+      sequencer_mode = STREAM_SEQUENCING;
+    else if (strcmp(value, "epoch") == 0)
+      sequencer_mode = EPOCH_SEQUENCING;
+    else
+      printf("Unknown sequencer mode in config file: %s\n", value);
+  } else if (strcmp(key, "dissemination_fanout") == 0) {
+    dissemination_fanout = atoi(value);
+  } else if (strcmp(key, "input_log") == 0) {
+    if (strcmp(value, "none") == 0)
+      input_log = 0;
+    else if (strcmp(value, "local") == 0)
+      input_log = 1;
+    else if (strcmp(value, "replica") == 0)
+      input_log = 2;
+    else
+      printf("Unknown input log durability in config file: %s\n", value);
+  } else if (strcmp(key, "input_log_dir") == 0) {
+    input_log_dir = value;
+  } else if (strcmp(key, "input_log_replica") == 0) {
+    input_log_replica = atoi(value);
+  } else if (strcmp(key, "input_log_direct_io") == 0) {
+    input_log_direct_io = atoi(value) != 0;
+  } else if (strcmp(key, "checkpoint_interval") == 0) {
+    checkpoint_interval = atoi(value);
+  } else if (strcmp(key, "prefetching") == 0) {
+    prefetching = atoi(value) != 0;
+  } else if (strcmp(key, "prefetch_percentile") == 0) {
+    prefetch_percentile = atoi(value);
+  } else if (strcmp(key, "snapshot_reads") == 0) {
+    snapshot_reads = atoi(value) != 0;
+  } else if (strncmp(key, "node", 4) != 0) {
 #if VERBOSE
     printf("Unknown key in config file: %s\n", key);
 #endif
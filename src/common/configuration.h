@@ -11,6 +11,19 @@
 //  # Node<id>=<replica>:<partition>:<cores>:<host>:<port>
 //  node13=1:3:16:4.8.15.16:1001:1002
 //  node23=2:3:16:4.8.15.16:1004:1005
+//  # Optional: how sequencers order txns, "epoch" (default) or "stream".
+//  sequencer_mode=stream
+//  # Optional: relay batches through groups of this many nodes (0 = off).
+//  dissemination_fanout=8
+//  # Optional: log sequenced batches, syncing them "none", "local" or to a
+//  # "replica" node before they count as durable (see sequencer/input_log.h).
+//  input_log=replica
+//  input_log_dir=../db/log
+//  input_log_replica=1
+//  input_log_direct_io=1
+//  # Optional: take an asynchronous checkpoint every this many epochs (0 =
+//  # off; needs a storage that supports it, see backend/storage.h).
+//  checkpoint_interval=100
 //
 // Note: Epoch duration, application and other global global options are
 //       specified as command line options at invocation time (see
@@ -22,6 +35,7 @@
 #include <stdint.h>
 
 #include <map>
+#include <set>
 #include <string>
 #include <vector>
 //#include <unordered_map>
@@ -33,26 +47,23 @@
 
 
 using std::map;
+using std::set;
 using std::string;
 using std::vector;
 using std::tr1::unordered_map;
 //using std::unordered_map;
 
-extern map<Key, Key> latest_order_id_for_customer;
-extern map<Key, int> latest_order_id_for_district;
-extern map<Key, int> smallest_order_id_for_district;
-extern map<Key, Key> customer_for_order;
-extern unordered_map<Key, int> next_order_id_for_district;
-extern map<Key, int> item_for_order_line;
-extern map<Key, int> order_line_number;
-
-extern vector<Key>* involed_customers;
-
-extern pthread_mutex_t mutex_;
-extern pthread_mutex_t mutex_for_item;
-
 #define ORDER_LINE_NUMBER 10
 
+// Txn ordering modes. In EPOCH_SEQUENCING mode every sequencer collects txns
+// for an epoch and the schedulers merge the resulting batches. In
+// STREAM_SEQUENCING mode sequencers stream timestamped txns continuously and
+// schedulers order them by timestamp once every origin's watermark has passed.
+enum SequencerMode {
+  EPOCH_SEQUENCING = 0,
+  STREAM_SEQUENCING = 1,
+};
+
 struct Node {
   // Globally unique node identifier.
   int node_id;
@@ -77,6 +88,11 @@ class Configuration {
   // Returns the node_id of the partition at which 'key' is stored.
   int LookupPartition(const Key& key) const;
 
+  // Adds to 'nodes' the node_ids of the partitions that may store keys in the
+  // range ['start', 'end') (an empty 'end' leaves it unbounded).
+  void LookupRangePartitions(const Key& start, const Key& end,
+                             set<int>* nodes) const;
+
   // Dump the current config into the file in key=value format.
   // Returns true when success.
   bool WriteToFile(const string& filename) const;
@@ -87,6 +103,49 @@ class Configuration {
   // Tracks the set of current active nodes in the system.
   map<int, Node*> all_nodes;
 
+  // How txns are ordered (see SequencerMode above).
+  SequencerMode sequencer_mode;
+
+  // If positive, sequencer batches are disseminated through a tree of relays
+  // over groups of this many nodes (see sequencer/batch_relay.h) instead of
+  // being sent directly to every node.
+  int dissemination_fanout;
+
+  // Durability mode of the input log (an InputLog::Durability), or -1 if
+  // sequenced batches are not logged. Segments are written to
+  // 'input_log_dir', copies are sent to node 'input_log_replica' in replica
+  // mode, and segments are opened with O_DIRECT if 'input_log_direct_io'.
+  int input_log;
+  string input_log_dir;
+  int input_log_replica;
+  bool input_log_direct_io;
+
+  // Number of epochs between checkpoints taken by the schedulers while they
+  // keep executing txns (0 = no checkpoints).
+  int checkpoint_interval;
+
+  // If set, the sequencer prefetches the objects of each txn it receives at
+  // every participant, and defers the txn to the first batch expected to
+  // start once the 'prefetch_percentile'th percentile of the participants'
+  // recent prefetch latencies has passed (and its objects here are in
+  // memory). Workers pin a txn's objects at this node while it executes.
+  bool prefetching;
+  int prefetch_percentile;
+
+  // If set, the sequencer tags read-only txns to read the snapshot as of the
+  // end of the epoch before their batch's, and schedulers run them without
+  // locks once every earlier txn has completed locally (if the storage keeps
+  // versions; see Storage::EnableSnapshotReads). Snapshots are labeled by txn
+  // id, so this relies on ids following the order in which txns run (txns
+  // that prefetching defers take ids in the batch that carries them). Not
+  // combined with prefetching.
+  bool snapshot_reads;
+
+  // Epoch at which the sequencer starts numbering batches and the scheduler
+  // starts merging them: 0, or after recovery the first epoch that was not
+  // replayed (see sequencer/replayer.h).
+  int64 first_epoch;
+
  private:
   // TODO(alex): Comments.
   void ProcessConfigLine(char key[], char value[]);
@@ -46,6 +46,20 @@ static inline uint16 UnpackUInt16(bytes s) { return *((uint16*)(s.data())); }
 static inline uint32 UnpackUInt32(bytes s) { return *((uint32*)(s.data())); }
 static inline uint64 UnpackUInt64(bytes s) { return *((uint64*)(s.data())); }
 
+// Convenience functions for fixed-layout (POD) records stored as the raw bytes
+// of a 'bytes' object. RecordOf returns the record held in place by '*value',
+// or NULL unless '*value' holds exactly one record of type T.
+template<typename T>
+static inline T* RecordOf(bytes* value) {
+  if (value == NULL || value->size() != sizeof(T))
+    return NULL;
+  return reinterpret_cast<T*>(&(*value)[0]);
+}
+template<typename T>
+static inline bytes* NewRecordValue(const T& record) {
+  return new bytes(reinterpret_cast<const char*>(&record), sizeof(record));
+}
+
 // Key type for database objects.
 // Note: if this changes from bytes, the types need to be updated for the
 // following fields in .proto files:
@@ -129,6 +129,27 @@ static inline int OffsetStringToInt(const string& s, int n) {
   return atoi(s.c_str() + n);
 }
 
+// Returns the CRC-32 (IEEE 802.3) of 'length' bytes at 'data'. To checksum
+// data in several pieces, pass the result for the previous pieces as 'crc'.
+static inline uint32 Crc32(const void* data, size_t length, uint32 crc = 0) {
+  static uint32 table[256];
+  static bool table_initialized = false;
+  if (!table_initialized) {
+    for (uint32 i = 0; i < 256; i++) {
+      uint32 c = i;
+      for (int j = 0; j < 8; j++)
+        c = (c & 1) ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+      table[i] = c;
+    }
+    table_initialized = true;
+  }
+  const uint8* bytes = reinterpret_cast<const uint8*>(data);
+  crc = ~crc;
+  for (size_t i = 0; i < length; i++)
+    crc = table[(crc ^ bytes[i]) & 0xFF] ^ (crc >> 8);
+  return ~crc;
+}
+
 // Function for deleting a heap-allocated string after it has been sent on a
 // zmq socket connection. E.g., if you want to send a heap-allocated
 // string '*s' on a socket 'sock':
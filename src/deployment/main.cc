@@ -6,35 +6,27 @@
 #include <csignal>
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
 #include <iostream>
 
 #include "applications/microbenchmark.h"
 #include "applications/tpcc.h"
 #include "common/configuration.h"
 #include "common/connection.h"
+#include "backend/array_storage.h"
+#include "backend/hot_cold_storage.h"
+#include "backend/ordered_storage.h"
 #include "backend/simple_storage.h"
 #include "backend/fetching_storage.h"
 #include "backend/collapsed_versioned_storage.h"
 #include "scheduler/serial_scheduler.h"
 #include "scheduler/deterministic_scheduler.h"
+#include "sequencer/replayer.h"
 #include "sequencer/sequencer.h"
 #include "proto/tpcc_args.pb.h"
 
 #define HOT 100
 
-map<Key, Key> latest_order_id_for_customer;
-map<Key, int> latest_order_id_for_district;
-map<Key, int> smallest_order_id_for_district;
-map<Key, Key> customer_for_order;
-unordered_map<Key, int> next_order_id_for_district;
-map<Key, int> item_for_order_line;
-map<Key, int> order_line_number;
-
-vector<Key>* involed_customers;
-
-pthread_mutex_t mutex_;
-pthread_mutex_t mutex_for_item;
-
 // Microbenchmark load generation client.
 class MClient : public Client {
  public:
@@ -134,13 +126,26 @@ void stop(int sig) {
 int main(int argc, char** argv) {
   // TODO(alex): Better arg checking.
   if (argc < 4) {
-    fprintf(stderr, "Usage: %s <node-id> <m[icro]|t[pcc]> <percent_mp>\n",
+    fprintf(stderr, "Usage: %s <node-id> <m[icro]|t[pcc]> <percent_mp>"
+            " [f[etching]][r[ecover]][v[ersioned]][a[rray]][h[otcold]]"
+            "[o[rdered]]\n",
             argv[0]);
     exit(1);
   }
   bool useFetching = false;
-  if (argc > 4 && argv[4][0] == 'f')
-    useFetching = true;
+  bool recovering = false;
+  bool useVersioned = false;
+  bool useArray = false;
+  bool useHotCold = false;
+  bool useOrdered = false;
+  if (argc > 4) {
+    useFetching = (strchr(argv[4], 'f') != NULL);
+    recovering = (strchr(argv[4], 'r') != NULL);
+    useVersioned = (strchr(argv[4], 'v') != NULL);
+    useArray = (strchr(argv[4], 'a') != NULL);
+    useHotCold = (strchr(argv[4], 'h') != NULL);
+    useOrdered = (strchr(argv[4], 'o') != NULL);
+  }
   // Catch ^C and kill signals and exit gracefully (for profiling).
   signal(SIGINT, &stop);
   signal(SIGTERM, &stop);
@@ -159,15 +164,27 @@ int main(int argc, char** argv) {
 // #ifdef PAXOS
 //  StartZookeeper(ZOOKEEPER_CONF);
 // #endif
-pthread_mutex_init(&mutex_, NULL);
-pthread_mutex_init(&mutex_for_item, NULL);
-involed_customers = new vector<Key>;
 
   Storage* storage;
-  if (!useFetching) {
-    storage = new SimpleStorage();
-  } else {
+  if (useFetching) {
+    // Objects must be pinned while txns access them.
+    config.prefetching = true;
     storage = FetchingStorage::BuildStorage();
+  } else if (useVersioned) {
+    // Supports checkpoints while txns keep executing (checkpoint_interval).
+    storage = new CollapsedVersionedStorage();
+  } else if (useArray && argv[2][0] == 'm') {
+    // Microbenchmark records are dense integers, every nparts'th one local.
+    storage = new ArrayStorage(Microbenchmark::kDBSize,
+                               config.all_nodes.size(), config.this_node_id);
+  } else if (useHotCold) {
+    // Records the application marks hot are kept apart from the rest.
+    storage = new HotColdStorage();
+  } else if (useOrdered) {
+    // Keeps objects ordered by key, so that txns can scan ranges.
+    storage = new OrderedStorage();
+  } else {
+    storage = new SimpleStorage();
   }
   storage->Initmutex();
   if (argv[2][0] == 't') {
@@ -192,24 +209,42 @@ involed_customers = new vector<Key>;
 
   }
 
+  const Application* application = (argv[2][0] == 't') ?
+      reinterpret_cast<const Application*>(new TPCC()) :
+      reinterpret_cast<const Application*>(
+          new Microbenchmark(config.all_nodes.size(), HOT));
+
+  // Recovery: restore the latest checkpoint over the initial database, then
+  // replay every logged txn after it through the scheduler before the
+  // sequencer starts, at the first epoch that was not replayed. Every node
+  // recovers at once, each needing the input logs of all nodes locally (see
+  // sequencer/replayer.h).
+  DeterministicScheduler* scheduler = NULL;
+  Replayer* replayer = NULL;
+  if (recovering) {
+    if (queue_mode != NORMAL_QUEUE) {
+      fprintf(stderr, "Recovery requires normal queue mode\n");
+      exit(EXIT_FAILURE);
+    }
+    int64 checkpoint_txn =
+        CollapsedVersionedStorage::LoadLatestCheckpoint(storage);
+    replayer = new Replayer(&config, checkpoint_txn);
+    scheduler = new DeterministicScheduler(
+        &config, multiplexer.NewConnection("scheduler_"), storage,
+        application, replayer->GetTxnsQueue(), client, queue_mode);
+    replayer->WaitUntilDone();
+    std::cout << "Resuming at epoch " << config.first_epoch << std::endl;
+  }
+
   // Initialize sequencer component and start sequencer thread running.
   Sequencer sequencer(&config, multiplexer.NewConnection("sequencer"), client,
                       storage, queue_mode);
 
-  // Run scheduler in main thread.
-  if (argv[2][0] == 't') {
-	  DeterministicScheduler scheduler(&config,
-	                                       multiplexer.NewConnection("scheduler_"),
-	                                       storage,
-	                                       new TPCC(), sequencer.GetTxnsQueue(), client, queue_mode);
-  }
-  else{
-    DeterministicScheduler scheduler(&config,
-                                     multiplexer.NewConnection("scheduler_"),
-                                     storage,
-                                     new Microbenchmark(config.all_nodes.size(), HOT),
-									 sequencer.GetTxnsQueue(),
-									 client, queue_mode);
+  // Start the scheduler, unless recovery already did.
+  if (scheduler == NULL) {
+    scheduler = new DeterministicScheduler(
+        &config, multiplexer.NewConnection("scheduler_"), storage,
+        application, sequencer.GetTxnsQueue(), client, queue_mode);
   }
 
   Spin(180);
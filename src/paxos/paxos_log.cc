@@ -0,0 +1,479 @@
+// Author: Kun Ren (kun.ren@yale.edu)
+//
+// The PaxosLog replicates the sequence of batches among the replicas of a
+// partition using Multi-Paxos over the ConnectionMultiplexer.
+
+#include "paxos/paxos_log.h"
+
+#include <algorithm>
+#include <cassert>
+
+#include "common/configuration.h"
+#include "common/connection.h"
+#include "proto/message.pb.h"
+
+void* PaxosLog::RunPaxosLog(void* arg) {
+  reinterpret_cast<PaxosLog*>(arg)->Run();
+  return NULL;
+}
+
+PaxosLog::PaxosLog(Configuration* conf, Connection* connection)
+    : configuration_(conf), connection_(connection), promised_ballot_(0),
+      is_leader_(false), last_heard_(GetTime()), forgotten_index_(0),
+      commit_index_(0),
+      delivered_index_(0), next_slot_(0), deconstructor_invoked_(false) {
+  // The replica group consists of all nodes storing this node's partition.
+  int partition = conf->all_nodes[conf->this_node_id]->partition_id;
+  for (map<int, Node*>::iterator it = conf->all_nodes.begin();
+       it != conf->all_nodes.end(); ++it) {
+    if (it->second->partition_id == partition) {
+      if (it->first == conf->this_node_id)
+        index_ = members_.size();
+      members_.push_back(it->first);
+    }
+  }
+  // The lowest node id owns ballot 0 and leads from the start.
+  is_leader_ = (index_ == 0);
+  member_delivered_.resize(members_.size(), 0);
+  member_progress_.resize(members_.size(), GetTime());
+  catch_up_to_.resize(members_.size(), 0);
+
+  pthread_mutex_init(&mutex_, NULL);
+  pthread_cond_init(&committed_cond_, NULL);
+  pthread_create(&thread_, NULL, RunPaxosLog, reinterpret_cast<void*>(this));
+}
+
+PaxosLog::~PaxosLog() {
+  deconstructor_invoked_ = true;
+  pthread_join(thread_, NULL);
+  delete connection_;
+}
+
+void PaxosLog::SubmitBatch(const string& batch_data) {
+  submitted_.Push(batch_data);
+}
+
+bool PaxosLog::GetNextBatch(string* batch_data) {
+  bool got_batch = false;
+  pthread_mutex_lock(&mutex_);
+  if (!committed_.empty()) {
+    batch_data->swap(committed_.front());
+    committed_.pop();
+    got_batch = true;
+  }
+  pthread_mutex_unlock(&mutex_);
+  return got_batch;
+}
+
+void PaxosLog::GetNextBatchBlocking(string* batch_data) {
+  pthread_mutex_lock(&mutex_);
+  while (committed_.empty())
+    pthread_cond_wait(&committed_cond_, &mutex_);
+  batch_data->swap(committed_.front());
+  committed_.pop();
+  pthread_mutex_unlock(&mutex_);
+}
+
+void PaxosLog::Run() {
+  MessageProto message;
+  double last_sent = 0;
+  // Stagger election timeouts so that replicas rarely compete.
+  double timeout = PAXOS_LEADER_TIMEOUT * (1 + index_ / 2.0);
+
+  while (!deconstructor_invoked_) {
+    bool idle = true;
+    while (connection_->GetMessage(&message)) {
+      idle = false;
+      switch (message.type()) {
+        case MessageProto::PAXOS_PREPARE:
+          HandlePrepare(message);
+          break;
+        case MessageProto::PAXOS_PROMISE:
+          HandlePromise(message);
+          break;
+        case MessageProto::PAXOS_ACCEPT:
+          HandleAccept(message);
+          break;
+        case MessageProto::PAXOS_ACCEPTED:
+          HandleAccepted(message);
+          break;
+        case MessageProto::PAXOS_COMMIT:
+          HandleCommit(message);
+          break;
+        case MessageProto::PAXOS_FORWARD:
+          for (int i = 0; i < message.data_size(); i++)
+            pending_.push(message.data(i));
+          break;
+        default:
+          assert(false);
+      }
+    }
+
+    string batch;
+    while (submitted_.Pop(&batch)) {
+      pending_.push(batch);
+      idle = false;
+    }
+    if (!pending_.empty())
+      Propose();
+
+    double now = GetTime();
+    if (is_leader_) {
+      if (!idle) {
+        last_sent = now;
+      } else if (now > last_sent + PAXOS_HEARTBEAT_INTERVAL) {
+        MessageProto heartbeat;
+        heartbeat.set_type(MessageProto::PAXOS_COMMIT);
+        heartbeat.set_ballot(promised_ballot_);
+        heartbeat.set_commit_index(commit_index_);
+        heartbeat.set_forget_index(ForgetIndex());
+        SendTo(-1, &heartbeat);
+        last_sent = now;
+      }
+    } else if (now > last_heard_ + timeout) {
+      StartElection();
+    }
+
+    if (idle)
+      Spin(0.0001);
+  }
+}
+
+void PaxosLog::SendTo(int node, MessageProto* message) {
+  message->set_destination_channel("paxos");
+  message->set_source_node(configuration_->this_node_id);
+  if (node != -1) {
+    message->set_destination_node(node);
+    connection_->Send(*message);
+    return;
+  }
+  for (uint32 i = 0; i < members_.size(); i++) {
+    if (static_cast<int>(i) == index_)
+      continue;
+    message->set_destination_node(members_[i]);
+    connection_->Send(*message);
+  }
+}
+
+void PaxosLog::Accept(int64 slot, int64 ballot, const string& value) {
+  if (slot < delivered_index_)
+    return;  // Already delivered here.
+  Entry* entry = &log_[slot];
+  entry->ballot = ballot;
+  entry->value = value;
+}
+
+void PaxosLog::Propose() {
+  if (is_leader_) {
+    int64 first = next_slot_;
+    while (!pending_.empty()) {
+      Accept(next_slot_, promised_ballot_, pending_.front());
+      accepted_by_[next_slot_] = 1 << index_;
+      pending_.pop();
+      next_slot_++;
+    }
+    SendAccept(-1, first, next_slot_);
+    AdvanceCommit();
+  } else if (promises_.empty()) {
+    // Not running an election, so the leader is known.
+    MessageProto forward;
+    forward.set_type(MessageProto::PAXOS_FORWARD);
+    while (!pending_.empty()) {
+      forward.add_data()->swap(pending_.front());
+      pending_.pop();
+    }
+    SendTo(LeaderOf(promised_ballot_), &forward);
+  }
+}
+
+void PaxosLog::SendAccept(int node, int64 from, int64 to) {
+  MessageProto accept;
+  accept.set_type(MessageProto::PAXOS_ACCEPT);
+  accept.set_ballot(promised_ballot_);
+  for (int64 slot = from; slot < to; slot++) {
+    map<int64, Entry>::iterator it = log_.find(slot);
+    if (it == log_.end())
+      continue;
+    accept.add_slots(slot);
+    accept.add_data(it->second.value);
+  }
+  accept.set_commit_index(commit_index_);
+  accept.set_forget_index(ForgetIndex());
+  SendTo(node, &accept);
+}
+
+void PaxosLog::AdvanceCommit() {
+  uint32 quorum = members_.size() / 2 + 1;
+  int64 commit_index = commit_index_;
+  map<int64, uint32>::iterator it = accepted_by_.begin();
+  while (it != accepted_by_.end() && it->first == commit_index &&
+         static_cast<uint32>(__builtin_popcount(it->second)) >= quorum) {
+    accepted_by_.erase(it++);
+    commit_index++;
+  }
+  Commit(commit_index);
+}
+
+void PaxosLog::Commit(int64 commit_index) {
+  if (commit_index > commit_index_)
+    commit_index_ = commit_index;
+
+  // Deliver committed slots in order. A follower only delivers values it
+  // accepted from the current leader; older values are replaced when the
+  // leader brings it up to date.
+  while (delivered_index_ < commit_index_) {
+    map<int64, Entry>::iterator it = log_.find(delivered_index_);
+    if (it == log_.end() || it->second.ballot != promised_ballot_)
+      break;
+    // Empty values are no-ops used to fill gaps after an election.
+    if (!it->second.value.empty()) {
+      pthread_mutex_lock(&mutex_);
+      committed_.push(it->second.value);
+      pthread_cond_signal(&committed_cond_);
+      pthread_mutex_unlock(&mutex_);
+    }
+    delivered_index_++;
+  }
+
+  if (is_leader_) {
+    member_delivered_[index_] = delivered_index_;
+    Forget(ForgetIndex());
+  }
+}
+
+void PaxosLog::CatchUp(int member, int64 delivered) {
+  double now = GetTime();
+  if (delivered > member_delivered_[member]) {
+    member_delivered_[member] = delivered;
+    member_progress_[member] = now;
+  }
+  if (delivered >= commit_index_) {
+    catch_up_to_[member] = 0;
+    return;
+  }
+
+  // Followers normally trail the commit index by a message or two. Resend
+  // only to one that has stopped making progress, or that is working
+  // through an earlier resend that stopped short.
+  bool resume = catch_up_to_[member] != 0 && delivered >= catch_up_to_[member];
+  if (!resume && now < member_progress_[member] + PAXOS_CATCH_UP_INTERVAL)
+    return;
+  int64 to = std::min(commit_index_, delivered + PAXOS_CATCH_UP_SLOTS);
+  SendAccept(members_[member], delivered, to);
+  catch_up_to_[member] = to < commit_index_ ? to : 0;
+  member_progress_[member] = now;
+}
+
+int64 PaxosLog::ForgetIndex() {
+  int64 index = delivered_index_;
+  for (uint32 i = 0; i < members_.size(); i++)
+    if (static_cast<int>(i) != index_ && member_delivered_[i] < index)
+      index = member_delivered_[i];
+  return index;
+}
+
+void PaxosLog::Forget(int64 index) {
+  // Never drop a slot this replica has yet to deliver.
+  index = std::min(index, delivered_index_);
+  while (!log_.empty() && log_.begin()->first < index)
+    log_.erase(log_.begin());
+  if (index > forgotten_index_)
+    forgotten_index_ = index;
+}
+
+void PaxosLog::StartElection() {
+  int64 size = members_.size();
+  promised_ballot_ = (promised_ballot_ / size + 1) * size + index_;
+  is_leader_ = false;
+  last_heard_ = GetTime();
+
+  // Promise our own ballot.
+  promises_.clear();
+  recovered_.clear();
+  promises_[configuration_->this_node_id] = delivered_index_;
+  for (map<int64, Entry>::iterator it = log_.lower_bound(commit_index_);
+       it != log_.end(); ++it)
+    recovered_[it->first] = it->second;
+
+  MessageProto prepare;
+  prepare.set_type(MessageProto::PAXOS_PREPARE);
+  prepare.set_ballot(promised_ballot_);
+  prepare.set_commit_index(commit_index_);
+  SendTo(-1, &prepare);
+
+  if (promises_.size() >= members_.size() / 2 + 1)
+    BecomeLeader();
+}
+
+void PaxosLog::BecomeLeader() {
+  is_leader_ = true;
+
+  // Re-propose every slot that a majority may have accepted under an earlier
+  // ballot, using the value accepted under the highest ballot. Gaps are filled
+  // with no-ops.
+  int64 last_slot = commit_index_ - 1;
+  if (!recovered_.empty() && recovered_.rbegin()->first > last_slot)
+    last_slot = recovered_.rbegin()->first;
+  accepted_by_.clear();
+  for (int64 slot = commit_index_; slot <= last_slot; slot++) {
+    map<int64, Entry>::iterator it = recovered_.find(slot);
+    Accept(slot, promised_ballot_,
+           it == recovered_.end() ? string() : it->second.value);
+    accepted_by_[slot] = 1 << index_;
+  }
+  next_slot_ = last_slot + 1;
+  recovered_.clear();
+
+  // Bring every replica that promised up to date, starting from its own
+  // commit index.
+  for (map<int, int64>::iterator it = promises_.begin();
+       it != promises_.end(); ++it) {
+    if (it->first != configuration_->this_node_id)
+      SendAccept(it->first, std::min(it->second, commit_index_), next_slot_);
+  }
+  // Members that did not promise are assumed to have delivered at least what
+  // this replica was told it could forget; they catch up once they report.
+  double now = GetTime();
+  for (uint32 i = 0; i < members_.size(); i++) {
+    map<int, int64>::iterator it = promises_.find(members_[i]);
+    if (it != promises_.end() && it->second > member_delivered_[i])
+      member_delivered_[i] = it->second;
+    if (member_delivered_[i] < forgotten_index_)
+      member_delivered_[i] = forgotten_index_;
+    member_progress_[i] = now;
+    catch_up_to_[i] = 0;
+  }
+  promises_.clear();
+  // Values committed earlier must also be delivered under the new ballot.
+  for (map<int64, Entry>::iterator it = log_.lower_bound(delivered_index_);
+       it != log_.end() && it->first < commit_index_; ++it)
+    it->second.ballot = promised_ballot_;
+  AdvanceCommit();
+}
+
+void PaxosLog::HandlePrepare(const MessageProto& message) {
+  MessageProto promise;
+  promise.set_type(MessageProto::PAXOS_PROMISE);
+  if (message.ballot() > promised_ballot_) {
+    promised_ballot_ = message.ballot();
+    is_leader_ = false;
+    promises_.clear();
+    last_heard_ = GetTime();
+    for (map<int64, Entry>::iterator it =
+             log_.lower_bound(message.commit_index());
+         it != log_.end(); ++it) {
+      promise.add_slots(it->first);
+      promise.add_accepted_ballots(it->second.ballot);
+      promise.add_data(it->second.value);
+    }
+  }
+  // A promise for a different ballot tells the candidate to give up.
+  promise.set_ballot(promised_ballot_);
+  promise.set_commit_index(delivered_index_);
+  SendTo(message.source_node(), &promise);
+}
+
+void PaxosLog::HandlePromise(const MessageProto& message) {
+  if (message.ballot() > promised_ballot_) {
+    promised_ballot_ = message.ballot();
+    is_leader_ = false;
+    promises_.clear();
+    return;
+  }
+  if (message.ballot() != promised_ballot_ ||
+      LeaderOf(promised_ballot_) != configuration_->this_node_id)
+    return;
+
+  if (is_leader_) {
+    // Late promise: bring that replica up to date.
+    SendAccept(message.source_node(),
+               std::min(message.commit_index(), commit_index_), next_slot_);
+    return;
+  }
+
+  promises_[message.source_node()] = message.commit_index();
+  for (int i = 0; i < message.slots_size(); i++) {
+    map<int64, Entry>::iterator it = recovered_.find(message.slots(i));
+    if (it == recovered_.end() ||
+        it->second.ballot < message.accepted_ballots(i)) {
+      Entry* entry = &recovered_[message.slots(i)];
+      entry->ballot = message.accepted_ballots(i);
+      entry->value = message.data(i);
+    }
+  }
+  if (promises_.size() >= members_.size() / 2 + 1)
+    BecomeLeader();
+}
+
+void PaxosLog::HandleAccept(const MessageProto& message) {
+  MessageProto accepted;
+  accepted.set_type(MessageProto::PAXOS_ACCEPTED);
+  if (message.ballot() < promised_ballot_) {
+    // Tell the stale leader about the newer ballot.
+    accepted.set_ballot(promised_ballot_);
+    SendTo(message.source_node(), &accepted);
+    return;
+  }
+  if (message.ballot() > promised_ballot_) {
+    promised_ballot_ = message.ballot();
+    is_leader_ = false;
+    promises_.clear();
+  }
+  last_heard_ = GetTime();
+
+  accepted.set_ballot(promised_ballot_);
+  for (int i = 0; i < message.slots_size(); i++) {
+    Accept(message.slots(i), message.ballot(), message.data(i));
+    accepted.add_slots(message.slots(i));
+  }
+  Commit(message.commit_index());
+  Forget(message.forget_index());
+  accepted.set_commit_index(delivered_index_);
+  SendTo(message.source_node(), &accepted);
+}
+
+void PaxosLog::HandleAccepted(const MessageProto& message) {
+  if (message.ballot() > promised_ballot_) {
+    promised_ballot_ = message.ballot();
+    is_leader_ = false;
+    promises_.clear();
+    return;
+  }
+  if (!is_leader_ || message.ballot() != promised_ballot_)
+    return;
+
+  int sender = 0;
+  while (members_[sender] != message.source_node())
+    sender++;
+  for (int i = 0; i < message.slots_size(); i++) {
+    map<int64, uint32>::iterator it = accepted_by_.find(message.slots(i));
+    if (it != accepted_by_.end())
+      it->second |= 1 << sender;
+  }
+  AdvanceCommit();
+  if (message.has_commit_index())
+    CatchUp(sender, message.commit_index());
+}
+
+void PaxosLog::HandleCommit(const MessageProto& message) {
+  if (message.ballot() < promised_ballot_)
+    return;
+  if (message.ballot() > promised_ballot_) {
+    promised_ballot_ = message.ballot();
+    is_leader_ = false;
+    promises_.clear();
+  }
+  last_heard_ = GetTime();
+  Commit(message.commit_index());
+  Forget(message.forget_index());
+
+  // Tell the leader while this replica lags, so that it resends what is
+  // missing.
+  if (delivered_index_ < commit_index_) {
+    MessageProto reply;
+    reply.set_type(MessageProto::PAXOS_ACCEPTED);
+    reply.set_ballot(promised_ballot_);
+    reply.set_commit_index(delivered_index_);
+    SendTo(message.source_node(), &reply);
+  }
+}
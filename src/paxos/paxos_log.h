@@ -0,0 +1,214 @@
+// Author: Kun Ren (kun.ren@yale.edu)
+//
+// The PaxosLog replicates the sequence of batches among the replicas of a
+// partition (all nodes sharing this node's partition_id) using Multi-Paxos
+// over the ConnectionMultiplexer, without any external coordination service.
+//
+// A stable leader assigns each submitted batch the next slot of the log and
+// sends it to all replicas in an ACCEPT message; batches submitted while
+// earlier ones are still in flight are sent together in the next ACCEPT, and
+// the leader never waits for a slot to commit before proposing the next one.
+// A slot is committed once a majority of replicas has accepted it, and
+// committed batches are handed to the reader in slot order.
+//
+// Replicas that stop hearing from the leader start an election with a higher
+// ballot (PREPARE/PROMISE). The new leader re-proposes every slot a majority
+// might have accepted, filling gaps with empty batches, and brings lagging
+// replicas up to date. Batches that followers forwarded to a leader that
+// failed before proposing them are lost.
+//
+// Followers report how far they have delivered the log in every ACCEPTED
+// message, and answer heartbeats with it while they lag behind. A replica
+// that missed slots, or missed the election of the current leader, stops
+// making progress; the leader notices and resends it the committed slots it
+// lacks. Replicas keep every slot some replica has not yet delivered, so a
+// replica that is down holds back the log until it returns.
+//
+// Ballots are 'round * group_size + index_in_group', so every replica owns a
+// distinct set of ballots. All replicas start having promised ballot 0, owned
+// by the lowest node id in the group, which therefore leads from the start
+// without running phase 1.
+
+#ifndef _DB_PAXOS_PAXOS_LOG_H_
+#define _DB_PAXOS_PAXOS_LOG_H_
+
+#include <pthread.h>
+
+#include <map>
+#include <queue>
+#include <string>
+#include <vector>
+
+#include "common/types.h"
+#include "common/utils.h"
+
+using std::map;
+using std::queue;
+using std::string;
+using std::vector;
+
+class Configuration;
+class Connection;
+class MessageProto;
+
+// Seconds without hearing from the leader before a replica starts an
+// election.
+#define PAXOS_LEADER_TIMEOUT 0.5
+
+// Seconds between leader heartbeats when there is nothing to propose.
+#define PAXOS_HEARTBEAT_INTERVAL 0.01
+
+// Seconds a lagging replica may go without making progress before the
+// leader resends it the committed slots it lacks.
+#define PAXOS_CATCH_UP_INTERVAL 0.05
+
+// Maximum number of slots resent to a lagging replica in one message.
+#define PAXOS_CATCH_UP_SLOTS 1000
+
+class PaxosLog {
+ public:
+  // Starts the log's main loop in a background thread. 'connection' must be
+  // registered on the "paxos" channel at every replica and is owned by the
+  // log.
+  PaxosLog(Configuration* conf, Connection* connection);
+
+  // Halts the main loop.
+  ~PaxosLog();
+
+  // Submits a new batch for insertion into the log. Does NOT block. Batches
+  // submitted by one replica appear in the log in submission order.
+  void SubmitBatch(const string& batch_data);
+
+  // Attempts to read the next committed batch into '*batch_data'. Returns
+  // false immediately if it is not yet known.
+  bool GetNextBatch(string* batch_data);
+
+  // Reads the next committed batch into '*batch_data', blocking until it has
+  // been committed.
+  void GetNextBatchBlocking(string* batch_data);
+
+  // Returns true if this replica currently believes itself to be the leader.
+  // May be called from any thread.
+  bool IsLeader() { return is_leader_; }
+
+ private:
+  // A value accepted for a slot and the ballot under which it was accepted.
+  struct Entry {
+    int64 ballot;
+    string value;
+  };
+
+  // Main loop.
+  void Run();
+  static void* RunPaxosLog(void* arg);
+
+  // Message handlers.
+  void HandlePrepare(const MessageProto& message);
+  void HandlePromise(const MessageProto& message);
+  void HandleAccept(const MessageProto& message);
+  void HandleAccepted(const MessageProto& message);
+  void HandleCommit(const MessageProto& message);
+
+  // Assigns slots to all proposals submitted since the last call and sends
+  // them to all replicas (or forwards them to the leader).
+  void Propose();
+
+  // Starts an election with the next ballot owned by this replica.
+  void StartElection();
+
+  // Takes over as leader once a majority has promised the current ballot.
+  void BecomeLeader();
+
+  // Commits, in slot order, the in-flight slots a majority has accepted.
+  void AdvanceCommit();
+
+  // Sends an ACCEPT for slots ['from', 'to') of the log to 'node' (or to all
+  // replicas if 'node' is -1).
+  void SendAccept(int node, int64 from, int64 to);
+
+  // Accepts 'value' for 'slot' under 'ballot' at this replica.
+  void Accept(int64 slot, int64 ballot, const string& value);
+
+  // Marks every slot below 'commit_index' as committed and delivers all
+  // committed batches that can be delivered in order.
+  void Commit(int64 commit_index);
+
+  // Leader: records that the member at 'member' (index in 'members_') has
+  // delivered every slot below 'delivered', and resends it committed slots
+  // if it has stopped making progress.
+  void CatchUp(int member, int64 delivered);
+
+  // Leader: returns the first slot some replica has not yet delivered.
+  int64 ForgetIndex();
+
+  // Drops all slots below 'index' from the log.
+  void Forget(int64 index);
+
+  // Sends 'message' to 'node', or to every replica if 'node' is -1.
+  void SendTo(int node, MessageProto* message);
+
+  // Returns the replica owning 'ballot'.
+  int LeaderOf(int64 ballot) { return members_[ballot % members_.size()]; }
+
+  Configuration* configuration_;
+  Connection* connection_;
+
+  // Node ids of all replicas in this group, ascending, and this replica's
+  // index in 'members_'.
+  vector<int> members_;
+  int index_;
+
+  // Highest ballot this replica has promised and whether it currently leads
+  // under that ballot. Written only by the main loop, but read by IsLeader.
+  volatile int64 promised_ballot_;
+  volatile bool is_leader_;
+
+  // Time of the last message received from (or, at the leader, sent as) the
+  // current leader.
+  double last_heard_;
+
+  // Accepted (and committed) values, by slot. All slots below
+  // 'forgotten_index_' have been dropped.
+  map<int64, Entry> log_;
+  int64 forgotten_index_;
+
+  // All slots below 'commit_index_' are committed, and all slots below
+  // 'delivered_index_' have been handed to the reader.
+  int64 commit_index_;
+  int64 delivered_index_;
+
+  // Leader state: next slot to assign, and a bitmask (by index in
+  // 'members_') of the replicas that accepted each in-flight slot under the
+  // current ballot.
+  int64 next_slot_;
+  map<int64, uint32> accepted_by_;
+
+  // Leader state, by index in 'members_': the first slot each replica has
+  // not yet delivered as far as the leader knows, when that last advanced
+  // (or when slots were last resent to it), and the end of a resend that
+  // had to stop short of the commit index (0 if none).
+  vector<int64> member_delivered_;
+  vector<double> member_progress_;
+  vector<int64> catch_up_to_;
+
+  // Candidate state: first slot each promising replica still needs, and the
+  // highest-ballot value reported for each slot.
+  map<int, int64> promises_;
+  map<int64, Entry> recovered_;
+
+  // Batches submitted locally but not yet handed to the main loop, and
+  // batches (local or forwarded) waiting to be proposed.
+  AtomicQueue<string> submitted_;
+  queue<string> pending_;
+
+  // Committed batches not yet read, protected by 'mutex_'. 'committed_cond_'
+  // is signalled whenever a batch is added.
+  queue<string> committed_;
+  pthread_mutex_t mutex_;
+  pthread_cond_t committed_cond_;
+
+  pthread_t thread_;
+  bool deconstructor_invoked_;
+};
+
+#endif  // _DB_PAXOS_PAXOS_LOG_H_
@@ -0,0 +1,123 @@
+// Author: Kun Ren (kun@cs.yale.edu)
+// Author: Alexander Thomson (thomson@cs.yale.edu)
+//
+// The BatchMerger assembles the sub-batches that every node's sequencer sends
+// to this scheduler into one totally ordered batch per epoch.
+
+#include "scheduler/batch_merger.h"
+
+#include <cassert>
+
+#include "common/connection.h"
+#include "common/utils.h"
+#include "proto/message.pb.h"
+
+BatchMerger::BatchMerger(int num_origins, Connection* connection)
+    : num_origins_(num_origins), connection_(connection),
+      latest_epoch_(num_origins, -1), wait_time_(num_origins, 0),
+      stalled_epoch_(-1), stalled_since_(0) {
+}
+
+BatchMerger::~BatchMerger() {
+  for (map<int64, vector<MessageProto*> >::iterator it = pending_.begin();
+       it != pending_.end(); ++it) {
+    for (int i = 0; i < num_origins_; i++)
+      delete it->second[i];
+  }
+}
+
+void BatchMerger::AddSubBatch(MessageProto* sub_batch) {
+  assert(sub_batch->type() == MessageProto::TXN_BATCH);
+  int64 epoch = sub_batch->batch_number() / num_origins_;
+  int origin = sub_batch->batch_number() % num_origins_;
+
+  vector<MessageProto*>& sub_batches = pending_[epoch];
+  if (sub_batches.empty())
+    sub_batches.resize(num_origins_, NULL);
+  assert(sub_batches[origin] == NULL);
+  sub_batches[origin] = sub_batch;
+
+  if (epoch > latest_epoch_[origin])
+    latest_epoch_[origin] = epoch;
+}
+
+void BatchMerger::Receive() {
+  if (connection_ == NULL)
+    return;
+  MessageProto* message = new MessageProto();
+  while (connection_->GetMessage(message)) {
+    if (message->type() == MessageProto::TXN_BATCH_BUNDLE) {
+      // Sub-batches coalesced by a relay.
+      for (int i = 0; i < message->data_size(); i++) {
+        MessageProto* sub_batch = new MessageProto();
+        sub_batch->ParseFromString(message->data(i));
+        AddSubBatch(sub_batch);
+      }
+    } else {
+      AddSubBatch(message);
+      message = new MessageProto();
+    }
+  }
+  delete message;
+}
+
+MessageProto* BatchMerger::GetEpoch(int64 epoch) {
+  Receive();
+
+  map<int64, vector<MessageProto*> >::iterator it = pending_.find(epoch);
+  int missing = num_origins_;
+  if (it != pending_.end()) {
+    for (int i = 0; i < num_origins_; i++)
+      if (it->second[i] != NULL)
+        missing--;
+  }
+
+  if (missing > 0) {
+    // Charge the time spent blocked on this epoch to the origins that have
+    // not delivered yet.
+    double now = GetTime();
+    if (stalled_epoch_ == epoch) {
+      for (int i = 0; i < num_origins_; i++)
+        if (it == pending_.end() || it->second[i] == NULL)
+          wait_time_[i] += now - stalled_since_;
+    }
+    stalled_epoch_ = epoch;
+    stalled_since_ = now;
+    return NULL;
+  }
+  stalled_epoch_ = -1;
+
+  // Concatenate sub-batches in origin order. Txn strings are swapped rather
+  // than copied into the merged batch.
+  MessageProto* merged = it->second[0];
+  merged->set_batch_number(epoch);
+  for (int i = 1; i < num_origins_; i++) {
+    MessageProto* sub_batch = it->second[i];
+    for (int j = 0; j < sub_batch->data_size(); j++)
+      merged->add_data()->swap(*sub_batch->mutable_data(j));
+    delete sub_batch;
+  }
+  pending_.erase(it);
+  return merged;
+}
+
+void BatchMerger::ReportLag(std::ostream& out) {
+  int64 latest = -1;
+  for (int i = 0; i < num_origins_; i++)
+    if (latest_epoch_[i] > latest)
+      latest = latest_epoch_[i];
+
+  bool reported = false;
+  for (int i = 0; i < num_origins_; i++) {
+    int64 lag = latest - latest_epoch_[i];
+    if (lag > 1 || wait_time_[i] > 0) {
+      out << (reported ? ", " : "Origin lag: ")
+          << "node " << i << " " << lag << " epochs behind, waited "
+          << wait_time_[i] << "s";
+      reported = true;
+    }
+    wait_time_[i] = 0;
+  }
+  if (reported)
+    out << "\n";
+}
@@ -0,0 +1,79 @@
+// Author: Kun Ren (kun@cs.yale.edu)
+// Author: Alexander Thomson (thomson@cs.yale.edu)
+//
+// The BatchMerger assembles the sub-batches that every node's sequencer sends
+// to this scheduler into one totally ordered batch per epoch.
+//
+// Sequencer 'n' (of N nodes) numbers its batches n, n + N, n + 2N, ..., so the
+// batch numbered 'b' is origin b % N's contribution to epoch b / N. An epoch
+// is released once a sub-batch (possibly empty) from every origin has arrived,
+// and its txns are ordered by origin and then by position within the origin's
+// sub-batch. A sequencer that has nothing to contribute to an epoch, or whose
+// batch did not become ready in time, sends an empty sub-batch as a promise so
+// that the other origins are never held up waiting for it.
+//
+// Sub-batches arrive either directly or coalesced into TXN_BATCH_BUNDLE
+// messages by a BatchRelay.
+//
+// The merger also records, per origin, how many epochs it trails the most
+// advanced origin and how long the scheduler was stalled waiting for it.
+
+#ifndef _DB_SCHEDULER_BATCH_MERGER_H_
+#define _DB_SCHEDULER_BATCH_MERGER_H_
+
+#include <map>
+#include <ostream>
+#include <vector>
+
+#include "common/types.h"
+
+using std::map;
+using std::vector;
+
+class Connection;
+class MessageProto;
+
+class BatchMerger {
+ public:
+  // Sub-batches are read from 'connection', which is not owned by the merger.
+  // If 'connection' is NULL, sub-batches must be supplied via AddSubBatch.
+  BatchMerger(int num_origins, Connection* connection);
+  ~BatchMerger();
+
+  // Returns a heap-allocated TXN_BATCH containing the txns of every origin's
+  // sub-batch for epoch 'epoch' in deterministic order, or NULL if some
+  // origin's sub-batch has not arrived yet. Epochs must be requested in
+  // increasing order. The caller takes ownership of the returned message.
+  MessageProto* GetEpoch(int64 epoch);
+
+  // Hands an already received sub-batch to the merger.
+  void AddSubBatch(MessageProto* sub_batch);
+
+  // Writes a one-line summary of every origin that is lagging or that the
+  // scheduler had to wait for since the last report, then resets the wait
+  // counters.
+  void ReportLag(std::ostream& out);
+
+ private:
+  // Drains all messages currently available on 'connection_'.
+  void Receive();
+
+  int num_origins_;
+  Connection* connection_;
+
+  // Sub-batches received but not yet merged, indexed by epoch, then origin.
+  map<int64, vector<MessageProto*> > pending_;
+
+  // Highest epoch received from each origin (-1 if none).
+  vector<int64> latest_epoch_;
+
+  // Seconds spent waiting on each origin since the last report.
+  vector<double> wait_time_;
+
+  // Epoch currently being waited on and time the wait began (0 if the merger
+  // is not currently blocked).
+  int64 stalled_epoch_;
+  double stalled_since_;
+};
+
+#endif  // _DB_SCHEDULER_BATCH_MERGER_H_
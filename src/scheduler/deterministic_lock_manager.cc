@@ -21,37 +21,60 @@ DeterministicLockManager::DeterministicLockManager(
     lock_table_[i] = new deque<KeysList>();
 }
 
+int DeterministicLockManager::LockForWrite(const Key& key, TxnProto* txn) {
+  int not_acquired = 0;
+  deque<KeysList>* key_requests = lock_table_[Hash(key)];
+
+  deque<KeysList>::iterator it;
+  for(it = key_requests->begin();
+      it != key_requests->end() && it->key != key; ++it) {
+  }
+  deque<LockRequest>* requests;
+  if (it == key_requests->end()) {
+    requests = new deque<LockRequest>();
+    key_requests->push_back(KeysList(key, requests));
+  } else {
+    requests = it->locksrequest;
+  }
+
+  // Only need to request this if lock txn hasn't already requested it.
+  if (requests->empty() || txn != requests->back().txn) {
+    requests->push_back(LockRequest(WRITE, txn));
+    // Write lock request fails if there is any previous request at all.
+    if (requests->size() > 1)
+      not_acquired++;
+
+    // It also waits for earlier txns whose range locks cover the key.
+    for (deque<RangeLockRequest>::iterator range = range_locks_.begin();
+         range != range_locks_.end(); ++range) {
+      if (range->txn != txn && range->start <= key &&
+          (range->end.empty() || key < range->end)) {
+        AddRangeWaiter(range->txn, txn);
+        not_acquired++;
+      }
+    }
+  }
+  return not_acquired;
+}
+
 int DeterministicLockManager::Lock(TxnProto* txn) {
   int not_acquired = 0;
 
-  // Handle read/write lock requests.
+  // Handle read/write lock requests, and write lock requests for the keys
+  // the txn inserts, which a range lock must also see.
   for (int i = 0; i < txn->read_write_set_size(); i++) {
     // Only lock local keys.
-    if (IsLocal(txn->read_write_set(i))) {
-      deque<KeysList>* key_requests = lock_table_[Hash(txn->read_write_set(i))];
-      
-      deque<KeysList>::iterator it;
-      for(it = key_requests->begin();
-          it != key_requests->end() && it->key != txn->read_write_set(i); ++it) { 
-      }
-      deque<LockRequest>* requests;
-      if (it == key_requests->end()) {
-        requests = new deque<LockRequest>();
-        key_requests->push_back(KeysList(txn->read_write_set(i), requests));
-      } else {
-        requests = it->locksrequest;
-      }
-      
-      // Only need to request this if lock txn hasn't already requested it.
-      if (requests->empty() || txn != requests->back().txn) {
-        requests->push_back(LockRequest(WRITE, txn));
-        // Write lock request fails if there is any previous request at all.
-        if (requests->size() > 1)
-          not_acquired++;
-      }
-    }
+    if (IsLocal(txn->read_write_set(i)))
+      not_acquired += LockForWrite(txn->read_write_set(i), txn);
+  }
+  for (int i = 0; i < txn->write_set_size(); i++) {
+    if (IsLocal(txn->write_set(i)))
+      not_acquired += LockForWrite(txn->write_set(i), txn);
   }
 
+  if (txn->read_write_set_size() > 0 || txn->write_set_size() > 0)
+    writers_.insert(txn);
+
   // Handle read lock requests. This is last so that we don't have to deal with
   // upgrading lock requests from read to write on hash collisions.
   for (int i = 0; i < txn->read_set_size(); i++) {
@@ -86,6 +109,36 @@ int DeterministicLockManager::Lock(TxnProto* txn) {
     }
   }
 
+  // Handle range lock requests, which wait for earlier writers to any key in
+  // their ranges.
+  for (int i = 0; i < txn->range_start_size(); i++) {
+    // Only lock ranges with local keys.
+    if (IsLocalRange(txn->range_start(i), txn->range_end(i))) {
+      const Key& start = txn->range_start(i);
+      const Key& end = txn->range_end(i);
+      range_locks_.push_back(RangeLockRequest(txn, start, end));
+      for (unordered_set<TxnProto*>::iterator it = writers_.begin();
+           it != writers_.end(); ++it) {
+        if (*it == txn)
+          continue;
+        for (int j = 0; j < (*it)->read_write_set_size(); j++) {
+          const Key& key = (*it)->read_write_set(j);
+          if (start <= key && (end.empty() || key < end) && IsLocal(key)) {
+            AddRangeWaiter(*it, txn);
+            not_acquired++;
+          }
+        }
+        for (int j = 0; j < (*it)->write_set_size(); j++) {
+          const Key& key = (*it)->write_set(j);
+          if (start <= key && (end.empty() || key < end) && IsLocal(key)) {
+            AddRangeWaiter(*it, txn);
+            not_acquired++;
+          }
+        }
+      }
+    }
+  }
+
   // Record and return the number of locks that the txn is blocked on.
   if (not_acquired > 0)
     txn_waits_[txn] = not_acquired;
@@ -98,14 +151,39 @@ void DeterministicLockManager::Release(TxnProto* txn) {
   for (int i = 0; i < txn->read_set_size(); i++)
     if (IsLocal(txn->read_set(i)))
       Release(txn->read_set(i), txn);
-  // Currently commented out because nothing in any write set can conflict
-  // in TPCC or Microbenchmark.
-//  for (int i = 0; i < txn->write_set_size(); i++)
-//    if (IsLocal(txn->write_set(i)))
-//      Release(txn->write_set(i), txn);
+  for (int i = 0; i < txn->write_set_size(); i++)
+    if (IsLocal(txn->write_set(i)))
+      Release(txn->write_set(i), txn);
   for (int i = 0; i < txn->read_write_set_size(); i++)
     if (IsLocal(txn->read_write_set(i)))
       Release(txn->read_write_set(i), txn);
+
+  // Release the txn's range locks; its writes no longer block later ones.
+  writers_.erase(txn);
+  if (txn->range_start_size() > 0) {
+    for (deque<RangeLockRequest>::iterator it = range_locks_.begin();
+         it != range_locks_.end();) {
+      if (it->txn == txn)
+        it = range_locks_.erase(it);
+      else
+        ++it;
+    }
+  }
+
+  // Txns that waited on this one because of range conflicts may now be ready.
+  unordered_map<TxnProto*, vector<TxnProto*> >::iterator waiters =
+      range_waiters_.find(txn);
+  if (waiters != range_waiters_.end()) {
+    for (uint32 i = 0; i < waiters->second.size(); i++) {
+      TxnProto* waiter = waiters->second[i];
+      txn_waits_[waiter]--;
+      if (txn_waits_[waiter] == 0) {
+        ready_txns_->push_back(waiter);
+        txn_waits_.erase(waiter);
+      }
+    }
+    range_waiters_.erase(waiters);
+  }
 }
 
 void DeterministicLockManager::Release(const Key& key, TxnProto* txn) {
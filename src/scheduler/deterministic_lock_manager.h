@@ -10,6 +10,8 @@
 #include <deque>
 //#include <unordered_map>
 #include <tr1/unordered_map>
+#include <tr1/unordered_set>
+#include <vector>
 
 #include "common/configuration.h"
 #include "scheduler/lock_manager.h"
@@ -18,6 +20,8 @@
 //using std::unordered_map;
 using std::tr1::unordered_map;
 using std::deque;
+using std::vector;
+using std::tr1::unordered_set;
 
 #define TABLE_SIZE 1000000
 
@@ -42,10 +46,21 @@ class DeterministicLockManager {
     return hash % TABLE_SIZE;
   }
 
+  // Requests a write lock on 'key' for 'txn'. Returns the number of locks
+  // the request waits on (earlier requests for the key, and earlier range
+  // locks covering it).
+  int LockForWrite(const Key& key, TxnProto* txn);
+
   bool IsLocal(const Key& key) {
     return configuration_->LookupPartition(key) == configuration_->this_node_id;
   }
 
+  bool IsLocalRange(const Key& start, const Key& end) {
+    set<int> nodes;
+    configuration_->LookupRangePartitions(start, end, &nodes);
+    return nodes.count(configuration_->this_node_id) > 0;
+  }
+
   // Configuration object (needed to avoid locking non-local keys).
   Configuration* configuration_;
 
@@ -72,6 +87,37 @@ class DeterministicLockManager {
 
   deque<KeysList>* lock_table_[TABLE_SIZE];
 
+  // Range locks. A txn reading a key range ('range_start'/'range_end') holds
+  // a read lock on the whole range, which conflicts with write locks on any
+  // key in it, including keys that do not exist yet (txns write lock the keys
+  // they insert, listed in their write sets), so nothing the range's scans see
+  // can change under them. Txns are locked in their global order,
+  // so each such conflict makes the later of the two txns wait until the
+  // earlier one releases all of its locks.
+  struct RangeLockRequest {
+    RangeLockRequest(TxnProto* t, const Key& s, const Key& e)
+        : txn(t), start(s), end(e) {}
+    TxnProto* txn;
+    Key start;
+    Key end;
+  };
+
+  // Adds a dependency of 'waiter' on 'owner' releasing its locks.
+  void AddRangeWaiter(TxnProto* owner, TxnProto* waiter) {
+    range_waiters_[owner].push_back(waiter);
+  }
+
+  // Range lock requests not yet released, in lock order.
+  deque<RangeLockRequest> range_locks_;
+
+  // Txns that requested write locks and have not released them yet, which a
+  // range lock request checks for writes to keys in its range. Tracking txns
+  // rather than keys keeps write lock requests as cheap as without ranges.
+  unordered_set<TxnProto*> writers_;
+
+  // Txns that wait on each txn because of a range conflict.
+  unordered_map<TxnProto*, vector<TxnProto*> > range_waiters_;
+
   // Queue of pointers to transactions that have acquired all locks that
   // they have requested. 'ready_txns_[key].front()' is the owner of the lock
   // for a specified key.
@@ -19,21 +19,26 @@
 #include <utility>
 #include <sched.h>
 #include <map>
+#include <set>
 
 #include "applications/application.h"
+#include "common/arena.h"
 #include "common/utils.h"
 #include "common/zmq.hpp"
 #include "common/connection.h"
+#include "backend/epoch_manager.h"
 #include "backend/storage.h"
 #include "backend/storage_manager.h"
 #include "proto/message.pb.h"
 #include "proto/txn.pb.h"
+#include "scheduler/batch_merger.h"
 #include "scheduler/deterministic_lock_manager.h"
+#include "scheduler/stream_merger.h"
 #include "applications/tpcc.h"
 
 // XXX(scw): why the F do we include from a separate component
 //           to get COLD_CUTOFF
-#include "sequencer/sequencer.h"  // COLD_CUTOFF and buffers in LATENCY_TEST
+#include "sequencer/sequencer.h"  // MAX_BATCH_SIZE and buffers in LATENCY_TEST
 
 using std::pair;
 using std::string;
@@ -69,6 +74,19 @@ DeterministicScheduler::DeterministicScheduler(Configuration* conf,
       storage_(storage), application_(application), to_lock_txns(input_queue), client_(client), queue_mode_(queue_mode) {
       ready_txns_ = new std::deque<TxnProto*>();
   lock_manager_ = new DeterministicLockManager(ready_txns_, configuration_);
+  batch_merger_ = NULL;
+  stream_merger_ = NULL;
+  if (configuration_->sequencer_mode == STREAM_SEQUENCING) {
+    stream_merger_ = new StreamMerger(configuration_->all_nodes.size(),
+                                      batch_connection_);
+  } else {
+    batch_merger_ = new BatchMerger(configuration_->all_nodes.size(),
+                                    batch_connection_);
+  }
+  snapshot_reads_ = batch_merger_ != NULL && queue_mode_ == NORMAL_QUEUE &&
+                    configuration_->snapshot_reads &&
+                    !configuration_->prefetching &&
+                    storage_->EnableSnapshotReads();
   
   txns_queue = new AtomicQueue<TxnProto*>();
   done_queue = new AtomicQueue<TxnProto*>();
@@ -118,18 +136,57 @@ std::cout << "Central locking thread starts at 4"<<std::endl;
 
 }
 
-void UnfetchAll(Storage* storage, TxnProto* txn) {
+// With prefetching, a txn's objects at this node are pinned in memory (and
+// fetched, if the sequencer's prefetch has not brought them in yet) from
+// before its StorageManager reads them until it has executed.
+void FetchAll(Storage* storage, Configuration* config, TxnProto* txn) {
+  double wait_time;
+  for (int i = 0; i < txn->read_set_size(); i++)
+    if (config->LookupPartition(txn->read_set(i)) == config->this_node_id)
+      storage->Prefetch(txn->read_set(i), &wait_time);
+  for (int i = 0; i < txn->read_write_set_size(); i++)
+    if (config->LookupPartition(txn->read_write_set(i)) ==
+        config->this_node_id)
+      storage->Prefetch(txn->read_write_set(i), &wait_time);
+  for (int i = 0; i < txn->write_set_size(); i++)
+    if (config->LookupPartition(txn->write_set(i)) == config->this_node_id)
+      storage->Prefetch(txn->write_set(i), &wait_time);
+}
+
+void UnfetchAll(Storage* storage, Configuration* config, TxnProto* txn) {
   for (int i = 0; i < txn->read_set_size(); i++)
-    if (StringToInt(txn->read_set(i)) > COLD_CUTOFF)
+    if (config->LookupPartition(txn->read_set(i)) == config->this_node_id)
       storage->Unfetch(txn->read_set(i));
   for (int i = 0; i < txn->read_write_set_size(); i++)
-    if (StringToInt(txn->read_write_set(i)) > COLD_CUTOFF)
+    if (config->LookupPartition(txn->read_write_set(i)) ==
+        config->this_node_id)
       storage->Unfetch(txn->read_write_set(i));
   for (int i = 0; i < txn->write_set_size(); i++)
-    if (StringToInt(txn->write_set(i)) > COLD_CUTOFF)
+    if (config->LookupPartition(txn->write_set(i)) == config->this_node_id)
       storage->Unfetch(txn->write_set(i));
 }
 
+// Prefetches the index entries of 'txn's reads at this node (see
+// Storage::PrefetchLookup).
+static void PrefetchLookups(Storage* storage, Configuration* config,
+                            TxnProto* txn) {
+  for (int i = 0; i < txn->read_set_size(); i++)
+    if (config->LookupPartition(txn->read_set(i)) == config->this_node_id)
+      storage->PrefetchLookup(txn->read_set(i));
+  for (int i = 0; i < txn->read_write_set_size(); i++)
+    if (config->LookupPartition(txn->read_write_set(i)) ==
+        config->this_node_id)
+      storage->PrefetchLookup(txn->read_write_set(i));
+}
+
+// Destroys 'manager' and the rest of its txn's transient objects, and keeps
+// their arena for the worker's next txn.
+static void FinishTxn(StorageManager* manager, vector<Arena*>* free_arenas) {
+  Arena* arena = manager->arena();
+  arena->Reset();
+  free_arenas->push_back(arena);
+}
+
 void* DeterministicScheduler::RunWorkerThread(void* arg) {
   int thread =
       reinterpret_cast<pair<int, DeterministicScheduler*>*>(arg)->first;
@@ -137,6 +194,11 @@ void* DeterministicScheduler::RunWorkerThread(void* arg) {
       reinterpret_cast<pair<int, DeterministicScheduler*>*>(arg)->second;
 
   unordered_map<string, StorageManager*> active_txns;
+
+  // Each txn's StorageManager and transient objects live in an arena of its
+  // own (txns waiting for remote reads overlap), reset and reused once the
+  // txn completes.
+  vector<Arena*> free_arenas;
   int counter = 0;
   double old_time = GetTime(), now_time;
 
@@ -153,7 +215,9 @@ void* DeterministicScheduler::RunWorkerThread(void* arg) {
         // Execute and clean up.
         TxnProto* txn = manager->txn_;
         scheduler->application_->Execute(txn, manager);
-        delete manager;
+        FinishTxn(manager, &free_arenas);
+        if (scheduler->configuration_->prefetching)
+          UnfetchAll(scheduler->storage_, scheduler->configuration_, txn);
 
         scheduler->thread_connections_[thread]->
             UnlinkChannel(IntToString(txn->txn_id()));
@@ -163,28 +227,59 @@ void* DeterministicScheduler::RunWorkerThread(void* arg) {
         scheduler->done_queue->Push(txn);
       }
     } else {
-      // No remote read result found, start on next txn if one is waiting.
-     TxnProto* txn;
-     bool got_it;
-     if (scheduler->queue_mode_ == SELF_QUEUE){
-		  got_it = true;
-		  scheduler->client_->GetTxn(&txn, counter++);
-		  scheduler->add_readers_writers(txn);
-     } else{
-    	 got_it = scheduler->txns_queue->Pop(&txn);
-     }
-      if (got_it == true) {
-        // Create manager.
-        StorageManager* manager =
-            new StorageManager(scheduler->configuration_,
-                               scheduler->thread_connections_[thread],
-                               scheduler->storage_, txn);
+      // No remote read result found, start on the next txns if any are
+      // waiting. The ready txns are started in a group, in stages: their
+      // index entries are prefetched first, then looked up (prefetching the
+      // objects) by constructing their managers, and the objects' contents
+      // are prefetched before the first of them executes. Each stage's cache
+      // misses thus overlap instead of stalling one txn at a time.
+      TxnProto* group[PREFETCH_GROUP];
+      int group_size = 0;
+      if (scheduler->queue_mode_ == SELF_QUEUE) {
+        scheduler->client_->GetTxn(&group[group_size++], counter++);
+        scheduler->add_readers_writers(group[0]);
+      } else {
+        while (group_size < PREFETCH_GROUP &&
+               scheduler->txns_queue->Pop(&group[group_size]))
+          group_size++;
+      }
+      if (group_size > 1) {
+        EpochPin pin(scheduler->storage_->epochs());
+        for (int i = 0; i < group_size; i++)
+          PrefetchLookups(scheduler->storage_, scheduler->configuration_,
+                          group[i]);
+      }
 
+      // Create managers.
+      StorageManager* managers[PREFETCH_GROUP];
+      for (int i = 0; i < group_size; i++) {
+        Arena* arena;
+        if (free_arenas.empty()) {
+          arena = new Arena();
+        } else {
+          arena = free_arenas.back();
+          free_arenas.pop_back();
+        }
+        if (scheduler->configuration_->prefetching)
+          FetchAll(scheduler->storage_, scheduler->configuration_, group[i]);
+        managers[i] =
+            arena->New<StorageManager>(scheduler->configuration_,
+                                       scheduler->thread_connections_[thread],
+                                       scheduler->storage_, group[i], arena);
+      }
+      for (int i = 0; i < group_size; i++)
+        managers[i]->PrefetchReads();
+
+      for (int i = 0; i < group_size; i++) {
+        TxnProto* txn = group[i];
+        StorageManager* manager = managers[i];
           // Writes occur at this node.
           if (manager->ReadyToExecute()) {
             // No remote reads. Execute and clean up.
             scheduler->application_->Execute(txn, manager);
-            delete manager;
+            FinishTxn(manager, &free_arenas);
+            if (scheduler->configuration_->prefetching)
+              UnfetchAll(scheduler->storage_, scheduler->configuration_, txn);
 
             // Respond to scheduler;
             //scheduler->SendTxnPtr(scheduler->responses_out_[thread], txn);
@@ -215,27 +310,16 @@ void* DeterministicScheduler::RunWorkerThread(void* arg) {
 DeterministicScheduler::~DeterministicScheduler() {
 }
 
-// Returns ptr to heap-allocated
-unordered_map<int, MessageProto*> batches;
-MessageProto* GetBatch(int batch_id, Connection* connection) {
-  if (batches.count(batch_id) > 0) {
-    // Requested batch has already been received.
-    MessageProto* batch = batches[batch_id];
-    batches.erase(batch_id);
-    return batch;
-  } else {
-    MessageProto* message = new MessageProto();
-    while (connection->GetMessage(message)) {
-      assert(message->type() == MessageProto::TXN_BATCH);
-      if (message->batch_number() == batch_id) {
-        return message;
-      } else {
-        batches[message->batch_number()] = message;
-        message = new MessageProto();
-      }
-    }
-    delete message;
-    return NULL;
+// Drops a reference to the protobuf arena of a batch's txns, freeing it with
+// the last one.
+static void ReleaseBatchArena(
+    unordered_map<google::protobuf::Arena*, int>* batch_arenas,
+    google::protobuf::Arena* arena) {
+  unordered_map<google::protobuf::Arena*, int>::iterator it =
+      batch_arenas->find(arena);
+  if (--it->second == 0) {
+    batch_arenas->erase(it);
+    delete arena;
   }
 }
 
@@ -250,33 +334,130 @@ void* DeterministicScheduler::LockManagerThread(void* arg) {
   int executing_txns = 0;
   int pending_txns = 0;
   int batch_offset = 0;
-  int batch_number = 0;
+  int64 epoch = scheduler->configuration_->first_epoch;
+  bool replaying = scheduler->queue_mode_ == NORMAL_QUEUE &&
+                   scheduler->to_lock_txns != NULL;
+
+  // Checkpoint currently being taken: the last txn id it includes, and the
+  // number of txns up to that id which have not finished executing yet.
+  int64 checkpoint_stable = -1;
+  int checkpoint_outstanding = 0;
+  int checkpoint_interval = scheduler->configuration_->checkpoint_interval;
+  int64 txns_per_epoch =
+      scheduler->configuration_->all_nodes.size() * MAX_BATCH_SIZE;
+
+  // The txns of each batch are parsed onto a protobuf arena of the batch,
+  // freed in one go once all of them are done. Counts the txns of each arena
+  // that are not done yet, plus one while the batch is being parsed.
+  unordered_map<google::protobuf::Arena*, int> batch_arenas;
+  google::protobuf::Arena* batch_arena = NULL;
+
+  // Snapshot reads: the txns of each epoch that took locks and are not done
+  // yet, and the number of epochs that are stable (read in full and done),
+  // which makes every txn id below stable_epochs * txns_per_epoch stable.
+  // Read-only txns wait in 'snapshot_waiting' until their snapshot is
+  // stable; 'snapshots' holds the snapshots of those not done yet. Every
+  // participant of a multi-partition read-only txn waits for the same
+  // snapshot, so they all read the same cluster-wide state.
+  std::map<int64, int> epoch_outstanding;
+  int64 stable_epochs = epoch;
+  std::multiset<int64> snapshots;
+  std::deque<TxnProto*> snapshot_waiting;
+  int64 snapshot_horizon = -1;
 //int test = 0;
   while (true) {
     TxnProto* done_txn;
     bool got_it = scheduler->done_queue->Pop(&done_txn);
     if (got_it == true) {
       // We have received a finished transaction back, release the lock
-      scheduler->lock_manager_->Release(done_txn);
+      if (done_txn->isolation_level() == TxnProto::SNAPSHOT) {
+        snapshots.erase(snapshots.find(done_txn->snapshot()));
+      } else {
+        scheduler->lock_manager_->Release(done_txn);
+        if (scheduler->snapshot_reads_)
+          epoch_outstanding[done_txn->txn_id() / txns_per_epoch]--;
+      }
       executing_txns--;
 
+      // Once every txn before the boundary is done, the stable versions are
+      // final and can be written out in the background.
+      if (checkpoint_outstanding > 0 &&
+          done_txn->txn_id() <= checkpoint_stable &&
+          --checkpoint_outstanding == 0) {
+        scheduler->storage_->Checkpoint();
+      }
+
       if(done_txn->writers_size() == 0 || rand() % done_txn->writers_size() == 0)
         txns++;
       //else
     	//  std::cout<<"WTF, not true? Writer size is "<<done_txn->writers_size()<<std::endl;
-      delete done_txn;
-
+      google::protobuf::Arena* arena = done_txn->GetArena();
+      if (arena == NULL)
+        delete done_txn;
+      else
+        ReleaseBatchArena(&batch_arenas, arena);
+
+    } else if (replaying) {
+      // Recovery: lock the replayed txns in log order. The NULL after them
+      // hands over to the epochs the sequencers start at.
+      if (executing_txns + pending_txns < 2000) {
+        for (int i = 0; i < 100; i++) {
+          TxnProto* txn;
+          if (!scheduler->to_lock_txns->Pop(&txn))
+            break;
+          if (txn == NULL) {
+            replaying = false;
+            epoch = scheduler->configuration_->first_epoch;
+            break;
+          }
+          // Snapshot reads are replayed with locks.
+          txn->clear_isolation_level();
+          txn->clear_snapshot();
+          if (scheduler->snapshot_reads_)
+            epoch_outstanding[txn->txn_id() / txns_per_epoch]++;
+          scheduler->lock_manager_->Lock(txn);
+          pending_txns++;
+        }
+      }
+    } else if (scheduler->queue_mode_ == NORMAL_QUEUE &&
+               scheduler->stream_merger_ != NULL) {
+      // Lock streamed txns as soon as their position in the order is final.
+      if (executing_txns + pending_txns < 2000) {
+        for (int i = 0; i < 100; i++) {
+          TxnProto* txn = scheduler->stream_merger_->NextTxn();
+          if (txn == NULL)
+            break;
+          scheduler->lock_manager_->Lock(txn);
+          pending_txns++;
+        }
+      }
     } else if (scheduler->queue_mode_ == NORMAL_QUEUE){
       // Have we run out of txns in our batch? Let's get some new ones.
       if (batch_message == NULL) {
-        batch_message = GetBatch(batch_number, scheduler->batch_connection_);
+        batch_message = scheduler->batch_merger_->GetEpoch(epoch);
 
       // Done with current batch, get next.
       } else if (batch_offset >= batch_message->data_size()) {
         batch_offset = 0;
-        batch_number++;
+        epoch++;
         delete batch_message;
-        batch_message = GetBatch(batch_number, scheduler->batch_connection_);
+        if (batch_arena != NULL) {
+          ReleaseBatchArena(&batch_arenas, batch_arena);
+          batch_arena = NULL;
+        }
+
+        // Every txn of the epochs so far has been locked, and none of the
+        // next: start a checkpoint at the boundary without waiting for them
+        // to finish.
+        if (checkpoint_interval > 0 && epoch % checkpoint_interval == 0 &&
+            !scheduler->storage_->CheckpointInProgress()) {
+          checkpoint_stable = epoch * txns_per_epoch - 1;
+          checkpoint_outstanding = executing_txns + pending_txns;
+          scheduler->storage_->PrepareForCheckpoint(checkpoint_stable);
+          if (checkpoint_outstanding == 0)
+            scheduler->storage_->Checkpoint();
+        }
+        batch_message = scheduler->batch_merger_->GetEpoch(epoch);
 
       // Current batch has remaining txns, grab up to 10.
       } else if (executing_txns + pending_txns < 2000) {
@@ -286,10 +467,29 @@ void* DeterministicScheduler::LockManagerThread(void* arg) {
             // Oops we ran out of txns in this batch. Stop adding txns for now.
             break;
           }
-          TxnProto* txn = new TxnProto();
+          if (batch_arena == NULL) {
+            batch_arena = new google::protobuf::Arena();
+            batch_arenas[batch_arena] = 1;
+          }
+          TxnProto* txn =
+              google::protobuf::Arena::CreateMessage<TxnProto>(batch_arena);
+          batch_arenas[batch_arena]++;
           txn->ParseFromString(batch_message->data(batch_offset));
           batch_offset++;
 
+          if (txn->isolation_level() == TxnProto::SNAPSHOT) {
+            if (scheduler->snapshot_reads_) {
+              snapshots.insert(txn->snapshot());
+              snapshot_waiting.push_back(txn);
+              pending_txns++;
+              continue;
+            }
+            // No versions to read a snapshot from: lock as usual.
+            txn->clear_isolation_level();
+            txn->clear_snapshot();
+          }
+          if (scheduler->snapshot_reads_)
+            epoch_outstanding[txn->txn_id() / txns_per_epoch]++;
           scheduler->lock_manager_->Lock(txn);
           pending_txns++;
         }
@@ -311,6 +511,35 @@ void* DeterministicScheduler::LockManagerThread(void* arg) {
     	}
     }
 
+    if (scheduler->snapshot_reads_) {
+      while (stable_epochs < epoch) {
+        std::map<int64, int>::iterator it =
+            epoch_outstanding.find(stable_epochs);
+        if (it != epoch_outstanding.end()) {
+          if (it->second > 0)
+            break;
+          epoch_outstanding.erase(it);
+        }
+        stable_epochs++;
+      }
+      int64 stable = stable_epochs * txns_per_epoch - 1;
+      while (!snapshot_waiting.empty() &&
+             snapshot_waiting.front()->snapshot() <= stable) {
+        scheduler->ready_txns_->push_back(snapshot_waiting.front());
+        snapshot_waiting.pop_front();
+      }
+
+      // Later read-only txns have snapshots no older than 'stable', so the
+      // storage may drop the versions no snapshot in use or to come needs.
+      int64 horizon = stable;
+      if (!snapshots.empty() && *snapshots.begin() < horizon)
+        horizon = *snapshots.begin();
+      if (horizon > snapshot_horizon) {
+        snapshot_horizon = horizon;
+        scheduler->storage_->SetSnapshotHorizon(horizon);
+      }
+    }
+
     // Start executing any and all ready transactions to get them off our plate
     while (!scheduler->ready_txns_->empty()) {
       TxnProto* txn = scheduler->ready_txns_->front();
@@ -330,7 +559,14 @@ void* DeterministicScheduler::LockManagerThread(void* arg) {
                 << " txns/sec, "
                 //<< test<< " for drop speed , " 
                 << executing_txns << " executing, "
-                << pending_txns << " pending\n" << std::flush;
+                << pending_txns << " pending"
+                << (scheduler->storage_->CheckpointInProgress() ?
+                    ", checkpointing\n" : "\n");
+      if (scheduler->batch_merger_ != NULL)
+        scheduler->batch_merger_->ReportLag(std::cout);
+      else if (scheduler->stream_merger_ != NULL)
+        scheduler->stream_merger_->ReportLag(std::cout);
+      std::cout << std::flush;
       // Reset txn count.
       time = GetTime();
       txns = 0;
@@ -36,12 +36,21 @@ class DeterministicLockManager;
 class Storage;
 class TxnProto;
 class Client;
+class BatchMerger;
+class StreamMerger;
 
 #define NUM_THREADS 4
-// #define PREFETCHING
+
+// Maximum number of ready txns a worker starts together, overlapping the
+// cache misses of their reads (see RunWorkerThread).
+#define PREFETCH_GROUP 8
 
 class DeterministicScheduler : public Scheduler {
  public:
+  // In DIRECT_QUEUE mode, txns to execute are taken from 'input_queue'. In
+  // NORMAL_QUEUE mode, a non-NULL 'input_queue' holds txns replayed during
+  // recovery (see sequencer/replayer.h), which are executed up to a NULL
+  // txn before the sequenced batches from conf->first_epoch on.
   DeterministicScheduler(Configuration* conf, Connection* batch_connection, Storage* storage,
 		  const Application* application, AtomicQueue<TxnProto*>* input_queue, Client* client, int queue_mode);
   virtual ~DeterministicScheduler();
@@ -65,6 +74,9 @@ class DeterministicScheduler : public Scheduler {
           writers.insert(configuration_->LookupPartition(txn->read_write_set(i)));
           readers.insert(configuration_->LookupPartition(txn->read_write_set(i)));
         }
+        for (int i = 0; i < txn->range_start_size(); i++)
+          configuration_->LookupRangePartitions(txn->range_start(i),
+                                                txn->range_end(i), &readers);
 
         for (set<int>::iterator it = readers.begin(); it != readers.end(); ++it)
           txn->add_readers(*it);
@@ -99,10 +111,22 @@ class DeterministicScheduler : public Scheduler {
   // and enforce equivalence to transaction orders.
   DeterministicLockManager* lock_manager_;
 
+  // Merges the per-origin sub-batches received on 'batch_connection_' into
+  // one batch per epoch. Used in EPOCH_SEQUENCING mode.
+  BatchMerger* batch_merger_;
+
+  // Orders txns streamed on 'batch_connection_' by timestamp. Used in
+  // STREAM_SEQUENCING mode.
+  StreamMerger* stream_merger_;
+
   // Queue of transaction ids of transactions that have acquired all locks that
   // they have requested.
   std::deque<TxnProto*>* ready_txns_;
 
+  // True if read-only txns tagged by the sequencer read snapshots without
+  // taking locks (see Configuration::snapshot_reads).
+  bool snapshot_reads_;
+
   // Sockets for communication between main scheduler thread and worker threads.
 //  socket_t* requests_out_;
 //  socket_t* requests_in_;
@@ -0,0 +1,89 @@
+// Author: Kun Ren (kun@cs.yale.edu)
+//
+// The StreamMerger orders the txns that sequencers stream to this scheduler
+// in STREAM_SEQUENCING mode.
+
+#include "scheduler/stream_merger.h"
+
+#include <cassert>
+
+#include "common/connection.h"
+#include "proto/message.pb.h"
+#include "proto/txn.pb.h"
+
+bool StreamMerger::LaterTxn::operator()(TxnProto* a, TxnProto* b) const {
+  return a->txn_id() > b->txn_id();
+}
+
+StreamMerger::StreamMerger(int num_origins, Connection* connection)
+    : num_origins_(num_origins), connection_(connection),
+      watermarks_(num_origins, -1) {
+}
+
+StreamMerger::~StreamMerger() {
+  while (!pending_.empty()) {
+    delete pending_.top();
+    pending_.pop();
+  }
+}
+
+void StreamMerger::AddMessage(const MessageProto& message) {
+  assert(message.type() == MessageProto::TXN_STREAM);
+  for (int i = 0; i < message.data_size(); i++) {
+    TxnProto* txn = new TxnProto();
+    txn->ParseFromString(message.data(i));
+    pending_.push(txn);
+  }
+  int origin = message.source_node();
+  if (message.watermark() > watermarks_[origin])
+    watermarks_[origin] = message.watermark();
+}
+
+void StreamMerger::Receive() {
+  if (connection_ == NULL)
+    return;
+  MessageProto message;
+  while (connection_->GetMessage(&message))
+    AddMessage(message);
+}
+
+TxnProto* StreamMerger::NextTxn() {
+  if (pending_.empty())
+    Receive();
+  if (pending_.empty())
+    return NULL;
+
+  int64 watermark = watermarks_[0];
+  for (int i = 1; i < num_origins_; i++)
+    if (watermarks_[i] < watermark)
+      watermark = watermarks_[i];
+
+  TxnProto* txn = pending_.top();
+  if (txn->txn_id() / num_origins_ > watermark) {
+    // Some origin may still send an earlier txn.
+    Receive();
+    return NULL;
+  }
+  pending_.pop();
+  return txn;
+}
+
+void StreamMerger::ReportLag(std::ostream& out) {
+  int64 latest = -1;
+  for (int i = 0; i < num_origins_; i++)
+    if (watermarks_[i] > latest)
+      latest = watermarks_[i];
+
+  bool reported = false;
+  for (int i = 0; i < num_origins_; i++) {
+    // Watermarks are in microseconds.
+    double lag = (latest - watermarks_[i]) / 1000.0;
+    if (lag >= 1) {
+      out << (reported ? ", " : "Watermark lag: ")
+          << "node " << i << " " << lag << "ms";
+      reported = true;
+    }
+  }
+  if (reported)
+    out << "\n";
+}
@@ -0,0 +1,67 @@
+// Author: Kun Ren (kun@cs.yale.edu)
+//
+// The StreamMerger orders the txns that sequencers stream to this scheduler
+// in STREAM_SEQUENCING mode.
+//
+// Each streamed txn carries the hybrid logical timestamp its origin assigned
+// to it, encoded in its id as 'timestamp * num_origins + origin', so sorting
+// by txn id sorts by (timestamp, origin). Every TXN_STREAM message also carries
+// the origin's watermark: all txns that origin sends later will have larger
+// timestamps. A txn's position in the global order is therefore final as soon
+// as every origin's watermark has reached its timestamp, and it can be handed
+// to the lock manager immediately rather than at the end of an epoch.
+
+#ifndef _DB_SCHEDULER_STREAM_MERGER_H_
+#define _DB_SCHEDULER_STREAM_MERGER_H_
+
+#include <ostream>
+#include <queue>
+#include <vector>
+
+#include "common/types.h"
+
+using std::priority_queue;
+using std::vector;
+
+class Connection;
+class MessageProto;
+class TxnProto;
+
+class StreamMerger {
+ public:
+  // Streams are read from 'connection', which is not owned by the merger. If
+  // 'connection' is NULL, messages must be supplied via AddMessage.
+  StreamMerger(int num_origins, Connection* connection);
+  ~StreamMerger();
+
+  // Returns the next txn in the global order if its position is final, or
+  // NULL otherwise. The caller takes ownership of the returned txn.
+  TxnProto* NextTxn();
+
+  // Hands an already received TXN_STREAM message to the merger. The message is
+  // not retained.
+  void AddMessage(const MessageProto& message);
+
+  // Writes a one-line summary of how far each origin's watermark trails the
+  // most advanced one.
+  void ReportLag(std::ostream& out);
+
+ private:
+  // Drains all messages currently available on 'connection_'.
+  void Receive();
+
+  struct LaterTxn {
+    bool operator()(TxnProto* a, TxnProto* b) const;
+  };
+
+  int num_origins_;
+  Connection* connection_;
+
+  // Received txns whose position is not yet final, earliest first.
+  priority_queue<TxnProto*, vector<TxnProto*>, LaterTxn> pending_;
+
+  // Latest watermark received from each origin (-1 if none).
+  vector<int64> watermarks_;
+};
+
+#endif  // _DB_SCHEDULER_STREAM_MERGER_H_
@@ -0,0 +1,164 @@
+// Author: Kun Ren (kun@cs.yale.edu)
+//
+// The BatchRelay disseminates sequencer output along a two-level tree instead
+// of having every sequencer send a TXN_BATCH to every scheduler each epoch.
+
+#include "sequencer/batch_relay.h"
+
+#include <algorithm>
+#include <cassert>
+
+#include "common/configuration.h"
+#include "common/connection.h"
+#include "common/utils.h"
+#include "proto/message.pb.h"
+
+int BatchRelay::RelayFor(const Configuration& conf, int node) {
+  return node - node % conf.dissemination_fanout;
+}
+
+bool BatchRelay::IsRelay(const Configuration& conf, int node) {
+  return conf.dissemination_fanout > 0 && RelayFor(conf, node) == node;
+}
+
+void* BatchRelay::RunRelay(void* arg) {
+  reinterpret_cast<BatchRelay*>(arg)->Run();
+  return NULL;
+}
+
+BatchRelay::BatchRelay(Configuration* conf, Connection* connection)
+    : configuration_(conf), connection_(connection),
+      deconstructor_invoked_(false) {
+  int num_nodes = configuration_->all_nodes.size();
+  fanout_ = configuration_->dissemination_fanout;
+  num_groups_ = (num_nodes + fanout_ - 1) / fanout_;
+  group_ = configuration_->this_node_id / fanout_;
+  group_size_ = std::min(fanout_, num_nodes - group_ * fanout_);
+
+  connection_->LinkChannel("relay_down");
+  pthread_create(&thread_, NULL, RunRelay, reinterpret_cast<void*>(this));
+}
+
+BatchRelay::~BatchRelay() {
+  deconstructor_invoked_ = true;
+  pthread_join(thread_, NULL);
+  delete connection_;
+}
+
+void BatchRelay::Run() {
+  int num_nodes = configuration_->all_nodes.size();
+  MessageProto* message = new MessageProto();
+  while (!deconstructor_invoked_) {
+    if (!connection_->GetMessage(message)) {
+      Flush(&up_bundles_, &BatchRelay::SendUp);
+      Flush(&down_bundles_, &BatchRelay::SendDown);
+      Spin(0.0001);
+      continue;
+    }
+    assert(message->type() == MessageProto::TXN_BATCH_BUNDLE);
+    if (message->destination_channel() == "relay") {
+      Collect(&up_bundles_, message->batch_number() / num_nodes, message,
+              group_size_, &BatchRelay::SendUp);
+    } else {
+      Collect(&down_bundles_, message->batch_number(), message, num_groups_,
+              &BatchRelay::SendDown);
+    }
+    message = new MessageProto();
+  }
+  delete message;
+
+  for (int i = 0; i < 2; i++) {
+    map<int64, Pending>* pending = i == 0 ? &up_bundles_ : &down_bundles_;
+    for (map<int64, Pending>::iterator it = pending->begin();
+         it != pending->end(); ++it) {
+      for (uint32 j = 0; j < it->second.bundles.size(); j++)
+        delete it->second.bundles[j];
+    }
+  }
+}
+
+void BatchRelay::Collect(map<int64, Pending>* pending, int64 epoch,
+                         MessageProto* bundle, int expected,
+                         SendFunction send) {
+  Pending* p = &(*pending)[epoch];
+  if (p->received == 0)
+    p->deadline = GetTime() + RELAY_MAX_WAIT;
+  p->bundles.push_back(bundle);
+  p->received++;
+  if (p->flushed || p->received == expected)
+    (this->*send)(epoch, &p->bundles);
+  if (p->received == expected)
+    pending->erase(epoch);
+}
+
+void BatchRelay::Flush(map<int64, Pending>* pending, SendFunction send) {
+  double now = GetTime();
+  for (map<int64, Pending>::iterator it = pending->begin();
+       it != pending->end();) {
+    Pending* p = &it->second;
+    if (now < p->deadline) {
+      ++it;
+    } else if (!p->flushed) {
+      (this->*send)(it->first, &p->bundles);
+      p->flushed = true;
+      p->deadline = now + RELAY_FORGET_TIME;
+      ++it;
+    } else {
+      pending->erase(it++);
+    }
+  }
+}
+
+void BatchRelay::SendUp(int64 epoch, vector<MessageProto*>* bundles) {
+  vector<MessageProto> group_bundles(num_groups_);
+  for (int g = 0; g < num_groups_; g++) {
+    group_bundles[g].set_type(MessageProto::TXN_BATCH_BUNDLE);
+    group_bundles[g].set_destination_node(g * fanout_);
+    group_bundles[g].set_destination_channel("relay_down");
+    group_bundles[g].set_source_node(configuration_->this_node_id);
+    group_bundles[g].set_batch_number(epoch);
+  }
+
+  for (uint32 i = 0; i < bundles->size(); i++) {
+    MessageProto* bundle = (*bundles)[i];
+    for (int j = 0; j < bundle->data_size(); j++) {
+      int destination = bundle->bundle_destinations(j);
+      MessageProto* group_bundle = &group_bundles[destination / fanout_];
+      group_bundle->add_data()->swap(*bundle->mutable_data(j));
+      group_bundle->add_bundle_destinations(destination);
+    }
+    delete bundle;
+  }
+  bundles->clear();
+
+  for (int g = 0; g < num_groups_; g++)
+    if (group_bundles[g].data_size() > 0)
+      connection_->Send(group_bundles[g]);
+}
+
+void BatchRelay::SendDown(int64 epoch, vector<MessageProto*>* bundles) {
+  vector<MessageProto> node_bundles(group_size_);
+  for (int i = 0; i < group_size_; i++) {
+    node_bundles[i].set_type(MessageProto::TXN_BATCH_BUNDLE);
+    node_bundles[i].set_destination_node(group_ * fanout_ + i);
+    node_bundles[i].set_destination_channel("scheduler_");
+    node_bundles[i].set_source_node(configuration_->this_node_id);
+    node_bundles[i].set_batch_number(epoch);
+  }
+
+  for (uint32 i = 0; i < bundles->size(); i++) {
+    MessageProto* bundle = (*bundles)[i];
+    for (int j = 0; j < bundle->data_size(); j++) {
+      int destination = bundle->bundle_destinations(j);
+      MessageProto* node_bundle = &node_bundles[destination % fanout_];
+      node_bundle->add_data()->swap(*bundle->mutable_data(j));
+      node_bundle->add_bundle_destinations(destination);
+    }
+    delete bundle;
+  }
+  bundles->clear();
+
+  for (int i = 0; i < group_size_; i++)
+    if (node_bundles[i].data_size() > 0)
+      connection_->Send(node_bundles[i]);
+}
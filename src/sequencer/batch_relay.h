@@ -0,0 +1,126 @@
+// Author: Kun Ren (kun@cs.yale.edu)
+//
+// The BatchRelay disseminates sequencer output along a two-level tree instead
+// of having every sequencer send a TXN_BATCH to every scheduler each epoch.
+//
+// With a dissemination fan-out of K, nodes are split into groups of K
+// consecutive node ids, and the first node of each group runs a relay:
+//
+//  1. Every sequencer sends one TXN_BATCH_BUNDLE holding its sub-batches for
+//     all nodes to its own group's relay ("relay" channel).
+//  2. Once a relay has every group member's bundle for an epoch, it sends one
+//     bundle to each group's relay ("relay_down" channel) holding the
+//     sub-batches for that group's nodes.
+//  3. Once a relay has the bundles of every group for an epoch, it sends each
+//     member scheduler one bundle holding all sub-batches addressed to it.
+//
+// This takes N + G^2 + N messages per epoch for G = N / K groups, rather than
+// N^2, and each scheduler receives one message per epoch.
+//
+// A relay waits at most RELAY_MAX_WAIT for the rest of an epoch's bundles, so
+// that a stalled sequencer or relay delays only its own sub-batches rather
+// than everything its group sends or receives. It then forwards what it has,
+// and forwards bundles arriving later for that epoch one at a time.
+
+#ifndef _DB_SEQUENCER_BATCH_RELAY_H_
+#define _DB_SEQUENCER_BATCH_RELAY_H_
+
+#include <pthread.h>
+
+#include <map>
+#include <vector>
+
+#include "common/types.h"
+
+using std::map;
+using std::vector;
+
+// Time in seconds a relay waits for the rest of an epoch's bundles once the
+// first has arrived.
+#define RELAY_MAX_WAIT 0.005
+
+// Time in seconds after which a relay forgets an epoch it has forwarded
+// without hearing from every sender.
+#define RELAY_FORGET_TIME 1.0
+
+class Configuration;
+class Connection;
+class MessageProto;
+
+class BatchRelay {
+ public:
+  // Starts the relay's main loop in a background thread. 'connection' must be
+  // registered on the "relay" channel and is owned by the relay.
+  BatchRelay(Configuration* conf, Connection* connection);
+
+  // Halts the main loop.
+  ~BatchRelay();
+
+  // Returns the node that relays batches for 'node' under 'conf'.
+  static int RelayFor(const Configuration& conf, int node);
+
+  // Returns true if 'node' is the relay of its group under 'conf'.
+  static bool IsRelay(const Configuration& conf, int node);
+
+ private:
+  // Main loop: forwards bundles as described above.
+  void Run();
+  static void* RunRelay(void* arg);
+
+  // Forwards the bundles collected for 'epoch' from this group's members to
+  // every group's relay.
+  void SendUp(int64 epoch, vector<MessageProto*>* bundles);
+
+  // Delivers the bundles collected for 'epoch' from every group to this
+  // group's members.
+  void SendDown(int64 epoch, vector<MessageProto*>* bundles);
+
+  // The bundles collected for an epoch so far.
+  struct Pending {
+    Pending() : received(0), deadline(0), flushed(false) {}
+
+    // Bundles not yet forwarded.
+    vector<MessageProto*> bundles;
+
+    // Number of bundles received, forwarded or not.
+    int received;
+
+    // Time at which the relay stops waiting for the rest of the bundles (or,
+    // once flushed, forgets the epoch).
+    double deadline;
+
+    // True once the relay has stopped waiting.
+    bool flushed;
+  };
+  typedef void (BatchRelay::*SendFunction)(int64, vector<MessageProto*>*);
+
+  // Adds 'bundle' to those collected for 'epoch', forwarding them with 'send'
+  // once all 'expected' bundles are in (or at once if the epoch was flushed).
+  void Collect(map<int64, Pending>* pending, int64 epoch, MessageProto* bundle,
+               int expected, SendFunction send);
+
+  // Forwards the bundles of epochs whose wait has run out.
+  void Flush(map<int64, Pending>* pending, SendFunction send);
+
+  Configuration* configuration_;
+  Connection* connection_;
+
+  // Dissemination fan-out, number of groups, and this relay's group.
+  int fanout_;
+  int num_groups_;
+  int group_;
+
+  // Number of nodes in this relay's group.
+  int group_size_;
+
+  // Bundles received from this group's sequencers, per epoch.
+  map<int64, Pending> up_bundles_;
+
+  // Bundles received from every group's relay, per epoch.
+  map<int64, Pending> down_bundles_;
+
+  pthread_t thread_;
+  bool deconstructor_invoked_;
+};
+
+#endif  // _DB_SEQUENCER_BATCH_RELAY_H_
@@ -0,0 +1,42 @@
+// Author: Kun Ren (kun.ren@yale.edu)
+//
+// A model of prefetch latencies per device (see fetch_latency_model.h).
+
+#include "sequencer/fetch_latency_model.h"
+
+void FetchLatencyModel::Record(int device, double latency) {
+  Histogram* histogram = &devices_[device];
+  int bucket = 0;
+  for (double bound = FETCH_LATENCY_MIN;
+       latency >= bound && bucket < FETCH_LATENCY_BUCKETS - 1;
+       bound *= 2) {
+    bucket++;
+  }
+  histogram->counts[bucket]++;
+  histogram->total++;
+
+  // Age the samples so that recent ones dominate.
+  if (++histogram->since_decay == FETCH_LATENCY_WINDOW) {
+    for (int i = 0; i < FETCH_LATENCY_BUCKETS; i++)
+      histogram->counts[i] /= 2;
+    histogram->total /= 2;
+    histogram->since_decay = 0;
+  }
+}
+
+double FetchLatencyModel::Percentile(int device, double percentile) const {
+  map<int, Histogram>::const_iterator it = devices_.find(device);
+  if (it == devices_.end() || it->second.total == 0)
+    return 0;
+  const Histogram& histogram = it->second;
+
+  double rank = histogram.total * percentile / 100;
+  double seen = 0;
+  double bound = FETCH_LATENCY_MIN;
+  for (int i = 0; i < FETCH_LATENCY_BUCKETS; i++, bound *= 2) {
+    seen += histogram.counts[i];
+    if (seen >= rank && histogram.counts[i] > 0)
+      return i == 0 ? 0 : bound;
+  }
+  return bound / 2;
+}
@@ -0,0 +1,61 @@
+// Author: Kun Ren (kun.ren@yale.edu)
+//
+// A model of how long prefetches take on each device (the storage of each
+// node), learned from the prefetches that completed recently. The sequencer
+// uses it to estimate when a txn's cold objects at other nodes will be in
+// memory, and defers the txn to the first batch expected to start after
+// that.
+//
+// Latencies are kept in a histogram per device with buckets doubling in
+// width from FETCH_LATENCY_MIN, so percentiles are exact to within a factor
+// of two. Every FETCH_LATENCY_WINDOW samples the counts are halved, so the
+// model follows changes in the load of a device.
+//
+// Not thread-safe: the sequencer's writer is its only user.
+
+#ifndef _DB_SEQUENCER_FETCH_LATENCY_MODEL_H_
+#define _DB_SEQUENCER_FETCH_LATENCY_MODEL_H_
+
+#include <map>
+
+using std::map;
+
+// Latencies below this (in seconds) count as no wait at all.
+#define FETCH_LATENCY_MIN 0.00001
+#define FETCH_LATENCY_BUCKETS 32
+#define FETCH_LATENCY_WINDOW 1000
+
+class FetchLatencyModel {
+ public:
+  FetchLatencyModel() {}
+
+  // Records that a prefetch at 'device' took 'latency' seconds.
+  void Record(int device, double latency);
+
+  // Returns the 'percentile'th percentile (0 to 100) of the recent prefetch
+  // latencies at 'device', rounded up to its bucket's bound, or 0 if none
+  // were recorded.
+  double Percentile(int device, double percentile) const;
+
+ private:
+  struct Histogram {
+    // Bucket 0 counts latencies below FETCH_LATENCY_MIN, bucket i > 0 those
+    // below FETCH_LATENCY_MIN * 2^i (the last one also all longer ones).
+    double counts[FETCH_LATENCY_BUCKETS];
+    double total;
+    int since_decay;
+
+    Histogram() : total(0), since_decay(0) {
+      for (int i = 0; i < FETCH_LATENCY_BUCKETS; i++)
+        counts[i] = 0;
+    }
+  };
+
+  map<int, Histogram> devices_;
+
+  // DISALLOW_COPY_AND_ASSIGN
+  FetchLatencyModel(const FetchLatencyModel&);
+  FetchLatencyModel& operator=(const FetchLatencyModel&);
+};
+
+#endif  // _DB_SEQUENCER_FETCH_LATENCY_MODEL_H_
@@ -0,0 +1,388 @@
+// Author: Kun Ren (kun.ren@yale.edu)
+//
+// The InputLog persists the stream of batches produced by this node's
+// sequencer reader.
+
+#include "sequencer/input_log.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include "common/connection.h"
+#include "proto/message.pb.h"
+
+
+string InputLogSegmentPath(const string& dir, int origin, int segment) {
+  return dir + "/input-" + IntToString(origin) + "-" + IntToString(segment) +
+         ".log";
+}
+
+// Encodes a record header for 'batch' into 'header'.
+static void EncodeHeader(int64 batch_number, const string& batch,
+                         char* header) {
+  uint32 length = batch.size();
+  uint32 crc = Crc32(&batch_number, sizeof(batch_number));
+  crc = Crc32(batch.data(), batch.size(), crc);
+  memcpy(header, &length, sizeof(length));
+  memcpy(header + 4, &crc, sizeof(crc));
+  memcpy(header + 8, &batch_number, sizeof(batch_number));
+}
+
+////////////////////////////////    SegmentWriter    ///////////////////////////
+
+InputLog::SegmentWriter::SegmentWriter(const string& dir, int origin,
+                                       bool direct_io)
+    : dir_(dir), origin_(origin), direct_io_(direct_io), segment_(0),
+      next_fd_(-1), buffer_size_(INPUT_LOG_BLOCK_SIZE), buffer_used_(0),
+      buffer_offset_(0) {
+  // Never overwrite segments left by an earlier run; they are needed for
+  // recovery.
+  struct stat st;
+  while (stat(InputLogSegmentPath(dir_, origin_, segment_).c_str(), &st) == 0)
+    segment_++;
+  fd_ = OpenSegment(segment_);
+
+  if (posix_memalign(reinterpret_cast<void**>(&buffer_), INPUT_LOG_BLOCK_SIZE,
+                     buffer_size_) != 0) {
+    perror("posix_memalign");
+    exit(EXIT_FAILURE);
+  }
+}
+
+InputLog::SegmentWriter::~SegmentWriter() {
+  Flush(true);
+  close(fd_);
+  if (next_fd_ != -1)
+    close(next_fd_);
+  free(buffer_);
+}
+
+int InputLog::SegmentWriter::OpenSegment(int segment) {
+  string path = InputLogSegmentPath(dir_, origin_, segment);
+  int fd = -1;
+  if (direct_io_) {
+    fd = open(path.c_str(), O_RDWR | O_CREAT | O_DIRECT, 0644);
+    if (fd < 0) {
+      // Not every file system supports O_DIRECT (e.g. tmpfs).
+      printf("InputLog: O_DIRECT unavailable for %s, using buffered I/O\n",
+             path.c_str());
+      direct_io_ = false;
+    }
+  }
+  if (fd < 0)
+    fd = open(path.c_str(), O_RDWR | O_CREAT, 0644);
+  if (fd < 0) {
+    perror(path.c_str());
+    exit(EXIT_FAILURE);
+  }
+
+  int error = posix_fallocate(fd, 0, INPUT_LOG_SEGMENT_SIZE);
+  if (error != 0)
+    printf("InputLog: could not preallocate %s: %s\n", path.c_str(),
+           strerror(error));
+  return fd;
+}
+
+void InputLog::SegmentWriter::Reserve(uint32 size) {
+  if (buffer_used_ + size <= buffer_size_)
+    return;
+
+  uint32 new_size = buffer_size_;
+  while (new_size < buffer_used_ + size)
+    new_size *= 2;
+  char* new_buffer;
+  if (posix_memalign(reinterpret_cast<void**>(&new_buffer),
+                     INPUT_LOG_BLOCK_SIZE, new_size) != 0) {
+    perror("posix_memalign");
+    exit(EXIT_FAILURE);
+  }
+  memcpy(new_buffer, buffer_, buffer_used_);
+  free(buffer_);
+  buffer_ = new_buffer;
+  buffer_size_ = new_size;
+}
+
+void InputLog::SegmentWriter::Add(int64 batch_number, const string& batch) {
+  uint32 size = INPUT_LOG_HEADER_SIZE + batch.size();
+  if (size + INPUT_LOG_HEADER_SIZE > INPUT_LOG_SEGMENT_SIZE) {
+    printf("InputLog: batch %lld too large to log\n",
+           static_cast<long long>(batch_number));
+    exit(EXIT_FAILURE);
+  }
+
+  // Leave room for the zero length that terminates the segment's records.
+  if (buffer_offset_ + buffer_used_ + size + INPUT_LOG_HEADER_SIZE >
+      INPUT_LOG_SEGMENT_SIZE) {
+    Flush(true);
+    close(fd_);
+    fd_ = (next_fd_ != -1) ? next_fd_ : OpenSegment(segment_ + 1);
+    next_fd_ = -1;
+    segment_++;
+    buffer_offset_ = 0;
+    buffer_used_ = 0;
+  }
+
+  Reserve(size);
+  EncodeHeader(batch_number, batch, buffer_ + buffer_used_);
+  memcpy(buffer_ + buffer_used_ + INPUT_LOG_HEADER_SIZE, batch.data(),
+         batch.size());
+  buffer_used_ += size;
+
+  // Preallocate the next segment once this one is half full, so that rolling
+  // over never waits for the file system.
+  if (next_fd_ == -1 &&
+      buffer_offset_ + buffer_used_ > INPUT_LOG_SEGMENT_SIZE / 2)
+    next_fd_ = OpenSegment(segment_ + 1);
+}
+
+void InputLog::SegmentWriter::Flush(bool sync) {
+  if (buffer_used_ == 0)
+    return;
+
+  // Write whole blocks, zero-padding the last one. The padding doubles as the
+  // end-of-records marker.
+  uint32 length = (buffer_used_ + INPUT_LOG_BLOCK_SIZE - 1) /
+                  INPUT_LOG_BLOCK_SIZE * INPUT_LOG_BLOCK_SIZE;
+  Reserve(length - buffer_used_);
+  memset(buffer_ + buffer_used_, 0, length - buffer_used_);
+
+  uint32 written = 0;
+  while (written < length) {
+    ssize_t n = pwrite(fd_, buffer_ + written, length - written,
+                       buffer_offset_ + written);
+    if (n < 0) {
+      perror("InputLog: pwrite");
+      exit(EXIT_FAILURE);
+    }
+    written += n;
+  }
+  if (sync && fdatasync(fd_) != 0) {
+    perror("InputLog: fdatasync");
+    exit(EXIT_FAILURE);
+  }
+
+  // Keep the partial last block in the buffer; the next flush rewrites it.
+  uint32 full = buffer_used_ / INPUT_LOG_BLOCK_SIZE * INPUT_LOG_BLOCK_SIZE;
+  memmove(buffer_, buffer_ + full, buffer_used_ - full);
+  buffer_offset_ += full;
+  buffer_used_ -= full;
+}
+
+////////////////////////////////      InputLog      ////////////////////////////
+
+void* InputLog::RunInputLog(void* arg) {
+  reinterpret_cast<InputLog*>(arg)->Run();
+  return NULL;
+}
+
+InputLog::InputLog(int node_id, const string& dir, Durability durability,
+                   bool direct_io, Connection* connection, int replica)
+    : node_id_(node_id), dir_(dir), durability_(durability),
+      direct_io_(direct_io), connection_(connection), replica_(replica),
+      written_batch_(-1), synced_batch_(-1), replicated_batch_(-1),
+      deconstructor_invoked_(false) {
+  writer_ = new SegmentWriter(dir_, node_id_, direct_io_);
+  pthread_create(&thread_, NULL, RunInputLog, reinterpret_cast<void*>(this));
+}
+
+InputLog::~InputLog() {
+  deconstructor_invoked_ = true;
+  pthread_join(thread_, NULL);
+  delete writer_;
+  for (map<int, SegmentWriter*>::iterator it = replica_writers_.begin();
+       it != replica_writers_.end(); ++it)
+    delete it->second;
+  delete connection_;
+}
+
+void InputLog::Append(MessageProto* batch) {
+  queue_.Push(batch);
+}
+
+int64 InputLog::DurableBatch() {
+  Lock l(&mutex_);
+  switch (durability_) {
+    case NONE:
+      return written_batch_;
+    case LOCAL:
+      return synced_batch_;
+    default:
+      return std::min(synced_batch_, replicated_batch_);
+  }
+}
+
+void InputLog::Run() {
+  MessageProto message;
+  while (true) {
+    // Read the flag before draining the queue, so that everything appended
+    // before the destructor was invoked gets written.
+    bool stopping = deconstructor_invoked_;
+    bool idle = true;
+
+    // Group commit: everything appended since the last round is written with
+    // one write and synced with one fdatasync.
+    MessageProto append;
+    int64 last = -1;
+    MessageProto* batch;
+    string serialized;
+    while (queue_.Pop(&batch)) {
+      batch->SerializeToString(&serialized);
+      writer_->Add(batch->batch_number(), serialized);
+      last = batch->batch_number();
+      if (durability_ == REPLICA) {
+        append.add_data()->swap(serialized);
+        append.add_batch_numbers(last);
+      }
+      delete batch;
+    }
+    if (last != -1) {
+      idle = false;
+      if (durability_ == REPLICA) {
+        append.set_type(MessageProto::INPUT_LOG_APPEND);
+        append.set_destination_node(replica_);
+        append.set_destination_channel("input_log");
+        append.set_source_node(node_id_);
+        connection_->Send(append);
+      }
+      writer_->Flush(durability_ != NONE);
+      Lock l(&mutex_);
+      written_batch_ = last;
+      if (durability_ != NONE)
+        synced_batch_ = last;
+    }
+
+    if (connection_ != NULL) {
+      while (connection_->GetMessage(&message)) {
+        idle = false;
+        HandleMessage(message);
+      }
+    }
+
+    if (stopping)
+      break;
+    if (idle)
+      Spin(0.0001);
+  }
+}
+
+void InputLog::HandleMessage(const MessageProto& message) {
+  if (message.type() == MessageProto::INPUT_LOG_ACK) {
+    Lock l(&mutex_);
+    replicated_batch_ = std::max(replicated_batch_, message.batch_number());
+    return;
+  }
+
+  // INPUT_LOG_APPEND: store the batches in our copy of the sender's stream and
+  // acknowledge once they are synced.
+  int origin = message.source_node();
+  if (replica_writers_.count(origin) == 0)
+    replica_writers_[origin] = new SegmentWriter(dir_, origin, direct_io_);
+  SegmentWriter* writer = replica_writers_[origin];
+  for (int i = 0; i < message.data_size(); i++)
+    writer->Add(message.batch_numbers(i), message.data(i));
+  writer->Flush(true);
+
+  MessageProto ack;
+  ack.set_type(MessageProto::INPUT_LOG_ACK);
+  ack.set_destination_node(origin);
+  ack.set_destination_channel("input_log");
+  ack.set_source_node(node_id_);
+  ack.set_batch_number(message.batch_numbers(message.data_size() - 1));
+  connection_->Send(ack);
+}
+
+////////////////////////////////   InputLogReader   ////////////////////////////
+
+InputLogReader::InputLogReader(const string& dir, int origin)
+    : dir_(dir), origin_(origin), segment_(0), offset_(0) {
+  // Note the first batch number of every segment (-1 if it has no records).
+  // A run that restarts after recovery opens a new segment and logs batches
+  // from the first epoch that was replayed no further, superseding what the
+  // crashed run logged from there on.
+  for (int segment = 0; ; segment++) {
+    FILE* file = fopen(InputLogSegmentPath(dir_, origin_, segment).c_str(),
+                       "rb");
+    if (file == NULL)
+      break;
+    char header[INPUT_LOG_HEADER_SIZE];
+    uint32 length = 0;
+    int64 batch_number = -1;
+    if (fread(header, 1, sizeof(header), file) == sizeof(header)) {
+      memcpy(&length, header, sizeof(length));
+      if (length != 0)
+        memcpy(&batch_number, header + 8, sizeof(batch_number));
+    }
+    fclose(file);
+    first_batches_.push_back(batch_number);
+  }
+  LoadSegment();
+}
+
+InputLogReader::~InputLogReader() {
+}
+
+bool InputLogReader::LoadSegment() {
+  data_.clear();
+  offset_ = 0;
+  superseded_from_ = -1;
+  for (uint32 i = segment_ + 1; i < first_batches_.size(); i++) {
+    if (first_batches_[i] != -1 &&
+        (superseded_from_ == -1 || first_batches_[i] < superseded_from_))
+      superseded_from_ = first_batches_[i];
+  }
+  FILE* file = fopen(InputLogSegmentPath(dir_, origin_, segment_).c_str(),
+                     "rb");
+  if (file == NULL)
+    return false;
+
+  char buffer[1 << 16];
+  size_t n;
+  while ((n = fread(buffer, 1, sizeof(buffer), file)) > 0)
+    data_.append(buffer, n);
+  fclose(file);
+  return true;
+}
+
+bool InputLogReader::Next(int64* batch_number, string* batch) {
+  while (true) {
+    uint32 length = 0;
+    if (offset_ + INPUT_LOG_HEADER_SIZE <= data_.size())
+      memcpy(&length, data_.data() + offset_, sizeof(length));
+
+    // A torn or corrupt record ends the log, unless a later run continued
+    // it in later segments.
+    bool end = length == 0;
+    if (!end && offset_ + INPUT_LOG_HEADER_SIZE + length > data_.size())
+      end = true;
+    const char* payload = NULL;
+    if (!end) {
+      payload = data_.data() + offset_ + INPUT_LOG_HEADER_SIZE;
+      uint32 crc;
+      memcpy(&crc, data_.data() + offset_ + 4, sizeof(crc));
+      memcpy(batch_number, data_.data() + offset_ + 8, sizeof(*batch_number));
+      end = Crc32(payload, length,
+                  Crc32(batch_number, sizeof(*batch_number))) != crc;
+    }
+    if (end) {
+      // End of this segment's records; continue with the next segment.
+      if (length != 0 && superseded_from_ == -1)
+        return false;
+      segment_++;
+      if (!LoadSegment())
+        return false;
+      continue;
+    }
+
+    offset_ += INPUT_LOG_HEADER_SIZE + length;
+    if (superseded_from_ != -1 && *batch_number >= superseded_from_)
+      continue;  // Logged again by a later run.
+    batch->assign(payload, length);
+    return true;
+  }
+}
@@ -0,0 +1,193 @@
+// Author: Kun Ren (kun.ren@yale.edu)
+//
+// The InputLog persists the stream of batches produced by this node's
+// sequencer reader. Because execution is deterministic, this stream (together
+// with a checkpoint) is enough to rebuild the node's state after a crash.
+//
+// Batches are handed to the log with Append, which never blocks; a background
+// thread writes everything appended since its last round to disk with one
+// write and (depending on the durability mode) one fdatasync, so the cost of
+// syncing is shared by all batches in the group. Records go to segment files
+// that are preallocated ahead of time so that appends never extend a file:
+//
+//   <dir>/input-<origin>-<segment>.log
+//
+// Each record is a 16-byte header (payload length, CRC-32 of batch number and
+// payload, batch number) followed by the payload. A zero length marks the end
+// of a segment's records. Writes are whole, aligned blocks, so segments may be
+// opened with O_DIRECT.
+//
+// Durability modes:
+//   NONE:    batches are written but never synced.
+//   LOCAL:   a batch is durable once it has been synced locally.
+//   REPLICA: a batch is durable once it has been synced locally and the
+//            replica node has acknowledged syncing its own copy. Every node
+//            running an InputLog also stores the streams replicas send to it.
+//
+// The sequencer dispatches a batch to the schedulers only once DurableBatch()
+// covers it, so no batch executes that a crash could lose from the log. The
+// reader keeps appending while earlier batches wait, so they still share
+// syncs.
+
+#ifndef _DB_SEQUENCER_INPUT_LOG_H_
+#define _DB_SEQUENCER_INPUT_LOG_H_
+
+#include <pthread.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "common/types.h"
+#include "common/utils.h"
+
+using std::map;
+using std::string;
+using std::vector;
+
+class Connection;
+class MessageProto;
+
+// Size of each preallocated segment file.
+#define INPUT_LOG_SEGMENT_SIZE (64 * 1024 * 1024)
+
+// Alignment of all writes (and of the write buffer), as required by O_DIRECT.
+#define INPUT_LOG_BLOCK_SIZE 4096
+
+// Size of a record header.
+#define INPUT_LOG_HEADER_SIZE 16
+
+class InputLog {
+ public:
+  enum Durability {
+    NONE = 0,
+    LOCAL = 1,
+    REPLICA = 2,
+  };
+
+  // Starts the log's writer thread. Segments are written to directory 'dir',
+  // which must exist. In REPLICA mode batches are also sent to node 'replica'
+  // via 'connection', which must be registered on the "input_log" channel;
+  // otherwise 'connection' may be NULL. 'connection' is owned by the log.
+  InputLog(int node_id, const string& dir, Durability durability,
+           bool direct_io, Connection* connection, int replica);
+
+  // Writes out everything appended so far and stops the writer thread.
+  ~InputLog();
+
+  // Queues 'batch' for writing and takes ownership of it. Batch numbers must
+  // increase with each call. Does NOT block; 'batch' is serialized by the
+  // writer thread.
+  void Append(MessageProto* batch);
+
+  // Returns the highest batch number that is durable under the log's
+  // durability mode (-1 if none).
+  int64 DurableBatch();
+
+ private:
+  // Appends records for one origin's stream to that stream's segments.
+  class SegmentWriter {
+   public:
+    SegmentWriter(const string& dir, int origin, bool direct_io);
+    ~SegmentWriter();
+
+    // Adds a record to the write buffer.
+    void Add(int64 batch_number, const string& batch);
+
+    // Writes the buffer out, and syncs it to disk if 'sync' is true.
+    void Flush(bool sync);
+
+   private:
+    // Opens segment 'segment', preallocating it if necessary.
+    int OpenSegment(int segment);
+
+    // Makes room for 'size' more bytes in the write buffer.
+    void Reserve(uint32 size);
+
+    string dir_;
+    int origin_;
+    bool direct_io_;
+
+    // Current segment, its file descriptor, and the next segment, which is
+    // opened and preallocated in advance (-1 if not yet).
+    int segment_;
+    int fd_;
+    int next_fd_;
+
+    // Aligned write buffer. 'buffer_[0]' corresponds to offset
+    // 'buffer_offset_' of the current segment, which is block-aligned; the
+    // buffer holds 'buffer_used_' valid bytes.
+    char* buffer_;
+    uint32 buffer_size_;
+    uint32 buffer_used_;
+    uint64 buffer_offset_;
+  };
+
+  // Writer thread main loop.
+  void Run();
+  static void* RunInputLog(void* arg);
+
+  // Handles a message from another node's InputLog.
+  void HandleMessage(const MessageProto& message);
+
+  int node_id_;
+  string dir_;
+  Durability durability_;
+  bool direct_io_;
+  Connection* connection_;
+  int replica_;
+
+  // Batches appended but not yet written.
+  AtomicQueue<MessageProto*> queue_;
+
+  // Writers for this node's stream and for the streams of nodes for which
+  // this node is the replica.
+  SegmentWriter* writer_;
+  map<int, SegmentWriter*> replica_writers_;
+
+  // Highest batch number written and synced locally, and acknowledged by the
+  // replica, protected by 'mutex_'.
+  int64 written_batch_;
+  int64 synced_batch_;
+  int64 replicated_batch_;
+  Mutex mutex_;
+
+  pthread_t thread_;
+  bool deconstructor_invoked_;
+};
+
+// Reads back the records of one origin's stream, in order.
+class InputLogReader {
+ public:
+  InputLogReader(const string& dir, int origin);
+  ~InputLogReader();
+
+  // Reads the next record into '*batch_number' and '*batch'. Returns false at
+  // the end of the log, or at the first record that is torn or corrupt. If
+  // the node was recovered and logged on, records of the crashed run that the
+  // later run logged again are skipped, and so is a torn end of the crashed
+  // run.
+  bool Next(int64* batch_number, string* batch);
+
+ private:
+  // Opens segment 'segment_' and reads it into 'data_'. Returns false if it
+  // does not exist.
+  bool LoadSegment();
+
+  string dir_;
+  int origin_;
+  int segment_;
+  string data_;
+  uint32 offset_;
+
+  // First batch number of each segment (-1 if it has no records), and the
+  // lowest of them after segment 'segment_' (-1 if none): records of the
+  // current segment from that batch number on were superseded.
+  vector<int64> first_batches_;
+  int64 superseded_from_;
+};
+
+// Returns the path of segment 'segment' of 'origin's stream in 'dir'.
+string InputLogSegmentPath(const string& dir, int origin, int segment);
+
+#endif  // _DB_SEQUENCER_INPUT_LOG_H_
@@ -0,0 +1,125 @@
+// Author: Kun Ren (kun.ren@yale.edu)
+//
+// The Replayer feeds logged batches back into this node's scheduler after a
+// crash.
+
+#include "sequencer/replayer.h"
+
+#include <stdio.h>
+
+#include <iostream>
+
+#include "common/configuration.h"
+#include "proto/message.pb.h"
+#include "proto/txn.pb.h"
+#include "sequencer/input_log.h"
+
+void* Replayer::RunReplayer(void* arg) {
+  reinterpret_cast<Replayer*>(arg)->Run();
+  return NULL;
+}
+
+Replayer::Replayer(Configuration* conf, int64 checkpoint_txn)
+    : configuration_(conf), checkpoint_txn_(checkpoint_txn),
+      start_time_(GetTime()), replayed_batches_(0), replayed_txns_(0),
+      done_(false), deconstructor_invoked_(false) {
+  for (uint32 i = 0; i < configuration_->all_nodes.size(); i++) {
+    readers_.push_back(new InputLogReader(configuration_->input_log_dir, i));
+  }
+  txns_queue_ = new AtomicQueue<TxnProto*>();
+  pthread_create(&thread_, NULL, RunReplayer, reinterpret_cast<void*>(this));
+}
+
+Replayer::~Replayer() {
+  deconstructor_invoked_ = true;
+  pthread_join(thread_, NULL);
+  for (uint32 i = 0; i < readers_.size(); i++)
+    delete readers_[i];
+  TxnProto* txn;
+  while (txns_queue_->Pop(&txn))
+    delete txn;
+  delete txns_queue_;
+}
+
+void Replayer::Run() {
+  int num_nodes = configuration_->all_nodes.size();
+  int this_node = configuration_->this_node_id;
+  double time = GetTime();
+  int64 reported_txns = 0;
+
+  vector<MessageProto> batches(num_nodes);
+  int64 epoch;
+  for (epoch = 0; !deconstructor_invoked_; epoch++) {
+    // Schedulers never start an epoch before every origin's batch for it has
+    // arrived, so an epoch is replayed only if it was logged by all origins.
+    bool complete = true;
+    for (int origin = 0; origin < num_nodes && complete; origin++) {
+      int64 batch_number;
+      string batch_string;
+      if (!readers_[origin]->Next(&batch_number, &batch_string)) {
+        if (epoch == 0) {
+          printf("Replayer: no input log of origin %d in %s\n", origin,
+                 configuration_->input_log_dir.c_str());
+        }
+        complete = false;
+      } else if (batch_number != epoch * num_nodes + origin) {
+        printf("Replayer: origin %d logged batch %ld, expected %ld\n", origin,
+               (long)batch_number, (long)(epoch * num_nodes + origin));
+        complete = false;
+      } else {
+        batches[origin].ParseFromString(batch_string);
+      }
+    }
+    if (!complete)
+      break;
+
+    for (int origin = 0; origin < num_nodes; origin++) {
+      for (int i = 0; i < batches[origin].data_size(); i++) {
+        TxnProto* txn = new TxnProto();
+        txn->ParseFromString(batches[origin].data(i));
+
+        bool participant = false;
+        for (int j = 0; j < txn->readers_size(); j++)
+          participant |= (txn->readers(j) == this_node);
+        for (int j = 0; j < txn->writers_size(); j++)
+          participant |= (txn->writers(j) == this_node);
+        if (txn->txn_id() <= checkpoint_txn_ || !participant) {
+          delete txn;
+          continue;
+        }
+
+        // Stay a bounded distance ahead of the lock manager.
+        while (txns_queue_->Size() >= 1000 && !deconstructor_invoked_)
+          Spin(0.0001);
+        txns_queue_->Push(txn);
+        replayed_txns_++;
+      }
+      replayed_batches_++;
+    }
+
+    // Report progress.
+    if (GetTime() > time + 1) {
+      double total_time = GetTime() - time;
+      std::cout << "Replayed " << epoch + 1 << " epochs, "
+                << (replayed_txns_ - reported_txns) / total_time
+                << " txns/sec\n" << std::flush;
+      time = GetTime();
+      reported_txns = replayed_txns_;
+    }
+  }
+
+  // Hand over to live sequencing at the first epoch not replayed.
+  configuration_->first_epoch = epoch;
+  txns_queue_->Push(NULL);
+  done_ = true;
+}
+
+int64 Replayer::WaitUntilDone() {
+  while (!done_ || !txns_queue_->Empty())
+    Spin(0.001);
+  double total_time = GetTime() - start_time_;
+  std::cout << "Replay finished: " << replayed_txns_ << " txns in "
+            << replayed_batches_ << " batches, " << total_time << " seconds ("
+            << replayed_txns_ / total_time << " txns/sec)\n" << std::flush;
+  return replayed_txns_;
+}
@@ -0,0 +1,84 @@
+// Author: Kun Ren (kun.ren@yale.edu)
+//
+// The Replayer rebuilds a node's state after a crash by feeding the batches
+// recorded in the input logs (see sequencer/input_log.h) back into the
+// node's scheduler, in place of the sequencer.
+//
+// Logs of every origin must be present in the configured input log
+// directory: a node only writes its own stream (and, in REPLICA mode, those
+// of the nodes it is the replica of), so the others' logs must be copied
+// there before recovering. The replayer reads them epoch by epoch in origin
+// order (the global order the schedulers originally merged them in) and
+// hands every txn in which this node participates to the scheduler's input
+// queue, so no batches travel over the network. Txns already reflected in
+// the loaded checkpoint are skipped. Remote reads of multi-partition txns
+// are served by the other participants, which replay the same logs
+// concurrently.
+//
+// Replay stops at the first epoch for which some origin's log has no record,
+// as the global order is not known beyond it. Since every node replays the
+// same logs, they all stop at the same epoch; the replayer records it as the
+// configuration's first_epoch and queues a NULL txn, upon which the
+// scheduler moves on to the batches of the sequencers, which start there.
+
+#ifndef _DB_SEQUENCER_REPLAYER_H_
+#define _DB_SEQUENCER_REPLAYER_H_
+
+#include <pthread.h>
+
+#include <vector>
+
+#include "common/types.h"
+#include "common/utils.h"
+
+using std::vector;
+
+class Configuration;
+class InputLogReader;
+class TxnProto;
+
+class Replayer {
+ public:
+  // Starts replaying in a background thread every logged txn with an id
+  // greater than 'checkpoint_txn' (-1 to replay the whole log).
+  Replayer(Configuration* conf, int64 checkpoint_txn);
+
+  // Halts the replay.
+  ~Replayer();
+
+  // Returns the queue into which txns are replayed.
+  AtomicQueue<TxnProto*>* GetTxnsQueue() { return txns_queue_; }
+
+  // Blocks until every logged txn and the final NULL have been taken off the
+  // queue, then reports replay throughput. Returns the number of txns
+  // replayed.
+  int64 WaitUntilDone();
+
+ private:
+  // Main loop.
+  void Run();
+  static void* RunReplayer(void* arg);
+
+  Configuration* configuration_;
+  int64 checkpoint_txn_;
+
+  // One reader per origin, by node id.
+  vector<InputLogReader*> readers_;
+
+  // Txns replayed but not yet locked, followed by NULL once replay is done.
+  AtomicQueue<TxnProto*>* txns_queue_;
+
+  // Time at which replay started.
+  double start_time_;
+
+  // Number of batches and txns replayed so far, and whether the end of the
+  // logs has been reached.
+  int64 replayed_batches_;
+  int64 replayed_txns_;
+  bool done_;
+
+  pthread_t thread_;
+  bool deconstructor_invoked_;
+};
+
+#endif  // _DB_SEQUENCER_REPLAYER_H_
@@ -20,12 +20,13 @@
 #include "common/utils.h"
 #include "proto/message.pb.h"
 #include "proto/txn.pb.h"
+#include "sequencer/batch_relay.h"
+#include "sequencer/input_log.h"
 #ifdef PAXOS
-# include "paxos/paxos.h"
+# include "paxos/paxos_log.h"
 #endif
 
 using std::map;
-using std::multimap;
 using std::set;
 using std::queue;
 
@@ -56,11 +57,59 @@ void* Sequencer::RunSequencerLoader(void *arg) {
   return NULL;
 }
 
+void* Sequencer::RunSequencerStreamer(void *arg) {
+  reinterpret_cast<Sequencer*>(arg)->RunStreamer();
+  return NULL;
+}
+
 Sequencer::Sequencer(Configuration* conf, Connection* connection,
                      Client* client, Storage* storage, int queue_mode)
-    : epoch_duration_(0.01), configuration_(conf), connection_(connection),
+    : epoch_duration_(0.01), max_batch_wait_(0.02),
+      stream_flush_interval_(0.0001), configuration_(conf), connection_(connection),
       client_(client), storage_(storage), deconstructor_invoked_(false), queue_mode_(queue_mode), fetched_txn_num_(0) {
   pthread_mutex_init(&mutex_, NULL);
+  txns_queue_ = NULL;
+
+  // The writer prefetches the objects of the txns it sequences.
+  prefetch_connection_ = NULL;
+  if (queue_mode != DIRECT_QUEUE &&
+      configuration_->sequencer_mode == EPOCH_SEQUENCING &&
+      configuration_->prefetching) {
+    prefetch_connection_ = connection_->multiplexer()->NewConnection("prefetch");
+  }
+
+  // Group leaders relay batches for their group in tree dissemination mode.
+  relay_ = NULL;
+  if (queue_mode != DIRECT_QUEUE &&
+      configuration_->sequencer_mode == EPOCH_SEQUENCING &&
+      BatchRelay::IsRelay(*configuration_, configuration_->this_node_id)) {
+    relay_ = new BatchRelay(configuration_,
+                            connection_->multiplexer()->NewConnection("relay"));
+  }
+
+  // The reader logs every batch it sequences if the input log is enabled.
+  input_log_ = NULL;
+  if (queue_mode != DIRECT_QUEUE &&
+      configuration_->sequencer_mode == EPOCH_SEQUENCING &&
+      configuration_->input_log >= 0) {
+    InputLog::Durability durability =
+        static_cast<InputLog::Durability>(configuration_->input_log);
+    input_log_ = new InputLog(
+        configuration_->this_node_id, configuration_->input_log_dir,
+        durability, configuration_->input_log_direct_io,
+        durability == InputLog::REPLICA ?
+            connection_->multiplexer()->NewConnection("input_log") : NULL,
+        configuration_->input_log_replica);
+  }
+
+#ifdef PAXOS
+  // Batches are ordered by the replicated log shared by writer and reader.
+  if (queue_mode != DIRECT_QUEUE) {
+    paxos_log_ = new PaxosLog(configuration_,
+                              connection_->multiplexer()->NewConnection("paxos"));
+  }
+#endif
+
   // Start Sequencer main loops running in background thread.
 
 cpu_set_t cpuset;
@@ -77,6 +126,17 @@ if(queue_mode == DIRECT_QUEUE){
 		  reinterpret_cast<void*>(this));
 	txns_queue_ = new AtomicQueue<TxnProto*>();
 }
+else if (configuration_->sequencer_mode == STREAM_SEQUENCING) {
+	CPU_ZERO(&cpuset);
+	CPU_SET(6, &cpuset);
+	std::cout << "Sequencer streamer starts at core 6"<<std::endl;
+	pthread_attr_t attr_streamer;
+	pthread_attr_init(&attr_streamer);
+	pthread_attr_setaffinity_np(&attr_streamer, sizeof(cpu_set_t), &cpuset);
+
+	pthread_create(&writer_thread_, &attr_streamer, RunSequencerStreamer,
+		  reinterpret_cast<void*>(this));
+}
 else{
 	pthread_attr_t attr_writer;
 	pthread_attr_init(&attr_writer);
@@ -114,8 +174,21 @@ Sequencer::~Sequencer() {
   deconstructor_invoked_ = true;
   if (queue_mode_ == DIRECT_QUEUE)
 	  delete txns_queue_;
-  pthread_join(writer_thread_, NULL);
-  pthread_join(reader_thread_, NULL);
+  // Join only the threads the constructor started for this mode.
+  bool streaming = queue_mode_ != DIRECT_QUEUE &&
+                   configuration_->sequencer_mode == STREAM_SEQUENCING;
+  if (queue_mode_ != DIRECT_QUEUE)
+    pthread_join(writer_thread_, NULL);
+  if (!streaming)
+    pthread_join(reader_thread_, NULL);
+  // The reader sends through the relay until it is joined.
+  delete relay_;
+  delete input_log_;
+  delete prefetch_connection_;
+#ifdef PAXOS
+  if (queue_mode_ != DIRECT_QUEUE)
+    delete paxos_log_;
+#endif
 }
 
 void Sequencer::FindParticipatingNodes(const TxnProto& txn, set<int>* nodes) {
@@ -126,44 +199,29 @@ void Sequencer::FindParticipatingNodes(const TxnProto& txn, set<int>* nodes) {
     nodes->insert(configuration_->LookupPartition(txn.write_set(i)));
   for (int i = 0; i < txn.read_write_set_size(); i++)
     nodes->insert(configuration_->LookupPartition(txn.read_write_set(i)));
+  for (int i = 0; i < txn.range_start_size(); i++)
+    configuration_->LookupRangePartitions(txn.range_start(i),
+                                          txn.range_end(i), nodes);
 }
 
-#ifdef PREFETCHING
-double PrefetchAll(Storage* storage, TxnProto* txn) {
-  double max_wait_time = 0;
-  double wait_time = 0;
-  for (int i = 0; i < txn->read_set_size(); i++) {
-    storage->Prefetch(txn->read_set(i), &wait_time);
-    max_wait_time = MAX(max_wait_time, wait_time);
-  }
-  for (int i = 0; i < txn->read_write_set_size(); i++) {
-    storage->Prefetch(txn->read_write_set(i), &wait_time);
-    max_wait_time = MAX(max_wait_time, wait_time);
+void Sequencer::PlaceTxn(TxnProto* txn, int batch_number, int position,
+                         int nodes) {
+  txn->set_txn_id(static_cast<int64>(batch_number) * MAX_BATCH_SIZE +
+                  position);
+  if (txn->isolation_level() == TxnProto::SNAPSHOT) {
+    int64 snapshot = static_cast<int64>(batch_number / nodes) * nodes *
+                     MAX_BATCH_SIZE - 1;
+    txn->set_snapshot(snapshot < 0 ? 0 : snapshot);
   }
-  for (int i = 0; i < txn->write_set_size(); i++) {
-    storage->Prefetch(txn->write_set(i), &wait_time);
-    max_wait_time = MAX(max_wait_time, wait_time);
-  }
-#ifdef LATENCY_TEST
-  if (txn->txn_id() % SAMPLE_RATE == 0)
-    prefetch_cold[txn->txn_id() / SAMPLE_RATE] = max_wait_time;
-#endif
-  return max_wait_time;
 }
-#endif
-
-void Sequencer::RunWriter() {
-  Spin(1);
-
-#ifdef PAXOS
-  Paxos paxos(ZOOKEEPER_CONF, false);
-#endif
 
-#ifdef PREFETCHING
-  multimap<double, TxnProto*> fetching_txns;
-#endif
+bool Sequencer::IsReadOnly(const TxnProto& txn) {
+  // Scans are left to the lock manager's range locks.
+  return txn.write_set_size() == 0 && txn.read_write_set_size() == 0 &&
+         txn.range_start_size() == 0;
+}
 
-  // Synchronization loadgen start with other sequencers.
+void Sequencer::SynchronizeWithPeers() {
   MessageProto synchronization_message;
   synchronization_message.set_type(MessageProto::EMPTY);
   synchronization_message.set_destination_channel("sequencer");
@@ -180,6 +238,138 @@ void Sequencer::RunWriter() {
       synchronization_counter++;
     }
   }
+}
+
+int64 Sequencer::NextTimestamp(int64* last) {
+  int64 now = static_cast<int64>(GetTime() * 1000000);
+  *last = (now > *last) ? now : *last + 1;
+  return *last;
+}
+
+// Prefetches the objects 'keys' of 'txn'. Returns true if all of them are in
+// memory already; otherwise the storage pushes 'txn' onto '*resident' once
+// they are.
+bool PrefetchAll(Storage* storage, TxnProto* txn, const vector<Key>& keys,
+                 AtomicQueue<TxnProto*>* resident) {
+  bool in_memory = storage->PrefetchTxn(txn, keys, resident);
+#ifdef LATENCY_TEST
+  // Cold txns record when their fetches started.
+  if (txn->txn_id() % SAMPLE_RATE == 0)
+    prefetch_cold[txn->txn_id() / SAMPLE_RATE] = in_memory ? 0 : GetTime();
+#endif
+  return in_memory;
+}
+
+void Sequencer::KeysAt(const TxnProto& txn, int node, vector<Key>* keys) {
+  keys->clear();
+  for (int i = 0; i < txn.read_set_size(); i++)
+    if (configuration_->LookupPartition(txn.read_set(i)) == node)
+      keys->push_back(txn.read_set(i));
+  for (int i = 0; i < txn.read_write_set_size(); i++)
+    if (configuration_->LookupPartition(txn.read_write_set(i)) == node)
+      keys->push_back(txn.read_write_set(i));
+  for (int i = 0; i < txn.write_set_size(); i++)
+    if (configuration_->LookupPartition(txn.write_set(i)) == node)
+      keys->push_back(txn.write_set(i));
+}
+
+void Sequencer::Unpin(const vector<Key>& keys) {
+  // The workers pin the objects again while the txn executes; until then
+  // they are kept in memory only as long as the storage sees fit.
+  for (uint32 i = 0; i < keys.size(); i++)
+    storage_->Unfetch(keys[i]);
+}
+
+double Sequencer::StartPrefetch(TxnProto* txn) {
+  double ready = GetTime();
+  set<int> nodes;
+  FindParticipatingNodes(*txn, &nodes);
+  vector<Key> keys;
+
+  // Remote objects are expected in memory once (almost) every prefetch at
+  // their node would have completed.
+  for (set<int>::iterator it = nodes.begin(); it != nodes.end(); ++it) {
+    if (*it == configuration_->this_node_id)
+      continue;
+    KeysAt(*txn, *it, &keys);
+    MessageProto prefetch;
+    prefetch.set_type(MessageProto::PREFETCH);
+    prefetch.set_destination_channel("prefetch");
+    prefetch.set_destination_node(*it);
+    prefetch.set_source_node(configuration_->this_node_id);
+    prefetch.set_prefetch_id(txn->txn_id());
+    for (uint32 i = 0; i < keys.size(); i++)
+      prefetch.add_data(keys[i]);
+    prefetch_connection_->Send(prefetch);
+
+    double expected = GetTime() +
+        latency_model_.Percentile(*it, configuration_->prefetch_percentile);
+    if (expected > ready)
+      ready = expected;
+  }
+
+  // Local objects report when they are in memory.
+  if (nodes.count(configuration_->this_node_id) == 0)
+    return ready;
+  KeysAt(*txn, configuration_->this_node_id, &keys);
+  if (PrefetchAll(storage_, txn, keys, &resident_txns_)) {
+    Unpin(keys);
+    return ready;
+  }
+  remote_ready_[txn] = ready;
+  return -1;
+}
+
+void Sequencer::HandlePrefetchMessages() {
+  MessageProto message;
+  while (prefetch_connection_->GetMessage(&message)) {
+    if (message.type() == MessageProto::PREFETCH_DONE) {
+      latency_model_.Record(message.source_node(), message.fetch_time());
+      continue;
+    }
+
+    // A placeholder txn accessing the objects stands in for the txn until
+    // they are in memory.
+    assert(message.type() == MessageProto::PREFETCH);
+    TxnProto* placeholder = new TxnProto();
+    placeholder->set_txn_id(message.prefetch_id());
+    vector<Key> keys;
+    for (int i = 0; i < message.data_size(); i++) {
+      placeholder->add_read_set(message.data(i));
+      keys.push_back(message.data(i));
+    }
+    serving_[placeholder] = std::make_pair(message.source_node(), GetTime());
+    if (storage_->PrefetchTxn(placeholder, keys, &served_prefetches_))
+      served_prefetches_.Push(placeholder);
+  }
+
+  // Report the prefetches served to their requesters.
+  TxnProto* placeholder;
+  while (served_prefetches_.Pop(&placeholder)) {
+    map<TxnProto*, pair<int, double> >::iterator it =
+        serving_.find(placeholder);
+    MessageProto done;
+    done.set_type(MessageProto::PREFETCH_DONE);
+    done.set_destination_channel("prefetch");
+    done.set_destination_node(it->second.first);
+    done.set_source_node(configuration_->this_node_id);
+    done.set_prefetch_id(placeholder->txn_id());
+    done.set_fetch_time(GetTime() - it->second.second);
+    prefetch_connection_->Send(done);
+    serving_.erase(it);
+
+    vector<Key> keys(placeholder->read_set().begin(),
+                     placeholder->read_set().end());
+    Unpin(keys);
+    delete placeholder;
+  }
+}
+
+void Sequencer::RunWriter() {
+  Spin(1);
+
+  // Synchronization loadgen start with other sequencers.
+  SynchronizeWithPeers();
 
   // Set up batch messages for each system node.
   MessageProto batch;
@@ -188,7 +378,12 @@ void Sequencer::RunWriter() {
   string batch_string;
   batch.set_type(MessageProto::TXN_BATCH);
 
-  for (int batch_number = configuration_->this_node_id;
+  const int nodes = configuration_->all_nodes.size();
+  const bool snapshot_reads =
+      configuration_->snapshot_reads && prefetch_connection_ == NULL;
+
+  for (int batch_number = configuration_->first_epoch * nodes +
+                          configuration_->this_node_id;
        !deconstructor_invoked_;
        batch_number += configuration_->all_nodes.size()) {
     // Begin epoch.
@@ -196,33 +391,52 @@ void Sequencer::RunWriter() {
     batch.set_batch_number(batch_number);
     batch.clear_data();
 
-#ifdef PREFETCHING
-    // Include txn requests from earlier that have now had time to prefetch.
-    while (!deconstructor_invoked_ &&
-           GetTime() < epoch_start + epoch_duration_) {
-      multimap<double, TxnProto*>::iterator it = fetching_txns.begin();
-      if (it == fetching_txns.end() || it->first > GetTime() ||
-          batch.data_size() >= MAX_BATCH_SIZE) {
-        break;
+    // The batch is expected to start once it is sent out, at the end of the
+    // epoch.
+    double batch_start = epoch_start + epoch_duration_;
+
+    if (prefetch_connection_ != NULL) {
+      HandlePrefetchMessages();
+
+      // Txns whose objects here are now in memory wait for those elsewhere.
+      TxnProto* fetched_txn;
+      vector<Key> keys;
+      while (resident_txns_.Pop(&fetched_txn)) {
+        KeysAt(*fetched_txn, configuration_->this_node_id, &keys);
+        Unpin(keys);
+        map<TxnProto*, double>::iterator it = remote_ready_.find(fetched_txn);
+        deferred_txns_.push(std::make_pair(it->second, fetched_txn));
+        remote_ready_.erase(it);
+      }
+
+      // Include txn requests from earlier whose objects are expected to be in
+      // memory by the time this batch starts. They take ids in this batch, so
+      // that ids keep following the order in which txns are run.
+      while (!deconstructor_invoked_ && batch.data_size() < MAX_BATCH_SIZE &&
+             !deferred_txns_.empty() &&
+             deferred_txns_.top().first <= batch_start) {
+        TxnProto* deferred_txn = deferred_txns_.top().second;
+        deferred_txn->set_txn_id(
+            static_cast<int64>(batch_number) * MAX_BATCH_SIZE +
+            batch.data_size());
+        string txn_string;
+        deferred_txn->SerializeToString(&txn_string);
+        batch.add_data(txn_string);
+        delete deferred_txns_.top().second;
+        deferred_txns_.pop();
       }
-      TxnProto* txn = it->second;
-      fetching_txns.erase(it);
-      string txn_string;
-      txn->SerializeToString(&txn_string);
-      batch.add_data(txn_string);
-      delete txn;
     }
-#endif
 
     // Collect txn requests for this epoch.
-    int txn_id_offset = 0;
     while (!deconstructor_invoked_ &&
            GetTime() < epoch_start + epoch_duration_) {
-      // Add next txn request to batch.
+      // Add next txn request to batch. (A txn deferred to a later batch gives
+      // up its id here and takes one in the batch that carries it.)
       if (batch.data_size() < MAX_BATCH_SIZE) {
         TxnProto* txn;
         string txn_string;
-        client_->GetTxn(&txn, batch_number * MAX_BATCH_SIZE + txn_id_offset);
+        client_->GetTxn(&txn, batch_number * MAX_BATCH_SIZE +
+                              batch.data_size());
 #ifdef LATENCY_TEST
         if (txn->txn_id() % SAMPLE_RATE == 0) {
           sequencer_recv[txn->txn_id() / SAMPLE_RATE] =
@@ -230,35 +444,40 @@ void Sequencer::RunWriter() {
             + epoch_duration_ * (static_cast<double>(rand()) / RAND_MAX);
         }
 #endif
-#ifdef PREFETCHING
-        double wait_time = PrefetchAll(storage_, txn);
-        if (wait_time > 0) {
-          fetching_txns.insert(std::make_pair(epoch_start + wait_time, txn));
-        } else {
-          txn->SerializeToString(&txn_string);
-          batch.add_data(txn_string);
-          txn_id_offset++;
-          delete txn;
-        }
-#else
         if(txn->txn_id() == -1) {
           delete txn;
           continue;
         }
 
+        // Read-only txns read a snapshot, which the reader picks once it
+        // knows the batch that carries them.
+        if (snapshot_reads && IsReadOnly(*txn))
+          txn->set_isolation_level(TxnProto::SNAPSHOT);
+
+        if (prefetch_connection_ != NULL) {
+          // Txns whose objects will not all be in memory by the time this
+          // batch starts go into a later batch instead.
+          double ready = StartPrefetch(txn);
+          if (ready < 0)
+            continue;
+          if (ready > batch_start) {
+            deferred_txns_.push(std::make_pair(ready, txn));
+            continue;
+          }
+        }
 
         txn->SerializeToString(&txn_string);
         batch.add_data(txn_string);
-        txn_id_offset++;
         delete txn;
-#endif
       }
+      if (prefetch_connection_ != NULL)
+        HandlePrefetchMessages();
     }
 
     // Send this epoch's requests to Paxos service.
     batch.SerializeToString(&batch_string);
 #ifdef PAXOS
-    paxos.SubmitBatch(batch_string);
+    paxos_log_->SubmitBatch(batch_string);
 #else
     pthread_mutex_lock(&mutex_);
     batch_queue_.push(batch_string);
@@ -271,10 +490,6 @@ void Sequencer::RunWriter() {
 
 void Sequencer::RunReader() {
   Spin(1);
-#ifdef PAXOS
-  Paxos paxos(ZOOKEEPER_CONF, true);
-#endif
-
   // Set up batch messages for each system node.
   map<int, MessageProto> batches;
   for (map<int, Node*>::iterator it = configuration_->all_nodes.begin();
@@ -287,7 +502,15 @@ void Sequencer::RunReader() {
   double time = GetTime();
   int txn_count = 0;
   int batch_count = 0;
-  int batch_number = configuration_->this_node_id;
+  int batch_number = configuration_->first_epoch *
+                     configuration_->all_nodes.size() +
+                     configuration_->this_node_id;
+  int empty_batches = 0;
+#ifndef PAXOS
+  double last_send = GetTime();
+#endif
+  // Batches logged but not yet durable, in batch order.
+  queue<MessageProto*> undispatched;
 
 #ifdef LATENCY_TEST
   int watched_txn = -1;
@@ -298,9 +521,22 @@ void Sequencer::RunReader() {
     string batch_string;
     MessageProto batch_message;
 #ifdef PAXOS
-    paxos.GetNextBatchBlocking(&batch_string);
+    if (input_log_ == NULL) {
+      paxos_log_->GetNextBatchBlocking(&batch_string);
+    } else {
+      // Keep dispatching earlier batches as they become durable.
+      while (!paxos_log_->GetNextBatch(&batch_string)) {
+        DispatchDurable(&undispatched);
+        Spin(0.0001);
+      }
+    }
 #else
+    // Wait a bounded amount of time for the writer's next batch. If the
+    // writer stalls past the deadline, an empty batch is sent in its place so
+    // that schedulers never block on this origin; the writer's txns will go
+    // out in the next epoch instead.
     bool got_batch = false;
+    double deadline = last_send + epoch_duration_ + max_batch_wait_;
     do {
       pthread_mutex_lock(&mutex_);
       if (batch_queue_.size()) {
@@ -309,14 +545,34 @@ void Sequencer::RunReader() {
         got_batch = true;
       }
       pthread_mutex_unlock(&mutex_);
-      if (!got_batch)
+      if (!got_batch) {
+        if (GetTime() > deadline)
+          break;
+        DispatchDurable(&undispatched);
         Spin(0.001);
+      }
     } while (!got_batch);
+    if (got_batch)
+      batch_message.ParseFromString(batch_string);
+    else
+      empty_batches++;
 #endif
-    batch_message.ParseFromString(batch_string);
+    // Place txns in the batch that actually carries them, which comes later
+    // than the writer's if empty batches were sent ahead of it, so that txn
+    // ids and snapshots keep following the global order.
+    const int nodes = configuration_->all_nodes.size();
+    MessageProto* logged_batch = NULL;
+    if (input_log_ != NULL) {
+      logged_batch = new MessageProto();
+      logged_batch->set_type(MessageProto::TXN_BATCH);
+      logged_batch->set_destination_node(configuration_->this_node_id);
+      logged_batch->set_destination_channel("sequencer");
+      logged_batch->set_batch_number(batch_number);
+    }
     for (int i = 0; i < batch_message.data_size(); i++) {
       TxnProto txn;
       txn.ParseFromString(batch_message.data(i));
+      PlaceTxn(&txn, batch_number, i, nodes);
 
 #ifdef LATENCY_TEST
       if (txn.txn_id() % SAMPLE_RATE == 0)
@@ -334,6 +590,9 @@ void Sequencer::RunReader() {
         writers.insert(configuration_->LookupPartition(txn.read_write_set(i)));
         readers.insert(configuration_->LookupPartition(txn.read_write_set(i)));
       }
+      for (int i = 0; i < txn.range_start_size(); i++)
+        configuration_->LookupRangePartitions(txn.range_start(i),
+                                              txn.range_end(i), &readers);
 
       for (set<int>::iterator it = readers.begin(); it != readers.end(); ++it)
         txn.add_readers(*it);
@@ -350,19 +609,52 @@ void Sequencer::RunReader() {
       // Insert txn into appropriate batches.
       for (set<int>::iterator it = readers.begin(); it != readers.end(); ++it)
         batches[*it].add_data(txn_data);
+      if (logged_batch != NULL)
+        logged_batch->add_data(txn_data);
 
       txn_count++;
     }
 
-    // Send this epoch's requests to all schedulers.
-    for (map<int, MessageProto>::iterator it = batches.begin();
-         it != batches.end(); ++it) {
-      it->second.set_batch_number(batch_number);
-      connection_->Send(it->second);
-      it->second.clear_data();
+    // Log the annotated batch (even if empty, so that replay sees every
+    // epoch). The log writes and syncs it in the background, together with
+    // whatever else has been appended meanwhile, and the batch is dispatched
+    // once it is durable.
+    if (logged_batch != NULL)
+      input_log_->Append(logged_batch);
+
+    // Send this epoch's requests to all schedulers, either directly or as a
+    // single bundle through this node's relay.
+    if (configuration_->dissemination_fanout > 0) {
+      MessageProto* bundle = new MessageProto();
+      bundle->set_type(MessageProto::TXN_BATCH_BUNDLE);
+      bundle->set_destination_node(
+          BatchRelay::RelayFor(*configuration_, configuration_->this_node_id));
+      bundle->set_destination_channel("relay");
+      bundle->set_source_node(configuration_->this_node_id);
+      bundle->set_batch_number(batch_number);
+      for (map<int, MessageProto>::iterator it = batches.begin();
+           it != batches.end(); ++it) {
+        it->second.set_batch_number(batch_number);
+        it->second.SerializeToString(bundle->add_data());
+        bundle->add_bundle_destinations(it->first);
+        it->second.clear_data();
+      }
+      Dispatch(bundle, &undispatched);
+    } else {
+      for (map<int, MessageProto>::iterator it = batches.begin();
+           it != batches.end(); ++it) {
+        it->second.set_batch_number(batch_number);
+        MessageProto* batch = new MessageProto();
+        batch->mutable_data()->Swap(it->second.mutable_data());
+        batch->MergeFrom(it->second);
+        Dispatch(batch, &undispatched);
+      }
     }
     batch_number += configuration_->all_nodes.size();
     batch_count++;
+#ifndef PAXOS
+    last_send = GetTime();
+#endif
 
 #ifdef LATENCY_TEST
     if (watched_txn != -1) {
@@ -376,11 +668,132 @@ void Sequencer::RunReader() {
 #ifdef VERBOSE_SEQUENCER
       std::cout << "Submitted " << txn_count << " txns in "
                 << batch_count << " batches,\n" << std::flush;
+      if (input_log_ != NULL) {
+        std::cout << "Input log durable through batch "
+                  << input_log_->DurableBatch() << " of " << batch_number
+                  << "\n" << std::flush;
+      }
 #endif
+      if (empty_batches > 0) {
+        std::cout << "Sequencer writer stalled, sent " << empty_batches
+                  << " empty batches\n" << std::flush;
+      }
       // Reset txn count.
       time = GetTime();
       txn_count = 0;
       batch_count = 0;
+      empty_batches = 0;
+    }
+  }
+  while (!undispatched.empty()) {
+    delete undispatched.front();
+    undispatched.pop();
+  }
+  Spin(1);
+}
+
+void Sequencer::Dispatch(MessageProto* message,
+                         queue<MessageProto*>* undispatched) {
+  if (input_log_ == NULL) {
+    connection_->Send(*message);
+    delete message;
+    return;
+  }
+  undispatched->push(message);
+  DispatchDurable(undispatched);
+}
+
+void Sequencer::DispatchDurable(queue<MessageProto*>* undispatched) {
+  if (undispatched->empty())
+    return;
+  int64 durable = input_log_->DurableBatch();
+  while (!undispatched->empty() &&
+         undispatched->front()->batch_number() <= durable) {
+    connection_->Send(*undispatched->front());
+    delete undispatched->front();
+    undispatched->pop();
+  }
+}
+
+void Sequencer::RunStreamer() {
+  Spin(1);
+  SynchronizeWithPeers();
+
+  // Set up stream messages for each system node.
+  int num_nodes = configuration_->all_nodes.size();
+  map<int, MessageProto> streams;
+  for (map<int, Node*>::iterator it = configuration_->all_nodes.begin();
+       it != configuration_->all_nodes.end(); ++it) {
+    streams[it->first].set_destination_channel("scheduler_");
+    streams[it->first].set_destination_node(it->first);
+    streams[it->first].set_source_node(configuration_->this_node_id);
+    streams[it->first].set_type(MessageProto::TXN_STREAM);
+  }
+
+  double time = GetTime();
+  int txn_count = 0;
+  int64 last_timestamp = 0;
+
+  while (!deconstructor_invoked_) {
+    double flush_start = GetTime();
+    int flush_count = 0;
+    while (!deconstructor_invoked_ &&
+           GetTime() < flush_start + stream_flush_interval_) {
+      if (flush_count >= MAX_STREAM_BATCH_SIZE) {
+        // The flush is full; sleep out the rest of the interval.
+        double remaining = flush_start + stream_flush_interval_ - GetTime();
+        if (remaining > 0)
+          Spin(remaining);
+        break;
+      }
+
+      // Txn ids order txns by (timestamp, origin).
+      int64 txn_id = NextTimestamp(&last_timestamp) * num_nodes
+                   + configuration_->this_node_id;
+      TxnProto* txn;
+      client_->GetTxn(&txn, txn_id);
+      if (txn->txn_id() == -1) {
+        delete txn;
+        continue;
+      }
+      txn->set_txn_id(txn_id);
+      add_readers_writers(txn);
+
+      bytes txn_data;
+      txn->SerializeToString(&txn_data);
+
+      // Send the txn to all participants.
+      set<int> participants(txn->readers().begin(), txn->readers().end());
+      participants.insert(txn->writers().begin(), txn->writers().end());
+      for (set<int>::iterator it = participants.begin();
+           it != participants.end(); ++it)
+        streams[*it].add_data(txn_data);
+
+      delete txn;
+      flush_count++;
+    }
+
+    // No txn streamed after this point will have a timestamp at or below the
+    // watermark.
+    int64 watermark = last_timestamp;
+    NextTimestamp(&watermark);
+    last_timestamp = watermark;
+    for (map<int, MessageProto>::iterator it = streams.begin();
+         it != streams.end(); ++it) {
+      it->second.set_watermark(watermark);
+      connection_->Send(it->second);
+      it->second.clear_data();
+    }
+    txn_count += flush_count;
+
+    // Report output.
+    if (GetTime() > time + 1) {
+#ifdef VERBOSE_SEQUENCER
+      std::cout << "Streamed " << txn_count << " txns\n" << std::flush;
+#endif
+      // Reset txn count.
+      time = GetTime();
+      txn_count = 0;
     }
   }
   Spin(1);
@@ -7,33 +7,49 @@
 #ifndef _DB_SEQUENCER_SEQUENCER_H_
 #define _DB_SEQUENCER_SEQUENCER_H_
 
+#include <functional>
+#include <map>
 #include <set>
 #include <string>
 #include <queue>
+#include <utility>
+#include <vector>
 #include "pthread.h"
 #include "common/utils.h"
 #include "proto/txn.pb.h"
 #include "common/configuration.h"
+#include "sequencer/fetch_latency_model.h"
 
 //#define PAXOS
-//#define PREFETCHING
 #define COLD_CUTOFF 990000
 
 //#define MAX_BATCH_SIZE 56
 #define MAX_BATCH_SIZE 150
 
+// Maximum number of txns a sequencer streams per flush interval in
+// STREAM_SEQUENCING mode.
+#define MAX_STREAM_BATCH_SIZE 2
+
 #define SAMPLES 100000
 #define SAMPLE_RATE 999
 //#define VERBOSE_SEQUENCER
 
 //#define LATENCY_TEST
 
+using std::map;
 using std::set;
 using std::string;
 using std::queue;
+using std::pair;
+using std::priority_queue;
+using std::vector;
 
+class BatchRelay;
+class InputLog;
+class PaxosLog;
 class Configuration;
 class Connection;
+class MessageProto;
 class Storage;
 class TxnProto;
 
@@ -67,32 +83,86 @@ class Sequencer {
 
   AtomicQueue<TxnProto*>* GetTxnsQueue() { return txns_queue_;}
 
+  // Places 'txn' at 'position' in batch 'batch_number' of a system of 'nodes'
+  // nodes: gives it the matching id and, if it reads a snapshot, the snapshot
+  // as of the end of the epoch before the batch's, which every scheduler
+  // reaches before it can have run any txn of the batch. (The initial state
+  // counts as txn 0's.)
+  static void PlaceTxn(TxnProto* txn, int batch_number, int position,
+                       int nodes);
+
  private:
   // Sequencer's main loops:
   //
   // RunWriter:
   //  while true:
   //    Spend epoch_duration collecting client txn requests into a batch.
-  //    Send batch to Paxos service.
+  //    Send batch to the replicated log (or directly to the reader).
   //
   // RunReader:
   //  while true:
-  //    Spend epoch_duration collecting client txn requests into a batch.
+  //    Get the next batch from Paxos (or the writer), or an empty batch if
+  //    none is ready in time.
+  //    Send each scheduler the txns it participates in (once the batch is
+  //    durable, if there is an input log).
+  //
+  // RunStreamer (STREAM_SEQUENCING mode only, replaces RunWriter/RunReader):
+  //  while true:
+  //    Spend stream_flush_interval collecting client txn requests, giving
+  //    each a hybrid logical timestamp.
+  //    Send each scheduler the txns it participates in, along with the
+  //    watermark below which no more txns will follow.
   //
   // Executes in a background thread created and started by the constructor.
   void RunWriter();
   void RunReader();
   void RunLoader();
+  void RunStreamer();
 
   // Functions to start the Multiplexor's main loops, called in new pthreads by
   // the Sequencer's constructor.
   static void* RunSequencerWriter(void *arg);
   static void* RunSequencerReader(void *arg);
   static void* RunSequencerLoader(void *arg);
+  static void* RunSequencerStreamer(void *arg);
+
+  // Waits until every other node's sequencer has started.
+  void SynchronizeWithPeers();
+
+  // Returns a hybrid logical timestamp (in microseconds) that is greater than
+  // '*last' and no less than the current time, and stores it in '*last'.
+  static int64 NextTimestamp(int64* last);
+
+  // Sends 'message', one of the reader's batches or bundles, and takes
+  // ownership of it. With an input log, it is held in '*undispatched' until
+  // the log reports its batch durable.
+  void Dispatch(MessageProto* message, queue<MessageProto*>* undispatched);
+
+  // Sends the messages in '*undispatched' whose batches have become durable.
+  void DispatchDurable(queue<MessageProto*>* undispatched);
 
   // Sets '*nodes' to contain the node_id of every node participating in 'txn'.
   void FindParticipatingNodes(const TxnProto& txn, set<int>* nodes);
 
+  // Returns true if 'txn' may read a snapshot instead of taking locks.
+  static bool IsReadOnly(const TxnProto& txn);
+
+  // Sets '*keys' to the objects 'txn' accesses at node 'node'.
+  void KeysAt(const TxnProto& txn, int node, vector<Key>* keys);
+
+  // Starts prefetching the objects of 'txn' at every participant. Returns
+  // the time by which all of them are expected to be in memory, or -1 if
+  // some at this node are not yet, in which case the storage pushes 'txn'
+  // onto 'resident_txns_' once they are.
+  double StartPrefetch(TxnProto* txn);
+
+  // Serves the prefetches other sequencers request of this node, and learns
+  // the latencies of those this sequencer requested.
+  void HandlePrefetchMessages();
+
+  // Drops the pins a prefetch of 'keys' left.
+  void Unpin(const vector<Key>& keys);
+
   inline void add_readers_writers(TxnProto* txn){
   	  set<int> readers, writers;
         for (int i = 0; i < txn->read_set_size(); i++)
@@ -103,6 +173,9 @@ class Sequencer {
           writers.insert(configuration_->LookupPartition(txn->read_write_set(i)));
           readers.insert(configuration_->LookupPartition(txn->read_write_set(i)));
         }
+        for (int i = 0; i < txn->range_start_size(); i++)
+          configuration_->LookupRangePartitions(txn->range_start(i),
+                                                txn->range_end(i), &readers);
 
         for (set<int>::iterator it = readers.begin(); it != readers.end(); ++it)
           txn->add_readers(*it);
@@ -114,6 +187,14 @@ class Sequencer {
   // batched, and sent out to schedulers.
   double epoch_duration_;
 
+  // Longest time the reader waits, beyond one epoch, for the writer's next
+  // batch before sending an empty batch for the epoch instead.
+  double max_batch_wait_;
+
+  // Interval at which the streamer sends out txns and watermarks in
+  // STREAM_SEQUENCING mode.
+  double stream_flush_interval_;
+
   // Configuration specifying node & system settings.
   Configuration* configuration_;
 
@@ -126,6 +207,34 @@ class Sequencer {
   // Pointer to this node's storage object, for prefetching.
   Storage* storage_;
 
+  // Prefetching state of the writer (see Configuration::prefetching). Txns
+  // whose objects at this node are being fetched are pushed onto
+  // 'resident_txns_' by the storage once they are in memory, and until then
+  // 'remote_ready_' keeps the time their remote objects are expected to be.
+  // Txns whose objects are all expected in memory only after the current
+  // batch starts wait in 'deferred_txns_', earliest first.
+  AtomicQueue<TxnProto*> resident_txns_;
+  map<TxnProto*, double> remote_ready_;
+  priority_queue<pair<double, TxnProto*>, vector<pair<double, TxnProto*> >,
+                 std::greater<pair<double, TxnProto*> > > deferred_txns_;
+
+  // Prefetch latencies of every other node's storage.
+  FetchLatencyModel latency_model_;
+
+  // Connection on which sequencers request prefetches of each other. Those
+  // served here stand in as placeholder txns until their objects are in
+  // memory, with the node that requested each and when it started.
+  Connection* prefetch_connection_;
+  AtomicQueue<TxnProto*> served_prefetches_;
+  map<TxnProto*, pair<int, double> > serving_;
+
+  // Relay for this node's group if it leads one in tree dissemination mode,
+  // otherwise NULL.
+  BatchRelay* relay_;
+
+  // Durable log of the batches sequenced by the reader, or NULL if disabled.
+  InputLog* input_log_;
+
   // Separate pthread contexts in which to run the sequencer's main loops.
   pthread_t writer_thread_;
   pthread_t reader_thread_;
@@ -134,6 +243,12 @@ class Sequencer {
   // main loop sees it and stops.
   bool deconstructor_invoked_;
 
+#ifdef PAXOS
+  // Replicated log through which the writer's batches reach the reader in
+  // paxos mode.
+  PaxosLog* paxos_log_;
+#endif
+
   // Queue for sending batches from writer to reader if not in paxos mode.
   queue<string> batch_queue_;
   pthread_mutex_t mutex_;
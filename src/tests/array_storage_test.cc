@@ -0,0 +1,78 @@
+// Author: Kun Ren (kun.ren@yale.edu)
+
+#include "backend/array_storage.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "backend/simple_storage.h"
+#include "common/testing.h"
+#include "common/utils.h"
+
+// Number of records each storage holds in the throughput test.
+#define NUM_RECORDS 1000000
+
+TEST(ArrayStorageTest) {
+  // Node 1 of 3 stores keys 1, 4, 7, ...
+  ArrayStorage storage(10, 3, 1);
+  EXPECT_EQ(0, storage.ReadObject("4"));
+  EXPECT_TRUE(storage.PutObject("4", new Value("value")));
+  Value* result = storage.ReadObject("4");
+  EXPECT_EQ(bytes("value"), *result);
+
+  // In-place updates and rewrites of the returned record.
+  *result = "updated";
+  EXPECT_TRUE(storage.PutObject("4", result));
+  EXPECT_EQ(bytes("updated"), *storage.ReadObject("4"));
+
+  // Keys of other nodes, outside the array, or not integers.
+  EXPECT_FALSE(storage.PutObject("5", new Value("value")));
+  EXPECT_FALSE(storage.PutObject("31", new Value("value")));
+  EXPECT_FALSE(storage.PutObject("w1", new Value("value")));
+  EXPECT_EQ(0, storage.ReadObject("5"));
+  EXPECT_EQ(0, storage.ReadObject("-2"));
+
+  EXPECT_TRUE(storage.DeleteObject("4"));
+  EXPECT_EQ(0, storage.ReadObject("4"));
+
+  END;
+}
+
+// Runs microbenchmark-style read-increment-write accesses to random keys of
+// 'storage'. Returns accesses/sec.
+double IncrementRecords(Storage* storage, const vector<Key>& keys) {
+  double start = GetTime();
+  for (uint32 i = 0; i < keys.size(); i++) {
+    Value* value = storage->ReadObject(keys[i]);
+    *value = IntToString(StringToInt(*value) + 1);
+  }
+  return keys.size() / (GetTime() - start);
+}
+
+TEST(ThroughputTest) {
+  ArrayStorage array(NUM_RECORDS, 1, 0);
+  SimpleStorage simple;
+  for (int i = 0; i < NUM_RECORDS; i++) {
+    array.PutObject(IntToString(i), new Value(IntToString(i)));
+    simple.PutObject(IntToString(i), new Value(IntToString(i)));
+  }
+
+  vector<Key> keys;
+  for (int i = 0; i < 2000000; i++)
+    keys.push_back(IntToString(rand() % NUM_RECORDS));
+  double array_rate = IncrementRecords(&array, keys);
+  double simple_rate = IncrementRecords(&simple, keys);
+  for (int i = 0; i < NUM_RECORDS; i += 9973)
+    EXPECT_EQ(*simple.ReadObject(IntToString(i)),
+              *array.ReadObject(IntToString(i)));
+
+  printf("Accesses: %.0f/sec ArrayStorage, %.0f/sec SimpleStorage\n",
+         array_rate, simple_rate);
+
+  END;
+}
+
+int main(int argc, char** argv) {
+  ArrayStorageTest();
+  ThroughputTest();
+}
@@ -0,0 +1,78 @@
+// Author: Kun Ren (kun@cs.yale.edu)
+
+#include "scheduler/batch_merger.h"
+
+#include <sstream>
+
+#include "common/testing.h"
+#include "common/utils.h"
+#include "proto/message.pb.h"
+
+MessageProto* SubBatch(int batch_number, const string& txn) {
+  MessageProto* batch = new MessageProto();
+  batch->set_type(MessageProto::TXN_BATCH);
+  batch->set_destination_node(0);
+  batch->set_destination_channel("scheduler_");
+  batch->set_batch_number(batch_number);
+  if (!txn.empty())
+    batch->add_data(txn);
+  return batch;
+}
+
+TEST(MergeInOriginOrderTest) {
+  BatchMerger merger(3, NULL);
+
+  // Epoch 0 arrives out of origin order.
+  merger.AddSubBatch(SubBatch(2, "c"));
+  merger.AddSubBatch(SubBatch(0, "a"));
+  EXPECT_TRUE(merger.GetEpoch(0) == NULL);
+  merger.AddSubBatch(SubBatch(1, "b"));
+
+  MessageProto* epoch = merger.GetEpoch(0);
+  EXPECT_TRUE(epoch != NULL);
+  EXPECT_EQ(3, epoch->data_size());
+  EXPECT_EQ("a", epoch->data(0));
+  EXPECT_EQ("b", epoch->data(1));
+  EXPECT_EQ("c", epoch->data(2));
+  delete epoch;
+
+  END;
+}
+
+TEST(EmptyPromiseTest) {
+  BatchMerger merger(2, NULL);
+
+  // Origin 1 promises an empty epoch 0 and runs ahead into epoch 1.
+  merger.AddSubBatch(SubBatch(1, ""));
+  merger.AddSubBatch(SubBatch(3, "d"));
+  merger.AddSubBatch(SubBatch(0, "a"));
+
+  MessageProto* epoch = merger.GetEpoch(0);
+  EXPECT_TRUE(epoch != NULL);
+  EXPECT_EQ(1, epoch->data_size());
+  EXPECT_EQ("a", epoch->data(0));
+  delete epoch;
+
+  // Epoch 1 is still waiting on origin 0, which gets reported.
+  EXPECT_TRUE(merger.GetEpoch(1) == NULL);
+  Spin(0.01);
+  EXPECT_TRUE(merger.GetEpoch(1) == NULL);
+  std::ostringstream report;
+  merger.ReportLag(report);
+  EXPECT_TRUE(report.str().find("node 0") != string::npos);
+
+  merger.AddSubBatch(SubBatch(2, "b"));
+  epoch = merger.GetEpoch(1);
+  EXPECT_TRUE(epoch != NULL);
+  EXPECT_EQ(2, epoch->data_size());
+  EXPECT_EQ("b", epoch->data(0));
+  EXPECT_EQ("d", epoch->data(1));
+  delete epoch;
+
+  END;
+}
+
+int main(int argc, char** argv) {
+  MergeInOriginOrderTest();
+  EmptyPromiseTest();
+}
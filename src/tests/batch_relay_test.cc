@@ -0,0 +1,163 @@
+// Author: Kun Ren (kun@cs.yale.edu)
+
+#include "sequencer/batch_relay.h"
+
+#include <set>
+
+#include "common/configuration.h"
+#include "common/connection.h"
+#include "common/testing.h"
+#include "common/utils.h"
+#include "proto/message.pb.h"
+
+#define NODES 4
+
+// Four nodes in two groups, relayed by nodes 0 and 2.
+struct Cluster {
+  Cluster() {
+    for (int i = 0; i < NODES; i++) {
+      configs[i] = new Configuration(i, "common/configuration_test_relay.conf");
+      multiplexers[i] = new ConnectionMultiplexer(configs[i]);
+    }
+    Spin(0.1);
+    for (int i = 0; i < NODES; i++) {
+      sequencers[i] = multiplexers[i]->NewConnection("sequencer");
+      schedulers[i] = multiplexers[i]->NewConnection("scheduler_");
+      relays[i] = NULL;
+      if (BatchRelay::IsRelay(*configs[i], i))
+        relays[i] = new BatchRelay(configs[i],
+                                   multiplexers[i]->NewConnection("relay"));
+    }
+  }
+
+  ~Cluster() {
+    for (int i = 0; i < NODES; i++) {
+      delete relays[i];
+      delete sequencers[i];
+      delete schedulers[i];
+      delete multiplexers[i];
+      delete configs[i];
+    }
+  }
+
+  // Sends origin's sub-batches for 'epoch' to its relay, as its sequencer
+  // would. Sub-batch 'd' holds the txn "<origin>-><d>".
+  void Send(int origin, int64 epoch) {
+    MessageProto bundle;
+    bundle.set_type(MessageProto::TXN_BATCH_BUNDLE);
+    bundle.set_destination_node(BatchRelay::RelayFor(*configs[origin], origin));
+    bundle.set_destination_channel("relay");
+    bundle.set_source_node(origin);
+    bundle.set_batch_number(epoch * NODES + origin);
+    for (int d = 0; d < NODES; d++) {
+      MessageProto batch;
+      batch.set_type(MessageProto::TXN_BATCH);
+      batch.set_destination_node(d);
+      batch.set_destination_channel("scheduler_");
+      batch.set_batch_number(epoch * NODES + origin);
+      batch.add_data(IntToString(origin) + "->" + IntToString(d));
+      batch.SerializeToString(bundle.add_data());
+      bundle.add_bundle_destinations(d);
+    }
+    sequencers[origin]->Send(bundle);
+  }
+
+  // Receives bundles at 'node' for up to 'max_wait_time' seconds, until
+  // 'count' sub-batches are in. Checks that sub-batches are addressed to
+  // 'node', and returns the number of bundles they came in.
+  int Receive(int node, int count, set<int64>* batch_numbers,
+              double max_wait_time) {
+    int bundles = 0;
+    double deadline = GetTime() + max_wait_time;
+    MessageProto message;
+    while (static_cast<int>(batch_numbers->size()) < count &&
+           GetTime() < deadline) {
+      if (!schedulers[node]->GetMessage(&message)) {
+        Spin(0.001);
+        continue;
+      }
+      EXPECT_EQ(MessageProto::TXN_BATCH_BUNDLE, message.type());
+      bundles++;
+      for (int i = 0; i < message.data_size(); i++) {
+        MessageProto batch;
+        batch.ParseFromString(message.data(i));
+        EXPECT_EQ(node, message.bundle_destinations(i));
+        int origin = batch.batch_number() % NODES;
+        EXPECT_EQ(IntToString(origin) + "->" + IntToString(node),
+                  batch.data(0));
+        batch_numbers->insert(batch.batch_number());
+      }
+    }
+    return bundles;
+  }
+
+  Configuration* configs[NODES];
+  ConnectionMultiplexer* multiplexers[NODES];
+  Connection* sequencers[NODES];
+  Connection* schedulers[NODES];
+  BatchRelay* relays[NODES];
+};
+
+TEST(GroupRelayTest) {
+  Cluster cluster;
+  EXPECT_TRUE(cluster.relays[0] != NULL);
+  EXPECT_TRUE(cluster.relays[1] == NULL);
+  EXPECT_TRUE(cluster.relays[2] != NULL);
+  EXPECT_EQ(2, BatchRelay::RelayFor(*cluster.configs[3], 3));
+
+  for (int i = 0; i < NODES; i++)
+    cluster.Send(i, 0);
+
+  // Every scheduler, relay or member, gets all of the epoch's sub-batches in
+  // a single bundle.
+  for (int i = 0; i < NODES; i++) {
+    set<int64> batch_numbers;
+    EXPECT_EQ(1, cluster.Receive(i, NODES, &batch_numbers, 5));
+    EXPECT_EQ(NODES, static_cast<int>(batch_numbers.size()));
+  }
+
+  END;
+}
+
+TEST(StalledOriginTest) {
+  Cluster cluster;
+
+  // Node 3 stalls in epoch 0. The other origins' sub-batches, including
+  // those of its group member node 2, still reach every scheduler, long
+  // before the relays would forget the epoch.
+  for (int i = 0; i < NODES - 1; i++)
+    cluster.Send(i, 0);
+  for (int i = 0; i < NODES; i++) {
+    set<int64> batch_numbers;
+    double start = GetTime();
+    cluster.Receive(i, NODES - 1, &batch_numbers, 5);
+    EXPECT_EQ(NODES - 1, static_cast<int>(batch_numbers.size()));
+    EXPECT_FALSE(batch_numbers.count(NODES - 1));
+    EXPECT_TRUE(GetTime() - start < RELAY_FORGET_TIME);
+  }
+
+  // Its late sub-batches are delivered as they come.
+  cluster.Send(NODES - 1, 0);
+  for (int i = 0; i < NODES; i++) {
+    set<int64> batch_numbers;
+    cluster.Receive(i, 1, &batch_numbers, 5);
+    EXPECT_EQ(1, static_cast<int>(batch_numbers.size()));
+    EXPECT_TRUE(batch_numbers.count(NODES - 1));
+  }
+
+  // Meanwhile the next epoch is relayed as usual.
+  for (int i = 0; i < NODES; i++)
+    cluster.Send(i, 1);
+  for (int i = 0; i < NODES; i++) {
+    set<int64> batch_numbers;
+    EXPECT_EQ(1, cluster.Receive(i, NODES, &batch_numbers, 5));
+    EXPECT_EQ(NODES, static_cast<int>(batch_numbers.size()));
+  }
+
+  END;
+}
+
+int main(int argc, char** argv) {
+  GroupRelayTest();
+  StalledOriginTest();
+}
@@ -0,0 +1,120 @@
+// Author: Kun Ren (kun.ren@yale.edu)
+
+#include "backend/checkpoint_file.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <utility>
+
+#include "backend/collapsed_versioned_storage.h"
+#include "backend/simple_storage.h"
+#include "common/testing.h"
+
+using std::pair;
+
+#define CHECKPOINT_PATH CHKPNTDIR "/test.checkpoint"
+
+// Number of records each writer thread adds.
+#define RECORDS_PER_THREAD 250000
+
+// Adds thread 'thread's share of the test records to a CheckpointWriter.
+void* AddRecords(void* arg) {
+  pair<int, CheckpointWriter*>* thread =
+      reinterpret_cast<pair<int, CheckpointWriter*>*>(arg);
+  Value value(100, 'a' + thread->first);
+  for (int i = 0; i < RECORDS_PER_THREAD; i++) {
+    int key = i * CHECKPOINT_THREADS + thread->first;
+    thread->second->Add(thread->first, key, IntToString(key), value);
+  }
+  return NULL;
+}
+
+// Writes the test records with 'num_threads' threads. Returns records/sec.
+double WriteCheckpoint(int num_threads) {
+  double start = GetTime();
+  CheckpointWriter writer(CHECKPOINT_PATH, 42, num_threads);
+  pthread_t threads[CHECKPOINT_THREADS];
+  pair<int, CheckpointWriter*> args[CHECKPOINT_THREADS];
+  for (int i = 0; i < num_threads; i++) {
+    args[i] = pair<int, CheckpointWriter*>(i, &writer);
+    pthread_create(&threads[i], NULL, AddRecords, &args[i]);
+  }
+  for (int i = 0; i < num_threads; i++)
+    pthread_join(threads[i], NULL);
+  EXPECT_TRUE(writer.Finish());
+  return num_threads * RECORDS_PER_THREAD / (GetTime() - start);
+}
+
+TEST(RoundTripTest) {
+  system("mkdir -p " CHKPNTDIR);
+  WriteCheckpoint(CHECKPOINT_THREADS);
+
+  CheckpointReader reader(CHECKPOINT_PATH);
+  EXPECT_TRUE(reader.valid());
+  EXPECT_EQ(42, reader.stable());
+  EXPECT_EQ(static_cast<uint64>(CHECKPOINT_THREADS * RECORDS_PER_THREAD),
+            reader.num_records());
+
+  SimpleStorage storage;
+  storage.Initmutex();
+  EXPECT_TRUE(reader.Load(&storage, CHECKPOINT_THREADS));
+  for (int key = 0; key < CHECKPOINT_THREADS * RECORDS_PER_THREAD;
+       key += 9973) {
+    Value* value = storage.ReadObject(IntToString(key));
+    EXPECT_TRUE(value != NULL);
+    EXPECT_EQ(Value(100, 'a' + key % CHECKPOINT_THREADS), *value);
+  }
+
+  END;
+}
+
+TEST(CorruptSegmentTest) {
+  WriteCheckpoint(CHECKPOINT_THREADS);
+
+  // Flip a byte in the middle of the record data.
+  FILE* file = fopen(CHECKPOINT_PATH, "r+b");
+  fseek(file, CHECKPOINT_SEGMENT_SIZE / 2, SEEK_SET);
+  int c = fgetc(file);
+  fseek(file, CHECKPOINT_SEGMENT_SIZE / 2, SEEK_SET);
+  fputc(c ^ 0xFF, file);
+  fclose(file);
+
+  CheckpointReader reader(CHECKPOINT_PATH);
+  EXPECT_TRUE(reader.valid());
+  SimpleStorage storage;
+  storage.Initmutex();
+  EXPECT_FALSE(reader.Load(&storage, CHECKPOINT_THREADS));
+
+  // A truncated file is rejected outright.
+  EXPECT_EQ(0, truncate(CHECKPOINT_PATH, 4096));
+  CheckpointReader truncated(CHECKPOINT_PATH);
+  EXPECT_FALSE(truncated.valid());
+
+  END;
+}
+
+TEST(ThroughputTest) {
+  for (int threads = 1; threads <= CHECKPOINT_THREADS; threads *= 2) {
+    double write_rate = WriteCheckpoint(threads);
+
+    double start = GetTime();
+    CheckpointReader reader(CHECKPOINT_PATH);
+    CollapsedVersionedStorage storage;
+    EXPECT_TRUE(reader.Load(&storage, threads));
+    double load_rate = reader.num_records() / (GetTime() - start);
+
+    printf("%d threads: write %.0f records/sec, load %.0f records/sec\n",
+           threads, write_rate, load_rate);
+  }
+  unlink(CHECKPOINT_PATH);
+
+  END;
+}
+
+int main(int argc, char** argv) {
+  RoundTripTest();
+  CorruptSegmentTest();
+  ThroughputTest();
+}
@@ -2,8 +2,17 @@
 
 #include "backend/collapsed_versioned_storage.h"
 
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "backend/checkpoint_file.h"
+#include "backend/simple_storage.h"
 #include "common/testing.h"
 
+// Number of records in the checkpoint overhead test.
+#define OVERHEAD_RECORDS 200000
+
 TEST(CollapsedVersionedStorageTest) {
   CollapsedVersionedStorage* storage = new CollapsedVersionedStorage();
 
@@ -12,11 +21,11 @@ TEST(CollapsedVersionedStorageTest) {
   Value value_two = bytes("value_two");
   Value* result = storage->ReadObject(key);
 
-  EXPECT_TRUE(storage->PutObject(key, &value_one, 10));
+  EXPECT_TRUE(storage->PutObject(key, new Value(value_one), 10));
   storage->PrepareForCheckpoint(15);
-  EXPECT_TRUE(storage->PutObject(key, &value_two, 12));
-  EXPECT_TRUE(storage->PutObject(key, &value_two, 20));
-  EXPECT_TRUE(storage->PutObject(key, &value_one, 30));
+  EXPECT_TRUE(storage->PutObject(key, new Value(value_two), 12));
+  EXPECT_TRUE(storage->PutObject(key, new Value(value_two), 20));
+  EXPECT_TRUE(storage->PutObject(key, new Value(value_one), 30));
 
   EXPECT_EQ(0, storage->ReadObject(key, 10));
   result = storage->ReadObject(key, 12);
@@ -49,9 +58,9 @@ TEST(CheckpointingTest) {
   Value value_two = bytes("value_two");
   Value* result;
 
-  EXPECT_TRUE(storage->PutObject(key, &value_one, 10));
+  EXPECT_TRUE(storage->PutObject(key, new Value(value_one), 10));
   storage->PrepareForCheckpoint(15);
-  EXPECT_TRUE(storage->PutObject(key, &value_two, 20));
+  EXPECT_TRUE(storage->PutObject(key, new Value(value_two), 20));
   storage->Checkpoint();
 
   sleep(5);
@@ -72,9 +81,216 @@ TEST(CheckpointingTest) {
   END;
 }
 
+TEST(LoadCheckpointTest) {
+  // Restores the checkpoint written by CheckpointingTest.
+  CollapsedVersionedStorage* storage = new CollapsedVersionedStorage();
+  EXPECT_EQ(15, CollapsedVersionedStorage::LoadLatestCheckpoint(storage));
+
+  Value* result = storage->ReadObject(bytes("key"));
+  EXPECT_TRUE(result != NULL);
+  EXPECT_EQ(bytes("value_one"), *result);
+
+  delete storage;
+
+  END;
+}
+
+TEST(InsertedRowsTest) {
+  CollapsedVersionedStorage* storage = new CollapsedVersionedStorage();
+
+  // TPC-C's inserted rows go to the append-only tables, other keys do not.
+  EXPECT_TRUE(storage->PutObject("w1d2o7", new Value("order"), 10));
+  EXPECT_TRUE(storage->PutObject("w1d2o7ol3", new Value("line"), 10));
+  EXPECT_TRUE(storage->PutObject("w1d2no7", new Value("new_order"), 10));
+  EXPECT_TRUE(storage->PutObject("w3h11", new Value("history"), 11));
+  EXPECT_TRUE(storage->PutObject("w1d2o7x", new Value("other"), 12));
+  EXPECT_EQ(bytes("order"), *storage->ReadObject("w1d2o7"));
+  EXPECT_EQ(bytes("line"), *storage->ReadObject("w1d2o7ol3"));
+  EXPECT_EQ(bytes("new_order"), *storage->ReadObject("w1d2no7"));
+  EXPECT_EQ(bytes("history"), *storage->ReadObject("w3h11"));
+  EXPECT_EQ(bytes("other"), *storage->ReadObject("w1d2o7x"));
+  EXPECT_EQ(0, storage->ReadObject("w1d2o8"));
+  EXPECT_EQ(0, storage->ReadObject("w1d3o7"));
+  EXPECT_EQ(0, storage->ReadObject("w2h11"));
+
+  // Delivery deletes the NewOrder row; earlier txns still see it.
+  EXPECT_TRUE(storage->DeleteObject("w1d2no7", 20));
+  EXPECT_EQ(0, storage->ReadObject("w1d2no7"));
+  EXPECT_EQ(bytes("new_order"), *storage->ReadObject("w1d2no7", 15));
+
+  // Delivering an order retires the orders RETAINED_ORDERS before it.
+  int64 delivered = RETAINED_ORDERS + 2 * INSERT_SEGMENT_SIZE;
+  char key[32];
+  snprintf(key, sizeof(key), "w1d2no%ld", static_cast<long>(delivered));
+  EXPECT_TRUE(storage->PutObject(key, new Value("new_order"), 30));
+  EXPECT_TRUE(storage->DeleteObject(key, 40));
+  EXPECT_EQ(0, storage->ReadObject("w1d2o7"));
+  EXPECT_EQ(0, storage->ReadObject("w1d2o7ol3"));
+  Value rejected("rejected");
+  EXPECT_FALSE(storage->PutObject("w1d2o7", &rejected, 50));
+  EXPECT_EQ(bytes("history"), *storage->ReadObject("w3h11"));
+
+  // Inserting History rows retires the ones RETAINED_HISTORY before them, in
+  // the same warehouse only.
+  int64 latest = RETAINED_HISTORY + 2 * INSERT_SEGMENT_SIZE;
+  snprintf(key, sizeof(key), "w4h%ld", static_cast<long>(latest));
+  EXPECT_TRUE(storage->PutObject("w4h11", new Value("history"), 50));
+  EXPECT_TRUE(storage->PutObject(key, new Value("history"), 50));
+  EXPECT_EQ(0, storage->ReadObject("w4h11"));
+  EXPECT_EQ(bytes("history"), *storage->ReadObject(key));
+  EXPECT_EQ(bytes("history"), *storage->ReadObject("w3h11"));
+
+  // Rows inserted up to the boundary are checkpointed under their keys.
+  EXPECT_TRUE(storage->PutObject("w1d2o9000", new Value("order"), 60));
+  EXPECT_TRUE(storage->PutObject("w1d2o9000ol0", new Value("line"), 60));
+  storage->PrepareForCheckpoint(70);
+  EXPECT_TRUE(storage->PutObject("w1d2o9001", new Value("order"), 80));
+  *storage->ReadObjectForUpdate("w1d2o9000", 80) = "delivered";
+  EXPECT_EQ(bytes("order"), *storage->ReadObject("w1d2o9000", 70));
+  storage->CaptureCheckpoint();
+  EXPECT_EQ(bytes("delivered"), *storage->ReadObject("w1d2o9000"));
+
+  char checkpoint_path[100];
+  snprintf(checkpoint_path, sizeof(checkpoint_path), "%s/70.checkpoint",
+           CHKPNTDIR);
+  CheckpointReader reader(checkpoint_path);
+  EXPECT_TRUE(reader.valid());
+  SimpleStorage loaded;
+  EXPECT_TRUE(reader.Load(&loaded, CHECKPOINT_THREADS));
+  EXPECT_EQ(bytes("order"), *loaded.ReadObject("w1d2o9000"));
+  EXPECT_EQ(bytes("line"), *loaded.ReadObject("w1d2o9000ol0"));
+  EXPECT_EQ(bytes("history"), *loaded.ReadObject("w3h11"));
+  EXPECT_EQ(bytes("other"), *loaded.ReadObject("w1d2o7x"));
+  EXPECT_EQ(0, loaded.ReadObject("w1d2o9001"));
+  EXPECT_EQ(0, loaded.ReadObject("w1d2no7"));
+  EXPECT_EQ(bytes("history"), *loaded.ReadObject(key));
+  EXPECT_EQ(static_cast<uint64>(5), reader.num_records());
+  unlink(checkpoint_path);
+
+  delete storage;
+
+  END;
+}
+
+TEST(SnapshotReadsTest) {
+  CollapsedVersionedStorage* storage = new CollapsedVersionedStorage();
+  EXPECT_TRUE(storage->EnableSnapshotReads());
+
+  Key key = bytes("key");
+  storage->PutObject(key, new Value("v0"), 0);
+  *storage->ReadObjectForUpdate(key, 10) = "v10";
+  *storage->ReadObjectForUpdate(key, 20) = "v20";
+  storage->PutObject(key, new Value("v30"), 30);
+
+  // Snapshots see the versions as of their txn id; locked txns the newest.
+  EXPECT_EQ(bytes("v0"), *storage->ReadObject(key, 5));
+  EXPECT_EQ(bytes("v10"), *storage->ReadObject(key, 19));
+  EXPECT_EQ(bytes("v20"), *storage->ReadObject(key, 29));
+  EXPECT_EQ(bytes("v30"), *storage->ReadObject(key, 31));
+
+  // Moving the horizon lets the next write drop the versions older than the
+  // one the horizon sees.
+  storage->SetSnapshotHorizon(25);
+  storage->PutObject(key, new Value("v40"), 40);
+  EXPECT_EQ(0, storage->ReadObject(key, 19));
+  EXPECT_EQ(bytes("v20"), *storage->ReadObject(key, 25));
+  EXPECT_EQ(bytes("v30"), *storage->ReadObject(key, 39));
+  EXPECT_EQ(bytes("v40"), *storage->ReadObject(key));
+
+  // A checkpoint's stable version outlives the horizon.
+  storage->PrepareForCheckpoint(35);
+  storage->SetSnapshotHorizon(45);
+  storage->PutObject(key, new Value("v50"), 50);
+  EXPECT_EQ(bytes("v30"), *storage->ReadObject(key, 35));
+  EXPECT_EQ(bytes("v40"), *storage->ReadObject(key, 45));
+
+  // Rows inserted after a snapshot are hidden from it.
+  EXPECT_TRUE(storage->PutObject("w1d2o7", new Value("order"), 60));
+  EXPECT_EQ(0, storage->ReadObject("w1d2o7", 55));
+  EXPECT_EQ(bytes("order"), *storage->ReadObject("w1d2o7", 60));
+
+  // Delivery-style updates to them after the horizon are hidden from earlier
+  // snapshots.
+  storage->SetSnapshotHorizon(65);
+  *storage->ReadObjectForUpdate("w1d2o7", 70) = "delivered";
+  EXPECT_EQ(bytes("order"), *storage->ReadObject("w1d2o7", 65));
+  EXPECT_EQ(bytes("delivered"), *storage->ReadObject("w1d2o7", 70));
+
+  // Dropped versions and their values are freed once no txn can hold them.
+  EXPECT_TRUE(storage->epochs()->retired() > 0);
+  storage->epochs()->Reclaim();
+  storage->epochs()->Reclaim();
+  EXPECT_EQ(0, storage->epochs()->retired());
+  delete storage;
+  END;
+}
+
+// Applies read-modify-write updates to random records for 'seconds',
+// starting at txn 'txn_id'. Returns updates/sec.
+double UpdateRecords(Storage* storage, int64* txn_id, double seconds) {
+  double start = GetTime();
+  int updates = 0;
+  while (GetTime() < start + seconds) {
+    for (int i = 0; i < 1000; i++) {
+      Value* value = storage->ReadObjectForUpdate(
+          IntToString(rand() % OVERHEAD_RECORDS), ++*txn_id);
+      (*value)[0] = 'b';
+      updates++;
+    }
+  }
+  return updates / (GetTime() - start);
+}
+
+TEST(CheckpointOverheadTest) {
+  CollapsedVersionedStorage* storage = new CollapsedVersionedStorage();
+  for (int i = 0; i < OVERHEAD_RECORDS; i++)
+    storage->PutObject(IntToString(i), new Value(100, 'a'), 0);
+
+  // Txns after the boundary update records while the checkpoint is taken.
+  int64 txn_id = 0;
+  double baseline = UpdateRecords(storage, &txn_id, 2);
+  int64 stable = txn_id;
+  storage->PrepareForCheckpoint(stable);
+  storage->Checkpoint();
+  double start = GetTime();
+  int64 updates = 0;
+  while (storage->CheckpointInProgress()) {
+    Value* value = storage->ReadObjectForUpdate(
+        IntToString(rand() % OVERHEAD_RECORDS), ++txn_id);
+    (*value)[0] = 'c';
+    updates++;
+  }
+  double during = updates / (GetTime() - start);
+  printf("Updates: %.0f/sec without checkpoint, %.0f/sec during checkpoint "
+         "(%.2f of it, %.1f seconds)\n", baseline, during, during / baseline,
+         GetTime() - start);
+
+  // None of the later updates made it into the checkpoint.
+  char checkpoint_path[100];
+  snprintf(checkpoint_path, sizeof(checkpoint_path), "%s/%ld.checkpoint",
+           CHKPNTDIR, static_cast<long>(stable));
+  CheckpointReader reader(checkpoint_path);
+  EXPECT_TRUE(reader.valid());
+  EXPECT_EQ(static_cast<uint64>(OVERHEAD_RECORDS), reader.num_records());
+  SimpleStorage loaded;
+  loaded.Initmutex();
+  EXPECT_TRUE(reader.Load(&loaded, CHECKPOINT_THREADS));
+  for (int i = 0; i < OVERHEAD_RECORDS; i++)
+    EXPECT_TRUE((*loaded.ReadObject(IntToString(i)))[0] != 'c');
+  unlink(checkpoint_path);
+
+  delete storage;
+
+  END;
+}
+
 int main(int argc, char** argv) {
   CollapsedVersionedStorageTest();
   CheckpointingTest();
+  LoadCheckpointTest();
+  InsertedRowsTest();
+  SnapshotReadsTest();
+  CheckpointOverheadTest();
 }
 
 
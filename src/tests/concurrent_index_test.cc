@@ -0,0 +1,182 @@
+// Author: Kun Ren (kun.ren@yale.edu)
+
+#include "backend/concurrent_index.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <tr1/unordered_map>
+
+#include "common/testing.h"
+
+using std::tr1::unordered_map;
+
+// Number of keys each inserting thread adds in the concurrent tests.
+#define KEYS_PER_THREAD 100000
+#define INSERTERS 4
+
+TEST(ConcurrentIndexTest) {
+  ConcurrentIndex index;
+  Value one = bytes("one");
+  Value two = bytes("two");
+
+  EXPECT_TRUE(index.Lookup("key") == NULL);
+  index.Insert("key", &one);
+  EXPECT_EQ(&one, index.Lookup("key"));
+  index.Insert("key", &two);
+  EXPECT_EQ(&two, index.Lookup("key"));
+  EXPECT_EQ(static_cast<uint64>(1), index.size());
+
+  EXPECT_TRUE(index.Erase("key"));
+  EXPECT_FALSE(index.Erase("key"));
+  EXPECT_TRUE(index.Lookup("key") == NULL);
+
+  // Enough keys to grow every shard several times, then erase half of them
+  // and insert them again (reusing erased slots).
+  vector<pair<Key, Value*> > objects;
+  for (int i = 0; i < 200000; i++)
+    objects.push_back(pair<Key, Value*>(IntToString(i), &one));
+  index.InsertBatch(objects);
+  for (int i = 0; i < 200000; i += 2)
+    EXPECT_TRUE(index.Erase(IntToString(i)));
+  EXPECT_EQ(static_cast<uint64>(100000), index.size());
+  for (int i = 0; i < 200000; i++) {
+    Value* expected = (i % 2 == 0) ? NULL : &one;
+    EXPECT_EQ(expected, index.Lookup(IntToString(i)));
+  }
+  for (int i = 0; i < 200000; i += 2)
+    index.Insert(IntToString(i), &two);
+  for (int i = 0; i < 200000; i++) {
+    Value* expected = (i % 2 == 0) ? &two : &one;
+    EXPECT_EQ(expected, index.Lookup(IntToString(i)));
+  }
+
+  END;
+}
+
+// Shared state of the concurrent tests.
+struct IndexTestState {
+  ConcurrentIndex* index;
+  Value values[INSERTERS];
+  volatile bool inserting;
+  volatile int64 lookups;
+  volatile bool wrong_value;
+};
+
+void* InsertKeys(void* arg) {
+  pair<int, IndexTestState*>* thread =
+      reinterpret_cast<pair<int, IndexTestState*>*>(arg);
+  IndexTestState* state = thread->second;
+  for (int i = 0; i < KEYS_PER_THREAD; i++) {
+    state->index->Insert(IntToString(i * INSERTERS + thread->first),
+                         &state->values[thread->first]);
+  }
+  return NULL;
+}
+
+void* LookupKeys(void* arg) {
+  IndexTestState* state = reinterpret_cast<IndexTestState*>(arg);
+  int64 lookups = 0;
+  while (state->inserting) {
+    // A key is either absent or maps to its inserter's value.
+    int key = rand() % (KEYS_PER_THREAD * INSERTERS);
+    Value* value = state->index->Lookup(IntToString(key));
+    if (value != NULL && value != &state->values[key % INSERTERS])
+      state->wrong_value = true;
+    lookups++;
+  }
+  __sync_fetch_and_add(&state->lookups, lookups);
+  return NULL;
+}
+
+TEST(ConcurrentInsertTest) {
+  IndexTestState state;
+  state.index = new ConcurrentIndex();
+  state.inserting = true;
+  state.lookups = 0;
+  state.wrong_value = false;
+
+  pthread_t readers[2];
+  for (int i = 0; i < 2; i++)
+    pthread_create(&readers[i], NULL, LookupKeys, &state);
+
+  double start = GetTime();
+  pthread_t inserters[INSERTERS];
+  pair<int, IndexTestState*> args[INSERTERS];
+  for (int i = 0; i < INSERTERS; i++) {
+    args[i] = pair<int, IndexTestState*>(i, &state);
+    pthread_create(&inserters[i], NULL, InsertKeys, &args[i]);
+  }
+  for (int i = 0; i < INSERTERS; i++)
+    pthread_join(inserters[i], NULL);
+  double elapsed = GetTime() - start;
+  state.inserting = false;
+  for (int i = 0; i < 2; i++)
+    pthread_join(readers[i], NULL);
+
+  EXPECT_FALSE(state.wrong_value);
+  EXPECT_EQ(static_cast<uint64>(KEYS_PER_THREAD * INSERTERS),
+            state.index->size());
+  for (int i = 0; i < KEYS_PER_THREAD * INSERTERS; i++)
+    EXPECT_EQ(&state.values[i % INSERTERS],
+              state.index->Lookup(IntToString(i)));
+  printf("%d threads inserted %.0f keys/sec alongside %ld lookups\n",
+         INSERTERS, KEYS_PER_THREAD * INSERTERS / elapsed,
+         static_cast<long>(state.lookups));
+  delete state.index;
+
+  END;
+}
+
+TEST(LookupThroughputTest) {
+  // Single-threaded lookups compared to the unordered_map SimpleStorage used
+  // to be built on.
+  ConcurrentIndex index;
+  unordered_map<Key, Value*> map;
+  Value value = bytes("value");
+  vector<pair<Key, Value*> > objects;
+  for (int i = 0; i < 1000000; i++) {
+    objects.push_back(pair<Key, Value*>(IntToString(i), &value));
+    map[IntToString(i)] = &value;
+  }
+  index.InsertBatch(objects);
+
+  vector<Key> keys;
+  for (int i = 0; i < 1000000; i++)
+    keys.push_back(IntToString(rand() % 1000000));
+
+  double start = GetTime();
+  int found = 0;
+  for (uint32 i = 0; i < keys.size(); i++)
+    found += index.Lookup(keys[i]) != NULL;
+  double index_rate = keys.size() / (GetTime() - start);
+
+  // Lookups in groups of eight, prefetched first as workers do.
+  start = GetTime();
+  for (uint32 i = 0; i < keys.size(); i += 8) {
+    for (uint32 j = i; j < i + 8 && j < keys.size(); j++)
+      index.Prefetch(keys[j]);
+    for (uint32 j = i; j < i + 8 && j < keys.size(); j++)
+      found += index.Lookup(keys[j]) != NULL;
+  }
+  double grouped_rate = keys.size() / (GetTime() - start);
+
+  start = GetTime();
+  for (uint32 i = 0; i < keys.size(); i++)
+    found += map.count(keys[i]) != 0 && map[keys[i]] != NULL;
+  double map_rate = keys.size() / (GetTime() - start);
+
+  EXPECT_EQ(3000000, found);
+  printf("Lookups: %.0f/sec concurrent index (%.0f/sec prefetched in "
+         "groups), %.0f/sec unordered_map\n",
+         index_rate, grouped_rate, map_rate);
+
+  END;
+}
+
+int main(int argc, char** argv) {
+  ConcurrentIndexTest();
+  ConcurrentInsertTest();
+  LookupThroughputTest();
+}
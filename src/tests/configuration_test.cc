@@ -16,6 +16,7 @@ TEST(ConfigurationTest_ReadFromFile) {
   EXPECT_EQ(50001, config.all_nodes[1]->port);
   EXPECT_EQ(2, config.all_nodes[2]->node_id);
   EXPECT_EQ(string("128.36.232.50"), config.all_nodes[2]->host);
+  EXPECT_EQ(EPOCH_SEQUENCING, config.sequencer_mode);
   END;
 }
 
@@ -26,8 +27,31 @@ TEST(ConfigurationTest_LookupPartition) {
   END;
 }
 
+TEST(ConfigurationTest_LookupRangePartitions) {
+  Configuration config(1, "common/configuration_test.conf");
+
+  // Ranges within one warehouse are stored at its partition.
+  set<int> nodes;
+  config.LookupRangePartitions(Key("w3d1s"), Key("w3d1t"), &nodes);
+  EXPECT_EQ(1, nodes.size());
+  EXPECT_EQ(1, *nodes.begin());
+
+  // Others may have keys at every partition.
+  nodes.clear();
+  config.LookupRangePartitions(Key("w3"), Key("w4"), &nodes);
+  EXPECT_EQ(2, nodes.size());
+  nodes.clear();
+  config.LookupRangePartitions(Key("w3d1s"), Key(""), &nodes);
+  EXPECT_EQ(2, nodes.size());
+  nodes.clear();
+  config.LookupRangePartitions(Key("1"), Key("2"), &nodes);
+  EXPECT_EQ(2, nodes.size());
+  END;
+}
+
 int main(int argc, char** argv) {
   ConfigurationTest_ReadFromFile();
   ConfigurationTest_LookupPartition();
+  ConfigurationTest_LookupRangePartitions();
 }
 
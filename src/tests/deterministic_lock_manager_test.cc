@@ -9,6 +9,7 @@
 #include "applications/tpcc.h"
 #include "common/utils.h"
 #include "common/testing.h"
+#include "proto/tpcc_args.pb.h"
 
 using std::set;
 /*
@@ -100,6 +101,41 @@ TEST(LocksReleasedOutOfOrder) {
 }
 */
 
+TEST(RangeLockTest) {
+  deque<TxnProto*> ready_txns;
+  Configuration config(0, "common/configuration_test_one_node.conf");
+  DeterministicLockManager lm(&ready_txns, &config);
+
+  // Txn 1 writes a key in the range txn 2 scans and inserts another one,
+  // and txn 3 then inserts a new key into it. Txn 4 writes outside the range.
+  TxnProto t1, t2, t3, t4;
+  t1.add_read_write_set("w0d1o5");
+  t1.add_write_set("w0d1o7");
+  t2.add_range_start("w0d1o");
+  t2.add_range_end("w0d1p");
+  t3.add_write_set("w0d1o6");
+  t4.add_read_write_set("w0d2o6");
+
+  EXPECT_EQ(0, lm.Lock(&t1));
+  EXPECT_EQ(2, lm.Lock(&t2));
+  EXPECT_EQ(1, lm.Lock(&t3));
+  EXPECT_EQ(0, lm.Lock(&t4));
+  EXPECT_EQ(2, static_cast<int>(ready_txns.size()));
+  EXPECT_EQ(&t4, ready_txns.at(1));
+
+  // The scan runs once txn 1 is done, and the insert once the scan is.
+  lm.Release(&t1);
+  EXPECT_EQ(3, static_cast<int>(ready_txns.size()));
+  EXPECT_EQ(&t2, ready_txns.at(2));
+  lm.Release(&t2);
+  EXPECT_EQ(4, static_cast<int>(ready_txns.size()));
+  EXPECT_EQ(&t3, ready_txns.at(3));
+  lm.Release(&t3);
+  lm.Release(&t4);
+
+  END;
+}
+
 TEST(ThroughputTest) {
   deque<TxnProto*> ready_txns;
   Configuration config(0, "common/configuration_test_one_node.conf");
@@ -117,7 +153,7 @@ TEST(ThroughputTest) {
 //    txns.push_back(new TxnProto());
 //    for (int j = 0; j < 10; j++)
 //      txns[i]->add_read_write_set(IntToString(j * 1000 + rand() % 1000));
-    txns.push_back(tpcc.NewTxn(i, TPCC::NEW_ORDER, args_string, NULL));
+    txns.push_back(tpcc.NewTxn(i, TPCC::NEW_ORDER, args_string, &config));
   }
 
   double start = GetTime();
@@ -142,6 +178,7 @@ TEST(ThroughputTest) {
 int main(int argc, char** argv) {
 //  SimpleLockingTest();
 //  LocksReleasedOutOfOrder();
+  RangeLockTest();
   ThroughputTest();
 }
 
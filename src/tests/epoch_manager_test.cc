@@ -0,0 +1,113 @@
+// Author: Kun Ren (kun.ren@yale.edu)
+
+#include "backend/epoch_manager.h"
+
+#include <pthread.h>
+
+#include "common/testing.h"
+#include "common/utils.h"
+
+#define READERS 4
+
+static int freed = 0;
+static void CountFree(void* object) {
+  freed++;
+}
+
+TEST(EpochManagerTest) {
+  EpochManager epochs;
+  int objects[3];
+
+  // A pin keeps what is retired after it.
+  int64 pin = epochs.Pin();
+  epochs.Retire(&objects[0], CountFree);
+  for (int i = 0; i < 10; i++)
+    epochs.Reclaim();
+  EXPECT_EQ(0, freed);
+  EXPECT_EQ(1, epochs.retired());
+
+  // Pins may overlap and be released out of order. Releasing the first pin
+  // frees what only it held.
+  int64 second = epochs.Pin();
+  epochs.Retire(&objects[1], CountFree);
+  epochs.Unpin(pin);
+  epochs.Reclaim();
+  EXPECT_EQ(1, freed);
+  epochs.Unpin(second);
+  epochs.Reclaim();
+  epochs.Reclaim();
+  EXPECT_EQ(2, freed);
+  EXPECT_EQ(0, epochs.retired());
+
+  // Without pins, objects are freed two epochs on.
+  epochs.Retire(&objects[2], CountFree);
+  epochs.Reclaim();
+  epochs.Reclaim();
+  EXPECT_EQ(3, freed);
+  END;
+}
+
+// A value readers check while a writer keeps replacing it.
+struct Shared {
+  EpochManager epochs;
+  int* volatile value;
+  volatile bool stop;
+  volatile int64 reads;
+  volatile int errors;
+};
+
+static void* RunReader(void* arg) {
+  Shared* shared = reinterpret_cast<Shared*>(arg);
+  while (!shared->stop) {
+    EpochPin pin(&shared->epochs);
+    int* value = shared->value;
+    int first = *value;
+    for (int i = 0; i < 100; i++) {
+      if (*value != first)
+        __sync_fetch_and_add(&shared->errors, 1);
+    }
+    __sync_fetch_and_add(&shared->reads, 1);
+  }
+  return NULL;
+}
+
+TEST(ConcurrentReclamationTest) {
+  Shared shared;
+  shared.value = new int(0);
+  shared.stop = false;
+  shared.reads = 0;
+  shared.errors = 0;
+
+  pthread_t readers[READERS];
+  for (int i = 0; i < READERS; i++)
+    pthread_create(&readers[i], NULL, RunReader, &shared);
+
+  // Memory stays flat however many values are retired.
+  double start = GetTime();
+  int64 replaced = 0;
+  int64 max_retired = 0;
+  while (GetTime() < start + 1) {
+    int* old = shared.value;
+    shared.value = new int(replaced + 1);
+    shared.epochs.Retire(old);
+    replaced++;
+    if (shared.epochs.retired() > max_retired)
+      max_retired = shared.epochs.retired();
+  }
+  shared.stop = true;
+  for (int i = 0; i < READERS; i++)
+    pthread_join(readers[i], NULL);
+  printf("Replaced %ld values (%ld reads), at most %ld retired at once\n",
+         static_cast<long>(replaced), static_cast<long>(shared.reads),
+         static_cast<long>(max_retired));
+  EXPECT_EQ(0, shared.errors);
+  EXPECT_TRUE(replaced > 1000);
+  EXPECT_TRUE(max_retired < replaced / 10);
+  delete shared.value;
+  END;
+}
+
+int main(int argc, char** argv) {
+  EpochManagerTest();
+  ConcurrentReclamationTest();
+}
@@ -0,0 +1,45 @@
+// Author: Kun Ren (kun.ren@yale.edu)
+
+#include "sequencer/fetch_latency_model.h"
+
+#include "common/testing.h"
+
+TEST(FetchLatencyModelTest) {
+  FetchLatencyModel model;
+  EXPECT_EQ(0, model.Percentile(1, 99));
+
+  // 90% of prefetches find their objects in memory, the rest wait about
+  // 5ms for the disk.
+  for (int i = 0; i < 900; i++)
+    model.Record(1, 0);
+  for (int i = 0; i < 100; i++)
+    model.Record(1, 0.005);
+  EXPECT_EQ(0, model.Percentile(1, 50));
+  double tail = model.Percentile(1, 99);
+  EXPECT_TRUE(tail >= 0.005 && tail < 0.01);
+
+  // Devices are modeled separately.
+  EXPECT_EQ(0, model.Percentile(2, 99));
+  model.Record(2, 0.1);
+  EXPECT_TRUE(model.Percentile(2, 50) >= 0.1);
+  EXPECT_TRUE(model.Percentile(1, 99) < 0.01);
+  END;
+}
+
+TEST(DecayTest) {
+  FetchLatencyModel model;
+  for (int i = 0; i < FETCH_LATENCY_WINDOW; i++)
+    model.Record(0, 0.001);
+
+  // The device gets slower; the model follows.
+  for (int i = 0; i < 4 * FETCH_LATENCY_WINDOW; i++)
+    model.Record(0, 0.05);
+  EXPECT_TRUE(model.Percentile(0, 50) >= 0.05);
+  EXPECT_TRUE(model.Percentile(0, 10) >= 0.05);
+  END;
+}
+
+int main(int argc, char** argv) {
+  FetchLatencyModelTest();
+  DecayTest();
+}
@@ -6,31 +6,127 @@
 #include <sstream>
 
 #include "common/testing.h"
+#include "proto/txn.pb.h"
 
 
 TEST(FetchingStorageTest) {
-  system("rm ../db/storage/*");
+  system("rm -f ../db/storage/*");
   FetchingStorage* storage = FetchingStorage::BuildStorage();
   Key key = bytes("1");
   Value value = bytes("value");
   Value* result;
   double wait_time;
-  EXPECT_FALSE(storage->Prefetch(key, &wait_time));
-  EXPECT_TRUE(storage->PutObject(key, &value));
+  EXPECT_TRUE(storage->Prefetch(key, &wait_time));
+  EXPECT_TRUE(storage->PutObject(key, new Value(value)));
   result = storage->ReadObject(key);
   EXPECT_EQ(value, *result);
   EXPECT_TRUE(storage->Unfetch(key));
+  EXPECT_TRUE(storage->HardUnfetch(key));
   sleep(1);
+  EXPECT_EQ(FetchingStorage::ON_DISK, storage->LatchFor(key)->state);
   EXPECT_TRUE(storage->Prefetch(key, &wait_time));
-  sleep(1);
   result = storage->ReadObject(key);
   EXPECT_EQ(value, *result);
   EXPECT_TRUE(storage->Unfetch(key));
+
+  // Objects too long for the log stay in memory.
+  Key oversize_key = bytes("50");
+  Value oversize(LOG_MAX_RECORD_SIZE + 1, 'x');
+  EXPECT_TRUE(storage->Prefetch(oversize_key, &wait_time));
+  EXPECT_TRUE(storage->PutObject(oversize_key, new Value(oversize)));
+  EXPECT_TRUE(storage->Unfetch(oversize_key));
+  EXPECT_TRUE(storage->HardUnfetch(oversize_key));
+  sleep(1);
+  EXPECT_EQ(FetchingStorage::IN_MEMORY,
+            storage->LatchFor(oversize_key)->state);
+  EXPECT_TRUE(storage->Prefetch(oversize_key, &wait_time));
+  EXPECT_EQ(oversize, *storage->ReadObject(oversize_key));
+  EXPECT_TRUE(storage->Unfetch(oversize_key));
   END;
 }
 
-int main(int argc, char** argv) {
-  FetchingStorageTest();
+TEST(PrefetchTxnTest) {
+  FetchingStorage* storage = FetchingStorage::BuildStorage();
+  AtomicQueue<TxnProto*> resident;
+  TxnProto txn;
+  vector<Key> keys;
+  double wait_time;
+
+  // Put some objects on disk.
+  for (int i = 2; i < 10; i++) {
+    Key key = IntToString(i);
+    storage->Prefetch(key, &wait_time);
+    storage->PutObject(key, new Value(IntToString(i * i)));
+    storage->Unfetch(key);
+    storage->HardUnfetch(key);
+    txn.add_read_set(key);
+    keys.push_back(key);
+  }
+  sleep(1);
+
+  for (int i = 2; i < 10; i++) {
+    EXPECT_EQ(FetchingStorage::ON_DISK,
+              storage->LatchFor(IntToString(i))->state);
+  }
+
+  // Unless the reads completed at once, the txn is handed back once all of
+  // them are in memory again.
+  if (!storage->PrefetchTxn(&txn, keys, &resident)) {
+    TxnProto* fetched = NULL;
+    double start = GetTime();
+    while (!resident.Pop(&fetched) && GetTime() < start + 5)
+      usleep(1000);
+    EXPECT_TRUE(fetched == &txn);
+  }
+  for (int i = 2; i < 10; i++) {
+    EXPECT_EQ(FetchingStorage::IN_MEMORY,
+              storage->LatchFor(IntToString(i))->state);
+    EXPECT_EQ(IntToString(i * i), *storage->ReadObject(IntToString(i)));
+  }
+
+  // Objects in memory need no fetching.
+  EXPECT_TRUE(storage->PrefetchTxn(&txn, keys, &resident));
+  END;
 }
 
+TEST(BufferPoolTest) {
+  FetchingStorage* storage = FetchingStorage::BuildStorage();
+  storage->SetMemoryBudget(100000);
+  double wait_time;
+
+  // Five times the budget's worth of objects, with one of them accessed
+  // throughout.
+  Key hot = "100";
+  for (int i = 100; i < 600; i++) {
+    Key key = IntToString(i);
+    storage->Prefetch(key, &wait_time);
+    storage->PutObject(key, new Value(1000, 'a' + i % 26));
+    storage->Unfetch(key);
+    storage->Prefetch(hot, &wait_time);
+    storage->ReadObject(hot);
+    storage->Unfetch(hot);
+  }
+  sleep(1);
+  EXPECT_TRUE(storage->resident_bytes() <= 100000);
+  EXPECT_EQ(FetchingStorage::IN_MEMORY, storage->LatchFor(hot)->state);
+  EXPECT_EQ(FetchingStorage::ON_DISK, storage->LatchFor("101")->state);
+
+  // Evicted objects come back intact.
+  bool correct = true;
+  for (int i = 100; i < 600; i++) {
+    Key key = IntToString(i);
+    storage->Prefetch(key, &wait_time);
+    correct &= (*storage->ReadObject(key) == Value(1000, 'a' + i % 26));
+    storage->Unfetch(key);
+  }
+  EXPECT_TRUE(correct);
+  sleep(1);
+  EXPECT_TRUE(storage->resident_bytes() <= 100000);
+  END;
+}
 
+int main(int argc, char** argv) {
+  FetchingStorageTest();
+  PrefetchTxnTest();
+  BufferPoolTest();
+}
@@ -0,0 +1,144 @@
+// Author: Kun Ren (kun.ren@yale.edu)
+
+#include "backend/hot_cold_storage.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "backend/simple_storage.h"
+#include "common/testing.h"
+#include "common/utils.h"
+
+// Number of cold records, and of hot records among them, in the throughput
+// test.
+#define NUM_RECORDS 1000000
+#define NUM_HOT 100
+
+// A record of the size of a TPC-C district.
+struct TestRecord {
+  char fields[152];
+  double year_to_date;
+};
+
+TEST(HotColdStorageTest) {
+  HotColdStorage storage(2);
+  TestRecord record;
+  memset(&record, 0, sizeof(record));
+
+  // Keys marked hot keep their objects.
+  EXPECT_FALSE(storage.MarkHot("w1"));
+  EXPECT_TRUE(storage.PutObject("w1", NewRecordValue(record)));
+  record.year_to_date = 2;
+  EXPECT_TRUE(storage.PutObject("w1d2", NewRecordValue(record)));
+  EXPECT_TRUE(storage.PutObject("w1d3", new Value("cold")));
+  EXPECT_TRUE(storage.PutObject("w1d4", new Value(HOT_RECORD_SIZE + 1, 'x')));
+  EXPECT_FALSE(storage.MarkHot("w1d4"));
+  EXPECT_TRUE(storage.MarkHot("w1"));
+  EXPECT_TRUE(storage.MarkHot("w1d2"));
+  EXPECT_TRUE(storage.MarkHot("w1d2"));
+  EXPECT_FALSE(storage.MarkHot("w1d3"));
+  EXPECT_EQ(2, RecordOf<TestRecord>(storage.ReadObject("w1d2"))->year_to_date);
+
+  // Hot records are read as their bytes in place, on a cache line of their
+  // own, and updated there.
+  char* bytes_in_place;
+  int size;
+  EXPECT_EQ(0, storage.ReadObjectOrRecord("w1d2", 0, true, &bytes_in_place,
+                                          &size));
+  EXPECT_EQ(static_cast<int>(sizeof(TestRecord)), size);
+  EXPECT_EQ(0, static_cast<int>(reinterpret_cast<uintptr_t>(bytes_in_place) %
+                                64));
+  reinterpret_cast<TestRecord*>(bytes_in_place)->year_to_date += 1;
+  EXPECT_EQ(3, RecordOf<TestRecord>(storage.ReadObject("w1d2"))->year_to_date);
+
+  // Writes of new values go to the same place.
+  record.year_to_date = 10;
+  EXPECT_TRUE(storage.PutObject("w1d2", NewRecordValue(record)));
+  EXPECT_EQ(10, reinterpret_cast<TestRecord*>(bytes_in_place)->year_to_date);
+
+  // Cold objects are read as values.
+  char* none;
+  Value* cold = storage.ReadObjectOrRecord("w1d3", 0, false, &none, &size);
+  EXPECT_TRUE(none == NULL);
+  EXPECT_EQ(bytes("cold"), *cold);
+
+  // Values too large for a slot make the key cold.
+  EXPECT_TRUE(storage.PutObject("w1", new Value(HOT_RECORD_SIZE + 1, 'y')));
+  Value* demoted = storage.ReadObjectOrRecord("w1", 0, false, &none, &size);
+  EXPECT_TRUE(none == NULL);
+  EXPECT_EQ(static_cast<size_t>(HOT_RECORD_SIZE + 1), demoted->size());
+
+  EXPECT_TRUE(storage.DeleteObject("w1d2"));
+  EXPECT_EQ(0, storage.ReadObject("w1d2"));
+  EXPECT_TRUE(storage.DeleteObject("w1d3"));
+  EXPECT_EQ(0, storage.ReadObject("w1d3"));
+
+  END;
+}
+
+// Runs TPC-C-style txns against 'storage': each adds to the year to date of
+// one hot record in place and reads nine cold ones. Returns txns/sec.
+double RunTxns(Storage* storage, const vector<Key>& keys) {
+  double start = GetTime();
+  int64 sum = 0;
+  for (uint32 i = 0; i < keys.size(); i += 10) {
+    char* bytes_in_place;
+    int size;
+    Value* value = storage->ReadObjectOrRecord(keys[i], 0, true,
+                                               &bytes_in_place, &size);
+    TestRecord* record = (bytes_in_place != NULL) ?
+        reinterpret_cast<TestRecord*>(bytes_in_place) :
+        RecordOf<TestRecord>(value);
+    record->year_to_date += 1;
+    for (uint32 j = i + 1; j < i + 10; j++)
+      sum += storage->ReadObject(keys[j])->size();
+  }
+  EXPECT_TRUE(sum > 0);
+  return keys.size() / 10 / (GetTime() - start);
+}
+
+TEST(ThroughputTest) {
+  HotColdStorage hot_cold;
+  SimpleStorage simple;
+  TestRecord record;
+  memset(&record, 0, sizeof(record));
+  Storage* storages[] = {&hot_cold, &simple};
+  for (int s = 0; s < 2; s++) {
+    for (int i = 0; i < NUM_RECORDS; i++) {
+      Key key = IntToString(i);
+      if (i < NUM_HOT)
+        storages[s]->PutObject(key, NewRecordValue(record));
+      else
+        storages[s]->PutObject(key, new Value(key));
+    }
+  }
+  for (int i = 0; i < NUM_HOT; i++)
+    EXPECT_TRUE(hot_cold.MarkHot(IntToString(i)));
+
+  vector<Key> keys;
+  for (int i = 0; i < 200000; i++) {
+    keys.push_back(IntToString(rand() % NUM_HOT));
+    for (int j = 1; j < 10; j++)
+      keys.push_back(IntToString(NUM_HOT + rand() % (NUM_RECORDS - NUM_HOT)));
+  }
+  double hot_cold_rate = RunTxns(&hot_cold, keys);
+  double simple_rate = RunTxns(&simple, keys);
+  for (int i = 0; i < NUM_HOT; i++) {
+    EXPECT_EQ(RecordOf<TestRecord>(simple.ReadObject(IntToString(i)))
+                  ->year_to_date,
+              RecordOf<TestRecord>(hot_cold.ReadObject(IntToString(i)))
+                  ->year_to_date);
+  }
+
+  printf("Txns: %.0f/sec HotColdStorage, %.0f/sec SimpleStorage\n",
+         hot_cold_rate, simple_rate);
+
+  END;
+}
+
+int main(int argc, char** argv) {
+  HotColdStorageTest();
+  ThroughputTest();
+}
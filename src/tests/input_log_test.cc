@@ -0,0 +1,113 @@
+// Author: Kun Ren (kun.ren@yale.edu)
+
+#include "sequencer/input_log.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "common/testing.h"
+#include "common/utils.h"
+#include "proto/message.pb.h"
+
+#define LOG_DIR "../db/log"
+
+MessageProto* Batch(int64 batch_number, int num_txns) {
+  MessageProto* batch = new MessageProto();
+  batch->set_type(MessageProto::TXN_BATCH);
+  batch->set_destination_node(0);
+  batch->set_destination_channel("sequencer");
+  batch->set_batch_number(batch_number);
+  for (int i = 0; i < num_txns; i++)
+    batch->add_data("txn" + IntToString(batch_number) + "." + IntToString(i));
+  return batch;
+}
+
+// Appends batches 'from', 'from' + 2, ... below 'to' to a fresh log and waits
+// until they are durable.
+void AppendBatches(int64 from, int64 to) {
+  InputLog log(0, LOG_DIR, InputLog::LOCAL, false, NULL, -1);
+  int64 last = -1;
+  for (int64 i = from; i < to; i += 2) {
+    log.Append(Batch(i, i % 7));
+    last = i;
+  }
+  while (log.DurableBatch() != last)
+    Spin(0.001);
+}
+
+TEST(RoundTripTest) {
+  system("mkdir -p " LOG_DIR "; rm -f " LOG_DIR "/input-*");
+  AppendBatches(0, 1000);
+
+  InputLogReader reader(LOG_DIR, 0);
+  int64 batch_number;
+  string data;
+  for (int64 i = 0; i < 1000; i += 2) {
+    EXPECT_TRUE(reader.Next(&batch_number, &data));
+    EXPECT_EQ(i, batch_number);
+    MessageProto batch;
+    EXPECT_TRUE(batch.ParseFromString(data));
+    EXPECT_EQ(i, batch.batch_number());
+    EXPECT_EQ(i % 7, batch.data_size());
+  }
+  EXPECT_FALSE(reader.Next(&batch_number, &data));
+
+  END;
+}
+
+TEST(RestartTest) {
+  // A restarted log continues in new segments instead of overwriting the
+  // records needed for recovery.
+  system("mkdir -p " LOG_DIR "; rm -f " LOG_DIR "/input-*");
+  AppendBatches(0, 100);
+  AppendBatches(100, 200);
+
+  InputLogReader reader(LOG_DIR, 0);
+  int64 batch_number;
+  string data;
+  for (int64 i = 0; i < 200; i += 2) {
+    EXPECT_TRUE(reader.Next(&batch_number, &data));
+    EXPECT_EQ(i, batch_number);
+  }
+  EXPECT_FALSE(reader.Next(&batch_number, &data));
+
+  END;
+}
+
+TEST(CorruptRecordTest) {
+  system("mkdir -p " LOG_DIR "; rm -f " LOG_DIR "/input-*");
+  AppendBatches(0, 10);
+
+  // Flip a byte in the payload of the third record.
+  string path = InputLogSegmentPath(LOG_DIR, 0, 0);
+  FILE* file = fopen(path.c_str(), "r+b");
+  InputLogReader probe(LOG_DIR, 0);
+  int64 batch_number;
+  string data;
+  uint32 offset = 0;
+  for (int i = 0; i < 2; i++) {
+    probe.Next(&batch_number, &data);
+    offset += INPUT_LOG_HEADER_SIZE + data.size();
+  }
+  fseek(file, offset + INPUT_LOG_HEADER_SIZE, SEEK_SET);
+  int c = fgetc(file);
+  fseek(file, offset + INPUT_LOG_HEADER_SIZE, SEEK_SET);
+  fputc(c ^ 0xFF, file);
+  fclose(file);
+
+  // Replay stops at the corrupt record.
+  InputLogReader reader(LOG_DIR, 0);
+  EXPECT_TRUE(reader.Next(&batch_number, &data));
+  EXPECT_TRUE(reader.Next(&batch_number, &data));
+  EXPECT_EQ(2, batch_number);
+  EXPECT_FALSE(reader.Next(&batch_number, &data));
+
+  system("rm -f " LOG_DIR "/input-*");
+  END;
+}
+
+int main(int argc, char** argv) {
+  RoundTripTest();
+  RestartTest();
+  CorruptRecordTest();
+}
@@ -0,0 +1,144 @@
+// Author: Kun Ren (kun.ren@yale.edu)
+
+#include "backend/insert_table.h"
+
+#include <pthread.h>
+#include <stdio.h>
+
+#include <climits>
+
+#include "common/testing.h"
+
+// Number of rows appended by the concurrent test's writer.
+#define APPENDED_ROWS 1000000
+
+TEST(InsertTableTest) {
+  EpochManager epochs;
+  InsertTable table(&epochs);
+  EXPECT_TRUE(table.Find(0) == NULL);
+  EXPECT_TRUE(table.Read(5, 100) == NULL);
+  Value rejected("rejected");
+  EXPECT_FALSE(table.Put(-1, &rejected, 1));
+
+  EXPECT_TRUE(table.Put(5, new Value("five"), 10, 3));
+  EXPECT_EQ(bytes("five"), *table.Read(5, 100));
+  EXPECT_EQ(3, table.Find(5)->owner);
+  EXPECT_EQ(10, table.Find(5)->txn_id);
+  EXPECT_TRUE(table.Read(6, 100) == NULL);
+
+  // Deleted rows stay visible to earlier txns.
+  EXPECT_TRUE(table.Delete(5, 20));
+  EXPECT_FALSE(table.Delete(6, 20));
+  EXPECT_TRUE(table.Read(5, 20) == NULL);
+  EXPECT_EQ(bytes("five"), *table.Read(5, 19));
+
+  // Rows far apart grow the directory.
+  int64 far = 1000 * INSERT_SEGMENT_SIZE;
+  EXPECT_TRUE(table.Put(far, new Value("far"), 30));
+  EXPECT_TRUE(table.NumSegments() > 1000);
+  EXPECT_EQ(bytes("far"), *table.Read(far, 100));
+  EXPECT_EQ(bytes("five"), *table.Read(5, 19));
+
+  // Retirement drops whole segments below the given id only.
+  EXPECT_TRUE(table.Put(INSERT_SEGMENT_SIZE, new Value("next"), 40));
+  table.Retire(INSERT_SEGMENT_SIZE + 1);
+  EXPECT_TRUE(table.Find(5) == NULL);
+  EXPECT_EQ(bytes("next"), *table.Read(INSERT_SEGMENT_SIZE, 100));
+  EXPECT_FALSE(table.Put(7, &rejected, 60));
+  table.Retire(far);
+  EXPECT_TRUE(table.Read(INSERT_SEGMENT_SIZE, 100) == NULL);
+  EXPECT_EQ(bytes("far"), *table.Read(far, 100));
+
+  // Retired segments are freed once no reader may hold them.
+  int64 pin = epochs.Pin();
+  EXPECT_TRUE(table.Put(far, new Value("replaced"), 70));
+  epochs.Reclaim();
+  EXPECT_TRUE(epochs.retired() > 0);
+  epochs.Unpin(pin);
+  epochs.Reclaim();
+  EXPECT_EQ(0, epochs.retired());
+
+  END;
+}
+
+TEST(UpdateTest) {
+  EpochManager epochs;
+  InsertTable table(&epochs);
+  EXPECT_TRUE(table.Put(1, new Value("inserted"), 10));
+  EXPECT_TRUE(table.Update(2, 20, LLONG_MAX, LLONG_MIN) == NULL);
+  EXPECT_TRUE(table.Update(1, 5, LLONG_MAX, LLONG_MIN) == NULL);
+
+  // With no earlier readers, updates are made in place.
+  Value* value = table.Update(1, 20, LLONG_MAX, LLONG_MIN);
+  EXPECT_EQ(table.Find(1)->value, value);
+  *value = "v20";
+
+  // Readers of the snapshots from 25 on keep seeing the contents as of them.
+  value = table.Update(1, 30, 25, LLONG_MAX);
+  *value = "v30";
+  EXPECT_EQ(bytes("v20"), *table.Read(1, 25));
+  EXPECT_EQ(bytes("v30"), *table.Read(1, 30));
+  EXPECT_EQ(value, table.Update(1, 30, 25, LLONG_MAX));
+  *table.Update(1, 40, 25, LLONG_MAX) = "v40";
+  EXPECT_EQ(bytes("v20"), *table.Read(1, 29));
+  EXPECT_EQ(bytes("v30"), *table.Read(1, 39));
+  EXPECT_EQ(bytes("v40"), *table.Read(1, 100));
+
+  // A checkpoint's boundary only needs the contents as of it.
+  value = table.Update(1, 50, 45, 45);
+  *value = "v50";
+  EXPECT_EQ(bytes("v40"), *table.Read(1, 45));
+  EXPECT_EQ(value, table.Update(1, 60, 45, 45));
+  EXPECT_EQ(bytes("v40"), *table.Read(1, 45));
+
+  // Once no reader needs them, the earlier contents are dropped.
+  *table.Update(1, 70, LLONG_MAX, LLONG_MIN) = "v70";
+  EXPECT_TRUE(table.Find(1)->updates == NULL);
+  EXPECT_EQ(bytes("v70"), *table.Read(1, 10));
+  EXPECT_TRUE(epochs.retired() > 0);
+  epochs.Reclaim();
+  epochs.Reclaim();
+  EXPECT_EQ(0, epochs.retired());
+
+  END;
+}
+
+void* AppendRows(void* arg) {
+  InsertTable* table = reinterpret_cast<InsertTable*>(arg);
+  for (int i = 0; i < APPENDED_ROWS; i++)
+    table->Put(i, new Value(IntToString(i)), i);
+  return NULL;
+}
+
+TEST(ConcurrentAppendTest) {
+  // A reader follows a writer that appends rows (allocating segments and
+  // growing the directory as it goes), and must only ever see complete rows.
+  EpochManager epochs;
+  InsertTable table(&epochs);
+  pthread_t writer;
+  pthread_create(&writer, NULL, &AppendRows, &table);
+
+  double start = GetTime();
+  int seen = 0;
+  bool consistent = true;
+  while (seen < APPENDED_ROWS) {
+    EpochPin pin(&epochs);
+    Value* value = table.Read(seen, APPENDED_ROWS);
+    if (value == NULL)
+      continue;
+    consistent &= (*value == IntToString(seen));
+    seen++;
+  }
+  pthread_join(writer, NULL);
+  EXPECT_TRUE(consistent);
+  printf("Appended and read %d rows in %f seconds\n", APPENDED_ROWS,
+         GetTime() - start);
+
+  END;
+}
+
+int main(int argc, char** argv) {
+  InsertTableTest();
+  UpdateTest();
+  ConcurrentAppendTest();
+}
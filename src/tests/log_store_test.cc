@@ -0,0 +1,132 @@
+// Author: Kun Ren (kun.ren@yale.edu)
+
+#include "backend/log_store.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "common/testing.h"
+
+#define TEST_FILE "log_store_test.data"
+
+// Keeps the record a read completed with and wakes the test.
+class RecordCompletion : public LogStore::ReadCompletion {
+ public:
+  RecordCompletion() : done_(false), length_(0) {
+    pthread_mutex_init(&mutex_, NULL);
+    pthread_cond_init(&cond_, NULL);
+  }
+  virtual void Complete(const char* data, int length) {
+    pthread_mutex_lock(&mutex_);
+    if (data != NULL)
+      record_.assign(data, length);
+    length_ = length;
+    done_ = true;
+    pthread_cond_signal(&cond_);
+    pthread_mutex_unlock(&mutex_);
+  }
+  // Waits for the read and returns the record ("FAILED" if it failed).
+  string Wait() {
+    pthread_mutex_lock(&mutex_);
+    while (!done_)
+      pthread_cond_wait(&cond_, &mutex_);
+    pthread_mutex_unlock(&mutex_);
+    return length_ < 0 ? "FAILED" : record_;
+  }
+
+ private:
+  bool done_;
+  int length_;
+  string record_;
+  pthread_mutex_t mutex_;
+  pthread_cond_t cond_;
+};
+
+static string ReadRecord(LogStore* store, int64 id) {
+  RecordCompletion completion;
+  if (!store->Read(id, &completion))
+    return "MISSING";
+  store->Submit();
+  return completion.Wait();
+}
+
+static string RecordFor(int id, int version) {
+  char prefix[32];
+  snprintf(prefix, sizeof(prefix), "%d.%d.", id, version);
+  return string(prefix) + string(1000, 'a' + (id + version) % 26);
+}
+
+TEST(LogStoreTest) {
+  LogStore store;
+  EXPECT_TRUE(store.Open(TEST_FILE, 16, 16));
+  EXPECT_EQ("MISSING", ReadRecord(&store, 1));
+
+  // Still in the tail block.
+  store.Append(1, "one", 3);
+  store.Append(2, "", 0);
+  EXPECT_EQ("one", ReadRecord(&store, 1));
+  EXPECT_EQ("", ReadRecord(&store, 2));
+
+  // Enough records to push the first ones to disk.
+  for (int i = 3; i < 100; i++) {
+    string record = RecordFor(i, 0);
+    store.Append(i, record.data(), record.size());
+  }
+  store.Append(1, "uno", 3);
+  store.Submit();
+  usleep(100000);
+  EXPECT_EQ("uno", ReadRecord(&store, 1));
+  EXPECT_EQ("", ReadRecord(&store, 2));
+  bool correct = true;
+  for (int i = 3; i < 100; i++)
+    correct &= (RecordFor(i, 0) == ReadRecord(&store, i));
+  EXPECT_TRUE(correct);
+
+  // Overlong records are rejected, leaving the earlier record in place.
+  string overlong(LOG_BLOCK_SIZE, 'x');
+  EXPECT_FALSE(store.Append(100, overlong.data(), overlong.size()));
+  EXPECT_EQ("MISSING", ReadRecord(&store, 100));
+  EXPECT_FALSE(store.Append(1, overlong.data(), overlong.size()));
+  EXPECT_EQ("uno", ReadRecord(&store, 1));
+  string longest(LOG_MAX_RECORD_SIZE, 'x');
+  EXPECT_TRUE(store.Append(100, longest.data(), longest.size()));
+  EXPECT_EQ(longest, ReadRecord(&store, 100));
+  END;
+}
+
+TEST(CompactionTest) {
+  LogStore store;
+  EXPECT_TRUE(store.Open(TEST_FILE, 64, 64));
+
+  // Rewrite every record many times over, leaving most of the log dead.
+  const int records = 5000;
+  const int versions = 20;
+  for (int version = 0; version < versions; version++) {
+    for (int i = 0; i < records; i++) {
+      string record = RecordFor(i, version);
+      store.Append(i, record.data(), record.size());
+    }
+    store.Submit();
+  }
+  sleep(1);
+
+  // Each segment holds about 4000 of these records.
+  int64 live = 0;
+  for (int i = 0; i < records; i++)
+    live += LOG_RECORD_HEADER_SIZE + RecordFor(i, versions - 1).size();
+  EXPECT_EQ(live, store.live_bytes());
+  EXPECT_TRUE(store.segments_in_use() <= 2 * records / 4000 + 2);
+
+  bool correct = true;
+  for (int i = 0; i < records; i++)
+    correct &= (RecordFor(i, versions - 1) == ReadRecord(&store, i));
+  EXPECT_TRUE(correct);
+  END;
+}
+
+int main(int argc, char** argv) {
+  LogStoreTest();
+  CompactionTest();
+  remove(TEST_FILE);
+}
@@ -0,0 +1,207 @@
+// Author: Kun Ren (kun.ren@yale.edu)
+
+#include "backend/ordered_index.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <map>
+
+#include "common/testing.h"
+
+using std::map;
+
+// Number of keys each inserting thread adds in the concurrent test.
+#define KEYS_PER_THREAD 100000
+#define INSERTERS 4
+
+// Zero-padded keys, so that they sort like the numbers they hold.
+Key OrderedKey(int i) {
+  char key[16];
+  snprintf(key, sizeof(key), "k%09d", i);
+  return key;
+}
+
+TEST(OrderedIndexTest) {
+  OrderedIndex index;
+  Value one = bytes("one");
+  Value two = bytes("two");
+
+  EXPECT_TRUE(index.Lookup("key") == NULL);
+  index.Insert("key", &one);
+  EXPECT_EQ(&one, index.Lookup("key"));
+  index.Insert("key", &two);
+  EXPECT_EQ(&two, index.Lookup("key"));
+  EXPECT_EQ(static_cast<uint64>(1), index.size());
+  EXPECT_TRUE(index.Erase("key"));
+  EXPECT_FALSE(index.Erase("key"));
+  EXPECT_TRUE(index.Lookup("key") == NULL);
+
+  // Keys sharing long prefixes, in random order, compared to std::map.
+  map<Key, Value*> expected;
+  for (int i = 0; i < 100000; i++) {
+    Key key = OrderedKey(rand() % 200000);
+    index.Insert(key, &one);
+    expected[key] = &one;
+  }
+  for (int i = 0; i < 200000; i += 3) {
+    bool present = expected.erase(OrderedKey(i)) == 1;
+    EXPECT_EQ(present, index.Erase(OrderedKey(i)));
+  }
+  EXPECT_EQ(static_cast<uint64>(expected.size()), index.size());
+  for (int i = 0; i < 200000; i++) {
+    Value* value = expected.count(OrderedKey(i)) ? &one : NULL;
+    EXPECT_EQ(value, index.Lookup(OrderedKey(i)));
+  }
+
+  // Scans return the keys in a range in order.
+  vector<pair<Key, Value*> > results;
+  int found = index.Scan(OrderedKey(1000), OrderedKey(2000), -1, &results);
+  map<Key, Value*>::iterator it = expected.lower_bound(OrderedKey(1000));
+  bool same = true;
+  for (int i = 0; i < found; i++, ++it)
+    same &= results[i].first == it->first && results[i].second == it->second;
+  same &= it == expected.lower_bound(OrderedKey(2000));
+  EXPECT_TRUE(same);
+  EXPECT_EQ(found, static_cast<int>(results.size()));
+
+  // A limit stops the scan early; an empty end scans to the last key.
+  results.clear();
+  EXPECT_EQ(10, index.Scan(OrderedKey(0), "", 10, &results));
+  EXPECT_EQ(expected.begin()->first, results[0].first);
+  results.clear();
+  EXPECT_EQ(static_cast<int>(expected.size()), index.Scan("", "", -1, &results));
+  EXPECT_EQ(expected.rbegin()->first, results.back().first);
+  results.clear();
+  EXPECT_EQ(0, index.Scan(OrderedKey(5), OrderedKey(5), -1, &results));
+
+  END;
+}
+
+// Shared state of the concurrent test.
+struct IndexTestState {
+  OrderedIndex* index;
+  Value values[INSERTERS];
+  volatile bool inserting;
+  volatile int64 scans;
+  volatile bool wrong_value;
+};
+
+void* InsertKeys(void* arg) {
+  pair<int, IndexTestState*>* thread =
+      reinterpret_cast<pair<int, IndexTestState*>*>(arg);
+  IndexTestState* state = thread->second;
+  for (int i = 0; i < KEYS_PER_THREAD; i++) {
+    state->index->Insert(OrderedKey(i * INSERTERS + thread->first),
+                         &state->values[thread->first]);
+  }
+  return NULL;
+}
+
+void* ScanKeys(void* arg) {
+  IndexTestState* state = reinterpret_cast<IndexTestState*>(arg);
+  int64 scans = 0;
+  vector<pair<Key, Value*> > results;
+  while (state->inserting) {
+    // Scans return increasing keys, each mapped to its inserter's value.
+    int start = rand() % (KEYS_PER_THREAD * INSERTERS);
+    results.clear();
+    state->index->Scan(OrderedKey(start), "", 100, &results);
+    for (uint32 i = 0; i < results.size(); i++) {
+      int key = atoi(results[i].first.c_str() + 1);
+      if (key < start || results[i].second != &state->values[key % INSERTERS] ||
+          (i > 0 && results[i].first <= results[i - 1].first))
+        state->wrong_value = true;
+    }
+    Value* value = state->index->Lookup(OrderedKey(start));
+    if (value != NULL && value != &state->values[start % INSERTERS])
+      state->wrong_value = true;
+    scans++;
+  }
+  __sync_fetch_and_add(&state->scans, scans);
+  return NULL;
+}
+
+TEST(ConcurrentInsertTest) {
+  IndexTestState state;
+  state.index = new OrderedIndex();
+  state.inserting = true;
+  state.scans = 0;
+  state.wrong_value = false;
+
+  pthread_t readers[2];
+  for (int i = 0; i < 2; i++)
+    pthread_create(&readers[i], NULL, ScanKeys, &state);
+
+  double start = GetTime();
+  pthread_t inserters[INSERTERS];
+  pair<int, IndexTestState*> args[INSERTERS];
+  for (int i = 0; i < INSERTERS; i++) {
+    args[i] = pair<int, IndexTestState*>(i, &state);
+    pthread_create(&inserters[i], NULL, InsertKeys, &args[i]);
+  }
+  for (int i = 0; i < INSERTERS; i++)
+    pthread_join(inserters[i], NULL);
+  double elapsed = GetTime() - start;
+  state.inserting = false;
+  for (int i = 0; i < 2; i++)
+    pthread_join(readers[i], NULL);
+
+  EXPECT_FALSE(state.wrong_value);
+  EXPECT_EQ(static_cast<uint64>(KEYS_PER_THREAD * INSERTERS),
+            state.index->size());
+  vector<pair<Key, Value*> > results;
+  EXPECT_EQ(KEYS_PER_THREAD * INSERTERS,
+            state.index->Scan("", "", -1, &results));
+  bool in_order = true;
+  for (int i = 0; i < KEYS_PER_THREAD * INSERTERS; i++)
+    in_order &= results[i].first == OrderedKey(i) &&
+                results[i].second == &state.values[i % INSERTERS];
+  EXPECT_TRUE(in_order);
+  printf("%d threads inserted %.0f keys/sec alongside %ld scans\n",
+         INSERTERS, KEYS_PER_THREAD * INSERTERS / elapsed,
+         static_cast<long>(state.scans));
+  delete state.index;
+
+  END;
+}
+
+TEST(ScanThroughputTest) {
+  // Scanning 100 consecutive keys, compared to looking each of them up.
+  OrderedIndex index;
+  Value value = bytes("value");
+  for (int i = 0; i < 1000000; i++)
+    index.Insert(OrderedKey(i), &value);
+
+  double start = GetTime();
+  int64 scanned = 0;
+  vector<pair<Key, Value*> > results;
+  for (int i = 0; i < 10000; i++) {
+    results.clear();
+    scanned += index.Scan(OrderedKey(rand() % 999900), "", 100, &results);
+  }
+  double scan_rate = scanned / (GetTime() - start);
+
+  start = GetTime();
+  int64 looked_up = 0;
+  for (int i = 0; i < 10000; i++) {
+    int first = rand() % 999900;
+    for (int j = first; j < first + 100; j++)
+      looked_up += index.Lookup(OrderedKey(j)) != NULL;
+  }
+  double lookup_rate = looked_up / (GetTime() - start);
+
+  EXPECT_EQ(1000000, scanned);
+  EXPECT_EQ(1000000, looked_up);
+  printf("Keys: %.0f/sec scanned, %.0f/sec looked up\n", scan_rate,
+         lookup_rate);
+
+  END;
+}
+
+int main(int argc, char** argv) {
+  OrderedIndexTest();
+  ConcurrentInsertTest();
+  ScanThroughputTest();
+}
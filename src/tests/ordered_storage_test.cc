@@ -0,0 +1,50 @@
+// Author: Kun Ren (kun.ren@yale.edu)
+
+#include "backend/ordered_storage.h"
+
+#include "common/testing.h"
+
+TEST(OrderedStorageTest) {
+  OrderedStorage storage;
+  Key key = bytes("key");
+  Value value = bytes("value");
+  Value* result;
+  EXPECT_EQ(0, storage.ReadObject(key));
+  EXPECT_TRUE(storage.PutObject(key, &value));
+  result = storage.ReadObject(key);
+  EXPECT_EQ(value, *result);
+
+  EXPECT_TRUE(storage.DeleteObject(key));
+  EXPECT_EQ(0, storage.ReadObject(key));
+
+  END;
+}
+
+TEST(ScanTest) {
+  OrderedStorage storage;
+  Value a = bytes("a");
+  Value b = bytes("b");
+  storage.PutObject("w1d1o1", &a);
+  storage.PutObject("w1d1o2", &b);
+  storage.PutObject("w1d2o1", &a);
+  storage.PutObject("w1d1", &a);
+
+  vector<pair<Key, Value*> > results;
+  EXPECT_TRUE(storage.Scan("w1d1o", "w1d1p", -1, &results));
+  EXPECT_EQ(2, static_cast<int>(results.size()));
+  EXPECT_EQ("w1d1o1", results[0].first);
+  EXPECT_EQ(&b, results[1].second);
+
+  results.clear();
+  EXPECT_TRUE(storage.Scan("w1d1", "", 3, &results));
+  EXPECT_EQ(3, static_cast<int>(results.size()));
+  EXPECT_EQ("w1d1", results[0].first);
+  EXPECT_EQ("w1d1o2", results[2].first);
+
+  END;
+}
+
+int main(int argc, char** argv) {
+  OrderedStorageTest();
+  ScanTest();
+}
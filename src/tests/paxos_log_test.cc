@@ -0,0 +1,103 @@
+// Author: Kun Ren (kun.ren@yale.edu)
+//
+// Runs three replicas of the PaxosLog as separate local processes and checks
+// that they all read the same batch sequence, also when one of them misses
+// part of the log.
+
+#include "paxos/paxos_log.h"
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <string>
+
+#include "common/configuration.h"
+#include "common/connection.h"
+#include "common/testing.h"
+
+#define REPLICAS 3
+#define BATCHES_PER_REPLICA 1000
+
+// Submits this replica's batches, reads the whole log back and writes a
+// checksum of the sequence read to 'fd'. If 'dropped_for' is positive, the
+// replica first drops every message sent to it for that many seconds, while
+// the others go ahead without it.
+void RunReplica(int node_id, int fd, double dropped_for) {
+  Configuration config(node_id, "common/configuration_test_replicas.conf");
+  ConnectionMultiplexer multiplexer(&config);
+  Spin(1);
+  if (dropped_for > 0) {
+    Connection* connection = multiplexer.NewConnection("paxos");
+    MessageProto message;
+    double end = GetTime() + dropped_for;
+    while (GetTime() < end)
+      connection->GetMessageBlocking(&message, end - GetTime());
+    delete connection;
+  }
+  PaxosLog log(&config, multiplexer.NewConnection("paxos"));
+  Spin(1);
+
+  double start = GetTime();
+  for (int i = 0; i < BATCHES_PER_REPLICA; i++)
+    log.SubmitBatch(IntToString(node_id) + ":" + IntToString(i));
+
+  uint64 checksum = 0;
+  string batch;
+  for (int i = 0; i < REPLICAS * BATCHES_PER_REPLICA; i++) {
+    log.GetNextBatchBlocking(&batch);
+    for (uint32 j = 0; j < batch.size(); j++)
+      checksum = checksum * 31 + batch[j];
+  }
+  if (node_id == 0) {
+    cout << (REPLICAS * BATCHES_PER_REPLICA) / (GetTime() - start)
+         << " batches/sec\n";
+  }
+  if (write(fd, &checksum, sizeof(checksum)) != sizeof(checksum))
+    exit(1);
+  Spin(1);
+}
+
+// Runs all replicas, replica 'dropped' (if not -1) dropping messages for a
+// while, and checks that they read the same sequence.
+void RunReplicas(int dropped) {
+  int fds[2];
+  EXPECT_EQ(0, pipe(fds));
+
+  pid_t pids[REPLICAS];
+  for (int i = 0; i < REPLICAS; i++) {
+    pids[i] = fork();
+    if (pids[i] == 0) {
+      RunReplica(i, fds[1], i == dropped ? 3 : 0);
+      exit(0);
+    }
+  }
+
+  uint64 checksums[REPLICAS];
+  for (int i = 0; i < REPLICAS; i++)
+    EXPECT_EQ(sizeof(checksums[i]),
+              read(fds[0], &checksums[i], sizeof(checksums[i])));
+  for (int i = 1; i < REPLICAS; i++)
+    EXPECT_EQ(checksums[0], checksums[i]);
+
+  for (int i = 0; i < REPLICAS; i++)
+    waitpid(pids[i], NULL, 0);
+  close(fds[0]);
+  close(fds[1]);
+}
+
+TEST(ReplicasAgreeTest) {
+  RunReplicas(-1);
+  END;
+}
+
+TEST(DroppedReplicaTest) {
+  // The last replica misses the other replicas' batches and must be brought
+  // up to date by the leader before it can read them.
+  RunReplicas(REPLICAS - 1);
+  END;
+}
+
+int main(int argc, char** argv) {
+  ReplicasAgreeTest();
+  DroppedReplicaTest();
+}
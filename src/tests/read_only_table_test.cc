@@ -0,0 +1,95 @@
+// Author: Kun Ren (kun.ren@yale.edu)
+
+#include "backend/read_only_table.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <tr1/unordered_map>
+
+#include "common/testing.h"
+#include "common/utils.h"
+
+using std::tr1::unordered_map;
+
+struct TestRecord {
+  char name[16];
+  double price;
+};
+
+TEST(ReadOnlyTableTest) {
+  ReadOnlyTable<TestRecord> table;
+  TestRecord record;
+  memset(&record, 0, sizeof(record));
+  strncpy(record.name, "first", sizeof(record.name));
+  record.price = 1.5;
+
+  EXPECT_FALSE(table.Put(-1, record));
+  EXPECT_TRUE(table.Put(3, record));
+  record.price = 2.5;
+  EXPECT_TRUE(table.Put(0, record));
+  table.Freeze();
+
+  EXPECT_TRUE(table.frozen());
+  EXPECT_EQ(4, table.size());
+  EXPECT_EQ(1.5, table.Get(3)->price);
+  EXPECT_EQ(string("first"), string(table.Get(3)->name));
+  EXPECT_EQ(2.5, table.Get(0)->price);
+  EXPECT_TRUE(table.Get(1) == NULL);
+  EXPECT_TRUE(table.Get(4) == NULL);
+  EXPECT_TRUE(table.Get(-1) == NULL);
+
+  // Frozen tables no longer change.
+  EXPECT_FALSE(table.Put(1, record));
+  EXPECT_TRUE(table.Get(1) == NULL);
+
+  END;
+}
+
+TEST(LookupThroughputTest) {
+  // Reading an item compared to the map of serialized records TPC-C used to
+  // keep items in.
+  ReadOnlyTable<TestRecord> table;
+  unordered_map<Key, Value*> map;
+  TestRecord record;
+  memset(&record, 0, sizeof(record));
+  for (int i = 0; i < 100000; i++) {
+    record.price = i;
+    table.Put(i, record);
+    map["i" + IntToString(i)] = new Value(
+        reinterpret_cast<char*>(&record), sizeof(record));
+  }
+  table.Freeze();
+
+  vector<int> ids;
+  for (int i = 0; i < 1000000; i++)
+    ids.push_back(rand() % 100000);
+
+  double start = GetTime();
+  double total = 0;
+  for (uint32 i = 0; i < ids.size(); i++)
+    total += table.Get(ids[i])->price;
+  double table_rate = ids.size() / (GetTime() - start);
+
+  start = GetTime();
+  char key[16];
+  for (uint32 i = 0; i < ids.size(); i++) {
+    snprintf(key, sizeof(key), "i%d", ids[i]);
+    total -= reinterpret_cast<const TestRecord*>(map[key]->data())->price;
+  }
+  double map_rate = ids.size() / (GetTime() - start);
+
+  EXPECT_EQ(0, total);
+  printf("Lookups: %.0f/sec read-only table, %.0f/sec unordered_map\n",
+         table_rate, map_rate);
+  for (unordered_map<Key, Value*>::iterator it = map.begin(); it != map.end();
+       ++it)
+    delete it->second;
+
+  END;
+}
+
+int main(int argc, char** argv) {
+  ReadOnlyTableTest();
+  LookupThroughputTest();
+}
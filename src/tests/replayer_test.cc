@@ -0,0 +1,121 @@
+// Author: Kun Ren (kun.ren@yale.edu)
+
+#include "sequencer/replayer.h"
+
+#include <stdlib.h>
+
+#include "common/configuration.h"
+#include "common/testing.h"
+#include "proto/message.pb.h"
+#include "proto/txn.pb.h"
+#include "sequencer/input_log.h"
+#include "sequencer/sequencer.h"
+
+// Logs the batches of epochs ['from', 'to') for 'origin' of a 3-node system,
+// as one run of its sequencer. Batch b holds two txns: one read by node 0 and
+// one read by node 1.
+void LogBatches(Configuration* config, int origin, int from, int to) {
+  InputLog log(origin, config->input_log_dir, InputLog::LOCAL, false, NULL,
+               -1);
+  int64 last = -1;
+  for (int epoch = from; epoch < to; epoch++) {
+    int64 batch_number = epoch * 3 + origin;
+    MessageProto* batch = new MessageProto();
+    batch->set_type(MessageProto::TXN_BATCH);
+    batch->set_destination_node(origin);
+    batch->set_destination_channel("sequencer");
+    batch->set_batch_number(batch_number);
+    for (int i = 0; i < 2; i++) {
+      TxnProto txn;
+      txn.set_txn_id(batch_number * MAX_BATCH_SIZE + i);
+      txn.add_readers(i);
+      txn.add_writers(i);
+      txn.SerializeToString(batch->add_data());
+    }
+    log.Append(batch);
+    last = batch_number;
+  }
+  while (log.DurableBatch() != last)
+    Spin(0.001);
+}
+
+TEST(ReplayInGlobalOrderTest) {
+  Configuration config(0, "common/configuration_test_replicas.conf");
+  system(("mkdir -p " + config.input_log_dir + "; rm -f " +
+          config.input_log_dir + "/input-*").c_str());
+
+  // Origin 2 crashed before logging epoch 9, so only epochs 0-8 are replayed.
+  LogBatches(&config, 0, 0, 10);
+  LogBatches(&config, 1, 0, 10);
+  LogBatches(&config, 2, 0, 9);
+
+  // Txns of batches 0 and 1 are in the checkpoint.
+  Replayer replayer(&config, 1 * MAX_BATCH_SIZE + 1);
+  AtomicQueue<TxnProto*>* queue = replayer.GetTxnsQueue();
+
+  int64 last_txn_id = -1;
+  int replayed = 0;
+  while (true) {
+    TxnProto* txn;
+    if (!queue->Pop(&txn))
+      continue;
+    if (txn == NULL)
+      break;
+    EXPECT_EQ(0, txn->readers(0));
+    EXPECT_TRUE(txn->txn_id() > last_txn_id);
+    EXPECT_EQ(0, txn->txn_id() % MAX_BATCH_SIZE);
+    last_txn_id = txn->txn_id();
+    replayed++;
+    delete txn;
+  }
+  EXPECT_EQ(9 * 3 - 2, replayed);
+  EXPECT_EQ(replayed, replayer.WaitUntilDone());
+  EXPECT_EQ((8 * 3 + 2) * MAX_BATCH_SIZE, last_txn_id);
+
+  // Sequencing resumes at the first epoch not replayed.
+  EXPECT_EQ(9, config.first_epoch);
+
+  system(("rm -f " + config.input_log_dir + "/input-*").c_str());
+  END;
+}
+
+TEST(ReplayAfterRestartTest) {
+  Configuration config(0, "common/configuration_test_replicas.conf");
+  system(("mkdir -p " + config.input_log_dir + "; rm -f " +
+          config.input_log_dir + "/input-*").c_str());
+
+  // The first run crashed with origin 2 behind, so recovery resumed at epoch
+  // 9 and the second run logged epochs 9 and 10 again.
+  LogBatches(&config, 0, 0, 10);
+  LogBatches(&config, 1, 0, 10);
+  LogBatches(&config, 2, 0, 9);
+  for (int origin = 0; origin < 3; origin++)
+    LogBatches(&config, origin, 9, 11);
+
+  // Epoch 9 is replayed once, from the second run.
+  Replayer replayer(&config, -1);
+  AtomicQueue<TxnProto*>* queue = replayer.GetTxnsQueue();
+  int64 last_txn_id = -1;
+  int replayed = 0;
+  while (true) {
+    TxnProto* txn;
+    if (!queue->Pop(&txn))
+      continue;
+    if (txn == NULL)
+      break;
+    EXPECT_TRUE(txn->txn_id() > last_txn_id);
+    last_txn_id = txn->txn_id();
+    replayed++;
+    delete txn;
+  }
+  EXPECT_EQ(11 * 3, replayed);
+  EXPECT_EQ(11, config.first_epoch);
+
+  system(("rm -f " + config.input_log_dir + "/input-*").c_str());
+  END;
+}
+
+int main(int argc, char** argv) {
+  ReplayInGlobalOrderTest();
+  ReplayAfterRestartTest();
+}
@@ -5,12 +5,44 @@
 #include <string>
 
 #include "common/testing.h"
+#include "proto/txn.pb.h"
 
 TEST(SequencerTest) {
   END;
 }
 
+// A batch renumbered into a later epoch takes ids and snapshots from the
+// batch that carries it, not from the one it was written for.
+TEST(PlaceTxnTest) {
+  const int nodes = 2;
+  TxnProto txn;
+  txn.set_isolation_level(TxnProto::SNAPSHOT);
+
+  // Written as node 1's batch of epoch 3.
+  Sequencer::PlaceTxn(&txn, 3 * nodes + 1, 4, nodes);
+  EXPECT_EQ((3 * nodes + 1) * MAX_BATCH_SIZE + 4, txn.txn_id());
+  EXPECT_EQ(3 * nodes * MAX_BATCH_SIZE - 1, txn.snapshot());
+
+  // Renumbered into node 1's batch of epoch 5.
+  Sequencer::PlaceTxn(&txn, 5 * nodes + 1, 4, nodes);
+  EXPECT_EQ((5 * nodes + 1) * MAX_BATCH_SIZE + 4, txn.txn_id());
+  EXPECT_EQ(5 * nodes * MAX_BATCH_SIZE - 1, txn.snapshot());
+
+  // The first epoch reads the initial state.
+  Sequencer::PlaceTxn(&txn, 1, 0, nodes);
+  EXPECT_EQ(MAX_BATCH_SIZE, txn.txn_id());
+  EXPECT_EQ(0, txn.snapshot());
+
+  // Txns that take locks keep no snapshot.
+  TxnProto locking_txn;
+  Sequencer::PlaceTxn(&locking_txn, 5 * nodes + 1, 0, nodes);
+  EXPECT_EQ((5 * nodes + 1) * MAX_BATCH_SIZE, locking_txn.txn_id());
+  EXPECT_FALSE(locking_txn.has_snapshot());
+
+  END;
+}
+
 int main(int argc, char** argv) {
   SequencerTest();
+  PlaceTxnTest();
 }
-
@@ -10,7 +10,7 @@ TEST(SimpleStorageTest) {
   Value value = bytes("value");
   Value* result;
   EXPECT_EQ(0, storage.ReadObject(key));
-  EXPECT_TRUE(storage.PutObject(key, &value));
+  EXPECT_TRUE(storage.PutObject(key, new Value(value)));
   result = storage.ReadObject(key);
   EXPECT_EQ(value, *result);
 
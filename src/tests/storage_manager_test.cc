@@ -18,10 +18,8 @@ TEST(SingleNode) {
   Connection* connection = multiplexer->NewConnection("storage_manager");
   SimpleStorage storage;
 
-  string a = "a";
-  string c = "c";
-  storage.PutObject("0", &a);
-  storage.PutObject("2", &c);
+  storage.PutObject("0", new Value("a"));
+  storage.PutObject("2", new Value("c"));
   TxnProto txn;
   txn.set_txn_id(1);
   txn.add_read_set("0");
@@ -92,14 +90,10 @@ TEST(TwoNodes) {
   c1 = multiplexer1->NewConnection("1");
   c2 = multiplexer2->NewConnection("1");
 
-  string a = "a";
-  string b = "b";
-  string c = "c";
-  string d = "d";
-  storage1.PutObject("0", &a);
-  storage2.PutObject("1", &b);
-  storage1.PutObject("2", &c);
-  storage2.PutObject("3", &d);
+  storage1.PutObject("0", new Value("a"));
+  storage2.PutObject("1", new Value("b"));
+  storage1.PutObject("2", new Value("c"));
+  storage2.PutObject("3", new Value("d"));
   txn.set_txn_id(1);
   txn.add_read_set("0");
   txn.add_read_set("1");
@@ -0,0 +1,61 @@
+// Author: Kun Ren (kun@cs.yale.edu)
+
+#include "scheduler/stream_merger.h"
+
+#include "common/testing.h"
+#include "proto/message.pb.h"
+#include "proto/txn.pb.h"
+
+// Builds a TXN_STREAM message from 'origin' (of 2) containing txns with the
+// given timestamps.
+MessageProto Stream(int origin, int64 watermark, int64 ts1 = -1,
+                    int64 ts2 = -1) {
+  MessageProto message;
+  message.set_type(MessageProto::TXN_STREAM);
+  message.set_destination_node(0);
+  message.set_destination_channel("scheduler_");
+  message.set_source_node(origin);
+  message.set_watermark(watermark);
+  int64 timestamps[] = {ts1, ts2};
+  for (int i = 0; i < 2; i++) {
+    if (timestamps[i] < 0)
+      continue;
+    TxnProto txn;
+    txn.set_txn_id(timestamps[i] * 2 + origin);
+    txn.SerializeToString(message.add_data());
+  }
+  return message;
+}
+
+TEST(WatermarkOrderTest) {
+  StreamMerger merger(2, NULL);
+
+  merger.AddMessage(Stream(0, 20, 10, 20));
+  // Origin 1 has not promised anything yet.
+  EXPECT_TRUE(merger.NextTxn() == NULL);
+
+  merger.AddMessage(Stream(1, 15, 10));
+  TxnProto* txn = merger.NextTxn();
+  EXPECT_TRUE(txn != NULL);
+  EXPECT_EQ(20, txn->txn_id());  // (10, origin 0)
+  delete txn;
+  txn = merger.NextTxn();
+  EXPECT_TRUE(txn != NULL);
+  EXPECT_EQ(21, txn->txn_id());  // (10, origin 1)
+  delete txn;
+
+  // Timestamp 20 is still above origin 1's watermark.
+  EXPECT_TRUE(merger.NextTxn() == NULL);
+  merger.AddMessage(Stream(1, 25));
+  txn = merger.NextTxn();
+  EXPECT_TRUE(txn != NULL);
+  EXPECT_EQ(40, txn->txn_id());
+  delete txn;
+  EXPECT_TRUE(merger.NextTxn() == NULL);
+
+  END;
+}
+
+int main(int argc, char** argv) {
+  WatermarkOrderTest();
+}
@@ -0,0 +1,119 @@
+// Author: Kun Ren (kun.ren@yale.edu)
+
+#include "applications/tpcc_index.h"
+
+#include <pthread.h>
+
+#include "applications/tpcc.h"
+#include "common/testing.h"
+
+// Number of orders recorded by the concurrent test's writer.
+#define RECORDED_ORDERS 200000
+
+TEST(TPCCIndexTest) {
+  TPCCIndex index;
+  int customer, order, line_count;
+  int items[MAX_ORDER_LINES];
+
+  // Nothing is known about a district before its first order.
+  EXPECT_EQ(0, index.NextOrderId(1, 2));
+  EXPECT_EQ(1, index.NextOrderId(1, 2));
+  EXPECT_EQ(0, index.NextOrderId(1, 3));
+  EXPECT_EQ(0, index.NextHistoryId(1));
+  EXPECT_EQ(1, index.NextHistoryId(1));
+  EXPECT_EQ(0, index.NextHistoryId(2));
+  EXPECT_FALSE(index.LatestOrder(1, 2, &order));
+  EXPECT_FALSE(index.ClaimUndelivered(1, 2, &order));
+  EXPECT_FALSE(index.RandomOrderingCustomer(1, 2, &customer, &order));
+
+  int first_items[] = {5, 6, 7};
+  int second_items[] = {8, 9};
+  index.RecordOrder(1, 2, 0, 42, 3, first_items);
+  index.RecordOrder(1, 2, 1, 42, 2, second_items);
+  EXPECT_TRUE(index.LatestOrder(1, 2, &order));
+  EXPECT_EQ(1, order);
+  EXPECT_TRUE(index.RandomOrderingCustomer(1, 2, &customer, &order));
+  EXPECT_EQ(42, customer);
+  EXPECT_EQ(1, order);
+  EXPECT_TRUE(index.LookupOrder(1, 2, 0, &customer, &line_count));
+  EXPECT_EQ(42, customer);
+  EXPECT_EQ(3, line_count);
+  EXPECT_TRUE(index.LookupOrderItems(1, 2, 1, items, &line_count));
+  EXPECT_EQ(2, line_count);
+  EXPECT_EQ(9, items[1]);
+  EXPECT_FALSE(index.LookupOrder(1, 2, 2, &customer, &line_count));
+  EXPECT_FALSE(index.LookupOrder(1, 3, 0, &customer, &line_count));
+
+  // Orders are delivered oldest first, once each.
+  EXPECT_TRUE(index.ClaimUndelivered(1, 2, &order));
+  EXPECT_EQ(0, order);
+  EXPECT_TRUE(index.ClaimUndelivered(1, 2, &order));
+  EXPECT_EQ(1, order);
+  EXPECT_FALSE(index.ClaimUndelivered(1, 2, &order));
+
+  // Only the last orders stay in the rings.
+  for (int i = 2; i < ORDER_INDEX_SLOTS + 10; i++)
+    index.RecordOrder(1, 2, i, i % CUSTOMERS_PER_DISTRICT, 1, first_items);
+  EXPECT_FALSE(index.LookupOrder(1, 2, 5, &customer, &line_count));
+  EXPECT_TRUE(index.LookupOrder(1, 2, 15, &customer, &line_count));
+  EXPECT_FALSE(index.LookupOrderItems(1, 2, 15, items, &line_count));
+  EXPECT_TRUE(index.ClaimUndelivered(1, 2, &order));
+  EXPECT_EQ(10, order);
+
+  // The middle one of the customers with a last name, by first name.
+  index.AddCustomer(4, 0, 7, "BARBARBAR", "C");
+  index.AddCustomer(4, 0, 8, "BARBARBAR", "A");
+  index.AddCustomer(4, 0, 9, "BARBARBAR", "B");
+  index.AddCustomer(4, 0, 10, "OUGHTBARBAR", "A");
+  EXPECT_EQ(9, index.CustomerByLastName(4, 0, "BARBARBAR"));
+  EXPECT_EQ(10, index.CustomerByLastName(4, 0, "OUGHTBARBAR"));
+  EXPECT_EQ(-1, index.CustomerByLastName(4, 0, "ABLEBARBAR"));
+  EXPECT_EQ(-1, index.CustomerByLastName(4, 1, "BARBARBAR"));
+
+  END;
+}
+
+void* RecordOrders(void* arg) {
+  TPCCIndex* index = reinterpret_cast<TPCCIndex*>(arg);
+  int items[MAX_ORDER_LINES];
+  for (int i = 0; i < RECORDED_ORDERS; i++) {
+    for (int j = 0; j < MAX_ORDER_LINES; j++)
+      items[j] = i;
+    index->RecordOrder(0, 0, i, i % CUSTOMERS_PER_DISTRICT, 1 + i % 15, items);
+  }
+  return NULL;
+}
+
+TEST(ConcurrentLookupTest) {
+  // The generator's lookups run while NewOrder txns record orders, and must
+  // only ever see orders as they were recorded.
+  TPCCIndex index;
+  pthread_t writer;
+  pthread_create(&writer, NULL, &RecordOrders, &index);
+
+  bool consistent = true;
+  int latest = -1;
+  while (latest < RECORDED_ORDERS - 1) {
+    int customer, line_count;
+    int items[MAX_ORDER_LINES];
+    if (!index.LatestOrder(0, 0, &latest))
+      continue;
+    if (index.LookupOrder(0, 0, latest, &customer, &line_count)) {
+      consistent &= (customer == latest % CUSTOMERS_PER_DISTRICT);
+      consistent &= (line_count == 1 + latest % 15);
+    }
+    if (index.LookupOrderItems(0, 0, latest, items, &line_count)) {
+      for (int j = 0; j < line_count; j++)
+        consistent &= (items[j] == latest);
+    }
+  }
+  pthread_join(writer, NULL);
+  EXPECT_TRUE(consistent);
+
+  END;
+}
+
+int main(int argc, char** argv) {
+  TPCCIndexTest();
+  ConcurrentLookupTest();
+}
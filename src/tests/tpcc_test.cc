@@ -2,12 +2,15 @@
 
 #include "applications/tpcc.h"
 
+#include "applications/tpcc_records.h"
+#include "backend/read_only_table.h"
 #include "backend/simple_storage.h"
 #include "backend/storage_manager.h"
 #include "common/configuration.h"
 #include "common/connection.h"
 #include "common/testing.h"
 #include "common/utils.h"
+#include "proto/tpcc_args.pb.h"
 
 // We make these global variables to avoid weird pointer passing and code
 // redundancy
@@ -38,17 +41,17 @@ TEST(IdGenerationTest) {
 
 // Test for creation of a warehouse, ensure the attributes are correct
 TEST(WarehouseTest) {
-  Warehouse* warehouse = tpcc->CreateWarehouse("w1");
-
-  EXPECT_EQ(warehouse->id(), "w1");
-  EXPECT_TRUE(warehouse->has_name());
-  EXPECT_TRUE(warehouse->has_street_1());
-  EXPECT_TRUE(warehouse->has_street_2());
-  EXPECT_TRUE(warehouse->has_city());
-  EXPECT_TRUE(warehouse->has_state());
-  EXPECT_TRUE(warehouse->has_zip());
-  EXPECT_EQ(warehouse->tax(), 0.05);
-  EXPECT_EQ(warehouse->year_to_date(), 0.0);
+  WarehouseRecord* warehouse = tpcc->CreateWarehouse("w1");
+
+  EXPECT_EQ(Field(warehouse->id), "w1");
+  EXPECT_EQ(Field(warehouse->name).size(), 10);
+  EXPECT_EQ(Field(warehouse->street_1).size(), 20);
+  EXPECT_EQ(Field(warehouse->street_2).size(), 20);
+  EXPECT_EQ(Field(warehouse->city).size(), 20);
+  EXPECT_EQ(Field(warehouse->state).size(), 2);
+  EXPECT_EQ(Field(warehouse->zip).size(), 9);
+  EXPECT_EQ(warehouse->tax, 0.05);
+  EXPECT_EQ(warehouse->year_to_date, 0.0);
 
   // Finish
   delete warehouse;
@@ -57,19 +60,19 @@ TEST(WarehouseTest) {
 
 // Test for creation of a district, ensure the attributes are correct
 TEST(DistrictTest) {
-  District* district = tpcc->CreateDistrict("d1", "w1");
-
-  EXPECT_EQ(district->id(), "d1");
-  EXPECT_EQ(district->warehouse_id(), "w1");
-  EXPECT_TRUE(district->has_name());
-  EXPECT_TRUE(district->has_street_1());
-  EXPECT_TRUE(district->has_street_2());
-  EXPECT_TRUE(district->has_city());
-  EXPECT_TRUE(district->has_state());
-  EXPECT_TRUE(district->has_zip());
-  EXPECT_EQ(district->tax(), 0.05);
-  EXPECT_EQ(district->year_to_date(), 0.0);
-  EXPECT_EQ(district->next_order_id(), 1);
+  DistrictRecord* district = tpcc->CreateDistrict("d1", "w1");
+
+  EXPECT_EQ(Field(district->id), "d1");
+  EXPECT_EQ(Field(district->warehouse_id), "w1");
+  EXPECT_EQ(Field(district->name).size(), 10);
+  EXPECT_EQ(Field(district->street_1).size(), 20);
+  EXPECT_EQ(Field(district->street_2).size(), 20);
+  EXPECT_EQ(Field(district->city).size(), 20);
+  EXPECT_EQ(Field(district->state).size(), 2);
+  EXPECT_EQ(Field(district->zip).size(), 9);
+  EXPECT_EQ(district->tax, 0.05);
+  EXPECT_EQ(district->year_to_date, 0.0);
+  EXPECT_EQ(district->next_order_id, 1);
 
   // Finish
   delete district;
@@ -81,28 +84,28 @@ TEST(CustomerTest) {
   // Create a transaction so the customer creation can do secondary insertion
   TxnProto* secondary_keying = new TxnProto();
   secondary_keying->set_txn_id(1);
-  Customer* customer = tpcc->CreateCustomer("c1", "d1", "w1");
-
-  EXPECT_EQ(strcmp(customer->id().c_str(), "c1"), 0);
-  EXPECT_EQ(strcmp(customer->district_id().c_str(), "d1"), 0);
-  EXPECT_EQ(strcmp(customer->warehouse_id().c_str(), "w1"), 0);
-  EXPECT_TRUE(customer->has_first());
-  EXPECT_TRUE(customer->has_middle());
-  EXPECT_TRUE(customer->has_last());
-  EXPECT_TRUE(customer->has_street_1());
-  EXPECT_TRUE(customer->has_street_2());
-  EXPECT_TRUE(customer->has_city());
-  EXPECT_TRUE(customer->has_state());
-  EXPECT_TRUE(customer->has_zip());
-  EXPECT_TRUE(customer->has_data());
-  EXPECT_EQ(customer->since(), 0);
-  EXPECT_EQ(customer->credit(), "GC");
-  EXPECT_EQ(customer->credit_limit(), 0.01);
-  EXPECT_EQ(customer->discount(), 0.5);
-  EXPECT_EQ(customer->balance(), 0);
-  EXPECT_EQ(customer->year_to_date_payment(), 0);
-  EXPECT_EQ(customer->payment_count(), 0);
-  EXPECT_EQ(customer->delivery_count(), 0);
+  CustomerRecord* customer = tpcc->CreateCustomer("c1", "d1", "w1");
+
+  EXPECT_EQ(strcmp(customer->id, "c1"), 0);
+  EXPECT_EQ(strcmp(customer->district_id, "d1"), 0);
+  EXPECT_EQ(strcmp(customer->warehouse_id, "w1"), 0);
+  EXPECT_EQ(Field(customer->first).size(), 20);
+  EXPECT_EQ(Field(customer->middle).size(), 20);
+  EXPECT_EQ(Field(customer->last), "BARBAROUGHT");
+  EXPECT_EQ(Field(customer->street_1).size(), 20);
+  EXPECT_EQ(Field(customer->street_2).size(), 20);
+  EXPECT_EQ(Field(customer->city).size(), 20);
+  EXPECT_EQ(Field(customer->state).size(), 2);
+  EXPECT_EQ(Field(customer->zip).size(), 9);
+  EXPECT_EQ(Field(customer->data).size(), 50);
+  EXPECT_EQ(customer->since, 0);
+  EXPECT_EQ(Field(customer->credit), "GC");
+  EXPECT_EQ(customer->credit_limit, 0.01);
+  EXPECT_EQ(customer->discount, 0.5);
+  EXPECT_EQ(customer->balance, 0);
+  EXPECT_EQ(customer->year_to_date_payment, 0);
+  EXPECT_EQ(customer->payment_count, 0);
+  EXPECT_EQ(customer->delivery_count, 0);
 
   // Finish
   delete secondary_keying;
@@ -112,12 +115,12 @@ TEST(CustomerTest) {
 
 // Test for creation of an item, ensure the attributes are correct
 TEST(ItemTest) {
-  Item* item = tpcc->CreateItem("i1");
+  ItemRecord* item = tpcc->CreateItem("i1");
 
-  EXPECT_EQ(item->id(), "i1");
-  EXPECT_TRUE(item->has_name());
-  EXPECT_TRUE(item->has_price());
-  EXPECT_TRUE(item->has_data());
+  EXPECT_EQ(Field(item->id), "i1");
+  EXPECT_EQ(Field(item->name).size(), 24);
+  EXPECT_TRUE(item->price >= 0 && item->price < 100);
+  EXPECT_EQ(Field(item->data).size(), 50);
 
   // Finish
   delete item;
@@ -126,16 +129,16 @@ TEST(ItemTest) {
 
 // Test for creation of a stock, ensure the attributes are correct
 TEST(StockTest) {
-  Stock* stock = tpcc->CreateStock("i1", "w1");
+  StockRecord* stock = tpcc->CreateStock("i1", "w1");
 
-  EXPECT_EQ(stock->id(), "w1si1");
-  EXPECT_EQ(stock->warehouse_id(), "w1");
-  EXPECT_EQ(stock->item_id(), "i1");
-  EXPECT_TRUE(stock->has_quantity());
-  EXPECT_TRUE(stock->has_data());
-  EXPECT_EQ(stock->year_to_date(), 0);
-  EXPECT_EQ(stock->order_count(), 0);
-  EXPECT_EQ(stock->remote_count(), 0);
+  EXPECT_EQ(Field(stock->id), "w1si1");
+  EXPECT_EQ(Field(stock->warehouse_id), "w1");
+  EXPECT_EQ(Field(stock->item_id), "i1");
+  EXPECT_TRUE(stock->quantity >= 100 && stock->quantity < 200);
+  EXPECT_EQ(Field(stock->data).size(), 50);
+  EXPECT_EQ(stock->year_to_date, 0);
+  EXPECT_EQ(stock->order_count, 0);
+  EXPECT_EQ(stock->remote_count, 0);
 
   // Finish
   delete stock;
@@ -170,10 +173,10 @@ TEST(NewTxnTest) {
   EXPECT_EQ(txn->status(), TxnProto::NEW);
 
   EXPECT_TRUE(tpcc_args->ParseFromString(txn->arg()));
-  EXPECT_TRUE(tpcc_args->order_line_count() >= 5 &&
-              tpcc_args->order_line_count() <= 15);
-  EXPECT_TRUE(txn->write_set_size() == tpcc_args->order_line_count() + 2);
-  for (int i = 0; i < tpcc_args->order_line_count(); i++)
+  EXPECT_TRUE(tpcc_args->order_line_count(0) >= 5 &&
+              tpcc_args->order_line_count(0) <= 15);
+  EXPECT_TRUE(txn->write_set_size() == tpcc_args->order_line_count(0) + 2);
+  for (int i = 0; i < tpcc_args->order_line_count(0); i++)
     EXPECT_TRUE(tpcc_args->quantities(i) <= 10 && tpcc_args->quantities(i) > 0);
 
   // Payment Transaction Generation
@@ -209,9 +212,7 @@ TEST(InitializeTest) {
     snprintf(warehouse_key, sizeof(warehouse_key), "w%d", i);
     warehouse_value = simple_store->ReadObject(warehouse_key);
 
-    Warehouse* dummy_warehouse = new Warehouse();
-    EXPECT_TRUE(dummy_warehouse->ParseFromString(*warehouse_value));
-    delete dummy_warehouse;
+    EXPECT_TRUE(RecordOf<WarehouseRecord>(warehouse_value) != NULL);
 
     // Expect all the districts to be there
     for (int j = 0; j < DISTRICTS_PER_WAREHOUSE; j++) {
@@ -221,9 +222,7 @@ TEST(InitializeTest) {
                i, j);
       district_value = simple_store->ReadObject(district_key);
 
-      District* dummy_district = new District();
-      EXPECT_TRUE(dummy_district->ParseFromString(*district_value));
-      delete dummy_district;
+      EXPECT_TRUE(RecordOf<DistrictRecord>(district_value) != NULL);
 
       // Expect all the customers to be there
       for (int k = 0; k < CUSTOMERS_PER_DISTRICT; k++) {
@@ -233,9 +232,7 @@ TEST(InitializeTest) {
                  "w%dd%dc%d", i, j, k);
         customer_value = simple_store->ReadObject(customer_key);
 
-        Customer* dummy_customer = new Customer();
-        EXPECT_TRUE(dummy_customer->ParseFromString(*customer_value));
-        delete dummy_customer;
+        EXPECT_TRUE(RecordOf<CustomerRecord>(customer_value) != NULL);
       }
     }
 
@@ -248,23 +245,15 @@ TEST(InitializeTest) {
                warehouse_key, item_key);
       stock_value = simple_store->ReadObject(stock_key);
 
-      Stock* dummy_stock = new Stock();
-      EXPECT_TRUE(dummy_stock->ParseFromString(*stock_value));
-      delete dummy_stock;
+      EXPECT_TRUE(RecordOf<StockRecord>(stock_value) != NULL);
     }
   }
 
   // Expect all items to be there
-  for (int i = 0; i < NUMBER_OF_ITEMS; i++) {
-      char item_key[128];
-      Value item_value;
-      snprintf(item_key, sizeof(item_key), "i%d", i);
-      item_value = *(tpcc->GetItem(string(item_key)));
-
-      Item* dummy_item = new Item();
-      EXPECT_TRUE(dummy_item->ParseFromString(item_value));
-      delete dummy_item;
-  }
+  EXPECT_TRUE(TPCC::Items()->frozen());
+  for (int i = 0; i < NUMBER_OF_ITEMS; i++)
+      EXPECT_TRUE(tpcc->GetItem(i) != NULL);
+  EXPECT_TRUE(tpcc->GetItem(NUMBER_OF_ITEMS) == NULL);
 
   END;
 }
@@ -284,7 +273,7 @@ TEST(NewOrderTest) {
     txn = tpcc->NewTxn(2, TPCC::NEW_ORDER, txn_args_value, config);
     assert(txn_args->ParseFromString(txn->arg()));
     invalid = false;
-    for (int i = 0; i < txn_args->order_line_count(); i++) {
+    for (int i = 0; i < txn_args->order_line_count(0); i++) {
       if (txn->read_write_set(i + 1).find("i-1") != string::npos)
         invalid = true;
     }
@@ -296,134 +285,116 @@ TEST(NewOrderTest) {
                                                txn);
 
   // Prefetch some values in order to ensure our ACIDity after
-  District *district = new District();
-  Value* district_value;
-  district_value = storage->ReadObject(txn->read_write_set(0));
-  assert(district->ParseFromString(*district_value));
-
-  // Prefetch the stocks
-  Stock* old_stocks[txn_args->order_line_count()];
-  for (int i = 0; i < txn_args->order_line_count(); i++) {
-    Value* stock_value;
-    Stock* stock = new Stock();
-    stock_value = storage->ReadObject(txn->read_write_set(i + 1));
-    assert(stock->ParseFromString(*stock_value));
-    old_stocks[i] = stock;
+  DistrictRecord* district =
+      storage->ReadRecord<DistrictRecord>(txn->read_write_set(0));
+  assert(district != NULL);
+
+  // Prefetch the stocks (copies, since execution updates them in place)
+  StockRecord old_stocks[txn_args->order_line_count(0)];
+  for (int i = 0; i < txn_args->order_line_count(0); i++) {
+    StockRecord* stock =
+        storage->ReadRecord<StockRecord>(txn->read_write_set(i + 1));
+    assert(stock != NULL);
+    old_stocks[i] = *stock;
   }
 
   // Prefetch the actual values
-  int old_next_order_id = district->next_order_id();
+  int old_next_order_id = district->next_order_id;
 
   // Execute the transaction
   tpcc->Execute(txn, storage);
 
   // Let's prefetch the keys we need for the post-check
   Key district_key = txn->read_write_set(0);
-  Key new_order_key = txn->write_set(txn_args->order_line_count());
-  Key order_key = txn->write_set(txn_args->order_line_count() + 1);
+  Key new_order_key = txn->write_set(txn_args->order_line_count(0));
+  Key order_key = txn->write_set(txn_args->order_line_count(0) + 1);
 
   // Add in all the keys and re-initialize the storage manager
   txn->add_read_set(new_order_key);
   txn->add_read_set(order_key);
-  for (int i = 0; i < txn_args->order_line_count(); i++) {
+  for (int i = 0; i < txn_args->order_line_count(0); i++) {
     txn->add_read_set(txn->write_set(i));
   }
   delete storage;
   storage = new StorageManager(config, connection, simple_store, txn);
 
   // Ensure that D_NEXT_O_ID is incremented for district
-  district_value = storage->ReadObject(district_key);
-  assert(district->ParseFromString(*district_value));
-  EXPECT_EQ(old_next_order_id + 1, district->next_order_id());
+  district = storage->ReadRecord<DistrictRecord>(district_key);
+  assert(district != NULL);
+  EXPECT_EQ(old_next_order_id + 1, district->next_order_id);
 
   // TPCC::NEW_ORDER row was inserted with appropriate fields
-  Value* new_order_value;
-  NewOrder* new_order = new NewOrder();
-  new_order_value = storage->ReadObject(new_order_key);
-  EXPECT_TRUE(new_order->ParseFromString(*new_order_value));
+  NewOrderRecord* new_order =
+      storage->ReadRecord<NewOrderRecord>(new_order_key);
+  EXPECT_TRUE(new_order != NULL);
+  EXPECT_EQ(Field(new_order->district_id), district_key);
 
   // ORDER row was inserted with appropriate fields
-  Value* order_value;
-  Order* order = new Order();
-  order_value = storage->ReadObject(order_key);
-  EXPECT_TRUE(order->ParseFromString(*order_value));
+  OrderRecord* order = storage->ReadRecord<OrderRecord>(order_key);
+  EXPECT_TRUE(order != NULL);
+  EXPECT_EQ(order->order_line_count, txn_args->order_line_count(0));
 
   // For each item in O_OL_CNT
-  for (int i = 0; i < txn_args->order_line_count(); i++) {
-    Value* stock_value;
-    Stock* stock = new Stock();
-    stock_value = storage->ReadObject(txn->read_write_set(i + 1));
-    EXPECT_TRUE(stock->ParseFromString(*stock_value));
+  for (int i = 0; i < txn_args->order_line_count(0); i++) {
+    StockRecord* stock =
+        storage->ReadRecord<StockRecord>(txn->read_write_set(i + 1));
+    EXPECT_TRUE(stock != NULL);
 
     // Check YTD, order_count, and remote_count
-    int corrected_year_to_date = old_stocks[i]->year_to_date();
-    for (int j = 0; j < txn_args->order_line_count(); j++) {
+    int corrected_year_to_date = old_stocks[i].year_to_date;
+    for (int j = 0; j < txn_args->order_line_count(0); j++) {
       if (txn->read_write_set(j + 1) == txn->read_write_set(i + 1))
         corrected_year_to_date += txn_args->quantities(j);
     }
-    EXPECT_EQ(stock->year_to_date(), corrected_year_to_date);
+    EXPECT_EQ(stock->year_to_date, corrected_year_to_date);
 
     // Check order_count
-    int corrected_order_count = old_stocks[i]->order_count();
-    for (int j = 0; j < txn_args->order_line_count(); j++) {
+    int corrected_order_count = old_stocks[i].order_count;
+    for (int j = 0; j < txn_args->order_line_count(0); j++) {
       if (txn->read_write_set(j + 1) == txn->read_write_set(i + 1))
         corrected_order_count--;
     }
-    EXPECT_EQ(stock->order_count(), corrected_order_count);
+    EXPECT_EQ(stock->order_count, corrected_order_count);
 
     // Check remote_count
     if (txn->multipartition()) {
-      int corrected_remote_count = old_stocks[i]->remote_count();
-      for (int j = 0; j < txn_args->order_line_count(); j++) {
+      int corrected_remote_count = old_stocks[i].remote_count;
+      for (int j = 0; j < txn_args->order_line_count(0); j++) {
         if (txn->read_write_set(j + 1) == txn->read_write_set(i + 1))
           corrected_remote_count++;
       }
-      EXPECT_EQ(stock->remote_count(), corrected_remote_count);
+      EXPECT_EQ(stock->remote_count, corrected_remote_count);
     }
 
     // Check stock supply decrease
-    int corrected_quantity = old_stocks[i]->quantity();
-    for (int j = 0; j < txn_args->order_line_count(); j++) {
+    int corrected_quantity = old_stocks[i].quantity;
+    for (int j = 0; j < txn_args->order_line_count(0); j++) {
       if (txn->read_write_set(j + 1) == txn->read_write_set(i + 1)) {
-        if (old_stocks[i]->quantity() >= txn_args->quantities(i) + 10)
+        if (old_stocks[i].quantity >= txn_args->quantities(i) + 10)
           corrected_quantity -= txn_args->quantities(j);
         else
           corrected_quantity -= txn_args->quantities(j) - 91;
       }
     }
-    EXPECT_EQ(stock->quantity(), corrected_quantity);
+    EXPECT_EQ(stock->quantity, corrected_quantity);
 
     // First, we check if the item is valid
     size_t item_idx = txn->read_write_set(i + 1).find("i");
     Key item_key = txn->read_write_set(i + 1).substr(item_idx, string::npos);
-    Value item_value = *(tpcc->GetItem(item_key));
-    Item* item = new Item();
-    EXPECT_TRUE(item->ParseFromString(item_value));
+    const ItemRecord* item = tpcc->GetItem(atoi(item_key.c_str() + 1));
+    EXPECT_TRUE(item != NULL);
 
     // Check the order line
-    // TODO(Thad): Get order_line_ptr from Order protobuf and deserialize from
-    // there
-//    Value* order_line_value;
-//    OrderLine* order_line = new OrderLine();
-//    order_line_value = storage->ReadObject(txn->write_set(i));
-//    EXPECT_TRUE(order_line->ParseFromString(*order_line_value));
-//    EXPECT_EQ(order_line->amount(), item->price() * txn_args->quantities(i));
-//    EXPECT_EQ(order_line->number(), i);
-
-    // Free memory
-//    delete order_line;
-    delete item;
-    delete stock;
+    OrderLineRecord* order_line =
+        storage->ReadRecord<OrderLineRecord>(txn->write_set(i));
+    EXPECT_TRUE(order_line != NULL);
+    EXPECT_EQ(order_line->amount, item->price * txn_args->quantities(i));
+    EXPECT_EQ(order_line->number, i);
   }
 
   // Free memory
-  for (int i = 0; i < txn_args->order_line_count(); i++)
-    delete old_stocks[i];
   delete txn_args;
   delete storage;
-  delete district;
-  delete order;
-  delete new_order;
   delete txn;
 
   END
@@ -451,27 +422,24 @@ TEST(PaymentTest) {
                                                txn);
 
   // Prefetch some values in order to ensure our ACIDity after
-  Warehouse *warehouse = new Warehouse();
-  Value* warehouse_value;
-  warehouse_value = storage->ReadObject(txn->read_write_set(0));
-  assert(warehouse->ParseFromString(*warehouse_value));
-  int old_warehouse_year_to_date = warehouse->year_to_date();
+  WarehouseRecord* warehouse =
+      storage->ReadRecord<WarehouseRecord>(txn->read_write_set(0));
+  assert(warehouse != NULL);
+  int old_warehouse_year_to_date = warehouse->year_to_date;
 
   // Prefetch district
-  District *district = new District();
-  Value* district_value;
-  district_value = storage->ReadObject(txn->read_write_set(1));
-  assert(district->ParseFromString(*district_value));
-  int old_district_year_to_date = district->year_to_date();
+  DistrictRecord* district =
+      storage->ReadRecord<DistrictRecord>(txn->read_write_set(1));
+  assert(district != NULL);
+  int old_district_year_to_date = district->year_to_date;
 
   // Preetch customer
-  Customer *customer = new Customer();
-  Value* customer_value;
-  customer_value = storage->ReadObject(txn->read_write_set(2));
-  assert(customer->ParseFromString(*customer_value));
-  int old_customer_year_to_date_payment = customer->year_to_date_payment();
-  int old_customer_balance = customer->balance();
-  int old_customer_payment_count = customer->payment_count();
+  CustomerRecord* customer =
+      storage->ReadRecord<CustomerRecord>(txn->read_write_set(2));
+  assert(customer != NULL);
+  int old_customer_year_to_date_payment = customer->year_to_date_payment;
+  int old_customer_balance = customer->balance;
+  int old_customer_payment_count = customer->payment_count;
 
   // Execute the transaction
   tpcc->Execute(txn, storage);
@@ -480,39 +448,36 @@ TEST(PaymentTest) {
   delete storage;
   storage = new StorageManager(config, connection, simple_store, txn);
 
-  warehouse_value = storage->ReadObject(txn->read_write_set(0));
-  assert(warehouse->ParseFromString(*warehouse_value));
-  district_value = storage->ReadObject(txn->read_write_set(1));
-  assert(district->ParseFromString(*district_value));
-  customer_value = storage->ReadObject(txn->read_write_set(2));
-  assert(customer->ParseFromString(*customer_value));
+  warehouse = storage->ReadRecord<WarehouseRecord>(txn->read_write_set(0));
+  assert(warehouse != NULL);
+  district = storage->ReadRecord<DistrictRecord>(txn->read_write_set(1));
+  assert(district != NULL);
+  customer = storage->ReadRecord<CustomerRecord>(txn->read_write_set(2));
+  assert(customer != NULL);
 
   // Check the old values against the new
-  EXPECT_EQ(warehouse->year_to_date(), old_warehouse_year_to_date +
+  EXPECT_EQ(warehouse->year_to_date, old_warehouse_year_to_date +
             txn_args->amount());
-  EXPECT_EQ(district->year_to_date(), old_district_year_to_date +
+  EXPECT_EQ(district->year_to_date, old_district_year_to_date +
             txn_args->amount());
-  EXPECT_EQ(customer->year_to_date_payment(),
+  EXPECT_EQ(customer->year_to_date_payment,
             old_customer_year_to_date_payment + txn_args->amount());
-  EXPECT_EQ(customer->balance(), old_customer_balance - txn_args->amount());
-  EXPECT_EQ(customer->payment_count(), old_customer_payment_count + 1);
+  EXPECT_EQ(customer->balance, old_customer_balance - txn_args->amount());
+  EXPECT_EQ(customer->payment_count, old_customer_payment_count + 1);
 
   // Ensure the history record is valid
-  History* history = new History();
-  Value* history_value;
-  history_value = storage->ReadObject(txn->read_set(0));
-  EXPECT_TRUE(history->ParseFromString(*history_value));
-  EXPECT_EQ(history->warehouse_id(), warehouse->id());
-  EXPECT_EQ(history->district_id(), district->id());
-  EXPECT_EQ(history->customer_id(), customer->id());
-  EXPECT_EQ(history->customer_warehouse_id(), customer->warehouse_id());
-  EXPECT_EQ(history->customer_district_id(), customer->district_id());
+  HistoryRecord* history =
+      storage->ReadRecord<HistoryRecord>(txn->read_set(0));
+  EXPECT_TRUE(history != NULL);
+  EXPECT_EQ(Field(history->warehouse_id), txn->read_write_set(0));
+  EXPECT_EQ(Field(history->district_id), txn->read_write_set(1));
+  EXPECT_EQ(Field(history->customer_id), Field(customer->id));
+  EXPECT_EQ(Field(history->customer_warehouse_id),
+            Field(customer->warehouse_id));
+  EXPECT_EQ(Field(history->customer_district_id),
+            Field(customer->district_id));
 
   // Free memory
-  delete history;
-  delete warehouse;
-  delete customer;
-  delete district;
   delete storage;
   delete txn_args;
   delete txn;
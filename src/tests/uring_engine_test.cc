@@ -0,0 +1,95 @@
+// Author: Kun Ren (kun.ren@yale.edu)
+
+#include "backend/uring_engine.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "common/testing.h"
+
+#define TEST_FILE "uring_engine_test.data"
+#define TEST_BLOCKS 64
+
+// Counts completions and wakes the test once all expected ones are in.
+class CountingCompletion : public UringEngine::Completion {
+ public:
+  explicit CountingCompletion(int expected)
+      : expected_(expected), completed_(0), failed_(0) {
+    pthread_mutex_init(&mutex_, NULL);
+    pthread_cond_init(&done_, NULL);
+  }
+  virtual void Complete(int result) {
+    pthread_mutex_lock(&mutex_);
+    completed_++;
+    if (result < 0)
+      failed_++;
+    if (completed_ == expected_)
+      pthread_cond_signal(&done_);
+    pthread_mutex_unlock(&mutex_);
+  }
+  // Waits for all expected completions and returns how many failed.
+  int Wait() {
+    pthread_mutex_lock(&mutex_);
+    while (completed_ < expected_)
+      pthread_cond_wait(&done_, &mutex_);
+    pthread_mutex_unlock(&mutex_);
+    return failed_;
+  }
+
+ private:
+  int expected_;
+  int completed_;
+  int failed_;
+  pthread_mutex_t mutex_;
+  pthread_cond_t done_;
+};
+
+TEST(UringEngineTest) {
+  remove(TEST_FILE);
+  UringEngine engine;
+  EXPECT_TRUE(engine.Open(TEST_FILE, 16, 8, 4096, false));
+
+  // Write more blocks than there are buffers, a batch at a time.
+  for (int i = 0; i < TEST_BLOCKS; i += 8) {
+    CountingCompletion writes(8);
+    int buffers[8];
+    for (int j = 0; j < 8; j++) {
+      buffers[j] = engine.AcquireBuffer();
+      memset(engine.Buffer(buffers[j]), 'a' + (i + j) % 26,
+             engine.block_size());
+      engine.QueueWrite(i + j, buffers[j], &writes);
+    }
+    engine.Submit();
+    EXPECT_EQ(0, writes.Wait());
+    for (int j = 0; j < 8; j++)
+      engine.ReleaseBuffer(buffers[j]);
+  }
+
+  // Read every block back.
+  bool correct = true;
+  for (int i = 0; i < TEST_BLOCKS; i += 8) {
+    CountingCompletion reads(8);
+    int buffers[8];
+    for (int j = 0; j < 8; j++) {
+      buffers[j] = engine.AcquireBuffer();
+      engine.QueueRead(i + j, buffers[j], &reads);
+    }
+    engine.Submit();
+    EXPECT_EQ(0, reads.Wait());
+    for (int j = 0; j < 8; j++) {
+      char* block = engine.Buffer(buffers[j]);
+      correct &= (block[0] == 'a' + (i + j) % 26);
+      correct &= (block[engine.block_size() - 1] == 'a' + (i + j) % 26);
+      engine.ReleaseBuffer(buffers[j]);
+    }
+  }
+  EXPECT_TRUE(correct);
+
+  END;
+}
+
+int main(int argc, char** argv) {
+  UringEngineTest();
+  remove(TEST_FILE);
+}